@@ -261,12 +261,19 @@ typedef struct {
 	List cluster_list;	/* list of char * */
 	uint32_t cpus_max;      /* number of cpus high range */
 	uint32_t cpus_min;      /* number of cpus low range */
+	char *cursor_cluster;	/* with page_size, return jobs from this
+				 * cluster with an id over cursor_jobid and
+				 * then from later clusters in cluster_list */
+	uint32_t cursor_jobid;
 	uint16_t duplicates;    /* report duplicate job entries */
 	int32_t exitcode;       /* exit code of job */
 	List groupid_list;	/* list of char * */
 	List jobname_list;	/* list of char * */
 	uint32_t nodes_max;     /* number of nodes high range */
 	uint32_t nodes_min;     /* number of nodes low range */
+	uint32_t page_size;	/* if set return jobs in pages of about this
+				 * many jobs from a single cluster, ordered by
+				 * job id, see slurmdb_jobs_get() */
 	List partition_list;	/* list of char * */
 	List qos_list;  	/* list of char * */
 	List resv_list;		/* list of char * */
@@ -1152,6 +1159,13 @@ extern List slurmdb_coord_remove(void *db_conn, List acct_list,
  */
 extern List slurmdb_config_get(void *db_conn);
 
+/*
+ * get slurmdbd RPC statistics from the storage
+ * RET: List of config_key_pair_t *
+ * note List needs to be freed with slurm_list_destroy() when called
+ */
+extern List slurmdb_stats_get(void *db_conn);
+
 /*
  * get info from the storage
  * IN:  slurmdb_event_cond_t *
@@ -1165,6 +1179,11 @@ extern List slurmdb_events_get(void *db_conn,
  * get info from the storage
  * returns List of slurmdb_job_rec_t *
  * note List needs to be freed with slurm_list_destroy() when called
+ *
+ * If job_cond->page_size is set at most that many jobs are returned. To
+ * get the next page set job_cond->cursor_cluster and cursor_jobid to the
+ * cluster and jobid of the last job returned. An empty list is returned
+ * once all jobs have been returned.
  */
 extern List slurmdb_jobs_get(void *db_conn, slurmdb_job_cond_t *job_cond);
 
@@ -1364,6 +1364,7 @@ void slurm_print_slurmd_status (FILE* out,
 				slurmd_status_t * slurmd_status_ptr)
 {
 	char time_str[32];
+	uint32_t i, limit_msec;
 
 	if (slurmd_status_ptr == NULL )
 		return ;
@@ -1401,6 +1402,35 @@ void slurm_print_slurmd_status (FILE* out,
 	} else
 		fprintf(out, "Last slurmctld msg time  = NONE\n");
 
+	fprintf(out, "Slurmstepd Launches      = %u (%u pre-started)\n",
+		slurmd_status_ptr->launch_cnt,
+		slurmd_status_ptr->launch_spare_cnt);
+	if (slurmd_status_ptr->launch_hist_cnt) {
+		fprintf(out, "Slurmstepd Launch Times  =");
+		limit_msec = 1;
+		for (i = 0; i < slurmd_status_ptr->launch_hist_cnt; i++) {
+			if (i + 1 < slurmd_status_ptr->launch_hist_cnt) {
+				fprintf(out, " <%ums:%u", limit_msec,
+					slurmd_status_ptr->launch_hist[i]);
+			} else {
+				fprintf(out, " >=%ums:%u", limit_msec / 10,
+					slurmd_status_ptr->launch_hist[i]);
+			}
+			limit_msec *= 10;
+		}
+		fprintf(out, "\n");
+	}
+	fprintf(out, "RPCs Processed           = %u (%u by message engine)\n",
+		slurmd_status_ptr->rpc_inline_cnt +
+		slurmd_status_ptr->rpc_queued_cnt,
+		slurmd_status_ptr->rpc_inline_cnt);
+	fprintf(out, "RPC Queue Depth          = %u (max %u)\n",
+		slurmd_status_ptr->rpc_queue_depth,
+		slurmd_status_ptr->rpc_queue_depth_max);
+	fprintf(out, "RPC Worker Threads       = %u (%u busy)\n",
+		slurmd_status_ptr->rpc_worker_cnt,
+		slurmd_status_ptr->rpc_worker_busy);
+
 	fprintf(out, "Slurmd PID               = %u\n",
 		slurmd_status_ptr->pid);
 	fprintf(out, "Slurmd Debug             = %u\n",
@@ -1101,6 +1101,134 @@ slurm_load_jobs (time_t update_time, job_info_msg_t **job_info_msg_pptr,
 	return SLURM_PROTOCOL_SUCCESS;
 }
 
+static int _cmp_job_id(const void *x, const void *y)
+{
+	uint32_t a = *(uint32_t *) x, b = *(uint32_t *) y;
+
+	if (a < b)
+		return -1;
+	if (a > b)
+		return 1;
+	return 0;
+}
+
+/* Merge a delta response into a previously loaded job table */
+static void _merge_job_delta(job_info_msg_t *job_info_ptr,
+			     job_info_delta_msg_t *delta_ptr)
+{
+	job_info_msg_t *new_ptr = delta_ptr->job_info;
+	uint32_t *drop_ids, drop_cnt, i, j;
+
+	/* Records to drop are those removed plus those being replaced */
+	drop_cnt = delta_ptr->removed_cnt + new_ptr->record_count;
+	drop_ids = xmalloc(sizeof(uint32_t) * (drop_cnt + 1));
+	if (delta_ptr->removed_cnt) {
+		memcpy(drop_ids, delta_ptr->removed_job_ids,
+		       sizeof(uint32_t) * delta_ptr->removed_cnt);
+	}
+	for (i = 0, j = delta_ptr->removed_cnt; i < new_ptr->record_count;
+	     i++, j++)
+		drop_ids[j] = new_ptr->job_array[i].job_id;
+	qsort(drop_ids, drop_cnt, sizeof(uint32_t), _cmp_job_id);
+
+	for (i = 0, j = 0; i < job_info_ptr->record_count; i++) {
+		if (drop_cnt &&
+		    bsearch(&job_info_ptr->job_array[i].job_id, drop_ids,
+			    drop_cnt, sizeof(uint32_t), _cmp_job_id)) {
+			slurm_free_job_info_members(
+				&job_info_ptr->job_array[i]);
+			continue;
+		}
+		if (i != j) {
+			memcpy(&job_info_ptr->job_array[j],
+			       &job_info_ptr->job_array[i],
+			       sizeof(job_info_t));
+		}
+		j++;
+	}
+	xfree(drop_ids);
+
+	/* Append new and changed records, the delta's records are moved
+	 * rather than copied */
+	if (new_ptr->record_count) {
+		xrealloc(job_info_ptr->job_array, sizeof(job_info_t) *
+			 (j + new_ptr->record_count));
+		memcpy(&job_info_ptr->job_array[j], new_ptr->job_array,
+		       sizeof(job_info_t) * new_ptr->record_count);
+		j += new_ptr->record_count;
+	}
+	xfree(new_ptr->job_array);
+	new_ptr->record_count = 0;
+
+	job_info_ptr->record_count = j;
+	job_info_ptr->last_update  = new_ptr->last_update;
+	job_info_ptr->generation   = new_ptr->generation;
+	job_info_ptr->gen_epoch    = new_ptr->gen_epoch;
+}
+
+/*
+ * slurm_load_jobs_delta - issue RPC to get information about jobs created,
+ *	modified or purged since a job table was loaded and merge those
+ *	changes into the table
+ * IN/OUT job_info_msg_pptr - job table to update. If *job_info_msg_pptr is
+ *	NULL, a full table is loaded. The table must have been loaded by
+ *	slurm_load_jobs_delta() with the same show_flags.
+ * IN show_flags - job filtering options
+ * RET 0 or -1 on error, the table is unchanged on error
+ * NOTE: free the table using slurm_free_job_info_msg
+ * NOTE: the order of records in the table is not preserved
+ */
+extern int slurm_load_jobs_delta(job_info_msg_t **job_info_msg_pptr,
+				 uint16_t show_flags)
+{
+	int rc;
+	slurm_msg_t resp_msg;
+	slurm_msg_t req_msg;
+	job_info_delta_request_msg_t req;
+	job_info_delta_msg_t *delta_ptr;
+	job_info_msg_t *job_info_ptr = *job_info_msg_pptr;
+
+	slurm_msg_t_init(&req_msg);
+	slurm_msg_t_init(&resp_msg);
+
+	memset(&req, 0, sizeof(job_info_delta_request_msg_t));
+	if (job_info_ptr) {
+		req.last_update = job_info_ptr->last_update;
+		req.generation  = job_info_ptr->generation;
+		req.gen_epoch   = job_info_ptr->gen_epoch;
+	}
+	req.show_flags   = show_flags;
+	req_msg.msg_type = REQUEST_JOB_INFO_DELTA;
+	req_msg.data     = &req;
+
+	if (slurm_send_recv_controller_msg(&req_msg, &resp_msg) < 0)
+		return SLURM_ERROR;
+
+	switch (resp_msg.msg_type) {
+	case RESPONSE_JOB_INFO_DELTA:
+		delta_ptr = (job_info_delta_msg_t *) resp_msg.data;
+		if (delta_ptr->full || (job_info_ptr == NULL)) {
+			slurm_free_job_info_msg(job_info_ptr);
+			*job_info_msg_pptr = delta_ptr->job_info;
+			delta_ptr->job_info = NULL;
+		} else
+			_merge_job_delta(job_info_ptr, delta_ptr);
+		slurm_free_job_info_delta_msg(delta_ptr);
+		break;
+	case RESPONSE_SLURM_RC:
+		rc = ((return_code_msg_t *) resp_msg.data)->return_code;
+		slurm_free_return_code_msg(resp_msg.data);
+		if (rc)
+			slurm_seterrno_ret(rc);
+		break;
+	default:
+		slurm_seterrno_ret(SLURM_UNEXPECTED_MSG_ERROR);
+		break;
+	}
+
+	return SLURM_PROTOCOL_SUCCESS;
+}
+
 /*
  * slurm_load_job_user - issue RPC to get slurm information about all jobs
  *	to be run as the specified user
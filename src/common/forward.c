@@ -45,11 +45,13 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <sys/time.h>
 #include <sys/types.h>
 
 #include "slurm/slurm.h"
 
 #include "src/common/forward.h"
+#include "src/common/xhash.h"
 #include "src/common/xmalloc.h"
 #include "src/common/xstring.h"
 #include "src/common/slurm_auth.h"
@@ -62,6 +64,13 @@
 
 #define MAX_RETRIES 3
 
+/* Payload size at which the tree is narrowed, so no one node must send
+ * the full payload to TreeWidth children */
+#define FORWARD_LARGE_MSG	(64 * 1024)
+/* Seconds for which a node which failed or answered slowly is kept out of
+ * the interior of the trees we build */
+#define FORWARD_SUSPECT_TIME	300
+
 typedef struct {
 	pthread_cond_t *notify;
 	int            *p_thr_count;
@@ -72,6 +81,167 @@ typedef struct {
 	pthread_mutex_t *tree_mutex;
 } fwd_tree_t;
 
+typedef struct {
+	char *node_name;
+	time_t mark_time;	/* time of last failure or slow response */
+} fwd_suspect_t;
+
+static pthread_mutex_t suspect_mutex = PTHREAD_MUTEX_INITIALIZER;
+static xhash_t *suspect_hash = NULL;	/* fwd_suspect_t by node_name */
+
+static const char *_suspect_id(void *item)
+{
+	fwd_suspect_t *fwd_suspect = (fwd_suspect_t *) item;
+	return fwd_suspect->node_name;
+}
+
+/*
+ * _mark_suspect - record that a node failed or answered slowly, or clear
+ *	that record once the node answers promptly
+ * IN node_name - node which was sent a message
+ * IN suspect - true if the node failed or was slow
+ */
+static void _mark_suspect(char *node_name, bool suspect)
+{
+	fwd_suspect_t *fwd_suspect;
+
+	if (!node_name)
+		return;
+
+	slurm_mutex_lock(&suspect_mutex);
+	if (!suspect_hash) {
+		if (!suspect) {
+			slurm_mutex_unlock(&suspect_mutex);
+			return;
+		}
+		suspect_hash = xhash_init(_suspect_id, NULL, 0);
+	}
+	fwd_suspect = xhash_get(suspect_hash, node_name);
+	if (suspect) {
+		if (!fwd_suspect) {
+			fwd_suspect = xmalloc(sizeof(fwd_suspect_t));
+			fwd_suspect->node_name = xstrdup(node_name);
+			xhash_add(suspect_hash, fwd_suspect);
+			debug2("forward: routing around %s", node_name);
+		}
+		fwd_suspect->mark_time = time(NULL);
+	} else if (fwd_suspect) {
+		xhash_delete(suspect_hash, node_name);
+		xfree(fwd_suspect->node_name);
+		xfree(fwd_suspect);
+	}
+	slurm_mutex_unlock(&suspect_mutex);
+}
+
+/*
+ * _split_suspects - remove up to max_cnt nodes which recently failed or
+ *	answered slowly from a hostlist, so they can be sent to directly
+ *	rather than forward the message to (and delay) other nodes
+ * IN/OUT hl - nodes to send to
+ * IN max_cnt - maximum number of nodes to remove
+ * RET hostlist of nodes removed or NULL if none, call hostlist_destroy()
+ */
+static hostlist_t _split_suspects(hostlist_t hl, int max_cnt)
+{
+	hostlist_t suspect_hl = NULL;
+	hostlist_iterator_t itr;
+	fwd_suspect_t *fwd_suspect;
+	time_t now = time(NULL);
+	char *name;
+	int cnt = 0;
+
+	slurm_mutex_lock(&suspect_mutex);
+	if (!suspect_hash || (xhash_count(suspect_hash) == 0)) {
+		slurm_mutex_unlock(&suspect_mutex);
+		return NULL;
+	}
+	itr = hostlist_iterator_create(hl);
+	while ((cnt < max_cnt) && (name = hostlist_next(itr))) {
+		fwd_suspect = xhash_get(suspect_hash, name);
+		if (fwd_suspect && (difftime(now, fwd_suspect->mark_time) >=
+				    FORWARD_SUSPECT_TIME)) {
+			xhash_delete(suspect_hash, name);
+			xfree(fwd_suspect->node_name);
+			xfree(fwd_suspect);
+		} else if (fwd_suspect) {
+			if (!suspect_hl)
+				suspect_hl = hostlist_create(NULL);
+			hostlist_push_host(suspect_hl, name);
+			hostlist_remove(itr);
+			cnt++;
+		}
+		free(name);
+	}
+	hostlist_iterator_destroy(itr);
+	slurm_mutex_unlock(&suspect_mutex);
+
+	return suspect_hl;
+}
+
+/*
+ * forward_tree_width - fanout to use for a message, based upon TreeWidth
+ * IN msg_type - message to be forwarded
+ * IN body_length - packed size of the message body, zero if not known
+ */
+extern uint16_t forward_tree_width(slurm_msg_type_t msg_type,
+				   uint32_t body_length)
+{
+	uint16_t tree_width = slurm_get_tree_width();
+
+#ifdef HAVE_FRONT_END
+	/* TreeWidth must cover every front end node */
+	return tree_width;
+#endif
+	switch (msg_type) {
+	case REQUEST_ACCT_GATHER_UPDATE:
+	case REQUEST_HEALTH_CHECK:
+	case REQUEST_NODE_REGISTRATION_STATUS:
+	case REQUEST_PING:
+		/* Small messages, a wider tree has fewer hops */
+		if (tree_width <= (0xfffe / 2))
+			tree_width *= 2;
+		break;
+	case REQUEST_BATCH_JOB_LAUNCH:
+	case REQUEST_FILE_BCAST:
+	case REQUEST_LAUNCH_TASKS:
+		body_length = MAX(body_length, FORWARD_LARGE_MSG);
+		break;
+	default:
+		break;
+	}
+	if ((body_length >= FORWARD_LARGE_MSG) && (tree_width > 2))
+		tree_width /= 2;
+
+	return tree_width;
+}
+
+/*
+ * _shift_tree_head - next node to send to directly, first the heads of the
+ *	tree branches built from hl, then each node in suspect_hl alone
+ * OUT direct - set if the node should forward to no others
+ * RET node name or NULL if none remain, call free()
+ */
+static char *_shift_tree_head(hostlist_t hl, hostlist_t suspect_hl,
+			      bool *direct)
+{
+	char *name = hostlist_shift(hl);
+
+	*direct = false;
+	if (!name && suspect_hl && (name = hostlist_shift(suspect_hl)))
+		*direct = true;
+	return name;
+}
+
+/* Microseconds since start */
+static long _delta_usec(struct timeval *start)
+{
+	struct timeval now;
+
+	gettimeofday(&now, NULL);
+	return ((now.tv_sec - start->tv_sec) * 1000000L) +
+	       (now.tv_usec - start->tv_usec);
+}
+
 void _destroy_tree_fwd(fwd_tree_t *fwd_tree)
 {
 	if (fwd_tree) {
@@ -104,6 +274,9 @@ void *_forward_thread(void *arg)
 	char *buf = NULL;
 	int steps = 0;
 	int start_timeout = fwd_msg->timeout;
+	struct timeval tv;
+	long usec;
+	bool slow = false;
 
 	/* repeat until we are sure the message was sent */
 	while ((name = hostlist_shift(hl))) {
@@ -120,8 +293,10 @@ void *_forward_thread(void *arg)
 			}
 			goto cleanup;
 		}
+		gettimeofday(&tv, NULL);
 		if ((fd = slurm_open_msg_conn(&addr)) < 0) {
 			error("forward_thread to %s: %m", name);
+			_mark_suspect(name, true);
 
 			slurm_mutex_lock(fwd_msg->forward_mutex);
 			mark_as_failed_forward(
@@ -169,6 +344,7 @@ void *_forward_thread(void *arg)
 				     get_buf_offset(buffer),
 				     SLURM_PROTOCOL_NO_SEND_RECV_FLAGS ) < 0) {
 			error("forward_thread: slurm_msg_sendto: %m");
+			_mark_suspect(name, true);
 
 			slurm_mutex_lock(fwd_msg->forward_mutex);
 			mark_as_failed_forward(&fwd_msg->ret_list, name,
@@ -209,7 +385,9 @@ void *_forward_thread(void *arg)
 				message_timeout =
 					slurm_get_msg_timeout() * 1000;
 			steps = (fwd_msg->header.forward.cnt+1) /
-				slurm_get_tree_width();
+				forward_tree_width(
+					fwd_msg->header.msg_type,
+					fwd_msg->header.body_length);
 			fwd_msg->timeout = (message_timeout*steps);
 /* 			info("got %d * %d = %d", message_timeout, steps, fwd_msg->timeout); */
 			steps++;
@@ -221,8 +399,17 @@ void *_forward_thread(void *arg)
 		/* info("sent %d forwards got %d back", */
 /* 		     fwd_msg->header.forward.cnt, list_count(ret_list)); */
 
+		usec = _delta_usec(&tv);
+		debug3("forward: %s and %d nodes under it answered in %ld usec",
+		       name, fwd_msg->header.forward.cnt, usec);
+		/* a node's own latency is only known if it forwards nothing */
+		if ((fwd_msg->header.forward.cnt == 0) &&
+		    (usec > (start_timeout * 500L)))
+			slow = true;
+
 		if (!ret_list || (fwd_msg->header.forward.cnt != 0
 				 && list_count(ret_list) <= 1)) {
+			_mark_suspect(name, true);
 			slurm_mutex_lock(fwd_msg->forward_mutex);
 			mark_as_failed_forward(&fwd_msg->ret_list, name,
 					       errno);
@@ -293,6 +480,11 @@ void *_forward_thread(void *arg)
 			if (!ret_data_info->node_name) {
 				ret_data_info->node_name = xstrdup(name);
 			}
+			_mark_suspect(ret_data_info->node_name,
+				      (ret_data_info->type ==
+				       RESPONSE_FORWARD_FAILED) ||
+				      (slow && !strcmp(ret_data_info->node_name,
+						       name)));
 			list_push(fwd_msg->ret_list, ret_data_info);
 			debug3("got response from %s",
 			       ret_data_info->node_name);
@@ -319,6 +511,11 @@ void *_fwd_tree_thread(void *arg)
 	char *name = NULL;
 	char *buf = NULL;
 	slurm_msg_t send_msg;
+	ret_data_info_t *ret_data_info = NULL;
+	ListIterator itr;
+	struct timeval tv;
+	long usec;
+	bool slow;
 
 	slurm_msg_t_init(&send_msg);
 	send_msg.msg_type = fwd_tree->orig_msg->msg_type;
@@ -354,13 +551,33 @@ void *_fwd_tree_thread(void *arg)
 		} else
 			debug3("Tree sending to %s", name);
 
+		gettimeofday(&tv, NULL);
 		ret_list = slurm_send_addr_recv_msgs(&send_msg, name,
 						     fwd_tree->timeout);
+		usec = _delta_usec(&tv);
+		debug3("Tree %s and %d nodes under it answered in %ld usec",
+		       name, send_msg.forward.cnt, usec);
 
 		xfree(send_msg.forward.nodelist);
 
 		if (ret_list) {
 			int ret_cnt = list_count(ret_list);
+
+			/* a node's own latency is only known if it forwards
+			 * nothing */
+			slow = ((send_msg.forward.cnt == 0) &&
+				(usec > (fwd_tree->timeout * 500L)));
+			itr = list_iterator_create(ret_list);
+			while ((ret_data_info = list_next(itr))) {
+				_mark_suspect(ret_data_info->node_name,
+					      (ret_data_info->type ==
+					       RESPONSE_FORWARD_FAILED) ||
+					      (slow && ret_data_info->node_name &&
+					       !strcmp(ret_data_info->node_name,
+						       name)));
+			}
+			list_iterator_destroy(itr);
+
 			/* This is most common if a slurmd is running
 			   an older version of Slurm than the
 			   originator of the message.
@@ -372,9 +589,7 @@ void *_fwd_tree_thread(void *arg)
 				      "%d",
 				      name, send_msg.forward.cnt + 1, ret_cnt);
 				if (ret_cnt > 1) { /* not likely */
-					ret_data_info_t *ret_data_info = NULL;
-					ListIterator itr =
-						list_iterator_create(ret_list);
+					itr = list_iterator_create(ret_list);
 					while ((ret_data_info =
 						list_next(itr))) {
 						if (strcmp(ret_data_info->
@@ -406,6 +621,7 @@ void *_fwd_tree_thread(void *arg)
 			error("fwd_tree_thread: no return list given from "
 			      "slurm_send_addr_recv_msgs spawned for %s",
 			      name);
+			_mark_suspect(name, true);
 			slurm_mutex_lock(fwd_tree->tree_mutex);
 			mark_as_failed_forward(
 				&fwd_tree->ret_list, name,
@@ -472,20 +688,27 @@ extern int forward_msg(forward_struct_t *forward_struct,
 	int retries = 0;
 	forward_msg_t *forward_msg = NULL;
 	int thr_count = 0;
-	int *span = set_span(header->forward.cnt, 0);
+	int *span = NULL;
+	uint16_t tree_width;
 	hostlist_t hl = NULL;
 	hostlist_t forward_hl = NULL;
+	hostlist_t suspect_hl = NULL;
 	char *name = NULL;
+	bool direct;
 
 	if (!forward_struct->ret_list) {
 		error("didn't get a ret_list from forward_struct");
-		xfree(span);
 		return SLURM_ERROR;
 	}
 	hl = hostlist_create(header->forward.nodelist);
 	hostlist_uniq(hl);
 
-	while ((name = hostlist_shift(hl))) {
+	tree_width = forward_tree_width(header->msg_type,
+					header->body_length);
+	suspect_hl = _split_suspects(hl, tree_width);
+	span = set_span(hostlist_count(hl), tree_width);
+
+	while ((name = _shift_tree_head(hl, suspect_hl, &direct))) {
 		pthread_attr_t attr_agent;
 		pthread_t thread_agent;
 		char *buf = NULL;
@@ -523,7 +746,7 @@ extern int forward_msg(forward_struct_t *forward_struct,
 
 		forward_hl = hostlist_create(name);
 		free(name);
-		for(j = 0; j < span[thr_count]; j++) {
+		for (j = 0; !direct && (j < span[thr_count]); j++) {
 			name = hostlist_shift(hl);
 			if (!name)
 				break;
@@ -547,6 +770,8 @@ extern int forward_msg(forward_struct_t *forward_struct,
 		thr_count++;
 	}
 	hostlist_destroy(hl);
+	if (suspect_hl)
+		hostlist_destroy(suspect_hl);
 	xfree(span);
 	return SLURM_SUCCESS;
 }
@@ -574,21 +799,32 @@ extern List start_msg_tree(hostlist_t hl, slurm_msg_t *msg, int timeout)
 	char *name = NULL;
 	int thr_count = 0;
 	int host_count = 0;
+	int branch = 0, suspect_cnt = 0;
+	uint16_t tree_width;
+	hostlist_t suspect_hl = NULL;
+	bool direct;
+	struct timeval tv;
 
 	xassert(hl);
 	xassert(msg);
 
+	gettimeofday(&tv, NULL);
 	hostlist_uniq(hl);
 	host_count = hostlist_count(hl);
 
-	span = set_span(host_count, 0);
+	/* Nodes which recently failed or answered slowly are sent to
+	 * directly, so they can not delay the nodes under them */
+	tree_width = forward_tree_width(msg->msg_type, 0);
+	if ((suspect_hl = _split_suspects(hl, tree_width)))
+		suspect_cnt = hostlist_count(suspect_hl);
+	span = set_span(hostlist_count(hl), tree_width);
 
 	slurm_mutex_init(&tree_mutex);
 	pthread_cond_init(&notify, NULL);
 
 	ret_list = list_create(destroy_data_info);
 
-	while ((name = hostlist_shift(hl))) {
+	while ((name = _shift_tree_head(hl, suspect_hl, &direct))) {
 		pthread_attr_t attr_agent;
 		pthread_t thread_agent;
 		int retries = 0;
@@ -613,13 +849,15 @@ extern List start_msg_tree(hostlist_t hl, slurm_msg_t *msg, int timeout)
 
 		fwd_tree->tree_hl = hostlist_create(name);
 		free(name);
-		for (j = 0; j < span[thr_count]; j++) {
+		for (j = 0; !direct && (j < span[branch]); j++) {
 			name = hostlist_shift(hl);
 			if (!name)
 				break;
 			hostlist_push(fwd_tree->tree_hl, name);
 			free(name);
 		}
+		if (!direct)
+			branch++;
 
 		/*
 		 * Lock and increase thread counter, we need that to protect
@@ -643,6 +881,8 @@ extern List start_msg_tree(hostlist_t hl, slurm_msg_t *msg, int timeout)
 
 	}
 	xfree(span);
+	if (suspect_hl)
+		hostlist_destroy(suspect_hl);
 
 	slurm_mutex_lock(&tree_mutex);
 
@@ -660,6 +900,10 @@ extern List start_msg_tree(hostlist_t hl, slurm_msg_t *msg, int timeout)
 	slurm_mutex_destroy(&tree_mutex);
 	pthread_cond_destroy(&notify);
 
+	debug2("Tree head sent msg_type %u to %d nodes (width %u, %d sent "
+	       "directly) in %ld usec", msg->msg_type, host_count, tree_width,
+	       suspect_cnt, _delta_usec(&tv));
+
 	return ret_list;
 }
 
@@ -103,6 +103,16 @@ extern int forward_msg(forward_struct_t *forward_struct,
  */
 extern List start_msg_tree(hostlist_t hl, slurm_msg_t *msg, int timeout);
 
+/*
+ * forward_tree_width - fanout used to forward a message, which is TreeWidth
+ *	widened for small messages and narrowed for large ones
+ * IN msg_type - message to be forwarded
+ * IN body_length - packed size of the message body, zero if not known
+ * RET fanout
+ */
+extern uint16_t forward_tree_width(slurm_msg_type_t msg_type,
+				   uint32_t body_length);
+
 /*
  * mark_as_failed_forward- mark a node as failed and add it to "ret_list"
  *
@@ -73,6 +73,8 @@ typedef struct slurm_acct_storage_ops {
 				    char *cluster_name);
 	int  (*close_conn)         (void **db_conn);
 	int  (*commit)             (void *db_conn, bool commit);
+	int  (*batch_start)        (void *db_conn);
+	int  (*batch_end)          (void *db_conn, bool commit);
 	int  (*add_users)          (void *db_conn, uint32_t uid,
 				    List user_list);
 	int  (*add_coord)          (void *db_conn, uint32_t uid,
@@ -198,6 +200,8 @@ static const char *syms[] = {
 	"acct_storage_p_get_connection",
 	"acct_storage_p_close_connection",
 	"acct_storage_p_commit",
+	"acct_storage_p_batch_start",
+	"acct_storage_p_batch_end",
 	"acct_storage_p_add_users",
 	"acct_storage_p_add_coord",
 	"acct_storage_p_add_accts",
@@ -336,6 +340,20 @@ extern int acct_storage_g_commit(void *db_conn, bool commit)
 
 }
 
+extern int acct_storage_g_batch_start(void *db_conn)
+{
+	if (slurm_acct_storage_init(NULL) < 0)
+		return SLURM_ERROR;
+	return (*(ops.batch_start))(db_conn);
+}
+
+extern int acct_storage_g_batch_end(void *db_conn, bool commit)
+{
+	if (slurm_acct_storage_init(NULL) < 0)
+		return SLURM_ERROR;
+	return (*(ops.batch_end))(db_conn, commit);
+}
+
 extern int acct_storage_g_add_users(void *db_conn, uint32_t uid,
 				    List user_list)
 {
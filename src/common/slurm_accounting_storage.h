@@ -82,6 +82,25 @@ extern int acct_storage_g_close_connection(void **db_conn);
  */
 extern int acct_storage_g_commit(void *db_conn, bool commit);
 
+/*
+ * make the changes of the following requests in one transaction, ended
+ * by acct_storage_g_batch_end(). Only connections which do not permit
+ * rollback may be batched.
+ * IN: void * pointer returned from acct_storage_g_get_connection()
+ * RET: SLURM_SUCCESS if a transaction was started, SLURM_ERROR if the
+ *      storage or connection does not support it
+ */
+extern int acct_storage_g_batch_start(void *db_conn);
+
+/*
+ * end a transaction started by acct_storage_g_batch_start()
+ * IN: void * pointer returned from acct_storage_g_get_connection()
+ * IN: bool - true will commit changes false will rollback
+ * RET: SLURM_SUCCESS if changes were committed (or rolled back as
+ *      requested), SLURM_ERROR if they were lost
+ */
+extern int acct_storage_g_batch_end(void *db_conn, bool commit);
+
 /*
  * add users to accounting system
  * IN:  user_list List of slurmdb_user_rec_t *
@@ -0,0 +1,189 @@
+/*****************************************************************************\
+ *  slurm_lz.c - fast LZ77 style compression of memory blocks
+ *****************************************************************************
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+
+/*
+ * The compressed data is a sequence of items, each starting with a
+ * control byte:
+ *
+ *   000LLLLL                  a run of L+1 literal bytes follows
+ *   LLLOOOOO OOOOOOOO         copy L+2 bytes from O+1 bytes back in the
+ *                             output, for L of 1 to 6
+ *   111OOOOO LLLLLLLL OOOOOOOO  copy L+9 bytes from O+1 bytes back
+ *
+ * Matches are found through a hash table of the last position at which
+ * each three byte sequence was seen, so both directions run in a single
+ * pass with no allocation other than the table.
+ */
+
+#if HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <string.h>
+
+#include "src/common/slurm_lz.h"
+#include "src/common/xmalloc.h"
+
+#define LZ_HASH_BITS	14
+#define LZ_HASH_SIZE	(1 << LZ_HASH_BITS)
+#define LZ_MAX_LIT	(1 << 5)		/* longest literal run */
+#define LZ_MAX_OFF	(1 << 13)		/* farthest match */
+#define LZ_MAX_MATCH	((1 << 8) + 8)		/* longest match */
+
+#define LZ_HASH(p) \
+	((((uint32_t) (p)[0] << 16 | (uint32_t) (p)[1] << 8 | (p)[2]) * \
+	  2654435761U) >> (32 - LZ_HASH_BITS))
+
+extern uint32_t slurm_lz_compress(const char *in, uint32_t in_len,
+				  char *out, uint32_t out_len)
+{
+	const uint8_t *ip = (const uint8_t *) in;
+	const uint8_t *in_start = ip, *in_end = ip + in_len;
+	const uint8_t *ref;
+	uint8_t *op = (uint8_t *) out, *out_end = op + out_len;
+	uint8_t *lit_hdr;
+	uint32_t *htab, hval, pos, off, len, max_len;
+	int lit = 0;
+
+	if ((in_len == 0) || (out_len == 0))
+		return 0;
+
+	/* Table entries hold a position plus one, zero is unused */
+	htab = xmalloc(sizeof(uint32_t) * LZ_HASH_SIZE);
+
+	/* Always keep room for the header of the current literal run */
+	lit_hdr = op++;
+	while (ip < in_end) {
+		if (ip + 2 < in_end) {
+			hval = LZ_HASH(ip);
+			pos = htab[hval];
+			htab[hval] = ip - in_start + 1;
+			off = ip - in_start - pos;
+			if (pos && (off < LZ_MAX_OFF) &&
+			    !memcmp(in_start + pos - 1, ip, 3)) {
+				ref = in_start + pos - 1;
+				max_len = in_end - ip;
+				if (max_len > LZ_MAX_MATCH)
+					max_len = LZ_MAX_MATCH;
+				len = 3;
+				while ((len < max_len) && (ref[len] == ip[len]))
+					len++;
+
+				/* Close the literal run, dropping its
+				 * header if it is empty */
+				if (lit)
+					*lit_hdr = lit - 1;
+				else
+					op--;
+				if (op + 4 > out_end)
+					goto too_big;
+				len -= 2;
+				if (len < 7) {
+					*op++ = (len << 5) | (off >> 8);
+				} else {
+					*op++ = (7 << 5) | (off >> 8);
+					*op++ = len - 7;
+				}
+				*op++ = off & 0xff;
+				ip += len + 2;
+
+				lit = 0;
+				lit_hdr = op++;
+				continue;
+			}
+		}
+
+		if (op >= out_end)
+			goto too_big;
+		*op++ = *ip++;
+		if (++lit == LZ_MAX_LIT) {
+			*lit_hdr = lit - 1;
+			if (op >= out_end)
+				goto too_big;
+			lit = 0;
+			lit_hdr = op++;
+		}
+	}
+	if (lit)
+		*lit_hdr = lit - 1;
+	else
+		op--;
+
+	xfree(htab);
+	return (op - (uint8_t *) out);
+
+too_big:
+	xfree(htab);
+	return 0;
+}
+
+extern uint32_t slurm_lz_decompress(const char *in, uint32_t in_len,
+				    char *out, uint32_t out_len)
+{
+	const uint8_t *ip = (const uint8_t *) in, *in_end = ip + in_len;
+	uint8_t *op = (uint8_t *) out, *out_end = op + out_len;
+	uint8_t *ref;
+	uint32_t ctrl, len;
+
+	while (ip < in_end) {
+		ctrl = *ip++;
+		if (ctrl < LZ_MAX_LIT) {
+			len = ctrl + 1;
+			if ((ip + len > in_end) || (op + len > out_end))
+				return 0;
+			memcpy(op, ip, len);
+			op += len;
+			ip += len;
+			continue;
+		}
+
+		len = ctrl >> 5;
+		if (len == 7) {
+			if (ip >= in_end)
+				return 0;
+			len += *ip++;
+		}
+		if (ip >= in_end)
+			return 0;
+		ref = op - ((ctrl & 0x1f) << 8) - *ip++ - 1;
+		len += 2;
+		if ((ref < (uint8_t *) out) || (op + len > out_end))
+			return 0;
+		/* The source and destination may overlap, so copy bytewise */
+		while (len--)
+			*op++ = *ref++;
+	}
+
+	return (op - (uint8_t *) out);
+}
@@ -0,0 +1,69 @@
+/*****************************************************************************\
+ *  slurm_lz.h - fast LZ77 style compression of memory blocks
+ *****************************************************************************
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+
+#ifndef _SLURM_LZ_H
+#define _SLURM_LZ_H
+
+#include <inttypes.h>
+
+/* Greatest ratio of original to compressed size, a three byte copy
+ * token restores at most 264 bytes */
+#define SLURM_LZ_MAX_RATIO	88
+
+/*
+ * slurm_lz_compress - Compress a block of memory. The compression favors
+ *	speed over ratio, so that compressing a block takes less time than
+ *	sending the bytes saved over the network.
+ * IN in - data to compress
+ * IN in_len - bytes of data
+ * OUT out - buffer for the compressed data
+ * IN out_len - size of out, normally less than in_len
+ * RET size of the compressed data or zero if it would not fit in out_len
+ */
+extern uint32_t slurm_lz_compress(const char *in, uint32_t in_len,
+				  char *out, uint32_t out_len);
+
+/*
+ * slurm_lz_decompress - Restore a block compressed by slurm_lz_compress()
+ * IN in - compressed data
+ * IN in_len - bytes of compressed data
+ * OUT out - buffer for the original data
+ * IN out_len - size of out
+ * RET size of the original data or zero if the compressed data is invalid
+ *	or would not fit in out_len
+ */
+extern uint32_t slurm_lz_decompress(const char *in, uint32_t in_len,
+				    char *out, uint32_t out_len);
+
+#endif /* !_SLURM_LZ_H */
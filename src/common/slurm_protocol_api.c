@@ -3539,7 +3539,7 @@ _send_and_recv_msgs(slurm_fd_t fd, slurm_msg_t *req, int timeout)
 			if (message_timeout < 0)
 				message_timeout = slurm_get_msg_timeout() * 1000;
 			steps = req->forward.cnt + 1;
-			width = slurm_get_tree_width();
+			width = forward_tree_width(req->msg_type, 0);
 			if (width)
 				steps /= width;
 			timeout = (message_timeout * steps);
@@ -239,6 +239,8 @@ typedef enum {
 	RESPONSE_STATS_RESET,
 	REQUEST_JOB_USER_INFO,
 	REQUEST_NODE_INFO_SINGLE,
+	REQUEST_JOB_INFO_DELTA,
+	RESPONSE_JOB_INFO_DELTA,
 
 	REQUEST_UPDATE_JOB = 3001,
 	REQUEST_UPDATE_NODE,
@@ -531,6 +533,23 @@ typedef struct job_info_request_msg {
 	uint16_t show_flags;
 } job_info_request_msg_t;
 
+typedef struct job_info_delta_request_msg {
+	time_t last_update;	/* time of client's job information */
+	uint32_t generation;	/* job table generation of client's
+				 * information, zero for full table */
+	time_t gen_epoch;	/* epoch of client's generation */
+	uint16_t show_flags;
+} job_info_delta_request_msg_t;
+
+typedef struct job_info_delta_msg {
+	job_info_msg_t *job_info;	/* new and changed jobs, or the full
+					 * table if "full" is set */
+	uint16_t full;			/* set if job_info replaces the
+					 * client's entire table */
+	uint32_t removed_cnt;		/* count of removed_job_ids */
+	uint32_t *removed_job_ids;	/* jobs purged or no longer visible */
+} job_info_delta_msg_t;
+
 typedef struct job_step_info_request_msg {
 	time_t last_update;
 	uint32_t job_id;
@@ -952,8 +971,19 @@ typedef struct file_bcast_msg {
 	sbcast_cred_t *cred;	/* credential for the RPC */
 	uint32_t block_len;	/* length of this data block */
 	char *block;		/* data for this block */
+	uint64_t block_offset;	/* file offset of this block, zero from
+				 * clients which send blocks in order */
+	uint16_t compress;	/* FILE_BCAST_COMPRESS_* of block */
+	uint32_t uncomp_len;	/* length of block once uncompressed */
 } file_bcast_msg_t;
 
+/* file_bcast_msg_t compress values */
+#define FILE_BCAST_COMPRESS_NONE	0
+#define FILE_BCAST_COMPRESS_LZ		1	/* see src/common/slurm_lz.h */
+
+/* Largest uncomp_len accepted, larger blocks are sent uncompressed */
+#define FILE_BCAST_MAX_UNCOMP_LEN	(64 * 1024 * 1024)
+
 typedef struct multi_core_data {
 	uint16_t boards_per_node;	/* boards per node required by job   */
 	uint16_t sockets_per_board;	/* sockets per board required by job */
@@ -1087,6 +1117,8 @@ extern void slurm_free_last_update_msg(last_update_msg_t * msg);
 extern void slurm_free_return_code_msg(return_code_msg_t * msg);
 extern void slurm_free_job_alloc_info_msg(job_alloc_info_msg_t * msg);
 extern void slurm_free_job_info_request_msg(job_info_request_msg_t *msg);
+extern void slurm_free_job_info_delta_request_msg(
+		job_info_delta_request_msg_t *msg);
 extern void slurm_free_job_step_info_request_msg(
 		job_step_info_request_msg_t *msg);
 extern void slurm_free_front_end_info_request_msg(
@@ -1194,6 +1226,7 @@ extern void slurm_free_submit_response_response_msg(
 		submit_response_msg_t * msg);
 extern void slurm_free_ctl_conf(slurm_ctl_conf_info_msg_t * config_ptr);
 extern void slurm_free_job_info_msg(job_info_msg_t * job_buffer_ptr);
+extern void slurm_free_job_info_delta_msg(job_info_delta_msg_t *msg);
 extern void slurm_free_job_step_info_response_msg(
 		job_step_info_response_msg_t * msg);
 extern void slurm_free_job_step_info_members (job_step_info_t * msg);
@@ -1239,6 +1272,9 @@ extern uint16_t preempt_mode_num(const char *preempt_mode);
 extern char *log_num2string(uint16_t inx);
 extern uint16_t log_string2num(char *name);
 
+/* Convert the message type of an RPC processed by slurmctld to a string */
+extern char *rpc_num2string(uint16_t msg_type);
+
 /* Convert HealthCheckNodeState numeric value to a string.
  * Caller must xfree() the return value */
 extern char *health_check_node_state_str(uint16_t node_state);
@@ -345,6 +345,12 @@ static void _pack_job_info_request_msg(job_info_request_msg_t *
 static int _unpack_job_info_request_msg(job_info_request_msg_t**
 					msg, Buf buffer,
 					uint16_t protocol_version);
+static void _pack_job_info_delta_request_msg(
+		job_info_delta_request_msg_t *msg, Buf buffer,
+		uint16_t protocol_version);
+static int _unpack_job_info_delta_request_msg(
+		job_info_delta_request_msg_t **msg, Buf buffer,
+		uint16_t protocol_version);
 
 static void _pack_block_info_req_msg(block_info_request_msg_t *
 				     msg, Buf buffer,
@@ -433,6 +439,8 @@ static int _unpack_job_desc_msg(job_desc_msg_t ** job_desc_buffer_ptr,
 				uint16_t protocol_version);
 static int _unpack_job_info_msg(job_info_msg_t ** msg, Buf buffer,
 				uint16_t protocol_version);
+static int _unpack_job_info_delta_msg(job_info_delta_msg_t **msg, Buf buffer,
+				      uint16_t protocol_version);
 
 static void _pack_last_update_msg(last_update_msg_t * msg, Buf buffer,
 				  uint16_t protocol_version);
@@ -793,6 +801,7 @@ pack_msg(slurm_msg_t const *msg, Buf buffer)
 					 msg->protocol_version);
 		break;
 	case RESPONSE_JOB_INFO:
+	case RESPONSE_JOB_INFO_DELTA:
 		_pack_job_info_msg((slurm_msg_t *) msg, buffer);
 		break;
 	case RESPONSE_PARTITION_INFO:
@@ -969,6 +978,11 @@ pack_msg(slurm_msg_t const *msg, Buf buffer)
 					   msg->data, buffer,
 					   msg->protocol_version);
 		break;
+	case REQUEST_JOB_INFO_DELTA:
+		_pack_job_info_delta_request_msg(
+			(job_info_delta_request_msg_t *) msg->data, buffer,
+			msg->protocol_version);
+		break;
 	case REQUEST_CANCEL_JOB_STEP:
 	case SRUN_STEP_SIGNAL:
 		_pack_job_step_kill_msg((job_step_kill_msg_t *)
@@ -1377,6 +1391,11 @@ unpack_msg(slurm_msg_t * msg, Buf buffer)
 					  buffer,
 					  msg->protocol_version);
 		break;
+	case RESPONSE_JOB_INFO_DELTA:
+		rc = _unpack_job_info_delta_msg((job_info_delta_msg_t **)
+						&(msg->data), buffer,
+						msg->protocol_version);
+		break;
 	case RESPONSE_PARTITION_INFO:
 		rc = _unpack_partition_info_msg((partition_info_msg_t **) &
 						(msg->data), buffer,
@@ -1566,6 +1585,11 @@ unpack_msg(slurm_msg_t * msg, Buf buffer)
 						  & (msg->data), buffer,
 						  msg->protocol_version);
 		break;
+	case REQUEST_JOB_INFO_DELTA:
+		rc = _unpack_job_info_delta_request_msg(
+			(job_info_delta_request_msg_t **) &(msg->data),
+			buffer, msg->protocol_version);
+		break;
 	case REQUEST_CANCEL_JOB_STEP:
 	case SRUN_STEP_SIGNAL:
 		rc = _unpack_job_step_kill_msg((job_step_kill_msg_t **)
@@ -4360,6 +4384,48 @@ unpack_error:
 	return SLURM_ERROR;
 }
 
+static int
+_unpack_job_info_delta_msg(job_info_delta_msg_t **msg, Buf buffer,
+			   uint16_t protocol_version)
+{
+	int i;
+	job_info_t *job = NULL;
+	job_info_msg_t *job_info;
+
+	xassert(msg != NULL);
+	*msg = xmalloc(sizeof(job_info_delta_msg_t));
+	job_info = (*msg)->job_info = xmalloc(sizeof(job_info_msg_t));
+
+	if (protocol_version >= SLURM_14_03_PROTOCOL_VERSION) {
+		safe_unpack32(&job_info->record_count, buffer);
+		safe_unpack_time(&job_info->last_update, buffer);
+		safe_unpack32(&job_info->generation, buffer);
+		safe_unpack_time(&job_info->gen_epoch, buffer);
+		safe_unpack16(&(*msg)->full, buffer);
+		job = job_info->job_array =
+			xmalloc(sizeof(job_info_t) * job_info->record_count);
+
+		/* load individual job info */
+		for (i = 0; i < job_info->record_count; i++) {
+			if (_unpack_job_info_members(&job[i], buffer,
+						     protocol_version))
+				goto unpack_error;
+		}
+		safe_unpack32_array(&(*msg)->removed_job_ids,
+				    &(*msg)->removed_cnt, buffer);
+	} else {
+		error("_unpack_job_info_delta_msg: protocol_version "
+		      "%hu not supported", protocol_version);
+		goto unpack_error;
+	}
+	return SLURM_SUCCESS;
+
+unpack_error:
+	slurm_free_job_info_delta_msg(*msg);
+	*msg = NULL;
+	return SLURM_ERROR;
+}
+
 /* _unpack_job_info_members
  * unpacks a set of slurm job info for one job
  * OUT job - pointer to the job info buffer
@@ -8800,6 +8866,37 @@ unpack_error:
 	return SLURM_ERROR;
 }
 
+static void
+_pack_job_info_delta_request_msg(job_info_delta_request_msg_t *msg,
+				 Buf buffer, uint16_t protocol_version)
+{
+	pack_time(msg->last_update, buffer);
+	pack32(msg->generation, buffer);
+	pack_time(msg->gen_epoch, buffer);
+	pack16(msg->show_flags, buffer);
+}
+
+static int
+_unpack_job_info_delta_request_msg(job_info_delta_request_msg_t **msg,
+				   Buf buffer, uint16_t protocol_version)
+{
+	job_info_delta_request_msg_t *job_info;
+
+	job_info = xmalloc(sizeof(job_info_delta_request_msg_t));
+	*msg = job_info;
+
+	safe_unpack_time(&job_info->last_update, buffer);
+	safe_unpack32(&job_info->generation, buffer);
+	safe_unpack_time(&job_info->gen_epoch, buffer);
+	safe_unpack16(&job_info->show_flags, buffer);
+	return SLURM_SUCCESS;
+
+unpack_error:
+	slurm_free_job_info_delta_request_msg(job_info);
+	*msg = NULL;
+	return SLURM_ERROR;
+}
+
 static void
 _pack_block_info_req_msg(block_info_request_msg_t *msg, Buf buffer,
 			 uint16_t protocol_version)
@@ -10529,6 +10626,9 @@ static void _pack_file_bcast(file_bcast_msg_t * msg , Buf buffer,
 		packstr ( msg->fname, buffer );
 		pack32 ( msg->block_len, buffer );
 		packmem ( msg->block, msg->block_len, buffer );
+		pack64 ( msg->block_offset, buffer );
+		pack16 ( msg->compress, buffer );
+		pack32 ( msg->uncomp_len, buffer );
 		pack_sbcast_cred( msg->cred, buffer );
 	} else {
 		pack16 ( msg->block_no, buffer );
@@ -10578,6 +10678,9 @@ static int _unpack_file_bcast(file_bcast_msg_t ** msg_ptr , Buf buffer,
 		safe_unpackmem_xmalloc ( & msg->block, &uint32_tmp , buffer ) ;
 		if ( uint32_tmp != msg->block_len )
 			goto unpack_error;
+		safe_unpack64 ( & msg->block_offset, buffer );
+		safe_unpack16 ( & msg->compress, buffer );
+		safe_unpack32 ( & msg->uncomp_len, buffer );
 
 		msg->cred = unpack_sbcast_cred( buffer );
 		if (msg->cred == NULL)
@@ -10908,7 +11011,36 @@ static void _pack_slurmd_status(slurmd_status_t *msg, Buf buffer,
 {
 	xassert(msg);
 
-	if (protocol_version >= SLURM_2_5_PROTOCOL_VERSION) {
+	if (protocol_version >= SLURM_14_03_PROTOCOL_VERSION) {
+		pack_time(msg->booted, buffer);
+		pack_time(msg->last_slurmctld_msg, buffer);
+
+		pack16(msg->slurmd_debug, buffer);
+		pack16(msg->actual_cpus, buffer);
+		pack16(msg->actual_boards, buffer);
+		pack16(msg->actual_sockets, buffer);
+		pack16(msg->actual_cores, buffer);
+		pack16(msg->actual_threads, buffer);
+
+		pack32(msg->actual_real_mem, buffer);
+		pack32(msg->actual_tmp_disk, buffer);
+		pack32(msg->pid, buffer);
+
+		packstr(msg->hostname, buffer);
+		packstr(msg->slurmd_logfile, buffer);
+		packstr(msg->step_list, buffer);
+		packstr(msg->version, buffer);
+
+		pack32(msg->launch_cnt, buffer);
+		pack32(msg->launch_spare_cnt, buffer);
+		pack32_array(msg->launch_hist, msg->launch_hist_cnt, buffer);
+		pack32(msg->rpc_inline_cnt, buffer);
+		pack32(msg->rpc_queued_cnt, buffer);
+		pack32(msg->rpc_queue_depth, buffer);
+		pack32(msg->rpc_queue_depth_max, buffer);
+		pack32(msg->rpc_worker_cnt, buffer);
+		pack32(msg->rpc_worker_busy, buffer);
+	} else if (protocol_version >= SLURM_2_5_PROTOCOL_VERSION) {
 		pack_time(msg->booted, buffer);
 		pack_time(msg->last_slurmctld_msg, buffer);
 
@@ -10943,7 +11075,41 @@ static int _unpack_slurmd_status(slurmd_status_t **msg_ptr, Buf buffer,
 
 	msg = xmalloc(sizeof(slurmd_status_t));
 
-	if (protocol_version >= SLURM_2_5_PROTOCOL_VERSION) {
+	if (protocol_version >= SLURM_14_03_PROTOCOL_VERSION) {
+		safe_unpack_time(&msg->booted, buffer);
+		safe_unpack_time(&msg->last_slurmctld_msg, buffer);
+
+		safe_unpack16(&msg->slurmd_debug, buffer);
+		safe_unpack16(&msg->actual_cpus, buffer);
+		safe_unpack16(&msg->actual_boards, buffer);
+		safe_unpack16(&msg->actual_sockets, buffer);
+		safe_unpack16(&msg->actual_cores, buffer);
+		safe_unpack16(&msg->actual_threads, buffer);
+
+		safe_unpack32(&msg->actual_real_mem, buffer);
+		safe_unpack32(&msg->actual_tmp_disk, buffer);
+		safe_unpack32(&msg->pid, buffer);
+
+		safe_unpackstr_xmalloc(&msg->hostname,
+					&uint32_tmp, buffer);
+		safe_unpackstr_xmalloc(&msg->slurmd_logfile,
+					&uint32_tmp, buffer);
+		safe_unpackstr_xmalloc(&msg->step_list,
+					&uint32_tmp, buffer);
+		safe_unpackstr_xmalloc(&msg->version,
+					&uint32_tmp, buffer);
+
+		safe_unpack32(&msg->launch_cnt, buffer);
+		safe_unpack32(&msg->launch_spare_cnt, buffer);
+		safe_unpack32_array(&msg->launch_hist, &msg->launch_hist_cnt,
+				    buffer);
+		safe_unpack32(&msg->rpc_inline_cnt, buffer);
+		safe_unpack32(&msg->rpc_queued_cnt, buffer);
+		safe_unpack32(&msg->rpc_queue_depth, buffer);
+		safe_unpack32(&msg->rpc_queue_depth_max, buffer);
+		safe_unpack32(&msg->rpc_worker_cnt, buffer);
+		safe_unpack32(&msg->rpc_worker_busy, buffer);
+	} else if (protocol_version >= SLURM_2_5_PROTOCOL_VERSION) {
 		safe_unpack_time(&msg->booted, buffer);
 		safe_unpack_time(&msg->last_slurmctld_msg, buffer);
 
@@ -11369,6 +11535,7 @@ static int  _unpack_stats_response_msg(stats_info_response_msg_t **msg_ptr,
 				       Buf buffer, uint16_t protocol_version)
 {
 	stats_info_response_msg_t * msg;
+	uint32_t uint32_tmp;
 	xassert ( msg_ptr != NULL );
 
 	msg = xmalloc ( sizeof (stats_info_response_msg_t) );
@@ -11409,6 +11576,73 @@ static int  _unpack_stats_response_msg(stats_info_response_msg_t **msg_ptr,
 			safe_unpack32(&msg->bf_depth_try_sum,	buffer);
 			safe_unpack32(&msg->bf_queue_len_sum,	buffer);
 			safe_unpack32(&msg->bf_active,		buffer);
+			if (protocol_version >= SLURM_14_03_PROTOCOL_VERSION) {
+				safe_unpack32(&msg->bf_last_slices_reused,
+					      buffer);
+				safe_unpack32(&msg->bf_last_slices_rebuilt,
+					      buffer);
+
+				safe_unpack32_array(&msg->lock_wait_cnt,
+						    &msg->lock_stat_cnt,
+						    buffer);
+				safe_unpack64_array(&msg->lock_wait_time,
+						    &uint32_tmp, buffer);
+				if (uint32_tmp != msg->lock_stat_cnt)
+					goto unpack_error;
+				safe_unpack32_array(&msg->lock_wait_max,
+						    &uint32_tmp, buffer);
+				if (uint32_tmp != msg->lock_stat_cnt)
+					goto unpack_error;
+
+				safe_unpack32_array(&msg->rpc_type_id,
+						    &msg->rpc_type_size,
+						    buffer);
+				safe_unpack32_array(&msg->rpc_type_cnt,
+						    &uint32_tmp, buffer);
+				if (uint32_tmp != msg->rpc_type_size)
+					goto unpack_error;
+				safe_unpack32_array(&msg->rpc_type_queued,
+						    &uint32_tmp, buffer);
+				if (uint32_tmp != msg->rpc_type_size)
+					goto unpack_error;
+				safe_unpack32_array(&msg->rpc_type_queued_max,
+						    &uint32_tmp, buffer);
+				if (uint32_tmp != msg->rpc_type_size)
+					goto unpack_error;
+				safe_unpack32(&msg->rpc_hist_size, buffer);
+				safe_unpack32_array(&msg->rpc_latency_hist,
+						    &uint32_tmp, buffer);
+				if (uint32_tmp != (msg->rpc_type_size *
+						   msg->rpc_hist_size))
+					goto unpack_error;
+
+				safe_unpack32_array(&msg->rpc_user_id,
+						    &msg->rpc_user_size,
+						    buffer);
+				safe_unpack32_array(&msg->rpc_user_cnt,
+						    &uint32_tmp, buffer);
+				if (uint32_tmp != msg->rpc_user_size)
+					goto unpack_error;
+				safe_unpack32_array(&msg->rpc_user_deferred,
+						    &uint32_tmp, buffer);
+				if (uint32_tmp != msg->rpc_user_size)
+					goto unpack_error;
+				safe_unpack32_array(&msg->rpc_user_throttled,
+						    &uint32_tmp, buffer);
+				if (uint32_tmp != msg->rpc_user_size)
+					goto unpack_error;
+				safe_unpack32_array(&msg->rpc_user_defer_time,
+						    &uint32_tmp, buffer);
+				if (uint32_tmp != msg->rpc_user_size)
+					goto unpack_error;
+
+				safe_unpack32(&msg->dbd_agent_queue_size,
+					      buffer);
+				safe_unpack64(&msg->dbd_agent_spool_size,
+					      buffer);
+				safe_unpack32(&msg->dbd_agent_drain_rate,
+					      buffer);
+			}
 		}
 	} else {
 		error("_unpack_stats_response_msg: protocol_version "
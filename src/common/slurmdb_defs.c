@@ -743,6 +743,7 @@ extern void slurmdb_destroy_job_cond(void *object)
 			list_destroy(job_cond->associd_list);
 		if (job_cond->cluster_list)
 			list_destroy(job_cond->cluster_list);
+		xfree(job_cond->cursor_cluster);
 		if (job_cond->groupid_list)
 			list_destroy(job_cond->groupid_list);
 		if (job_cond->jobname_list)
@@ -50,9 +50,12 @@
 #endif				/*  HAVE_CONFIG_H */
 
 #include <arpa/inet.h>
+#include <dirent.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <pthread.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <syslog.h>
 #include <sys/poll.h>
 #include <sys/stat.h>
@@ -69,6 +72,7 @@
 #include "src/common/slurm_protocol_api.h"
 #include "src/common/slurm_accounting_storage.h"
 #include "src/common/slurm_jobacct_gather.h"
+#include "src/common/slurm_lz.h"
 #include "src/common/xmalloc.h"
 #include "src/common/xsignal.h"
 #include "src/common/xstring.h"
@@ -87,6 +91,58 @@ strong_alias(slurmdbd_free_id_rc_msg,	slurmdb_slurmdbd_free_id_rc_msg);
 #define MAX_AGENT_QUEUE		10000
 #define MAX_DBD_MSG_LEN		16384
 #define SLURMDBD_TIMEOUT	900	/* Seconds SlurmDBD for response */
+#define DBD_WRITE_TIMEOUT	5000	/* msec to wait for socket space */
+
+/* The agent sends queued records in DBD_SEND_MULT_MSG batches with up to
+ * DBD_PIPELINE_DEPTH batches outstanding. Batch size is tuned so slurmdbd
+ * takes about DBD_BATCH_TARGET_MSEC to process each batch. */
+#define DBD_PIPELINE_DEPTH	4
+#define DBD_BATCH_MIN		100
+#define DBD_BATCH_MAX		10000
+#define DBD_BATCH_MAX_BYTES	(8 * 1024 * 1024) /* slurmdbd limit is 16MB */
+#define DBD_BATCH_TARGET_MSEC	2000
+
+/* Each record queued for the agent is also appended to a spool of segment
+ * files named DBD_SPOOL_PREFIX<number> in StateSaveLocation, so records
+ * survive a slurmctld crash. A spool thread does all of the file I/O, so
+ * queuing a record never waits for the disk. Each segment starts with a
+ * count of its leading records which slurmdbd has processed, so they are
+ * not sent again after a restart, and is removed once slurmdbd has
+ * processed all of its records. Records queued while max_agent_queue
+ * records are already in memory are kept only in the spool and read back
+ * as the queue drains. Segments flagged DBD_SPOOL_LZ in their header hold
+ * each record compressed with slurm_lz_compress() if that shrinks it. */
+#define DBD_SPOOL_PREFIX	"dbd.spool."
+#define DBD_SPOOL_LZ		0x0001	/* segment flag, records compressed */
+#define DBD_SPOOL_SEG_SIZE	(4 * 1024 * 1024)
+#define DBD_SPOOL_READ_MAX	1000	/* records read per agent_lock hold */
+#define DBD_STATS_INTERVAL	60	/* seconds per drain rate sample */
+
+typedef struct {
+	uint32_t id;		/* file name suffix */
+	uint16_t rpc_version;	/* protocol version of the records */
+	bool     recovered;	/* written before the last restart */
+	bool     compress;	/* records stored by _spool_compress() */
+	uint32_t hdr_size;	/* bytes in the version string and processed
+				 * record count */
+	uint32_t drain_offset;	/* file offset of the processed record count,
+				 * zero if the file has none */
+	uint32_t drained;	/* processed record count in the file */
+	uint32_t size;		/* bytes written to the file */
+	uint32_t rec_cnt;	/* records written to the file */
+	uint32_t rd_num;	/* first record not read into agent_list */
+	uint32_t rd_offset;	/* file offset of record rd_num */
+	uint32_t *mem_rec;	/* numbers of the records in agent_list */
+	int      mem_head;	/* first used entry of mem_rec */
+	int      mem_cnt;	/* records in agent_list */
+	int      mem_size;	/* entries allocated in mem_rec */
+} dbd_spool_seg_t;
+
+typedef struct {
+	uint32_t id;		/* spool segment file name suffix */
+	uint32_t offset;	/* file offset of the processed record count */
+	uint32_t drained;	/* processed record count, network order */
+} dbd_spool_mark_t;
 
 uint16_t running_cache = 0;
 pthread_mutex_t assoc_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
@@ -97,6 +153,29 @@ static pthread_cond_t  agent_cond = PTHREAD_COND_INITIALIZER;
 static List      agent_list     = (List) NULL;
 static pthread_t agent_tid      = 0;
 static time_t    agent_shutdown = 0;
+static int       agent_batch_size = 1000;
+static uint32_t  agent_drain_cnt  = 0;	/* records processed by slurmdbd */
+static uint32_t  agent_drain_rate = 0;	/* records per minute */
+static bool      agent_mult_sent  = false; /* DBD_SEND_MULT_MSG batches are
+					    * awaiting replies */
+
+/* Spool state, protected by agent_lock. The segment files and the
+ * segments' sizes and record counts are only changed by the spool thread,
+ * which reads them without the lock. */
+static pthread_cond_t  spool_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t spool_tid      = 0;
+static bool      spool_shutdown = false;
+static List      spool_in_list  = (List) NULL;	/* records to be spooled */
+static List      spool_seg_list = (List) NULL;	/* oldest segment first */
+static dbd_spool_seg_t *spool_rd_seg = NULL;	/* segment read from */
+static dbd_spool_seg_t *spool_wr_seg = NULL;	/* segment appended to */
+static int       spool_rd_fd    = -1;
+static int       spool_wr_fd    = -1;
+static uint32_t  spool_next_id  = 0;
+static int       spool_disk_cnt = 0;	/* records only in the spool */
+static uint64_t  spool_bytes    = 0;
+static bool      spool_active   = false;
+static bool      spool_unlink_msgs = false;	/* dbd.messages loaded */
 
 static pthread_mutex_t slurmdbd_lock = PTHREAD_MUTEX_INITIALIZER;
 static pthread_cond_t  slurmdbd_cond = PTHREAD_COND_INITIALIZER;
@@ -112,26 +191,56 @@ static bool      need_to_register    = 0;
 
 static void * _agent(void *x);
 static void   _close_slurmdbd_fd(void);
+static int    _cmp_spool_id(const void *a, const void *b);
+static Buf    _convert_dbd_rec(Buf buffer, uint16_t rpc_version);
 static void   _create_agent(void);
+static void   _enqueue_agent_rec(Buf buffer);
 static bool   _fd_readable(slurm_fd_t fd, int read_timeout);
-static int    _fd_writeable(slurm_fd_t fd);
+static int    _fd_writeable(slurm_fd_t fd, int write_timeout);
+static int    _find_spool_seg(void *x, void *key);
+static void   _free_spool_seg(void *x);
 static int    _get_return_code(uint16_t rpc_version, int read_timeout);
+static int    _handle_mult_rc_ret(uint16_t rpc_version, Buf buffer,
+				  List sent_list, int *done_cnt);
 static Buf    _load_dbd_rec(int fd);
 static void   _load_dbd_state(void);
+static int    _load_dbd_ver(int fd, uint16_t *rpc_version, Buf *buffer);
+static int    _max_agent_queue(void);
 static void   _open_slurmdbd_fd(bool db_needed);
 static int    _purge_job_start_req(void);
 static Buf    _recv_msg(int read_timeout);
 static void   _reopen_slurmdbd_fd(void);
 static int    _save_dbd_rec(int fd, Buf buffer);
 static void   _save_dbd_state(void);
+static int    _save_dbd_ver(int fd, uint32_t *size);
+static int    _send_batches(int read_timeout);
 static int    _send_init_msg(void);
 static int    _send_fini_msg(void);
 static int    _send_msg(Buf buffer);
+static int    _send_msg_opt(Buf buffer, int write_timeout, bool reopen);
 static void   _sig_handler(int signal);
 static void   _shutdown_agent(void);
 static void   _slurmdbd_packstr(void *str, uint16_t rpc_version, Buf buffer);
 static int    _slurmdbd_unpackstr(void **str, uint16_t rpc_version, Buf buffer);
+static void * _spool_agent(void *x);
+static void   _spool_close(bool remove_files);
+static Buf    _spool_compress(Buf buffer);
+static uint32_t _spool_drained(dbd_spool_seg_t *seg);
+static void   _spool_fail(List rec_list);
+static char * _spool_fname(uint32_t id);
+static void   _spool_mem_add(dbd_spool_seg_t *seg, uint32_t num);
+static int    _spool_new_seg(void);
+static int    _spool_open_rd(dbd_spool_seg_t *seg, uint32_t offset);
+static void   _spool_rec_done(int inx, int cnt);
+static void   _spool_recover(void);
+static void   _spool_refill(int max_cnt);
+static void   _spool_stop(void);
+static Buf    _spool_uncompress(Buf buffer, uint32_t id);
+static void   _spool_unlink_msgs(void);
+static bool   _spool_update_segs(void);
+static void   _spool_write(List rec_list);
 static int    _tot_wait (struct timeval *start_time);
+static void   _update_agent_stats(void);
 
 /****************************************************************************
  * Socket open/close/read/write functions
@@ -365,16 +474,10 @@ end_it:
 extern int slurm_send_slurmdbd_msg(uint16_t rpc_version, slurmdbd_msg_t *req)
 {
 	Buf buffer;
-	int cnt, rc = SLURM_SUCCESS;
+	int cnt, max_agent_queue, rc = SLURM_SUCCESS;
 	static time_t syslog_time = 0;
-	static int max_agent_queue = 0;
-
-	/* Whatever our max job count is times that by 2 or
-	 * MAX_AGENT_QUEUE which ever is bigger */
-	if (!max_agent_queue)
-		max_agent_queue =
-			MAX(MAX_AGENT_QUEUE, slurmctld_conf.max_job_cnt * 2);
 
+	max_agent_queue = _max_agent_queue();
 	buffer = pack_slurmdbd_msg(req, rpc_version);
 
 	slurm_mutex_lock(&agent_lock);
@@ -386,7 +489,9 @@ extern int slurm_send_slurmdbd_msg(uint16_t rpc_version, slurmdbd_msg_t *req)
 			return SLURM_ERROR;
 		}
 	}
-	cnt = list_count(agent_list);
+	cnt = list_count(agent_list) + spool_disk_cnt;
+	if (spool_in_list)
+		cnt += list_count(spool_in_list);
 	if ((cnt >= (max_agent_queue / 2)) &&
 	    (difftime(time(NULL), syslog_time) > 120)) {
 		/* Record critical error every 120 seconds */
@@ -396,11 +501,14 @@ extern int slurm_send_slurmdbd_msg(uint16_t rpc_version, slurmdbd_msg_t *req)
 		if (callbacks_requested)
 			(callback.dbd_fail)();
 	}
-	if (cnt == (max_agent_queue - 1))
+	/* Records sent to slurmdbd must stay queued until its replies
+	 * are matched to them */
+	if (!spool_active && !agent_mult_sent &&
+	    (cnt >= (max_agent_queue - 1)))
 		cnt -= _purge_job_start_req();
-	if (cnt < max_agent_queue) {
-		if (list_enqueue(agent_list, buffer) == NULL)
-			fatal("list_enqueue: memory allocation failure");
+	if (spool_active || (cnt < max_agent_queue)) {
+		/* Records beyond max_agent_queue wait in the spool */
+		_enqueue_agent_rec(buffer);
 	} else {
 		error("slurmdbd: agent queue is full, discarding request");
 		if (callbacks_requested)
@@ -413,6 +521,25 @@ extern int slurm_send_slurmdbd_msg(uint16_t rpc_version, slurmdbd_msg_t *req)
 	return rc;
 }
 
+/* Report the SlurmDBD agent's backlog and the rate it is being processed
+ * queue_size OUT - records pending, in memory or only in the spool
+ * spool_size OUT - bytes in the agent's spool files
+ * drain_rate OUT - records processed by slurmdbd per minute, sampled
+ *	every DBD_STATS_INTERVAL seconds */
+extern void slurmdbd_agent_stats(uint32_t *queue_size, uint64_t *spool_size,
+				 uint32_t *drain_rate)
+{
+	slurm_mutex_lock(&agent_lock);
+	*queue_size = spool_disk_cnt;
+	if (agent_list)
+		*queue_size += list_count(agent_list);
+	if (spool_in_list)
+		*queue_size += list_count(spool_in_list);
+	*spool_size = spool_bytes;
+	*drain_rate = agent_drain_rate;
+	slurm_mutex_unlock(&agent_lock);
+}
+
 /* Open a connection to the Slurm DBD and set slurmdbd_fd */
 static void _open_slurmdbd_fd(bool need_db)
 {
@@ -1528,7 +1655,7 @@ static int _send_fini_msg(void)
 
 	/* If the connection is already gone, we don't need to send a
 	   fini. */
-	if (_fd_writeable(slurmdbd_fd) == -1)
+	if (_fd_writeable(slurmdbd_fd, DBD_WRITE_TIMEOUT) == -1)
 		return SLURM_SUCCESS;
 
 	buffer = init_buf(1024);
@@ -1561,6 +1688,18 @@ static void _reopen_slurmdbd_fd(void)
 }
 
 static int _send_msg(Buf buffer)
+{
+	return _send_msg_opt(buffer, DBD_WRITE_TIMEOUT, true);
+}
+
+/*
+ * _send_msg_opt - send a message to slurmdbd
+ * IN buffer - the message
+ * IN write_timeout - msec to wait for socket space
+ * IN reopen - if set, reopen a closed connection and retry. Clear this if
+ *	replies to earlier messages are still outstanding.
+ */
+static int _send_msg_opt(Buf buffer, int write_timeout, bool reopen)
 {
 	uint32_t msg_size, nw_size;
 	char *msg;
@@ -1570,17 +1709,17 @@ static int _send_msg(Buf buffer)
 	if (slurmdbd_fd < 0)
 		return EAGAIN;
 
-	rc =_fd_writeable(slurmdbd_fd);
+	rc =_fd_writeable(slurmdbd_fd, write_timeout);
 	if (rc == -1) {
 	re_open:	/* SlurmDBD shutdown, try to reopen a connection now */
-		if (retry_cnt++ > 3)
+		if (!reopen || (retry_cnt++ > 3))
 			return EAGAIN;
 		/* if errno is ACCESS_DENIED do not try to reopen to
 		   connection just return that */
 		if (errno == ESLURM_ACCESS_DENIED)
 			return ESLURM_ACCESS_DENIED;
 		_reopen_slurmdbd_fd();
-		rc = _fd_writeable(slurmdbd_fd);
+		rc = _fd_writeable(slurmdbd_fd, write_timeout);
 	}
 	if (rc < 1)
 		return EAGAIN;
@@ -1593,7 +1732,7 @@ static int _send_msg(Buf buffer)
 
 	msg = get_buf_data(buffer);
 	while (msg_size > 0) {
-		rc = _fd_writeable(slurmdbd_fd);
+		rc = _fd_writeable(slurmdbd_fd, write_timeout);
 		if (rc == -1)
 			goto re_open;
 		if (rc < 1)
@@ -1683,19 +1822,76 @@ static int _get_return_code(uint16_t rpc_version, int read_timeout)
 	return rc;
 }
 
-static int _handle_mult_rc_ret(uint16_t rpc_version, int read_timeout)
+/*
+ * slurmdbd_mult_rc_remove - remove from a queue the records of a
+ *	DBD_SEND_MULT_MSG which slurmdbd reports processed
+ * IN/OUT rec_list - queue of records, which may have had more added to it
+ *	since the message was sent
+ * IN sent_list - records sent in the message, in order
+ * IN rc_list - return code message of each record processed, in order
+ * IN rpc_version - protocol version of rc_list
+ * RET count of records removed, fewer than in sent_list if one failed
+ * NOTE: Records are found by identity rather than position, so those not
+ *	removed keep their order in rec_list. Call with agent_lock locked
+ *	if rec_list is the agent's queue.
+ */
+extern int slurmdbd_mult_rc_remove(List rec_list, List sent_list,
+				   List rc_list, uint16_t rpc_version)
+{
+	ListIterator rec_itr, sent_itr, rc_itr;
+	Buf rec, sent, rc_buf;
+	int inx = 0, done_cnt = 0;
+
+	rec_itr  = list_iterator_create(rec_list);
+	sent_itr = list_iterator_create(sent_list);
+	rc_itr   = list_iterator_create(rc_list);
+	while ((rc_buf = list_next(rc_itr))) {
+		if (_unpack_return_code(rpc_version, rc_buf) != SLURM_SUCCESS)
+			break;
+		if (!(sent = list_next(sent_itr))) {
+			error("slurmdbd: DBD_GOT_MULT_MSG has more replies "
+			      "than records sent");
+			break;
+		}
+		while ((rec = list_next(rec_itr)) && (rec != sent))
+			inx++;
+		if (!rec) {
+			error("slurmdbd: DBD_GOT_MULT_MSG record not queued");
+			break;
+		}
+		list_remove(rec_itr);
+		free_buf(rec);
+		if (rec_list == agent_list) {
+			_spool_rec_done(inx, 1);
+			agent_drain_cnt++;
+		}
+		done_cnt++;
+	}
+	list_iterator_destroy(rc_itr);
+	list_iterator_destroy(sent_itr);
+	list_iterator_destroy(rec_itr);
+
+	return done_cnt;
+}
+
+/*
+ * _handle_mult_rc_ret - process the reply to a DBD_SEND_MULT_MSG, removing
+ *	each record which slurmdbd processed from agent_list
+ * IN rpc_version - protocol version of the reply
+ * IN buffer - the reply, freed here
+ * IN sent_list - records sent in the message, in order
+ * OUT done_cnt - count of records processed and removed
+ * RET SLURM_SUCCESS if every record sent was processed
+ */
+static int _handle_mult_rc_ret(uint16_t rpc_version, Buf buffer,
+			       List sent_list, int *done_cnt)
 {
-	Buf buffer;
 	uint16_t msg_type;
 	dbd_rc_msg_t *msg;
 	dbd_list_msg_t *list_msg;
 	int rc = SLURM_ERROR;
-	Buf out_buf = NULL;
-
-	buffer = _recv_msg(read_timeout);
-	if (buffer == NULL)
-		return rc;
 
+	*done_cnt = 0;
 	safe_unpack16(&msg_type, buffer);
 	switch(msg_type) {
 	case DBD_GOT_MULT_MSG:
@@ -1708,23 +1904,11 @@ static int _handle_mult_rc_ret(uint16_t rpc_version, int read_timeout)
 
 		slurm_mutex_lock(&agent_lock);
 		if (agent_list) {
-			ListIterator itr =
-				list_iterator_create(list_msg->my_list);
-			while ((out_buf = list_next(itr))) {
-				Buf b;
-				if ((rc = _unpack_return_code(
-					    rpc_version, out_buf))
-				    != SLURM_SUCCESS)
-					break;
-
-				if ((b = list_dequeue(agent_list))) {
-					free_buf(b);
-				} else {
-					error("slurmdbd: DBD_GOT_MULT_MSG "
-					      "unpack message error");
-				}
-			}
-			list_iterator_destroy(itr);
+			*done_cnt = slurmdbd_mult_rc_remove(
+				agent_list, sent_list, list_msg->my_list,
+				rpc_version);
+			if (*done_cnt == list_count(sent_list))
+				rc = SLURM_SUCCESS;
 		}
 		slurm_mutex_unlock(&agent_lock);
 		slurmdbd_free_list_msg(list_msg);
@@ -1884,10 +2068,9 @@ static bool _fd_readable(slurm_fd_t fd, int read_timeout)
  *     0 if can not be written to within 5 seconds
  *     -1 if file has been closed POLLHUP
  */
-static int _fd_writeable(slurm_fd_t fd)
+static int _fd_writeable(slurm_fd_t fd, int write_timeout)
 {
 	struct pollfd ufds;
-	int write_timeout = 5000;
 	int rc, time_left;
 	struct timeval tstart;
 	char temp[2];
@@ -1911,9 +2094,11 @@ static int _fd_writeable(slurm_fd_t fd)
 		 * If not then exit out and notify the sender.  This
  		 * is here since a write doesn't always tell you the
 		 * socket is gone, but getting 0 back from a
-		 * nonblocking read means just that.
+		 * nonblocking read means just that. Peek so a reply
+		 * to an earlier message is left in place.
 		 */
-		if (ufds.revents & POLLHUP || (recv(fd, &temp, 1, 0) == 0)) {
+		if (ufds.revents & POLLHUP ||
+		    (recv(fd, &temp, 1, MSG_PEEK) == 0)) {
 			debug2("SlurmDBD connection is closed");
 			if (callbacks_requested)
 				(callback.dbd_fail)();
@@ -1955,6 +2140,15 @@ static void _create_agent(void)
 		_load_dbd_state();
 	}
 
+	if (spool_active && (spool_tid == 0)) {
+		pthread_attr_t spool_attr;
+		slurm_attr_init(&spool_attr);
+		if (pthread_create(&spool_tid, &spool_attr, _spool_agent,
+				   NULL) || (spool_tid == 0))
+			fatal("pthread_create: %m");
+		slurm_attr_destroy(&spool_attr);
+	}
+
 	if (agent_tid == 0) {
 		pthread_attr_t agent_attr;
 		slurm_attr_init(&agent_attr);
@@ -2006,6 +2200,144 @@ unpack_error:
 	return SLURM_ERROR;
 }
 
+/*
+ * _send_batches - send queued records to slurmdbd in DBD_SEND_MULT_MSG
+ *	batches of up to agent_batch_size records, with up to
+ *	DBD_PIPELINE_DEPTH batches sent before reading the first reply.
+ *	Records are removed from agent_list as slurmdbd reports them processed
+ *	and the batch size is adjusted to the time slurmdbd spends on each.
+ *	Once a record fails slurmdbd processes none of the later batches on
+ *	the connection, which is closed so that all the records left queued
+ *	are sent again in order. Call with slurmdbd_lock locked.
+ * RET SLURM_SUCCESS if every record sent was processed
+ */
+static int _send_batches(int read_timeout)
+{
+	slurmdbd_msg_t list_req;
+	dbd_list_msg_t list_msg;
+	ListIterator agent_itr;
+	Buf buffer;
+	List sent_list[DBD_PIPELINE_DEPTH];
+	struct timeval batch_start[DBD_PIPELINE_DEPTH], last_reply;
+	int batch_cnt[DBD_PIPELINE_DEPTH];
+	int depth, i, queued = 0, done_cnt, msec;
+	uint32_t batch_bytes;
+	int rc = SLURM_SUCCESS;
+
+	list_req.msg_type = DBD_SEND_MULT_MSG;
+	list_req.data = &list_msg;
+	memset(&list_msg, 0, sizeof(dbd_list_msg_t));
+
+	for (depth = 0; depth < DBD_PIPELINE_DEPTH; depth++) {
+		/* Leave records on the queue until processing complete.
+		 * Records are only appended to agent_list while batches
+		 * are awaiting replies, see agent_mult_sent */
+		sent_list[depth] = list_create(NULL);
+		slurm_mutex_lock(&agent_lock);
+		agent_mult_sent = true;
+		if (agent_list) {
+			i = 0;
+			batch_bytes = 0;
+			agent_itr = list_iterator_create(agent_list);
+			while ((buffer = list_next(agent_itr))) {
+				if (i++ < queued)
+					continue;	/* already sent */
+				list_enqueue(sent_list[depth], buffer);
+				batch_bytes += get_buf_offset(buffer);
+				if ((list_count(sent_list[depth]) >=
+				     agent_batch_size) ||
+				    (batch_bytes >= DBD_BATCH_MAX_BYTES))
+					break;
+			}
+			list_iterator_destroy(agent_itr);
+		}
+		batch_cnt[depth] = list_count(sent_list[depth]);
+		if (batch_cnt[depth]) {
+			list_msg.my_list = sent_list[depth];
+			buffer = pack_slurmdbd_msg(&list_req,
+						   SLURM_PROTOCOL_VERSION);
+			list_msg.my_list = NULL;
+		} else
+			buffer = NULL;
+		slurm_mutex_unlock(&agent_lock);
+		if (!buffer) {
+			list_destroy(sent_list[depth]);
+			break;
+		}
+
+		/* NOTE: agent_lock is clear here, so we can add more
+		 * requests to the queue while waiting for this RPC to
+		 * complete. Later batches wait for slurmdbd to work
+		 * through earlier ones and can not reconnect, which
+		 * would lose the replies to earlier ones. */
+		gettimeofday(&batch_start[depth], NULL);
+		if (depth == 0)
+			rc = _send_msg(buffer);
+		else
+			rc = _send_msg_opt(buffer, read_timeout, false);
+		free_buf(buffer);
+		if (rc != SLURM_SUCCESS) {
+			list_destroy(sent_list[depth]);
+			break;
+		}
+		queued += batch_cnt[depth];
+	}
+	if ((rc != SLURM_SUCCESS) && depth) {
+		/* A partial message may have been written */
+		error("slurmdbd: Failure sending pipelined message: %d: %m",
+		      rc);
+		_close_slurmdbd_fd();
+		goto fini;
+	}
+
+	for (i = 0; i < depth; i++) {
+		if (!(buffer = _recv_msg(read_timeout))) {
+			/* A late reply could be taken as the reply to a
+			 * later request */
+			_close_slurmdbd_fd();
+			rc = SLURM_ERROR;
+			break;
+		}
+		rc = _handle_mult_rc_ret(SLURM_PROTOCOL_VERSION, buffer,
+					 sent_list[i], &done_cnt);
+		if (rc != SLURM_SUCCESS) {
+			/* slurmdbd will process no later batch on this
+			 * connection, reconnect to send them again */
+			_close_slurmdbd_fd();
+			break;
+		}
+
+		/* slurmdbd starts a batch once it is received and the
+		 * previous batch is done */
+		msec = _tot_wait(&batch_start[i]);
+		if (i)
+			msec = MIN(msec, _tot_wait(&last_reply));
+		gettimeofday(&last_reply, NULL);
+		if ((msec > DBD_BATCH_TARGET_MSEC) &&
+		    (agent_batch_size > DBD_BATCH_MIN)) {
+			agent_batch_size = MAX(agent_batch_size / 2,
+					       DBD_BATCH_MIN);
+			debug("slurmdbd: agent batch size now %d",
+			      agent_batch_size);
+		} else if ((msec < (DBD_BATCH_TARGET_MSEC / 2)) &&
+			   (batch_cnt[i] >= agent_batch_size) &&
+			   (agent_batch_size < DBD_BATCH_MAX)) {
+			agent_batch_size = MIN(agent_batch_size * 2,
+					       DBD_BATCH_MAX);
+			debug("slurmdbd: agent batch size now %d",
+			      agent_batch_size);
+		}
+	}
+
+fini:
+	for (i = 0; i < depth; i++)
+		list_destroy(sent_list[i]);
+	slurm_mutex_lock(&agent_lock);
+	agent_mult_sent = false;
+	slurm_mutex_unlock(&agent_lock);
+	return rc;
+}
+
 static void *_agent(void *x)
 {
 	int cnt, rc;
@@ -2014,12 +2346,6 @@ static void *_agent(void *x)
 	static time_t fail_time = 0;
 	int sigarray[] = {SIGUSR1, 0};
 	int read_timeout = SLURMDBD_TIMEOUT * 1000;
-	slurmdbd_msg_t list_req;
-	dbd_list_msg_t list_msg;
-
-	list_req.msg_type = DBD_SEND_MULT_MSG;
-	list_req.data = &list_msg;
-	memset(&list_msg, 0, sizeof(dbd_list_msg_t));
 	/* DEF_TIMERS; */
 
 	/* Prepare to catch SIGUSR1 to interrupt pending
@@ -2042,6 +2368,7 @@ static void *_agent(void *x)
 		}
 
 		slurm_mutex_lock(&agent_lock);
+		_update_agent_stats();
 		if (agent_list && slurmdbd_fd)
 			cnt = list_count(agent_list);
 		else
@@ -2057,30 +2384,32 @@ static void *_agent(void *x)
 			continue;
 		} else if ((cnt > 0) && ((cnt % 50) == 0))
 			info("slurmdbd: agent queue size %u", cnt);
+		if (cnt > 1) {
+			slurm_mutex_unlock(&agent_lock);
+			rc = _send_batches(read_timeout);
+			if ((rc != SLURM_SUCCESS) && agent_shutdown) {
+				slurm_mutex_unlock(&slurmdbd_lock);
+				break;
+			}
+			slurm_mutex_unlock(&slurmdbd_lock);
+			slurm_mutex_lock(&assoc_cache_mutex);
+			if (slurmdbd_fd >= 0 && running_cache)
+				pthread_cond_signal(&assoc_cache_cond);
+			slurm_mutex_unlock(&assoc_cache_mutex);
+
+			slurm_mutex_lock(&agent_lock);
+			if (rc == SLURM_SUCCESS)
+				fail_time = 0;
+			else
+				fail_time = time(NULL);
+			slurm_mutex_unlock(&agent_lock);
+			goto registration;
+		}
+
 		/* Leave item on the queue until processing complete */
-		if (agent_list) {
-			int handle_agent_count = 1000;
-			if (cnt > handle_agent_count) {
-				int agent_count = 0;
-				ListIterator agent_itr =
-					list_iterator_create(agent_list);
-				list_msg.my_list = list_create(NULL);
-				while ((buffer = list_next(agent_itr))) {
-					list_enqueue(list_msg.my_list, buffer);
-					agent_count++;
-					if (agent_count > handle_agent_count)
-						break;
-				}
-				list_iterator_destroy(agent_itr);
-				buffer = pack_slurmdbd_msg(&list_req,
-							   SLURM_PROTOCOL_VERSION);
-			} else if (cnt > 1) {
-				list_msg.my_list = agent_list;
-				buffer = pack_slurmdbd_msg(&list_req,
-							   SLURM_PROTOCOL_VERSION);
-			} else
-				buffer = (Buf) list_peek(agent_list);
-		} else
+		if (agent_list)
+			buffer = (Buf) list_peek(agent_list);
+		else
 			buffer = NULL;
 		slurm_mutex_unlock(&agent_lock);
 		if (buffer == NULL) {
@@ -2104,9 +2433,6 @@ static void *_agent(void *x)
 				break;
 			}
 			error("slurmdbd: Failure sending message: %d: %m", rc);
-		} else if (list_msg.my_list) {
-			rc = _handle_mult_rc_ret(SLURM_PROTOCOL_VERSION,
-						 read_timeout);
 		} else {
 			rc = _get_return_code(SLURM_PROTOCOL_VERSION, read_timeout);
 			if (rc == EAGAIN) {
@@ -2126,34 +2452,16 @@ static void *_agent(void *x)
 
 		slurm_mutex_lock(&agent_lock);
 		if (agent_list && (rc == SLURM_SUCCESS)) {
-			/* If we sent a mult_msg we just need to free
-			   buffer, we don't need to requeue, just mark
-			   list_msg.my_list as NULL as that is the
-			   sign we sent a mult_msg.
-			*/
-			if (list_msg.my_list) {
-				if (list_msg.my_list != agent_list)
-					list_destroy(list_msg.my_list);
-				list_msg.my_list = NULL;
-			} else
-				buffer = (Buf) list_dequeue(agent_list);
-
+			_spool_rec_done(0, 1);
+			buffer = (Buf) list_dequeue(agent_list);
 			free_buf(buffer);
+			agent_drain_cnt++;
 			fail_time = 0;
 		} else {
-			/* We still need to free a mult_msg even if we
-			   got a failure.
-			*/
-			if (list_msg.my_list) {
-				if (list_msg.my_list != agent_list)
-					list_destroy(list_msg.my_list);
-				list_msg.my_list = NULL;
-				free_buf(buffer);
-			}
-
 			fail_time = time(NULL);
 		}
 		slurm_mutex_unlock(&agent_lock);
+registration:
 		/* END_TIMER; */
 		/* info("at the end with %s", TIME_STR); */
 		if (need_to_register) {
@@ -2167,6 +2475,7 @@ static void *_agent(void *x)
 		}
 	}
 
+	_spool_stop();
 	slurm_mutex_lock(&agent_lock);
 	_save_dbd_state();
 	if (agent_list) {
@@ -2177,13 +2486,35 @@ static void *_agent(void *x)
 	return NULL;
 }
 
+/* Save the agent's pending records at shutdown, in the spool if it is in
+ * use, otherwise in dbd.messages. Call with agent_lock locked, it is
+ * released while records queued after the spool thread exited are
+ * written. */
 static void _save_dbd_state(void)
 {
 	char *dbd_fname;
 	Buf buffer;
-	int fd, rc, wrote = 0;
+	int fd, rc = SLURM_SUCCESS, wrote = 0;
 	uint16_t msg_type;
 	uint32_t offset;
+	List rec_list;
+
+	if (spool_active) {
+		/* Spool records queued after the spool thread exited */
+		rec_list = list_create(slurmdbd_free_buffer);
+		while (spool_active && list_count(spool_in_list)) {
+			list_transfer(rec_list, spool_in_list);
+			slurm_mutex_unlock(&agent_lock);
+			_spool_write(rec_list);
+			slurm_mutex_lock(&agent_lock);
+		}
+		list_destroy(rec_list);
+	}
+	if (spool_active) {
+		/* Pending records are already in the spool */
+		_spool_close(false);
+		return;
+	}
 
 	dbd_fname = slurm_get_state_save_location();
 	xstrcat(dbd_fname, "/dbd.messages");
@@ -2191,14 +2522,9 @@ static void _save_dbd_state(void)
 	fd = open(dbd_fname, O_WRONLY | O_CREAT | O_TRUNC, 0600);
 	if (fd < 0) {
 		error("slurmdbd: Creating state save file %s", dbd_fname);
+		rc = SLURM_ERROR;
 	} else if (agent_list && list_count(agent_list)) {
-		char curr_ver_str[10];
-		snprintf(curr_ver_str, sizeof(curr_ver_str),
-			 "VER%d", SLURM_PROTOCOL_VERSION);
-		buffer = init_buf(strlen(curr_ver_str));
-		packstr(curr_ver_str, buffer);
-		rc = _save_dbd_rec(fd, buffer);
-		free_buf(buffer);
+		rc = _save_dbd_ver(fd, NULL);
 		if (rc != SLURM_SUCCESS)
 			goto end_it;
 
@@ -2236,6 +2562,10 @@ end_it:
 		(void) close(fd);
 	}
 	xfree(dbd_fname);
+
+	/* The spool failed earlier and its records were read into
+	 * agent_list, so they are now in dbd.messages */
+	_spool_close(rc == SLURM_SUCCESS);
 }
 
 static void _load_dbd_state(void)
@@ -2245,6 +2575,9 @@ static void _load_dbd_state(void)
 	int fd, recovered = 0;
 	uint16_t rpc_version = 0;
 
+	if (!spool_seg_list)
+		_spool_recover();
+
 	dbd_fname = slurm_get_state_save_location();
 	xstrcat(dbd_fname, "/dbd.messages");
 	fd = open(dbd_fname, O_RDONLY);
@@ -2257,31 +2590,9 @@ static void _load_dbd_state(void)
 			error("slurmdbd: Opening state save file %s: %m",
 			      dbd_fname);
 	} else {
-		char *ver_str = NULL;
-		uint32_t ver_str_len;
-
-		buffer = _load_dbd_rec(fd);
-		if (buffer == NULL)
+		if (_load_dbd_ver(fd, &rpc_version, &buffer) != SLURM_SUCCESS)
 			goto end_it;
-		/* This is set to the end of the buffer for send so we
-		   need to set it back to 0 */
-		set_buf_offset(buffer, 0);
-		safe_unpackstr_xmalloc(&ver_str, &ver_str_len, buffer);
-		if (remaining_buf(buffer))
-			goto unpack_error;
-		debug3("Version string in dbd_state header is %s", ver_str);
-		free_buf(buffer);
-		buffer = NULL;
-	unpack_error:
-		if (ver_str) {
-			char curr_ver_str[10];
-			snprintf(curr_ver_str, sizeof(curr_ver_str),
-				 "VER%d", SLURM_PROTOCOL_VERSION);
-			if (!strcmp(ver_str, curr_ver_str))
-				rpc_version = SLURM_PROTOCOL_VERSION;
-		}
 
-		xfree(ver_str);
 		while (1) {
 			/* If the buffer was not the VER%d string it
 			   was an actual message so we don't want to
@@ -2291,47 +2602,13 @@ static void _load_dbd_state(void)
 				buffer = _load_dbd_rec(fd);
 			if (buffer == NULL)
 				break;
-			if (rpc_version != SLURM_PROTOCOL_VERSION) {
-				slurmdbd_msg_t msg;
-				int rc;
-				set_buf_offset(buffer, 0);
-				if (rpc_version == 0) {
-					/* This should only happen for
-					   pre 2.2.0.rc4 and 2.1
-					   machines so no real need to
-					   keep it add more to it.
-					*/
-					rc = unpack_slurmdbd_msg(
-						&msg, SLURM_PROTOCOL_VERSION, buffer);
-					if ((rc == SLURM_SUCCESS)
-					    && !remaining_buf(buffer))
-						goto got_it;
-
-					/* If the current version
-					   failed lets try the last
-					   version.
-					*/
-					set_buf_offset(buffer, 0);
-					rc = unpack_slurmdbd_msg(
-						&msg, SLURMDBD_VERSION_MIN,
-						buffer);
-				} else
-					rc = unpack_slurmdbd_msg(
-						&msg, rpc_version, buffer);
-			got_it:
-				free_buf(buffer);
-				if (rc == SLURM_SUCCESS)
-					buffer = pack_slurmdbd_msg(
-						&msg, SLURM_PROTOCOL_VERSION);
-				else
-					buffer = NULL;
-			}
+			if (rpc_version != SLURM_PROTOCOL_VERSION)
+				buffer = _convert_dbd_rec(buffer, rpc_version);
 			if (!buffer) {
 				error("no buffer given");
 				continue;
 			}
-			if (!list_enqueue(agent_list, buffer))
-				fatal("slurmdbd: list_enqueue, no memory");
+			_enqueue_agent_rec(buffer);
 			recovered++;
 			buffer = NULL;
 		}
@@ -2339,10 +2616,111 @@ static void _load_dbd_state(void)
 	end_it:
 		verbose("slurmdbd: recovered %d pending RPCs", recovered);
 		(void) close(fd);
+		/* The spool thread removes the file once its records are
+		 * in the spool */
+		if (spool_active && recovered)
+			spool_unlink_msgs = true;
+		else if (spool_active)
+			(void) unlink(dbd_fname);
 	}
 	xfree(dbd_fname);
 }
 
+/* Write the version string which starts each state and spool file
+ * OUT size - bytes written, if not NULL */
+static int _save_dbd_ver(int fd, uint32_t *size)
+{
+	char curr_ver_str[10];
+	Buf buffer;
+	int rc;
+
+	snprintf(curr_ver_str, sizeof(curr_ver_str),
+		 "VER%d", SLURM_PROTOCOL_VERSION);
+	buffer = init_buf(strlen(curr_ver_str));
+	packstr(curr_ver_str, buffer);
+	rc = _save_dbd_rec(fd, buffer);
+	if (size)
+		*size = get_buf_offset(buffer) + (2 * sizeof(uint32_t));
+	free_buf(buffer);
+
+	return rc;
+}
+
+/* Read the version string which starts each state and spool file
+ * OUT rpc_version - protocol version of the file's records, 0 if not known
+ * OUT buffer - the file's first record if it has no version string,
+ *	otherwise NULL
+ * RET SLURM_ERROR if the file has no records */
+static int _load_dbd_ver(int fd, uint16_t *rpc_version, Buf *buffer)
+{
+	char *ver_str = NULL;
+	uint32_t ver_str_len;
+	Buf rec;
+
+	*rpc_version = 0;
+	*buffer = NULL;
+	rec = _load_dbd_rec(fd);
+	if (rec == NULL)
+		return SLURM_ERROR;
+	/* This is set to the end of the buffer for send so we
+	   need to set it back to 0 */
+	set_buf_offset(rec, 0);
+	safe_unpackstr_xmalloc(&ver_str, &ver_str_len, rec);
+	if (remaining_buf(rec))
+		goto unpack_error;
+	debug3("Version string in dbd_state header is %s", ver_str);
+	free_buf(rec);
+	rec = NULL;
+unpack_error:
+	if (ver_str) {
+		char curr_ver_str[10];
+		snprintf(curr_ver_str, sizeof(curr_ver_str),
+			 "VER%d", SLURM_PROTOCOL_VERSION);
+		if (!strcmp(ver_str, curr_ver_str))
+			*rpc_version = SLURM_PROTOCOL_VERSION;
+	}
+	xfree(ver_str);
+	*buffer = rec;
+
+	return SLURM_SUCCESS;
+}
+
+/* Repack a record saved by an earlier version of SLURM
+ * IN buffer - the record, freed here
+ * IN rpc_version - protocol version of the record, 0 if not known
+ * RET the record packed for SLURM_PROTOCOL_VERSION or NULL on error */
+static Buf _convert_dbd_rec(Buf buffer, uint16_t rpc_version)
+{
+	slurmdbd_msg_t msg;
+	int rc;
+
+	set_buf_offset(buffer, 0);
+	if (rpc_version == 0) {
+		/* This should only happen for
+		   pre 2.2.0.rc4 and 2.1
+		   machines so no real need to
+		   keep it add more to it.
+		*/
+		rc = unpack_slurmdbd_msg(&msg, SLURM_PROTOCOL_VERSION, buffer);
+		if ((rc == SLURM_SUCCESS) && !remaining_buf(buffer))
+			goto got_it;
+
+		/* If the current version
+		   failed lets try the last
+		   version.
+		*/
+		set_buf_offset(buffer, 0);
+		rc = unpack_slurmdbd_msg(&msg, SLURMDBD_VERSION_MIN, buffer);
+	} else
+		rc = unpack_slurmdbd_msg(&msg, rpc_version, buffer);
+got_it:
+	free_buf(buffer);
+	if (rc != SLURM_SUCCESS)
+		return NULL;
+
+	return pack_slurmdbd_msg(&msg, SLURM_PROTOCOL_VERSION);
+}
+
 static int _save_dbd_rec(int fd, Buf buffer)
 {
 	ssize_t size, wrote;
@@ -2430,6 +2808,831 @@ static Buf _load_dbd_rec(int fd)
 	return buffer;
 }
 
+/* Return the most records to hold in agent_list: MAX_AGENT_QUEUE or twice
+ * our max job count, whichever is bigger */
+static int _max_agent_queue(void)
+{
+	return MAX(MAX_AGENT_QUEUE, slurmctld_conf.max_job_cnt * 2);
+}
+
+/* Queue a record for the agent. If the spool is in use the record is
+ * handed to the spool thread, which writes it to the spool before it is
+ * queued in agent_list. Call with agent_lock locked. */
+static void _enqueue_agent_rec(Buf buffer)
+{
+	if (spool_active) {
+		if (list_enqueue(spool_in_list, buffer) == NULL)
+			fatal("list_enqueue: memory allocation failure");
+		pthread_cond_signal(&spool_cond);
+		return;
+	}
+
+	if (list_enqueue(agent_list, buffer) == NULL)
+		fatal("list_enqueue: memory allocation failure");
+}
+
+/* Sample the rate at which slurmdbd processes queued records and log the
+ * agent's backlog. Call with agent_lock locked. */
+static void _update_agent_stats(void)
+{
+	static time_t last_time = 0;
+	static uint32_t last_cnt = 0;
+	time_t now = time(NULL);
+	int delta_t;
+
+	if (last_time == 0) {
+		last_time = now;
+		last_cnt = agent_drain_cnt;
+		return;
+	}
+	delta_t = (int) difftime(now, last_time);
+	if (delta_t < DBD_STATS_INTERVAL)
+		return;
+
+	agent_drain_rate = ((agent_drain_cnt - last_cnt) * 60) / delta_t;
+	last_time = now;
+	last_cnt = agent_drain_cnt;
+	if (agent_list && (list_count(agent_list) || spool_disk_cnt)) {
+		debug("slurmdbd: agent backlog %d records (%d only in "
+		      "spool), spool size %"PRIu64" bytes, processing %u "
+		      "records per minute",
+		      list_count(agent_list) + spool_disk_cnt,
+		      spool_disk_cnt, spool_bytes, agent_drain_rate);
+	}
+}
+
+static int _cmp_spool_id(const void *a, const void *b)
+{
+	uint32_t id_a = *(uint32_t *) a;
+	uint32_t id_b = *(uint32_t *) b;
+
+	if (id_a < id_b)
+		return -1;
+	if (id_a > id_b)
+		return 1;
+	return 0;
+}
+
+static int _find_spool_seg(void *x, void *key)
+{
+	return (x == key);
+}
+
+static void _free_spool_seg(void *x)
+{
+	dbd_spool_seg_t *seg = (dbd_spool_seg_t *) x;
+
+	xfree(seg->mem_rec);
+	xfree(seg);
+}
+
+/* Return the xmalloc'ed path of a spool segment */
+static char *_spool_fname(uint32_t id)
+{
+	char *fname = slurm_get_state_save_location();
+
+	xstrfmtcat(fname, "/%s%u", DBD_SPOOL_PREFIX, id);
+	return fname;
+}
+
+/* Return the number of leading records of a spool segment which slurmdbd
+ * has processed. Call with agent_lock locked. */
+static uint32_t _spool_drained(dbd_spool_seg_t *seg)
+{
+	if (seg->mem_cnt)
+		return seg->mem_rec[seg->mem_head];
+	return seg->rd_num;
+}
+
+/* Find the spool segments left by an earlier slurmctld and count their
+ * records not yet processed, which are read into agent_list as it drains.
+ * A record cut short by a crash ends its segment. */
+static void _spool_recover(void)
+{
+	char *state_loc, *fname, *end;
+	DIR *dirp;
+	struct dirent *ent;
+	dbd_spool_seg_t *seg;
+	Buf buffer;
+	uint32_t *ids = NULL, drained = 0, flags, hdr_len;
+	int fd, i, id_cnt = 0, prefix_len = strlen(DBD_SPOOL_PREFIX);
+	off_t offset;
+
+	spool_seg_list = list_create(_free_spool_seg);
+	spool_in_list = list_create(slurmdbd_free_buffer);
+	spool_active = true;
+
+	state_loc = slurm_get_state_save_location();
+	if (!(dirp = opendir(state_loc))) {
+		error("slurmdbd: Opening directory %s: %m", state_loc);
+		xfree(state_loc);
+		return;
+	}
+	while ((ent = readdir(dirp))) {
+		if (strncmp(ent->d_name, DBD_SPOOL_PREFIX, prefix_len))
+			continue;
+		i = strtol(ent->d_name + prefix_len, &end, 10);
+		if ((end == (ent->d_name + prefix_len)) || (end[0] != '\0') ||
+		    (i < 0))
+			continue;
+		xrealloc(ids, sizeof(uint32_t) * (id_cnt + 1));
+		ids[id_cnt++] = i;
+	}
+	closedir(dirp);
+	xfree(state_loc);
+	if (id_cnt == 0)
+		return;
+
+	qsort(ids, id_cnt, sizeof(uint32_t), _cmp_spool_id);
+	for (i = 0; i < id_cnt; i++) {
+		spool_next_id = ids[i] + 1;
+		fname = _spool_fname(ids[i]);
+		fd = open(fname, O_RDONLY);
+		if (fd < 0) {
+			error("slurmdbd: Opening spool file %s: %m", fname);
+			xfree(fname);
+			continue;
+		}
+		seg = xmalloc(sizeof(dbd_spool_seg_t));
+		seg->id = ids[i];
+		seg->recovered = true;
+		drained = 0;
+		if (_load_dbd_ver(fd, &seg->rpc_version, &buffer) ==
+		    SLURM_SUCCESS) {
+			if (!buffer)
+				buffer = _load_dbd_rec(fd);
+			if (buffer &&
+			    (((hdr_len = get_buf_offset(buffer)) ==
+			      sizeof(uint32_t)) ||
+			     (hdr_len == (2 * sizeof(uint32_t))))) {
+				/* The processed record count, then the
+				 * segment's flags if it has any */
+				set_buf_offset(buffer, 0);
+				unpack32(&drained, buffer);
+				flags = 0;
+				if (hdr_len > sizeof(uint32_t))
+					unpack32(&flags, buffer);
+				seg->compress = (flags & DBD_SPOOL_LZ);
+				free_buf(buffer);
+				buffer = NULL;
+				offset = lseek(fd, 0, SEEK_CUR);
+				seg->drain_offset = offset - hdr_len -
+						    sizeof(uint32_t);
+				seg->hdr_size = offset;
+			} else {
+				error("slurmdbd: spool file %s has no "
+				      "processed record count", fname);
+				drained = 0;
+			}
+			if (buffer) {
+				/* Not a header, count the record */
+				free_buf(buffer);
+				seg->rec_cnt++;
+			}
+			seg->size = lseek(fd, 0, SEEK_CUR);
+			seg->rd_offset = seg->size;
+			while ((buffer = _load_dbd_rec(fd))) {
+				free_buf(buffer);
+				seg->rec_cnt++;
+				if ((offset = lseek(fd, 0, SEEK_CUR)) > 0)
+					seg->size = offset;
+				if (seg->rec_cnt <= drained)
+					seg->rd_offset = seg->size;
+			}
+		}
+		(void) close(fd);
+
+		seg->rd_num = MIN(drained, seg->rec_cnt);
+		seg->drained = seg->rd_num;
+		if (seg->rd_num == seg->rec_cnt) {
+			(void) unlink(fname);
+			_free_spool_seg(seg);
+		} else {
+			list_append(spool_seg_list, seg);
+			spool_disk_cnt += seg->rec_cnt - seg->rd_num;
+			spool_bytes += seg->size;
+		}
+		xfree(fname);
+	}
+	xfree(ids);
+
+	if (spool_disk_cnt) {
+		verbose("slurmdbd: recovered %d pending RPCs from %d spool "
+			"files", spool_disk_cnt, list_count(spool_seg_list));
+	}
+}
+
+/* Start a new spool segment for records to be appended to, with a
+ * processed record count of zero and the segment's flags after its version
+ * string. Its records are compressed.
+ * Called by the spool thread with agent_lock unlocked. */
+static int _spool_new_seg(void)
+{
+	dbd_spool_seg_t *seg;
+	Buf buffer;
+	char *fname;
+	int fd, rc;
+
+	fname = _spool_fname(spool_next_id);
+	fd = open(fname, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0600);
+	if (fd < 0) {
+		error("slurmdbd: Creating spool file %s: %m", fname);
+		xfree(fname);
+		return SLURM_ERROR;
+	}
+	fd_set_close_on_exec(fd);
+
+	seg = xmalloc(sizeof(dbd_spool_seg_t));
+	seg->id = spool_next_id++;
+	seg->rpc_version = SLURM_PROTOCOL_VERSION;
+	seg->compress = true;
+	rc = _save_dbd_ver(fd, &seg->hdr_size);
+	if (rc == SLURM_SUCCESS) {
+		buffer = init_buf(2 * sizeof(uint32_t));
+		pack32(0, buffer);
+		pack32(DBD_SPOOL_LZ, buffer);
+		rc = _save_dbd_rec(fd, buffer);
+		free_buf(buffer);
+	}
+	if (rc != SLURM_SUCCESS) {
+		(void) close(fd);
+		(void) unlink(fname);
+		xfree(fname);
+		_free_spool_seg(seg);
+		return SLURM_ERROR;
+	}
+	xfree(fname);
+
+	seg->drain_offset = seg->hdr_size + sizeof(uint32_t);
+	seg->hdr_size += 4 * sizeof(uint32_t);
+	seg->size = seg->hdr_size;
+	seg->rd_offset = seg->hdr_size;
+
+	slurm_mutex_lock(&agent_lock);
+	spool_bytes += seg->size;
+	list_append(spool_seg_list, seg);
+	spool_wr_seg = seg;
+	slurm_mutex_unlock(&agent_lock);
+	spool_wr_fd = fd;
+
+	return SLURM_SUCCESS;
+}
+
+/* Note that record number num of a spool segment is now in agent_list.
+ * Call with agent_lock locked. */
+static void _spool_mem_add(dbd_spool_seg_t *seg, uint32_t num)
+{
+	if ((seg->mem_head + seg->mem_cnt) >= seg->mem_size) {
+		if (seg->mem_head >= (seg->mem_size / 2)) {
+			memmove(seg->mem_rec, seg->mem_rec + seg->mem_head,
+				sizeof(uint32_t) * seg->mem_cnt);
+			seg->mem_head = 0;
+		} else {
+			seg->mem_size = MAX(seg->mem_size * 2, 64);
+			xrealloc(seg->mem_rec,
+				 sizeof(uint32_t) * seg->mem_size);
+		}
+	}
+	seg->mem_rec[seg->mem_head + seg->mem_cnt++] = num;
+}
+
+/* Append records to the spool, then queue them in agent_list, or keep them
+ * only in the spool if agent_list is full or earlier records are only in
+ * the spool, so agent_list is in spool order. A new segment is started
+ * once the current one reaches DBD_SPOOL_SEG_SIZE, and each segment is
+ * flushed to disk once it is complete. The spool is disabled if a record
+ * can not be written.
+ * IN rec_list - records to write, returned empty
+ * Called by the spool thread with agent_lock unlocked. */
+static void _spool_write(List rec_list)
+{
+	dbd_spool_seg_t *seg;
+	ListIterator itr;
+	Buf buffer, stored;
+	uint32_t num, offset, *sizes;
+	int i, wrote, max_agent_queue = _max_agent_queue();
+	bool failed = false;
+
+	while (!failed && list_count(rec_list)) {
+		if (spool_wr_seg && (spool_wr_seg->size >= DBD_SPOOL_SEG_SIZE)) {
+			if (fsync(spool_wr_fd))
+				error("slurmdbd: Syncing spool file: %m");
+			(void) close(spool_wr_fd);
+			spool_wr_fd = -1;
+			slurm_mutex_lock(&agent_lock);
+			spool_wr_seg = NULL;
+			slurm_mutex_unlock(&agent_lock);
+		}
+		if (!spool_wr_seg && (_spool_new_seg() != SLURM_SUCCESS)) {
+			failed = true;
+			break;
+		}
+		seg = spool_wr_seg;
+
+		wrote = 0;
+		offset = seg->size;
+		sizes = xmalloc(sizeof(uint32_t) * list_count(rec_list));
+		itr = list_iterator_create(rec_list);
+		while ((offset < DBD_SPOOL_SEG_SIZE) &&
+		       (buffer = list_next(itr))) {
+			stored = seg->compress ?
+				 _spool_compress(buffer) : buffer;
+			if (_save_dbd_rec(spool_wr_fd, stored) !=
+			    SLURM_SUCCESS)
+				failed = true;
+			sizes[wrote] = get_buf_offset(stored) +
+				       (2 * sizeof(uint32_t));
+			if (stored != buffer)
+				free_buf(stored);
+			if (failed)
+				break;
+			offset += sizes[wrote++];
+		}
+		list_iterator_destroy(itr);
+
+		slurm_mutex_lock(&agent_lock);
+		for (i = 0; i < wrote; i++) {
+			buffer = list_pop(rec_list);
+			num = seg->rec_cnt++;
+			seg->size += sizes[i];
+			spool_bytes += sizes[i];
+			if (spool_disk_cnt ||
+			    (list_count(agent_list) >= max_agent_queue)) {
+				spool_disk_cnt++;
+				free_buf(buffer);
+				continue;
+			}
+			seg->rd_num = seg->rec_cnt;
+			seg->rd_offset = seg->size;
+			_spool_mem_add(seg, num);
+			if (list_enqueue(agent_list, buffer) == NULL)
+				fatal("list_enqueue: memory allocation failure");
+		}
+		if (wrote)
+			pthread_cond_broadcast(&agent_cond);
+		slurm_mutex_unlock(&agent_lock);
+		xfree(sizes);
+	}
+
+	if (failed)
+		_spool_fail(rec_list);
+}
+
+/* Return a record as stored in a compressed spool segment: its original
+ * size, then the record compressed, or a size of zero then the record as
+ * is if compression would not shrink it. Records are compressed by the
+ * spool thread, so queuing a record does not wait for it. */
+static Buf _spool_compress(Buf buffer)
+{
+	uint32_t size = get_buf_offset(buffer), comp_len = 0;
+	Buf stored = init_buf(size + sizeof(uint32_t));
+
+	if (size > sizeof(uint32_t)) {
+		comp_len = slurm_lz_compress(get_buf_data(buffer), size,
+					     get_buf_data(stored) +
+					     sizeof(uint32_t),
+					     size - sizeof(uint32_t));
+	}
+	if (comp_len) {
+		pack32(size, stored);
+		set_buf_offset(stored, comp_len + sizeof(uint32_t));
+	} else {
+		pack32(0, stored);
+		packmem_array(get_buf_data(buffer), size, stored);
+	}
+	return stored;
+}
+
+/* Restore a record read from a compressed spool segment
+ * IN buffer - the record as stored by _spool_compress(), freed here
+ * IN id - the segment's file name suffix, for logging
+ * RET the original record or NULL if it is corrupt */
+static Buf _spool_uncompress(Buf buffer, uint32_t id)
+{
+	uint32_t size, comp_len;
+	Buf rec = NULL;
+
+	comp_len = get_buf_offset(buffer);
+	set_buf_offset(buffer, 0);
+	if (comp_len < sizeof(uint32_t))
+		goto fini;
+	unpack32(&size, buffer);
+	comp_len -= sizeof(uint32_t);
+	if (size == 0) {
+		rec = init_buf(comp_len);
+		packmem_array(get_buf_data(buffer) + sizeof(uint32_t),
+			      comp_len, rec);
+		goto fini;
+	}
+	/* Bound the allocation by what the record could hold */
+	if ((size > MAX_DBD_MSG_LEN) ||
+	    ((uint64_t) size > ((uint64_t) comp_len * SLURM_LZ_MAX_RATIO)))
+		goto fini;
+	rec = init_buf(size);
+	if (slurm_lz_decompress(get_buf_data(buffer) + sizeof(uint32_t),
+				comp_len, get_buf_data(rec), size) != size) {
+		free_buf(rec);
+		rec = NULL;
+		goto fini;
+	}
+	set_buf_offset(rec, size);
+
+fini:
+	if (!rec) {
+		error("slurmdbd: discarding corrupt record from spool file "
+		      "%s%u", DBD_SPOOL_PREFIX, id);
+	}
+	free_buf(buffer);
+	return rec;
+}
+
+/* Position the spool read file at offset in a segment.
+ * Called by the spool thread with agent_lock unlocked. */
+static int _spool_open_rd(dbd_spool_seg_t *seg, uint32_t offset)
+{
+	char *fname;
+
+	if (spool_rd_seg != seg) {
+		if (spool_rd_fd >= 0)
+			(void) close(spool_rd_fd);
+		spool_rd_seg = NULL;
+		fname = _spool_fname(seg->id);
+		spool_rd_fd = open(fname, O_RDONLY);
+		if (spool_rd_fd < 0) {
+			error("slurmdbd: Opening spool file %s: %m", fname);
+			xfree(fname);
+			return SLURM_ERROR;
+		}
+		fd_set_close_on_exec(spool_rd_fd);
+		xfree(fname);
+		spool_rd_seg = seg;
+	}
+	if (lseek(spool_rd_fd, offset, SEEK_SET) != offset) {
+		error("slurmdbd: Seeking in spool file %s%u: %m",
+		      DBD_SPOOL_PREFIX, seg->id);
+		return SLURM_ERROR;
+	}
+	return SLURM_SUCCESS;
+}
+
+/* Read records which are only in the spool into agent_list, oldest first,
+ * until it holds max_cnt records. Up to DBD_SPOOL_READ_MAX records are read
+ * at a time with agent_lock unlocked. Registration messages written before
+ * the last restart are discarded, as by _save_dbd_state(), as are records
+ * of a segment which can not be read.
+ * Called by the spool thread with agent_lock unlocked. */
+static void _spool_refill(int max_cnt)
+{
+	ListIterator itr;
+	dbd_spool_seg_t *seg;
+	Buf *recs;
+	uint32_t *ends, offset;
+	uint16_t msg_type;
+	int i, rd_cnt, want;
+	bool rd_err;
+
+	recs = xmalloc(sizeof(Buf) * DBD_SPOOL_READ_MAX);
+	ends = xmalloc(sizeof(uint32_t) * DBD_SPOOL_READ_MAX);
+	slurm_mutex_lock(&agent_lock);
+	while (spool_disk_cnt &&
+	       ((want = max_cnt - list_count(agent_list)) > 0)) {
+		itr = list_iterator_create(spool_seg_list);
+		while ((seg = list_next(itr))) {
+			if (seg->rd_num < seg->rec_cnt)
+				break;
+		}
+		list_iterator_destroy(itr);
+		if (!seg) {
+			spool_disk_cnt = 0;
+			break;
+		}
+		want = MIN(want, DBD_SPOOL_READ_MAX);
+		want = MIN(want, seg->rec_cnt - seg->rd_num);
+		offset = seg->rd_offset;
+		slurm_mutex_unlock(&agent_lock);
+
+		rd_cnt = 0;
+		rd_err = (_spool_open_rd(seg, offset) != SLURM_SUCCESS);
+		while (!rd_err && (rd_cnt < want)) {
+			if (!(recs[rd_cnt] = _load_dbd_rec(spool_rd_fd))) {
+				rd_err = true;
+				break;
+			}
+			ends[rd_cnt++] = lseek(spool_rd_fd, 0, SEEK_CUR);
+		}
+		for (i = 0; i < rd_cnt; i++) {
+			if (seg->compress)
+				recs[i] = _spool_uncompress(recs[i], seg->id);
+			if (recs[i] &&
+			    (seg->rpc_version != SLURM_PROTOCOL_VERSION))
+				recs[i] = _convert_dbd_rec(recs[i],
+							   seg->rpc_version);
+			if (recs[i] && seg->recovered &&
+			    (get_buf_offset(recs[i]) >= 2)) {
+				offset = get_buf_offset(recs[i]);
+				set_buf_offset(recs[i], 0);
+				unpack16(&msg_type, recs[i]);
+				set_buf_offset(recs[i], offset);
+				if (msg_type == DBD_REGISTER_CTLD) {
+					free_buf(recs[i]);
+					recs[i] = NULL;
+				}
+			}
+		}
+
+		slurm_mutex_lock(&agent_lock);
+		for (i = 0; i < rd_cnt; i++) {
+			spool_disk_cnt--;
+			seg->rd_offset = ends[i];
+			if (recs[i]) {
+				_spool_mem_add(seg, seg->rd_num);
+				if (list_enqueue(agent_list, recs[i]) == NULL)
+					fatal("list_enqueue: memory "
+					      "allocation failure");
+			}
+			seg->rd_num++;
+		}
+		if (rd_err) {
+			error("slurmdbd: discarding %u records from spool "
+			      "file %s%u", seg->rec_cnt - seg->rd_num,
+			      DBD_SPOOL_PREFIX, seg->id);
+			spool_disk_cnt -= seg->rec_cnt - seg->rd_num;
+			seg->rd_num = seg->rec_cnt;
+		}
+		pthread_cond_broadcast(&agent_cond);
+	}
+	slurm_mutex_unlock(&agent_lock);
+	xfree(recs);
+	xfree(ends);
+}
+
+/* Note that cnt records starting at position inx of agent_list are being
+ * removed from it, so the spool thread can update the processed record
+ * count of their segments. Call with agent_lock locked. */
+static void _spool_rec_done(int inx, int cnt)
+{
+	ListIterator itr;
+	dbd_spool_seg_t *seg;
+	int n;
+
+	if (!spool_seg_list)
+		return;
+
+	itr = list_iterator_create(spool_seg_list);
+	while (cnt && (seg = list_next(itr))) {
+		if (inx >= seg->mem_cnt) {
+			inx -= seg->mem_cnt;
+			continue;
+		}
+		n = MIN(cnt, seg->mem_cnt - inx);
+		if (inx == 0) {
+			seg->mem_head += n;
+		} else {
+			memmove(seg->mem_rec + seg->mem_head + inx,
+				seg->mem_rec + seg->mem_head + inx + n,
+				sizeof(uint32_t) * (seg->mem_cnt - inx - n));
+		}
+		seg->mem_cnt -= n;
+		if (seg->mem_cnt == 0)
+			seg->mem_head = 0;
+		cnt -= n;
+		inx = 0;
+	}
+	list_iterator_destroy(itr);
+	/* Records left over were queued after the spool failed */
+
+	if (spool_active)
+		pthread_cond_signal(&spool_cond);
+}
+
+/* Write the processed record count of spool segments for which it has
+ * advanced, and remove segments other than the one being appended to once
+ * all of their records are processed. The counts are not synced to disk,
+ * so a crash may still send slurmdbd a few records a second time.
+ * Called by the spool thread with agent_lock locked, which is released
+ * while the files are updated.
+ * RET true if any file was updated */
+static bool _spool_update_segs(void)
+{
+	ListIterator itr;
+	dbd_spool_seg_t *seg;
+	dbd_spool_mark_t *marks = NULL;
+	uint32_t *rm_ids = NULL, drained;
+	int fd, i, mark_cnt = 0, rm_cnt = 0;
+	char *fname;
+
+	itr = list_iterator_create(spool_seg_list);
+	while ((seg = list_next(itr))) {
+		if ((seg->mem_cnt == 0) && (seg->rd_num == seg->rec_cnt) &&
+		    (seg != spool_wr_seg)) {
+			if (seg == spool_rd_seg) {
+				(void) close(spool_rd_fd);
+				spool_rd_fd = -1;
+				spool_rd_seg = NULL;
+			}
+			xrealloc(rm_ids, sizeof(uint32_t) * (rm_cnt + 1));
+			rm_ids[rm_cnt++] = seg->id;
+			spool_bytes -= seg->size;
+			list_delete_item(itr);
+			continue;
+		}
+		drained = _spool_drained(seg);
+		if ((drained == seg->drained) || !seg->drain_offset)
+			continue;
+		seg->drained = drained;
+		xrealloc(marks, sizeof(dbd_spool_mark_t) * (mark_cnt + 1));
+		marks[mark_cnt].id = seg->id;
+		marks[mark_cnt].offset = seg->drain_offset;
+		marks[mark_cnt].drained = htonl(drained);
+		mark_cnt++;
+	}
+	list_iterator_destroy(itr);
+	if (!mark_cnt && !rm_cnt)
+		return false;
+
+	slurm_mutex_unlock(&agent_lock);
+	for (i = 0; i < mark_cnt; i++) {
+		fname = _spool_fname(marks[i].id);
+		if ((fd = open(fname, O_WRONLY)) < 0) {
+			error("slurmdbd: Opening spool file %s: %m", fname);
+		} else {
+			if (pwrite(fd, &marks[i].drained, sizeof(uint32_t),
+				   marks[i].offset) != sizeof(uint32_t))
+				error("slurmdbd: Writing spool file %s: %m",
+				      fname);
+			(void) close(fd);
+		}
+		xfree(fname);
+	}
+	for (i = 0; i < rm_cnt; i++) {
+		fname = _spool_fname(rm_ids[i]);
+		if (unlink(fname) && (errno != ENOENT))
+			error("slurmdbd: Removing spool file %s: %m", fname);
+		xfree(fname);
+	}
+	xfree(marks);
+	xfree(rm_ids);
+	slurm_mutex_lock(&agent_lock);
+
+	return true;
+}
+
+/* The spool can not be written, so read all records which are only in the
+ * spool into agent_list, followed by the records not yet spooled. Later
+ * records are held only in memory, to be saved to dbd.messages at
+ * shutdown.
+ * IN rec_list - records taken from spool_in_list but not yet spooled
+ * Called by the spool thread with agent_lock unlocked. */
+static void _spool_fail(List rec_list)
+{
+	error("slurmdbd: agent spool disabled, pending records are now "
+	      "held in memory");
+	if (spool_wr_fd >= 0) {
+		(void) close(spool_wr_fd);
+		spool_wr_fd = -1;
+	}
+	slurm_mutex_lock(&agent_lock);
+	spool_wr_seg = NULL;
+	slurm_mutex_unlock(&agent_lock);
+
+	_spool_refill(INT_MAX);
+
+	slurm_mutex_lock(&agent_lock);
+	list_transfer(agent_list, rec_list);
+	list_transfer(agent_list, spool_in_list);
+	spool_active = false;
+	pthread_cond_broadcast(&agent_cond);
+	slurm_mutex_unlock(&agent_lock);
+}
+
+/* Once the records recovered from dbd.messages are in the spool, flush
+ * them to disk and remove the file.
+ * Called by the spool thread with agent_lock unlocked. */
+static void _spool_unlink_msgs(void)
+{
+	char *dbd_fname;
+
+	if (!spool_active)
+		return;		/* dbd.messages is rewritten at shutdown */
+	if ((spool_wr_fd >= 0) && fsync(spool_wr_fd)) {
+		error("slurmdbd: Syncing spool file: %m");
+		return;
+	}
+	dbd_fname = slurm_get_state_save_location();
+	xstrcat(dbd_fname, "/dbd.messages");
+	(void) unlink(dbd_fname);
+	xfree(dbd_fname);
+}
+
+/* The spool thread does all I/O on the spool files, so that threads
+ * queuing records for slurmdbd, which may hold slurmctld locks, and the
+ * agent thread never wait for the disk. It exits once spool_shutdown is
+ * set and every record queued for it is written, or if the spool fails. */
+static void *_spool_agent(void *x)
+{
+	List rec_list = list_create(slurmdbd_free_buffer);
+	bool unlink_msgs;
+
+	slurm_mutex_lock(&agent_lock);
+	while (spool_active) {
+		if (list_count(spool_in_list)) {
+			list_transfer(rec_list, spool_in_list);
+			unlink_msgs = spool_unlink_msgs;
+			spool_unlink_msgs = false;
+			slurm_mutex_unlock(&agent_lock);
+			_spool_write(rec_list);
+			if (unlink_msgs)
+				_spool_unlink_msgs();
+			slurm_mutex_lock(&agent_lock);
+		} else if (!spool_shutdown && spool_disk_cnt &&
+			   (list_count(agent_list) <=
+			    (_max_agent_queue() / 2))) {
+			slurm_mutex_unlock(&agent_lock);
+			_spool_refill(_max_agent_queue());
+			slurm_mutex_lock(&agent_lock);
+		} else if (_spool_update_segs()) {
+			continue;
+		} else if (spool_shutdown) {
+			break;
+		} else {
+			pthread_cond_wait(&spool_cond, &agent_lock);
+		}
+	}
+	slurm_mutex_unlock(&agent_lock);
+
+	list_destroy(rec_list);
+	return NULL;
+}
+
+/* Have the spool thread write the records queued for it and exit.
+ * Call with agent_lock unlocked. */
+static void _spool_stop(void)
+{
+	pthread_t tid;
+
+	slurm_mutex_lock(&agent_lock);
+	tid = spool_tid;
+	spool_shutdown = true;
+	pthread_cond_broadcast(&spool_cond);
+	slurm_mutex_unlock(&agent_lock);
+
+	if (tid)
+		pthread_join(tid, NULL);
+
+	slurm_mutex_lock(&agent_lock);
+	spool_tid = 0;
+	spool_shutdown = false;
+	slurm_mutex_unlock(&agent_lock);
+}
+
+/* Close the spool at shutdown, after the spool thread has exited
+ * IN remove_files - remove the spool files, all of their records having
+ *	been saved to dbd.messages */
+static void _spool_close(bool remove_files)
+{
+	dbd_spool_seg_t *seg;
+	char *fname;
+
+	if (spool_wr_fd >= 0) {
+		if (fsync(spool_wr_fd))
+			error("slurmdbd: Syncing spool file: %m");
+		(void) close(spool_wr_fd);
+		spool_wr_fd = -1;
+	}
+	if (spool_rd_fd >= 0) {
+		(void) close(spool_rd_fd);
+		spool_rd_fd = -1;
+	}
+	spool_rd_seg = NULL;
+	spool_wr_seg = NULL;
+
+	if (spool_seg_list) {
+		if (spool_active) {
+			verbose("slurmdbd: %d pending RPCs kept in %d spool "
+				"files",
+				(agent_list ? list_count(agent_list) : 0) +
+				spool_disk_cnt, list_count(spool_seg_list));
+		} else if (remove_files) {
+			while ((seg = list_pop(spool_seg_list))) {
+				fname = _spool_fname(seg->id);
+				(void) unlink(fname);
+				xfree(fname);
+				_free_spool_seg(seg);
+			}
+		}
+		list_destroy(spool_seg_list);
+		spool_seg_list = NULL;
+	}
+	if (spool_in_list) {
+		list_destroy(spool_in_list);
+		spool_in_list = NULL;
+	}
+	spool_disk_cnt = 0;
+	spool_bytes = 0;
+	spool_active = false;
+	spool_unlink_msgs = false;
+}
+
 static void _sig_handler(int signal)
 {
 }
@@ -2438,7 +3641,7 @@ static void _sig_handler(int signal)
  * RET number of records purged */
 static int _purge_job_start_req(void)
 {
-	int purged = 0;
+	int inx = 0, purged = 0;
 	ListIterator iter;
 	uint16_t msg_type;
 	uint32_t offset;
@@ -2447,17 +3650,21 @@ static int _purge_job_start_req(void)
 	iter = list_iterator_create(agent_list);
 	while ((buffer = list_next(iter))) {
 		offset = get_buf_offset(buffer);
-		if (offset < 2)
+		if (offset < 2) {
+			inx++;
 			continue;
+		}
 		set_buf_offset(buffer, 0);
 		unpack16(&msg_type, buffer);
 		set_buf_offset(buffer, offset);
 		if ((msg_type == DBD_JOB_START) ||
 		    (msg_type == DBD_STEP_START) ||
 		    (msg_type == DBD_STEP_COMPLETE)) {
+			_spool_rec_done(inx, 1);
 			list_remove(iter);
 			purged++;
-		}
+		} else
+			inx++;
 	}
 	list_iterator_destroy(iter);
 	info("slurmdbd: purge %d job/step start records", purged);
@@ -422,6 +422,26 @@ extern int slurm_close_slurmdbd_conn();
 extern int slurm_send_slurmdbd_msg(uint16_t rpc_version,
 				   slurmdbd_msg_t *req);
 
+/*
+ * slurmdbd_mult_rc_remove - remove from a queue the records of a
+ *	DBD_SEND_MULT_MSG which slurmdbd reports processed, matching them by
+ *	identity so that the records left keep their order
+ * IN/OUT rec_list - queue of records
+ * IN sent_list - records sent in the message, in order
+ * IN rc_list - return code message of each record processed, in order
+ * IN rpc_version - protocol version of rc_list
+ * RET count of records removed
+ */
+extern int slurmdbd_mult_rc_remove(List rec_list, List sent_list,
+				   List rc_list, uint16_t rpc_version);
+
+/* Report the SlurmDBD agent's backlog and the rate it is being processed
+ * queue_size OUT - records pending, in memory or only in the spool
+ * spool_size OUT - bytes in the agent's spool files
+ * drain_rate OUT - records processed by slurmdbd per minute */
+extern void slurmdbd_agent_stats(uint32_t *queue_size, uint64_t *spool_size,
+				 uint32_t *drain_rate);
+
 /* Send an RPC to the SlurmDBD and wait for an arbitrary reply message.
  * The RPC will not be queued if an error occurs.
  * The "resp" message must be freed by the caller.
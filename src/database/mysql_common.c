@@ -47,6 +47,8 @@
 #include "src/common/read_config.h"
 
 static char *table_defs_table = "table_defs_table";
+static pthread_once_t thread_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t thread_key;
 
 typedef struct {
 	char *name;
@@ -64,12 +66,41 @@ static void _destroy_db_key(void *arg)
 	}
 }
 
+static void _thread_fini(void *arg)
+{
+	mysql_thread_end();
+}
+
+static void _thread_key_create(void)
+{
+	if (pthread_key_create(&thread_key, _thread_fini))
+		fatal("pthread_key_create: %m");
+}
+
+/* Set up MySQL's per-thread state the first time this thread uses a
+ * connection. Connections are shared between threads (slurmdbd hands
+ * each message to whichever RPC worker is free), so the state is released
+ * when the thread exits rather than when a connection is closed. */
+static void _thread_init(void)
+{
+	if (!mysql_thread_safe())
+		return;
+
+	pthread_once(&thread_key_once, _thread_key_create);
+	if (pthread_getspecific(thread_key))
+		return;
+	mysql_thread_init();
+	pthread_setspecific(thread_key, (void *) 1);
+}
+
 /* NOTE: Insure that mysql_conn->lock is set on function entry */
 static int _clear_results(MYSQL *db_conn)
 {
 	MYSQL_RES *result = NULL;
 	int rc = 0;
 
+	_thread_init();
+
 	do {
 		/* did current statement return data? */
 		if ((result = mysql_store_result(db_conn)))
@@ -556,8 +587,6 @@ static int _create_db(char *db_name, mysql_db_info_t *db_info)
 				      mysql_errno(mysql_db),
 				      mysql_error(mysql_db), create_line);
 			}
-			if (mysql_thread_safe())
-				mysql_thread_end();
 			mysql_close(mysql_db);
 		} else {
 			info("Connection failed to host = %s "
@@ -659,6 +688,7 @@ extern int mysql_db_get_db_connection(mysql_conn_t *mysql_conn, char *db_name,
 
 	slurm_mutex_lock(&mysql_conn->lock);
 
+	_thread_init();
 	if (!(mysql_conn->db_conn = mysql_init(mysql_conn->db_conn))) {
 		slurm_mutex_unlock(&mysql_conn->lock);
 		fatal("mysql_init failed: %s",
@@ -712,8 +742,6 @@ extern int mysql_db_close_db_connection(mysql_conn_t *mysql_conn)
 {
 	slurm_mutex_lock(&mysql_conn->lock);
 	if (mysql_conn && mysql_conn->db_conn) {
-		if (mysql_thread_safe())
-			mysql_thread_end();
 		mysql_close(mysql_conn->db_conn);
 		mysql_conn->db_conn = NULL;
 	}
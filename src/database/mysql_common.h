@@ -78,6 +78,7 @@ typedef struct {
 	bool rollback;
 	List update_list;
 	int conn;
+	unsigned long batch_thread_id; /* server thread of a batch */
 } mysql_conn_t;
 
 typedef struct {
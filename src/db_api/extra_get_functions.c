@@ -58,6 +58,16 @@ extern List slurmdb_config_get(void *db_conn)
 	return acct_storage_g_get_config(db_conn, "slurmdbd.conf");
 }
 
+/*
+ * get slurmdbd RPC statistics from the storage
+ * RET: List of config_key_pairs_t *
+ * note List needs to be freed when called
+ */
+extern List slurmdb_stats_get(void *db_conn)
+{
+	return acct_storage_g_get_config(db_conn, "slurmdbd.stats");
+}
+
 /*
  * get info from the storage
  * IN:  slurmdb_event_cond_t *
@@ -134,6 +134,7 @@ char *job_table = "job_table";
 char *last_ran_table = "last_ran_table";
 char *qos_table = "qos_table";
 char *resv_table = "resv_table";
+char *rollup_dirty_table = "rollup_dirty_table";
 char *step_table = "step_table";
 char *txn_table = "txn_table";
 char *user_table = "user_table";
@@ -958,6 +959,13 @@ extern int create_cluster_tables(mysql_conn_t *mysql_conn, char *cluster_name)
 		{ NULL, NULL}
 	};
 
+	storage_field_t rollup_dirty_table_fields[] = {
+		{ "dirty_inx", "int unsigned not null auto_increment" },
+		{ "time_start", "int unsigned default 0 not null" },
+		{ "time_end", "int unsigned default 0 not null" },
+		{ NULL, NULL}
+	};
+
 	storage_field_t resv_table_fields[] = {
 		{ "id_resv", "int unsigned default 0 not null" },
 		{ "deleted", "tinyint default 0 not null" },
@@ -1147,6 +1155,14 @@ extern int create_cluster_tables(mysql_conn_t *mysql_conn, char *cluster_name)
 	    == SLURM_ERROR)
 		return SLURM_ERROR;
 
+	snprintf(table_name, sizeof(table_name), "\"%s_%s\"",
+		 cluster_name, rollup_dirty_table);
+	if (mysql_db_create_table(mysql_conn, table_name,
+				  rollup_dirty_table_fields,
+				  ", primary key (dirty_inx))")
+	    == SLURM_ERROR)
+		return SLURM_ERROR;
+
 	snprintf(table_name, sizeof(table_name), "\"%s_%s\"",
 		 cluster_name, resv_table);
 	if (mysql_db_create_table(mysql_conn, table_name,
@@ -1245,7 +1261,8 @@ extern int remove_cluster_tables(mysql_conn_t *mysql_conn, char *cluster_name)
 		   "\"%s_%s\", \"%s_%s\", \"%s_%s\", "
 		   "\"%s_%s\", \"%s_%s\", \"%s_%s\", \"%s_%s\", "
 		   "\"%s_%s\", \"%s_%s\", \"%s_%s\", \"%s_%s\", "
-		   "\"%s_%s\", \"%s_%s\", \"%s_%s\", \"%s_%s\";",
+		   "\"%s_%s\", \"%s_%s\", \"%s_%s\", \"%s_%s\", "
+		   "\"%s_%s\";",
 		   cluster_name, assoc_table,
 		   cluster_name, assoc_day_table,
 		   cluster_name, assoc_hour_table,
@@ -1257,6 +1274,7 @@ extern int remove_cluster_tables(mysql_conn_t *mysql_conn, char *cluster_name)
 		   cluster_name, job_table,
 		   cluster_name, last_ran_table,
 		   cluster_name, resv_table,
+		   cluster_name, rollup_dirty_table,
 		   cluster_name, step_table,
 		   cluster_name, suspend_table,
 		   cluster_name, wckey_table,
@@ -2239,6 +2257,61 @@ extern int acct_storage_p_commit(mysql_conn_t *mysql_conn, bool commit)
 	return SLURM_SUCCESS;
 }
 
+extern int acct_storage_p_batch_start(mysql_conn_t *mysql_conn)
+{
+	int rc = check_connection(mysql_conn);
+
+	if (rc != SLURM_SUCCESS)
+		return rc;
+	/* A connection which permits rollback is always in a transaction
+	 * ended by acct_storage_p_commit() */
+	if (mysql_conn->rollback)
+		return SLURM_ERROR;
+
+	if (mysql_autocommit(mysql_conn->db_conn, 0)) {
+		error("mysql_autocommit failed: %d %s",
+		      mysql_errno(mysql_conn->db_conn),
+		      mysql_error(mysql_conn->db_conn));
+		return SLURM_ERROR;
+	}
+	/* A reconnect during the batch loses the transaction, note the
+	 * server thread so we can tell */
+	mysql_conn->batch_thread_id = mysql_thread_id(mysql_conn->db_conn);
+
+	return SLURM_SUCCESS;
+}
+
+extern int acct_storage_p_batch_end(mysql_conn_t *mysql_conn, bool commit)
+{
+	int rc = SLURM_SUCCESS;
+
+	if (!mysql_conn || !mysql_conn->db_conn)
+		return SLURM_ERROR;
+
+	if (mysql_thread_id(mysql_conn->db_conn) !=
+	    mysql_conn->batch_thread_id) {
+		error("mysql connection lost during batch, rolling back");
+		commit = false;
+		rc = SLURM_ERROR;
+	}
+	if (commit) {
+		rc = mysql_db_commit(mysql_conn);
+	} else if (mysql_db_rollback(mysql_conn))
+		error("rollback failed");
+
+	mysql_autocommit(mysql_conn->db_conn, 1);
+	mysql_conn->batch_thread_id = 0;
+
+	/* Send updates made during the batch (such as wckeys added for
+	 * its jobs) only once they are committed */
+	if (commit && (rc == SLURM_SUCCESS))
+		acct_storage_p_commit(mysql_conn, 1);
+	else
+		list_flush(mysql_conn->update_list);
+
+	return rc;
+}
+
 extern int acct_storage_p_add_users(mysql_conn_t *mysql_conn, uint32_t uid,
 				    List user_list)
 {
@@ -86,6 +86,7 @@ extern char *job_table;
 extern char *last_ran_table;
 extern char *qos_table;
 extern char *resv_table;
+extern char *rollup_dirty_table;
 extern char *step_table;
 extern char *txn_table;
 extern char *user_table;
@@ -141,6 +142,8 @@ extern int remove_common(mysql_conn_t *mysql_conn,
 
 /*local api functions */
 extern int acct_storage_p_commit(mysql_conn_t *mysql_conn, bool commit);
+extern int acct_storage_p_batch_start(mysql_conn_t *mysql_conn);
+extern int acct_storage_p_batch_end(mysql_conn_t *mysql_conn, bool commit);
 
 extern int acct_storage_p_add_associations(mysql_conn_t *mysql_conn,
 					   uint32_t uid,
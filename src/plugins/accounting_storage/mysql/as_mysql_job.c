@@ -85,6 +85,33 @@ static int _get_db_index(mysql_conn_t *mysql_conn,
 	return db_index;
 }
 
+/* Return true if a suspend or resume at event_time is already recorded in
+ * the suspend table, as when slurmctld sends a spooled record again after
+ * a restart. Applying it twice would count the suspended time wrongly. */
+static bool _suspend_recorded(mysql_conn_t *mysql_conn, uint32_t job_db_inx,
+			      bool suspend, time_t event_time)
+{
+	MYSQL_RES *result = NULL;
+	bool recorded;
+	char *query = xstrdup_printf("select job_db_inx from \"%s_%s\" where "
+				     "job_db_inx=%u && %s=%d",
+				     mysql_conn->cluster_name, suspend_table,
+				     job_db_inx,
+				     suspend ? "time_start" : "time_end",
+				     (int)event_time);
+
+	if (!(result = mysql_db_query_ret(mysql_conn, query, 0))) {
+		xfree(query);
+		return false;
+	}
+	xfree(query);
+
+	recorded = (mysql_num_rows(result) != 0);
+	mysql_free_result(result);
+
+	return recorded;
+}
+
 static char *_get_user_from_associd(mysql_conn_t *mysql_conn,
 				    char *cluster, uint32_t associd)
 {
@@ -176,6 +203,7 @@ static uint32_t _get_wckeyid(mysql_conn_t *mysql_conn, char **name,
 					    NULL) != SLURM_SUCCESS) {
 			List wckey_list = NULL;
 			slurmdb_wckey_rec_t *wckey_ptr = NULL;
+			int rc;
 
 			wckey_list = list_create(slurmdb_destroy_wckey_rec);
 
@@ -190,15 +218,24 @@ static uint32_t _get_wckeyid(mysql_conn_t *mysql_conn, char **name,
 			/* we have already checked to make
 			   sure this was the slurm user before
 			   calling this */
-			if (as_mysql_add_wckeys(mysql_conn,
-						slurm_get_slurm_user_id(),
-						wckey_list)
-			    == SLURM_SUCCESS)
-				acct_storage_p_commit(mysql_conn, 1);
-			/* If that worked lets get it */
-			assoc_mgr_fill_in_wckey(mysql_conn, &wckey_rec,
-						ACCOUNTING_ENFORCE_WCKEYS,
-						NULL);
+			rc = as_mysql_add_wckeys(mysql_conn,
+						 slurm_get_slurm_user_id(),
+						 wckey_list);
+			if (mysql_conn->batch_thread_id) {
+				/* Part of a batch, which
+				   acct_storage_p_batch_end() commits
+				   or rolls back as a whole, so the
+				   wckey is not in assoc_mgr yet */
+				if (rc == SLURM_SUCCESS)
+					wckey_rec.id = wckey_ptr->id;
+			} else {
+				if (rc == SLURM_SUCCESS)
+					acct_storage_p_commit(mysql_conn, 1);
+				/* If that worked lets get it */
+				assoc_mgr_fill_in_wckey(
+					mysql_conn, &wckey_rec,
+					ACCOUNTING_ENFORCE_WCKEYS, NULL);
+			}
 
 			list_destroy(wckey_list);
 		}
@@ -338,24 +375,17 @@ extern int as_mysql_job_start(mysql_conn_t *mysql_conn,
 			      slurm_ctime(&check_time),
 			      job_ptr->job_id, mysql_conn->cluster_name);
 
-		global_last_rollup = check_time;
 		slurm_mutex_unlock(&rollup_lock);
 
-		/* If the times here are later than the daily_rollup
-		   or monthly rollup it isn't a big deal since they
-		   are always shrunk down to the beginning of each
-		   time period.
-		*/
-		query = xstrdup_printf("update \"%s_%s\" set "
-				       "hourly_rollup=%ld, "
-				       "daily_rollup=%ld, monthly_rollup=%ld",
-				       mysql_conn->cluster_name,
-				       last_ran_table, check_time,
-				       check_time, check_time);
-		debug3("%d(%s:%d) query\n%s",
-		       mysql_conn->conn, THIS_FILE, __LINE__, query);
-		rc = mysql_db_query(mysql_conn, query);
-		xfree(query);
+		/* Only the hours this job could have changed are rolled
+		 * up again, the job can not affect usage after it
+		 * ended. */
+		if (job_ptr->end_time > check_time)
+			rc = as_mysql_reroll_usage(mysql_conn, check_time,
+						   job_ptr->end_time);
+		else
+			rc = as_mysql_reroll_usage(mysql_conn, check_time,
+						   time(NULL));
 	} else
 		slurm_mutex_unlock(&rollup_lock);
 
@@ -737,19 +767,11 @@ extern int as_mysql_job_complete(mysql_conn_t *mysql_conn,
 
 	slurm_mutex_lock(&rollup_lock);
 	if (end_time < global_last_rollup) {
-		global_last_rollup = job_ptr->end_time;
 		slurm_mutex_unlock(&rollup_lock);
 
-		query = xstrdup_printf("update \"%s_%s\" set "
-				       "hourly_rollup=%ld, "
-				       "daily_rollup=%ld, monthly_rollup=%ld",
-				       mysql_conn->cluster_name,
-				       last_ran_table, end_time,
-				       end_time, end_time);
-		debug3("%d(%s:%d) query\n%s",
-		       mysql_conn->conn, THIS_FILE, __LINE__, query);
-		rc = mysql_db_query(mysql_conn, query);
-		xfree(query);
+		/* The hours since the job ended were rolled up as if it
+		 * was still running */
+		rc = as_mysql_reroll_usage(mysql_conn, end_time, time(NULL));
 	} else
 		slurm_mutex_unlock(&rollup_lock);
 
@@ -1201,6 +1223,16 @@ extern int as_mysql_suspend(mysql_conn_t *mysql_conn,
 	} else
 		job_db_inx = job_ptr->db_index;
 
+	if (_suspend_recorded(mysql_conn, job_ptr->db_index,
+			      IS_JOB_SUSPENDED(job_ptr),
+			      job_ptr->suspend_time)) {
+		debug("%s of job %u at %ld already recorded",
+		      IS_JOB_SUSPENDED(job_ptr) ? "Suspend" : "Resume",
+		      job_ptr->job_id, (long)job_ptr->suspend_time);
+		xfree(query);
+		return SLURM_SUCCESS;
+	}
+
 	/* use job_db_inx for this one since we want to update the
 	   supend time of the job before it was resized.
 	*/
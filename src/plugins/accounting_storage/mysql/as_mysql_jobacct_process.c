@@ -317,6 +317,15 @@ static void _state_time_string(char **extra, uint32_t state,
 	return;
 }
 
+static int _find_job_id(void *x, void *key)
+{
+	slurmdb_job_rec_t *job = (slurmdb_job_rec_t *)x;
+
+	if (job->jobid == *(uint32_t *)key)
+		return 1;
+	return 0;
+}
+
 static void _destroy_local_cluster(void *object)
 {
 	local_cluster_t *local_cluster = (local_cluster_t *)object;
@@ -334,7 +343,9 @@ static int _cluster_get_jobs(mysql_conn_t *mysql_conn,
 			     char *cluster_name,
 			     char *job_fields, char *step_fields,
 			     char *sent_extra,
-			     bool is_admin, int only_pending, List sent_list)
+			     bool is_admin, int only_pending,
+			     uint32_t *cursor_jobid, bool *more,
+			     List sent_list)
 {
 	char *query = NULL;
 	char *extra = xstrdup(sent_extra);
@@ -351,7 +362,9 @@ static int _cluster_get_jobs(mysql_conn_t *mysql_conn,
 	int set = 0;
 	char *prefix="t2";
 	int rc = SLURM_SUCCESS;
-	int last_id = -1, curr_id = -1;
+	int last_id = -1, curr_id = -1, first_id = -1;
+	uint32_t row_cnt = 0;
+	uint32_t page_size = job_cond ? job_cond->page_size : 0;
 	local_cluster_t *curr_cluster = NULL;
 
 	/* This is here to make sure we are looking at only this user
@@ -421,6 +434,15 @@ static int _cluster_get_jobs(mysql_conn_t *mysql_conn,
 	setup_job_cluster_cond_limits(mysql_conn, job_cond,
 				      cluster_name, &extra);
 
+	/* Continue from the last job returned in the previous page */
+	if (page_size && *cursor_jobid) {
+		if (extra)
+			xstrfmtcat(extra, " && (t1.id_job>%u)", *cursor_jobid);
+		else
+			xstrfmtcat(extra, " where (t1.id_job>%u)",
+				   *cursor_jobid);
+	}
+
 	query = xstrdup_printf("select %s from \"%s_%s\" as t1 "
 			       "left join \"%s_%s\" as t2 "
 			       "on t1.id_assoc=t2.id_assoc",
@@ -436,6 +458,9 @@ static int _cluster_get_jobs(mysql_conn_t *mysql_conn,
 	   resized jobs.
 	*/
 	xstrcat(query, " group by id_job, time_submit desc");
+	if (page_size)
+		xstrfmtcat(query, " order by id_job, time_submit desc "
+			   "limit %u", page_size);
 
 	debug3("%d(%s:%d) query\n%s",
 	       mysql_conn->conn, THIS_FILE, __LINE__, query);
@@ -468,6 +493,8 @@ static int _cluster_get_jobs(mysql_conn_t *mysql_conn,
 		int submit = slurm_atoul(row[JOB_REQ_SUBMIT]);
 
 		curr_id = slurm_atoul(row[JOB_REQ_JOBID]);
+		if (!row_cnt++)
+			first_id = curr_id;
 
 		if (job_cond && !job_cond->duplicates
 		    && (curr_id == last_id)
@@ -863,6 +890,21 @@ static int _cluster_get_jobs(mysql_conn_t *mysql_conn,
 	}
 	mysql_free_result(result);
 
+	if (page_size && job_list && row_cnt) {
+		*cursor_jobid = curr_id;
+		if (row_cnt >= page_size) {
+			*more = true;
+			/* The page may end part way through the records
+			 * of the last job id, return them all in the next
+			 * page instead */
+			if (curr_id != first_id) {
+				list_delete_all(job_list, _find_job_id,
+						cursor_jobid);
+				(*cursor_jobid)--;
+			}
+		}
+	}
+
 end_it:
 	if (local_cluster_list)
 		list_destroy(local_cluster_list);
@@ -1473,6 +1515,8 @@ extern List as_mysql_jobacct_process_get_jobs(mysql_conn_t *mysql_conn,
 	int only_pending = 0;
 	List use_cluster_list = as_mysql_cluster_list;
 	char *cluster_name;
+	uint32_t cursor_jobid;
+	bool cursor_found = false, more;
 
 	memset(&user, 0, sizeof(slurmdb_user_rec_t));
 	user.uid = uid;
@@ -1523,12 +1567,34 @@ extern List as_mysql_jobacct_process_get_jobs(mysql_conn_t *mysql_conn,
 	itr = list_iterator_create(use_cluster_list);
 	while ((cluster_name = list_next(itr))) {
 		int rc;
-		if ((rc = _cluster_get_jobs(mysql_conn, &user, job_cond,
-					    cluster_name, tmp, tmp2, extra,
-					    is_admin, only_pending, job_list))
-		    != SLURM_SUCCESS)
+
+		cursor_jobid = 0;
+		if (job_cond && job_cond->page_size
+		    && job_cond->cursor_cluster && !cursor_found) {
+			/* skip the clusters in previous pages */
+			if (strcmp(cluster_name, job_cond->cursor_cluster))
+				continue;
+			cursor_found = true;
+			cursor_jobid = job_cond->cursor_jobid;
+		}
+
+		/* Keep reading while no job in a page matched, so an
+		 * empty page is only returned at the end */
+		do {
+			more = false;
+			rc = _cluster_get_jobs(mysql_conn, &user, job_cond,
+					       cluster_name, tmp, tmp2, extra,
+					       is_admin, only_pending,
+					       &cursor_jobid, &more, job_list);
+		} while ((rc == SLURM_SUCCESS) && more
+			 && !list_count(job_list));
+		if (rc != SLURM_SUCCESS)
 			error("Problem getting jobs for cluster %s",
 			      cluster_name);
+
+		/* a page only holds jobs from one cluster */
+		if (job_cond && job_cond->page_size && list_count(job_list))
+			break;
 	}
 	list_iterator_destroy(itr);
 
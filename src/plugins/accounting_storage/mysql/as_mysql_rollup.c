@@ -42,6 +42,9 @@
 #include "as_mysql_archive.h"
 #include "src/common/parse_time.h"
 
+/* Seconds between progress reports of an hourly rollup */
+#define ROLLUP_REPORT_SECS 60
+
 typedef struct {
 	int id;
 	uint64_t a_cpu;
@@ -468,6 +471,8 @@ extern int as_mysql_hourly_rollup(mysql_conn_t *mysql_conn,
 	time_t now = time(NULL);
 	time_t curr_start = start;
 	time_t curr_end = curr_start + add_sec;
+	time_t report_time = now;
+	int hours_done = 0, hours_tot = (end - start) / add_sec;
 	char *query = NULL;
 	MYSQL_RES *result = NULL;
 	MYSQL_ROW row;
@@ -1121,6 +1126,17 @@ extern int as_mysql_hourly_rollup(mysql_conn_t *mysql_conn,
 		list_flush(resv_usage_list);
 		curr_start = curr_end;
 		curr_end = curr_start + add_sec;
+
+		/* Report progress through a long rollup, such as
+		 * catching up after slurmdbd was down */
+		hours_done++;
+		if (difftime(time(NULL), report_time) >= ROLLUP_REPORT_SECS) {
+			report_time = time(NULL);
+			info("hourly_rollup for %s: %d of %d hours done, "
+			     "%.1f hours/sec", cluster_name,
+			     hours_done, hours_tot,
+			     hours_done / difftime(report_time, now));
+		}
 	}
 end_it:
 	xfree(suspend_str);
@@ -57,6 +57,258 @@ typedef struct {
 	time_t sent_start;
 } local_rollup_t;
 
+/* A cluster's hourly rollup is split between threads, each rolling up at
+ * least ROLLUP_CHUNK_HOURS hours on its own database connection */
+#define ROLLUP_CHUNK_HOURS	24
+#define ROLLUP_HOUR_THREADS	4
+
+typedef struct {
+	char *cluster_name;
+	int conn;		/* parent connection, for logging */
+	time_t end;
+	int rc;
+	time_t start;
+} local_hour_rollup_t;
+
+enum {
+	ROLLUP_HOUR,
+	ROLLUP_DAY,
+	ROLLUP_MONTH
+};
+
+/* Return the start of the hour, day or month containing "when" */
+static time_t _period_start(time_t when, int period)
+{
+	struct tm tm;
+
+	if (!localtime_r(&when, &tm))
+		return when;
+	tm.tm_sec = 0;
+	tm.tm_min = 0;
+	if (period != ROLLUP_HOUR)
+		tm.tm_hour = 0;
+	if (period == ROLLUP_MONTH)
+		tm.tm_mday = 1;
+	tm.tm_isdst = -1;
+	return mktime(&tm);
+}
+
+/* Return the end of the hour, day or month containing "when - 1", so a
+ * time already on a period boundary is returned unchanged */
+static time_t _period_end(time_t when, int period)
+{
+	struct tm tm;
+
+	when = _period_start(when - 1, period);
+	if (!localtime_r(&when, &tm))
+		return when;
+	if (period == ROLLUP_HOUR)
+		tm.tm_hour++;
+	else if (period == ROLLUP_DAY)
+		tm.tm_mday++;
+	else
+		tm.tm_mon++;
+	tm.tm_isdst = -1;
+	return mktime(&tm);
+}
+
+static void *_hour_rollup_chunk(void *arg)
+{
+	local_hour_rollup_t *chunk = (local_hour_rollup_t *)arg;
+	mysql_conn_t mysql_conn;
+
+	memset(&mysql_conn, 0, sizeof(mysql_conn_t));
+	mysql_conn.rollback = 1;
+	mysql_conn.conn = chunk->conn;
+	slurm_mutex_init(&mysql_conn.lock);
+
+	if ((chunk->rc = check_connection(&mysql_conn)) == SLURM_SUCCESS)
+		chunk->rc = as_mysql_hourly_rollup(&mysql_conn,
+						   chunk->cluster_name,
+						   chunk->start, chunk->end, 0);
+	if (chunk->rc == SLURM_SUCCESS) {
+		if (mysql_db_commit(&mysql_conn)) {
+			error("Couldn't commit hourly rollup of cluster %s",
+			      chunk->cluster_name);
+			chunk->rc = SLURM_ERROR;
+		}
+	} else if (mysql_db_rollback(&mysql_conn))
+		error("rollback failed");
+
+	mysql_db_close_db_connection(&mysql_conn);
+	slurm_mutex_destroy(&mysql_conn.lock);
+
+	return NULL;
+}
+
+/* Roll up the hours from start to end. Large ranges are split into
+ * chunks rolled up in parallel, each by a thread with its own connection
+ * and transaction, while this thread rolls up the last chunk on
+ * mysql_conn. Hourly records are replaced, so a chunk committed before a
+ * failure elsewhere is simply rolled up again by the next rollup. */
+static int _hourly_rollup(mysql_conn_t *mysql_conn, char *cluster_name,
+			  time_t start, time_t end, uint16_t archive_data)
+{
+	local_hour_rollup_t chunk[ROLLUP_HOUR_THREADS];
+	pthread_t chunk_tid[ROLLUP_HOUR_THREADS];
+	pthread_attr_t chunk_attr;
+	int hours = (end - start) / 3600;
+	int chunk_cnt, chunk_hours, i, rc;
+	time_t chunk_start = start;
+
+	chunk_cnt = MIN(hours / ROLLUP_CHUNK_HOURS, ROLLUP_HOUR_THREADS);
+	if (chunk_cnt < 2)
+		return as_mysql_hourly_rollup(mysql_conn, cluster_name,
+					      start, end, archive_data);
+
+	chunk_hours = hours / chunk_cnt;
+	debug2("hourly_rollup for %s: %d hours in %d chunks",
+	       cluster_name, hours, chunk_cnt);
+	slurm_attr_init(&chunk_attr);
+	for (i = 0; i < (chunk_cnt - 1); i++) {
+		chunk[i].cluster_name = cluster_name;
+		chunk[i].conn = mysql_conn->conn;
+		chunk[i].start = chunk_start;
+		chunk[i].end = chunk_start + (chunk_hours * 3600);
+		chunk[i].rc = SLURM_SUCCESS;
+		chunk_start = chunk[i].end;
+		if (pthread_create(&chunk_tid[i], &chunk_attr,
+				   _hour_rollup_chunk, (void *) &chunk[i]))
+			fatal("pthread_create: %m");
+	}
+	slurm_attr_destroy(&chunk_attr);
+
+	rc = as_mysql_hourly_rollup(mysql_conn, cluster_name,
+				    chunk_start, end, archive_data);
+
+	for (i = 0; i < (chunk_cnt - 1); i++) {
+		pthread_join(chunk_tid[i], NULL);
+		if ((rc == SLURM_SUCCESS) && (chunk[i].rc != SLURM_SUCCESS))
+			rc = chunk[i].rc;
+	}
+
+	return rc;
+}
+
+/* Roll up again the days and months from start to end, stopping at
+ * day_limit and month_limit, which this rollup will process anyway */
+static int _reroll_days(mysql_conn_t *mysql_conn, char *cluster_name,
+			time_t start, time_t end,
+			time_t day_limit, time_t month_limit)
+{
+	time_t period_start, period_end;
+	int rc = SLURM_SUCCESS;
+
+	period_start = _period_start(start, ROLLUP_DAY);
+	period_end = MIN(_period_end(end, ROLLUP_DAY), day_limit);
+	if (period_end > period_start)
+		rc = as_mysql_daily_rollup(mysql_conn, cluster_name,
+					   period_start, period_end, 0);
+	if (rc != SLURM_SUCCESS)
+		return rc;
+
+	period_start = _period_start(start, ROLLUP_MONTH);
+	period_end = MIN(_period_end(end, ROLLUP_MONTH), month_limit);
+	if (period_end > period_start)
+		rc = as_mysql_monthly_rollup(mysql_conn, cluster_name,
+					     period_start, period_end, 0);
+	return rc;
+}
+
+/* Roll up again the hours recorded in the cluster's rollup_dirty_table
+ * by as_mysql_reroll_usage() which were rolled up before the late
+ * records arrived, and the days and months containing them. Overlapping
+ * ranges are merged so each hour is only rolled up once. Hours from
+ * hour_limit on are rolled up by this rollup, but a range reaching them
+ * is kept starting at hour_limit in case its record was added while
+ * they were being rolled up.
+ * OUT hours - count of hours rolled up again */
+static int _reroll_dirty(mysql_conn_t *mysql_conn, char *cluster_name,
+			 time_t hour_limit, time_t day_limit,
+			 time_t month_limit, int *hours)
+{
+	MYSQL_RES *result = NULL;
+	MYSQL_ROW row;
+	char *query = NULL, *done_inx = NULL, *keep_inx = NULL;
+	time_t range_start = 0, range_end = 0, row_start, row_end;
+	int rc = SLURM_SUCCESS;
+
+	query = xstrdup_printf("select dirty_inx, time_start, time_end "
+			       "from \"%s_%s\" order by time_start",
+			       cluster_name, rollup_dirty_table);
+	debug4("%d(%s:%d) query\n%s",
+	       mysql_conn->conn, THIS_FILE, __LINE__, query);
+	if (!(result = mysql_db_query_ret(mysql_conn, query, 0))) {
+		xfree(query);
+		return SLURM_ERROR;
+	}
+	xfree(query);
+
+	while ((row = mysql_fetch_row(result))) {
+		row_start = _period_start(slurm_atoul(row[1]), ROLLUP_HOUR);
+		row_end = slurm_atoul(row[2]);
+		if (row_end > hour_limit)
+			xstrfmtcat(keep_inx, "%s%s", keep_inx ? "," : "",
+				   row[0]);
+		else
+			xstrfmtcat(done_inx, "%s%s", done_inx ? "," : "",
+				   row[0]);
+		row_end = MIN(_period_end(row_end, ROLLUP_HOUR), hour_limit);
+		if (row_end <= row_start)
+			continue;
+		if (range_end && (row_start <= range_end)) {
+			range_end = MAX(range_end, row_end);
+			continue;
+		}
+		if (range_end) {
+			debug("Rolling up %s again from %ld to %ld",
+			      cluster_name, range_start, range_end);
+			*hours += (range_end - range_start) / 3600;
+			if ((rc = _hourly_rollup(mysql_conn, cluster_name,
+						 range_start, range_end, 0))
+			    || (rc = _reroll_days(mysql_conn, cluster_name,
+						  range_start, range_end,
+						  day_limit, month_limit)))
+				break;
+		}
+		range_start = row_start;
+		range_end = row_end;
+	}
+	mysql_free_result(result);
+
+	if ((rc == SLURM_SUCCESS) && range_end) {
+		debug("Rolling up %s again from %ld to %ld",
+		      cluster_name, range_start, range_end);
+		*hours += (range_end - range_start) / 3600;
+		if ((rc = _hourly_rollup(mysql_conn, cluster_name,
+					 range_start, range_end, 0))
+		    == SLURM_SUCCESS)
+			rc = _reroll_days(mysql_conn, cluster_name,
+					  range_start, range_end,
+					  day_limit, month_limit);
+	}
+
+	if ((rc == SLURM_SUCCESS) && done_inx)
+		xstrfmtcat(query, "delete from \"%s_%s\" "
+			   "where dirty_inx in (%s);",
+			   cluster_name, rollup_dirty_table, done_inx);
+	if ((rc == SLURM_SUCCESS) && keep_inx)
+		xstrfmtcat(query, "update \"%s_%s\" set time_start=%ld "
+			   "where dirty_inx in (%s);",
+			   cluster_name, rollup_dirty_table, hour_limit,
+			   keep_inx);
+	xfree(done_inx);
+	xfree(keep_inx);
+	if (query) {
+		debug3("%d(%s:%d) query\n%s",
+		       mysql_conn->conn, THIS_FILE, __LINE__, query);
+		rc = mysql_db_query(mysql_conn, query);
+		xfree(query);
+	}
+
+	return rc;
+}
+
 static void *_cluster_rollup_usage(void *arg)
 {
 	local_rollup_t *local_rollup = (local_rollup_t *)arg;
@@ -72,12 +324,14 @@ static void *_cluster_rollup_usage(void *arg)
 	time_t last_hour = local_rollup->sent_start;
 	time_t last_day = local_rollup->sent_start;
 	time_t last_month = local_rollup->sent_start;
-	time_t hour_start;
-	time_t hour_end;
+	time_t hour_start = 0;
+	time_t hour_end = 0;
 	time_t day_start;
 	time_t day_end;
 	time_t month_start;
 	time_t month_end;
+	time_t rollup_start = time(NULL);
+	int reroll_hours = 0;
 	DEF_TIMERS;
 
 	char *update_req_inx[] = {
@@ -294,13 +548,28 @@ static void *_cluster_rollup_usage(void *arg)
 /* 	info("month end %s", slurm_ctime(&month_end)); */
 /* 	info("diff is %d", month_end-month_start); */
 
+	/* Hours already rolled up are only rolled up again if late
+	 * records changed them, see as_mysql_reroll_usage() */
+	if (!local_rollup->sent_start && !local_rollup->sent_end) {
+		START_TIMER;
+		rc = _reroll_dirty(&mysql_conn, local_rollup->cluster_name,
+				   hour_start, day_start, month_start,
+				   &reroll_hours);
+		snprintf(timer_str, sizeof(timer_str),
+			 "rollup of late records for %s",
+			 local_rollup->cluster_name);
+		END_TIMER3(timer_str, 5000000);
+		if (rc != SLURM_SUCCESS)
+			goto end_it;
+	}
+
 	if ((hour_end - hour_start) > 0) {
 		START_TIMER;
-		rc = as_mysql_hourly_rollup(&mysql_conn,
-					    local_rollup->cluster_name,
-					    hour_start,
-					    hour_end,
-					    local_rollup->archive_data);
+		rc = _hourly_rollup(&mysql_conn,
+				    local_rollup->cluster_name,
+				    hour_start,
+				    hour_end,
+				    local_rollup->archive_data);
 		snprintf(timer_str, sizeof(timer_str),
 			 "hourly_rollup for %s", local_rollup->cluster_name);
 		END_TIMER3(timer_str, 5000000);
@@ -383,6 +652,16 @@ end_it:
 			error("Couldn't commit rollup of cluster %s",
 			      local_rollup->cluster_name);
 			rc = SLURM_ERROR;
+		} else if ((hour_end - hour_start) > 3600 || reroll_hours) {
+			int hours = reroll_hours;
+			double secs = difftime(time(NULL), rollup_start);
+
+			if (hour_end > hour_start)
+				hours += (hour_end - hour_start) / 3600;
+			info("Rolled up %d hours (%d again for late records) "
+			     "of cluster %s in %.0f sec, %.1f hours/sec",
+			     hours, reroll_hours, local_rollup->cluster_name,
+			     secs, hours / MAX(secs, 1.0));
 		}
 	} else {
 		error("Cluster %s rollup failed", local_rollup->cluster_name);
@@ -399,6 +678,7 @@ end_it:
 		(*local_rollup->rc) = rc;
 	pthread_cond_signal(local_rollup->rolledup_cond);
 	slurm_mutex_unlock(local_rollup->rolledup_lock);
+	xfree(local_rollup->cluster_name);
 	xfree(local_rollup);
 
 	return NULL;
@@ -923,12 +1203,13 @@ extern int as_mysql_roll_usage(mysql_conn_t *mysql_conn,
 			       uint16_t archive_data)
 {
 	int rc = SLURM_SUCCESS;
-	int rolledup = 0;
+	int rolledup = 0, cluster_cnt = 0;
 	char *cluster_name = NULL;
 	ListIterator itr;
 	pthread_mutex_t rolledup_lock = PTHREAD_MUTEX_INITIALIZER;
 	pthread_cond_t rolledup_cond;
-	//DEF_TIMERS;
+	pthread_t rollup_tid;
+	pthread_attr_t rollup_attr;
 
 	if (check_connection(mysql_conn) != SLURM_SUCCESS)
 		return ESLURM_DB_CONNECTION;
@@ -938,16 +1219,18 @@ extern int as_mysql_roll_usage(mysql_conn_t *mysql_conn,
 	slurm_mutex_init(&rolledup_lock);
 	pthread_cond_init(&rolledup_cond, NULL);
 
-	//START_TIMER;
+	/* Each cluster is rolled up by its own thread on its own
+	 * database connection */
+	slurm_attr_init(&rollup_attr);
+	if (pthread_attr_setdetachstate(&rollup_attr, PTHREAD_CREATE_DETACHED))
+		error("pthread_attr_setdetachstate error %m");
 	slurm_mutex_lock(&as_mysql_cluster_list_lock);
 	itr = list_iterator_create(as_mysql_cluster_list);
 	while ((cluster_name = list_next(itr))) {
-		/* pthread_t rollup_tid; */
-		/* pthread_attr_t rollup_attr; */
 		local_rollup_t *local_rollup = xmalloc(sizeof(local_rollup_t));
 
 		local_rollup->archive_data = archive_data;
-		local_rollup->cluster_name = cluster_name;
+		local_rollup->cluster_name = xstrdup(cluster_name);
 
 		local_rollup->mysql_conn = mysql_conn;
 		local_rollup->rc = &rc;
@@ -960,25 +1243,18 @@ extern int as_mysql_roll_usage(mysql_conn_t *mysql_conn,
 
 		/* _cluster_rollup_usage is responsible for freeing
 		   this local_rollup */
-		_cluster_rollup_usage(local_rollup);
-		/* It turns out doing this with threads only buys a
-		   very small victory, and can skew the timings.  So
-		   just doing them one after the other isn't too bad.
-		   If you really want to do this in threads you can
-		   just uncomment this, and comment the call above.
-		*/
-		/* slurm_attr_init(&rollup_attr); */
-		/* if (pthread_create(&rollup_tid, &rollup_attr, */
-		/* 		   _cluster_rollup_usage, */
-		/* 		   (void *)local_rollup)) */
-		/* 	fatal("pthread_create: %m"); */
-		/* slurm_attr_destroy(&rollup_attr); */
+		if (pthread_create(&rollup_tid, &rollup_attr,
+				   _cluster_rollup_usage,
+				   (void *)local_rollup))
+			fatal("pthread_create: %m");
+		cluster_cnt++;
 	}
-	slurm_mutex_lock(&rolledup_lock);
 	list_iterator_destroy(itr);
 	slurm_mutex_unlock(&as_mysql_cluster_list_lock);
+	slurm_attr_destroy(&rollup_attr);
 
-	while (rolledup < list_count(as_mysql_cluster_list)) {
+	slurm_mutex_lock(&rolledup_lock);
+	while (rolledup < cluster_cnt) {
 		pthread_cond_wait(&rolledup_cond, &rolledup_lock);
 		debug2("Got %d rolled up", rolledup);
 	}
@@ -986,10 +1262,29 @@ extern int as_mysql_roll_usage(mysql_conn_t *mysql_conn,
 	debug2("Everything rolled up");
 	slurm_mutex_destroy(&rolledup_lock);
 	pthread_cond_destroy(&rolledup_cond);
-	/* END_TIMER; */
-	/* info("total time was %s", TIME_STR); */
 
 	slurm_mutex_unlock(&usage_rollup_lock);
 
 	return rc;
 }
+
+extern int as_mysql_reroll_usage(mysql_conn_t *mysql_conn,
+				 time_t start, time_t end)
+{
+	char *query = NULL;
+	int rc;
+
+	if (end <= start)
+		return SLURM_SUCCESS;
+
+	query = xstrdup_printf("insert into \"%s_%s\" "
+			       "(time_start, time_end) values (%ld, %ld);",
+			       mysql_conn->cluster_name, rollup_dirty_table,
+			       start, end);
+	debug3("%d(%s:%d) query\n%s",
+	       mysql_conn->conn, THIS_FILE, __LINE__, query);
+	rc = mysql_db_query(mysql_conn, query);
+	xfree(query);
+
+	return rc;
+}
@@ -55,4 +55,10 @@ extern int as_mysql_roll_usage(mysql_conn_t *mysql_conn,
 			    time_t sent_start, time_t sent_end,
 			    uint16_t archive_data);
 
+/* Record that usage of mysql_conn->cluster_name from start to end changed
+ * after it may have been rolled up, so the next rollup processes those
+ * hours, and the days and months containing them, again */
+extern int as_mysql_reroll_usage(mysql_conn_t *mysql_conn,
+				 time_t start, time_t end);
+
 #endif
@@ -105,6 +105,16 @@ extern int acct_storage_p_commit(void *db_conn, bool commit)
 	return SLURM_SUCCESS;
 }
 
+extern int acct_storage_p_batch_start(void *db_conn)
+{
+	return SLURM_ERROR;	/* not supported */
+}
+
+extern int acct_storage_p_batch_end(void *db_conn, bool commit)
+{
+	return SLURM_SUCCESS;
+}
+
 extern int acct_storage_p_add_users(void *db_conn, uint32_t uid,
 				    List user_list)
 {
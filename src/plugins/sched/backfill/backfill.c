@@ -13,6 +13,13 @@
  *  three nodes. Without explicitly forcing the second job to use nodes
  *  "lx[06-08]", we can't start it without possibly delaying the higher
  *  priority job.
+ *
+ *  Jobs are tested one at a time with the job and node write locks held,
+ *  since select_g_job_test() in will-run mode updates select plugin state
+ *  that is shared by all callers and can not safely be run from several
+ *  threads. The number of jobs tested per bf_interval is instead governed
+ *  by bf_yield_interval and bf_yield_sleep, which control how long the locks
+ *  are held and then released.
  *****************************************************************************
  *  Copyright (C) 2003-2007 The Regents of the University of California.
  *  Copyright (C) 2008-2010 Lawrence Livermore National Security.
@@ -102,6 +109,16 @@
 #  define BF_MAX_USERS	1000
 #endif
 
+/* Default time (in microseconds) spent testing jobs before relinquishing
+ * locks and how long to sleep before reacquiring them */
+#ifndef BACKFILL_YIELD_INTERVAL
+#  define BACKFILL_YIELD_INTERVAL	2000000
+#endif
+
+#ifndef BACKFILL_YIELD_SLEEP
+#  define BACKFILL_YIELD_SLEEP		1000000
+#endif
+
 #define SLURMCTLD_THREAD_LIMIT	5
 
 typedef struct node_space_map {
@@ -129,6 +146,15 @@ static int max_backfill_job_cnt = 100;
 static int max_backfill_job_per_part = 0;
 static int max_backfill_job_per_user = 0;
 static bool backfill_continue = false;
+static int yield_interval = BACKFILL_YIELD_INTERVAL;
+static int yield_sleep = BACKFILL_YIELD_SLEEP;
+
+/* The node space table and its bitmaps are retained between backfill cycles
+ * (and lock yields) so records can be rebuilt in place rather than being
+ * reallocated each time */
+static node_space_map_t *bf_node_space = NULL;
+static int bf_node_space_size = 0;	/* records allocated */
+static int bf_node_space_bits = 0;	/* size of retained bitmaps */
 
 /*********************** local functions *********************/
 static void _add_reservation(uint32_t start_time, uint32_t end_reserve,
@@ -140,7 +166,12 @@ static bool _job_is_completing(void);
 static void _load_config(void);
 static bool _many_pending_rpcs(void);
 static bool _more_work(time_t last_backfill_time);
-static void _my_sleep(int secs);
+static void _my_sleep(int64_t usec);
+static void _node_space_free(void);
+static node_space_map_t *_node_space_init(time_t begin_time,
+					  time_t end_time);
+static void _node_space_set(node_space_map_t *node_space_ptr,
+			    bitstr_t *src_bitmap);
 static int  _num_feature_count(struct job_record *job_ptr);
 static void _reset_job_time_limit(struct job_record *job_ptr, time_t now,
 				  node_space_map_t *node_space);
@@ -203,6 +234,66 @@ static void _dump_node_space_table(node_space_map_t *node_space_ptr)
 	info("=========================================");
 }
 
+/* Release the retained node space table and all of its bitmaps */
+static void _node_space_free(void)
+{
+	int i;
+
+	for (i = 0; i < bf_node_space_size; i++)
+		FREE_NULL_BITMAP(bf_node_space[i].avail_bitmap);
+	xfree(bf_node_space);
+	bf_node_space_size = 0;
+	bf_node_space_bits = 0;
+}
+
+/*
+ * Load a node space record's bitmap from src_bitmap. A bitmap retained from
+ * an earlier backfill cycle is overwritten in place, otherwise a new one is
+ * allocated.
+ */
+static void _node_space_set(node_space_map_t *node_space_ptr,
+			    bitstr_t *src_bitmap)
+{
+	if (node_space_ptr->avail_bitmap) {
+		bit_copybits(node_space_ptr->avail_bitmap, src_bitmap);
+		slurmctld_diag_stats.bf_last_slices_reused++;
+	} else {
+		node_space_ptr->avail_bitmap = bit_copy(src_bitmap);
+		slurmctld_diag_stats.bf_last_slices_rebuilt++;
+	}
+}
+
+/*
+ * Prepare the node space table for a new backfill cycle, growing it if
+ * max_job_bf has been increased and discarding its bitmaps if the node count
+ * has changed.
+ * RET - node space table with one record covering the whole window
+ */
+static node_space_map_t *_node_space_init(time_t begin_time,
+					  time_t end_time)
+{
+	int node_space_size = max_backfill_job_cnt + 3;
+
+	if (bf_node_space &&
+	    (bf_node_space_bits != bit_size(avail_node_bitmap)))
+		_node_space_free();
+	if (bf_node_space_size < node_space_size) {
+		xrealloc(bf_node_space,
+			 sizeof(node_space_map_t) * node_space_size);
+		bf_node_space_size = node_space_size;
+	}
+	bf_node_space_bits = bit_size(avail_node_bitmap);
+
+	slurmctld_diag_stats.bf_last_slices_reused = 0;
+	slurmctld_diag_stats.bf_last_slices_rebuilt = 0;
+	bf_node_space[0].begin_time = begin_time;
+	bf_node_space[0].end_time = end_time;
+	_node_space_set(&bf_node_space[0], avail_node_bitmap);
+	bf_node_space[0].next = 0;
+
+	return bf_node_space;
+}
+
 /*
  * _job_is_completing - Determine if jobs are in the process of completing.
  *	This is a variant of job_is_completing in slurmctld/job_scheduler.c.
@@ -401,11 +492,21 @@ extern void stop_backfill_agent(void)
 	pthread_mutex_unlock(&term_lock);
 }
 
-static void _my_sleep(int secs)
+static void _my_sleep(int64_t usec)
 {
+	int64_t nsec;
 	struct timespec ts = {0, 0};
+	struct timeval  tv = {0, 0};
 
-	ts.tv_sec = time(NULL) + secs;
+	if (gettimeofday(&tv, NULL)) {		/* Some error */
+		sleep(1);
+		return;
+	}
+
+	nsec  = tv.tv_usec + usec;
+	nsec *= 1000;
+	ts.tv_sec  = tv.tv_sec + (nsec / 1000000000);
+	ts.tv_nsec = nsec % 1000000000;
 	pthread_mutex_lock(&term_lock);
 	if (!stop_backfill)
 		pthread_cond_timedwait(&term_cond, &term_lock, &ts);
@@ -463,6 +564,22 @@ static void _load_config(void)
 		      max_backfill_job_per_user);
 	}
 
+	if (sched_params &&
+	    (tmp_ptr = strstr(sched_params, "bf_yield_interval=")))
+		yield_interval = atoi(tmp_ptr + 18);
+	if (yield_interval < 1) {
+		fatal("Invalid backfill scheduler bf_yield_interval: %d",
+		      yield_interval);
+	}
+
+	if (sched_params &&
+	    (tmp_ptr = strstr(sched_params, "bf_yield_sleep=")))
+		yield_sleep = atoi(tmp_ptr + 15);
+	if (yield_sleep < 1) {
+		fatal("Invalid backfill scheduler bf_yield_sleep: %d",
+		      yield_sleep);
+	}
+
 	/* bf_continue makes backfill continue where it was if interrupted
 	 */
 	if (sched_params && (strstr(sched_params, "bf_continue"))) {
@@ -481,13 +598,12 @@ extern void backfill_reconfig(void)
 static void _do_diag_stats(struct timeval *tv1, struct timeval *tv2,
 			   int yield_sleep)
 {
-	uint32_t yield_sleep_usecs = yield_sleep * 1000000;
 	uint32_t delta_t, real_time;
 
 	delta_t  = (tv2->tv_sec  - tv1->tv_sec) * 1000000;
 	delta_t +=  tv2->tv_usec - tv1->tv_usec;
 
-	real_time = (delta_t - (bf_last_yields * yield_sleep_usecs));
+	real_time = (delta_t - (bf_last_yields * yield_sleep));
 
 	slurmctld_diag_stats.bf_cycle_counter++;
 	slurmctld_diag_stats.bf_cycle_sum += real_time;
@@ -519,7 +635,7 @@ extern void *backfill_agent(void *args)
 	_load_config();
 	last_backfill_time = time(NULL);
 	while (!stop_backfill) {
-		_my_sleep(backfill_interval);
+		_my_sleep((int64_t) backfill_interval * 1000000);
 		if (stop_backfill)
 			break;
 		if (config_flag) {
@@ -538,12 +654,27 @@ extern void *backfill_agent(void *args)
 		last_backfill_time = time(NULL);
 		unlock_slurmctld(all_locks);
 	}
+	_node_space_free();
 	return NULL;
 }
 
+/* Return true if the backfill scheduler has held its locks for at least
+ * yield_interval microseconds since start_tv */
+static bool _yield_due(struct timeval *start_tv)
+{
+	struct timeval now_tv;
+	int64_t delta_t;
+
+	gettimeofday(&now_tv, NULL);
+	delta_t  = (int64_t) (now_tv.tv_sec - start_tv->tv_sec) * 1000000;
+	delta_t += now_tv.tv_usec - start_tv->tv_usec;
+
+	return (delta_t >= yield_interval);
+}
+
 /* Return non-zero to break the backfill loop if change in job, node or
  * partition state or the backfill scheduler needs to be stopped. */
-static int _yield_locks(int secs)
+static int _yield_locks(int usec)
 {
 	slurmctld_lock_t all_locks = {
 		READ_LOCK, WRITE_LOCK, WRITE_LOCK, READ_LOCK };
@@ -555,7 +686,7 @@ static int _yield_locks(int secs)
 
 	unlock_slurmctld(all_locks);
 	bf_last_yields++;
-	_my_sleep(secs);
+	_my_sleep(usec);
 	lock_slurmctld(all_locks);
 
 	if ((last_job_update  == job_update)  &&
@@ -584,8 +715,7 @@ static int _attempt_backfill(void)
 	bitstr_t *exc_core_bitmap = NULL;
 	time_t now, sched_start, later_start, start_res, resv_end;
 	node_space_map_t *node_space;
-	struct timeval bf_time1, bf_time2;
-	int sched_timeout = 2, yield_sleep = 1;
+	struct timeval bf_time1, bf_time2, start_tv;
 	int rc = 0;
 	int job_test_count = 0;
 	uint32_t *uid = NULL, nuser = 0, bf_parts = 0, *bf_part_jobs = NULL;
@@ -613,7 +743,7 @@ static int _attempt_backfill(void)
 
 	/* The Basil inventory can take a long time to complete. Process
 	 * pending RPCs before starting the backfill scheduling logic */
-	_yield_locks(1);
+	_yield_locks(1000000);
 #endif
 
 	START_TIMER;
@@ -622,6 +752,7 @@ static int _attempt_backfill(void)
 	else
 		debug("backfill: beginning");
 	sched_start = now = time(NULL);
+	gettimeofday(&start_tv, NULL);
 
 	if (slurm_get_root_filter())
 		filter_root = true;
@@ -643,12 +774,8 @@ static int _attempt_backfill(void)
 	slurmctld_diag_stats.bf_when_last_cycle = now;
 	slurmctld_diag_stats.bf_active = 1;
 
-	node_space = xmalloc(sizeof(node_space_map_t) *
-			     (max_backfill_job_cnt + 3));
-	node_space[0].begin_time = sched_start;
-	node_space[0].end_time = sched_start + backfill_window;
-	node_space[0].avail_bitmap = bit_copy(avail_node_bitmap);
-	node_space[0].next = 0;
+	node_space = _node_space_init(sched_start,
+				      sched_start + backfill_window);
 	node_space_recs = 1;
 	if (debug_flags & DEBUG_FLAG_BACKFILL)
 		_dump_node_space_table(node_space);
@@ -673,7 +800,7 @@ static int _attempt_backfill(void)
 	}
 	while ((job_queue_rec = (job_queue_rec_t *)
 				list_pop_bottom(job_queue, sort_job_queue2))) {
-		if ((time(NULL) - sched_start) >= sched_timeout) {
+		if (_yield_due(&start_tv)) {
 			if (debug_flags & DEBUG_FLAG_BACKFILL) {
 				END_TIMER;
 				info("backfill: completed yielding locks "
@@ -693,6 +820,7 @@ static int _attempt_backfill(void)
 			}
 			/* Reset backfill scheduling timers, resume testing */
 			sched_start = time(NULL);
+			gettimeofday(&start_tv, NULL);
 			job_test_count = 0;
 			START_TIMER;
 		}
@@ -844,7 +972,7 @@ static int _attempt_backfill(void)
 		/* Determine impact of any resource reservations */
 		later_start = now;
  TRY_LATER:
-		if ((time(NULL) - sched_start) >= sched_timeout) {
+		if (_yield_due(&start_tv)) {
 			uint32_t save_job_id = job_ptr->job_id;
 			uint32_t save_time_limit = job_ptr->time_limit;
 			job_ptr->time_limit = orig_time_limit;
@@ -880,6 +1008,7 @@ static int _attempt_backfill(void)
 			job_ptr->time_limit = save_time_limit;
 			/* Reset backfill scheduling timers, resume testing */
 			sched_start = time(NULL);
+			gettimeofday(&start_tv, NULL);
 			job_test_count = 1;
 			START_TIMER;
 		}
@@ -975,6 +1104,7 @@ static int _attempt_backfill(void)
 		if (start_res > job_ptr->start_time) {
 			job_ptr->start_time = start_res;
 			last_job_update = now;
+			job_record_changed(job_ptr);
 		}
 		if (job_ptr->start_time <= now) {
 			uint32_t save_time_limit = job_ptr->time_limit;
@@ -1070,12 +1200,7 @@ static int _attempt_backfill(void)
 	FREE_NULL_BITMAP(exc_core_bitmap);
 	FREE_NULL_BITMAP(resv_bitmap);
 
-	for (i=0; ; ) {
-		FREE_NULL_BITMAP(node_space[i].avail_bitmap);
-		if ((i = node_space[i].next) == 0)
-			break;
-	}
-	xfree(node_space);
+	/* node_space bitmaps are retained for the next cycle */
 	list_destroy(job_queue);
 	gettimeofday(&bf_time2, NULL);
 	_do_diag_stats(&bf_time1, &bf_time2, yield_sleep);
@@ -1109,6 +1234,7 @@ static int _start_job(struct job_record *job_ptr, bitstr_t *resv_bitmap)
 	if (rc == SLURM_SUCCESS) {
 		/* job initiated */
 		last_job_update = time(NULL);
+		job_record_changed(job_ptr);
 		info("backfill: Started JobId=%u on %s",
 		     job_ptr->job_id, job_ptr->nodes);
 		if (job_ptr->batch_flag == 0)
@@ -1213,8 +1339,8 @@ static void _add_reservation(uint32_t start_time, uint32_t end_reserve,
 			node_space[i].begin_time = start_time;
 			node_space[i].end_time = node_space[j].end_time;
 			node_space[j].end_time = start_time;
-			node_space[i].avail_bitmap =
-				bit_copy(node_space[j].avail_bitmap);
+			_node_space_set(&node_space[i],
+					node_space[j].avail_bitmap);
 			node_space[i].next = node_space[j].next;
 			node_space[j].next = i;
 			(*node_space_recs)++;
@@ -1233,8 +1359,8 @@ static void _add_reservation(uint32_t start_time, uint32_t end_reserve,
 				node_space[i].end_time = node_space[j].
 							 end_time;
 				node_space[j].end_time = end_reserve;
-				node_space[i].avail_bitmap =
-					bit_copy(node_space[j].avail_bitmap);
+				_node_space_set(&node_space[i],
+						node_space[j].avail_bitmap);
 				node_space[i].next = node_space[j].next;
 				node_space[j].next = i;
 				(*node_space_recs)++;
@@ -162,6 +162,7 @@ static void _sync_agent(bg_action_t *bg_action_ptr, bg_record_t *bg_record)
 		int sync_user_rc;
 		job_ptr->job_state &= (~JOB_CONFIGURING);
 		last_job_update = time(NULL);
+		job_record_changed(job_ptr);
 		/* Just in case reset the boot flags */
 		bg_record->boot_state = 0;
 		bg_record->boot_count = 0;
@@ -571,6 +572,7 @@ no_reboot:
 		lock_slurmctld(job_write_lock);
 		bg_action_ptr->job_ptr->job_state &= (~JOB_CONFIGURING);
 		last_job_update = time(NULL);
+		job_record_changed(bg_action_ptr->job_ptr);
 		unlock_slurmctld(job_write_lock);
 	}
 
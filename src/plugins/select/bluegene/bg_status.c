@@ -235,6 +235,7 @@ nochange_state:
 				bg_record->job_ptr->job_state |=
 					JOB_CONFIGURING;
 				last_job_update = time(NULL);
+				job_record_changed(bg_record->job_ptr);
 			} else if (bg_record->job_list
 				   && list_count(bg_record->job_list)) {
 				struct job_record *job_ptr;
@@ -252,6 +253,7 @@ nochange_state:
 						continue;
 					}
 					job_ptr->job_state |= JOB_CONFIGURING;
+					job_record_changed(job_ptr);
 				}
 				list_iterator_destroy(job_itr);
 				last_job_update = time(NULL);
@@ -301,6 +303,7 @@ nochange_state:
 				bg_record->job_ptr->job_state &=
 					(~JOB_CONFIGURING);
 				last_job_update = time(NULL);
+				job_record_changed(bg_record->job_ptr);
 			} else if (bg_record->job_list
 				   && list_count(bg_record->job_list)) {
 				struct job_record *job_ptr;
@@ -319,6 +322,7 @@ nochange_state:
 					}
 					job_ptr->job_state &=
 						(~JOB_CONFIGURING);
+					job_record_changed(job_ptr);
 				}
 				list_iterator_destroy(job_itr);
 				last_job_update = time(NULL);
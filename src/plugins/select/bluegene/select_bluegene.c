@@ -1721,6 +1721,7 @@ extern int select_p_job_ready(struct job_record *job_ptr)
 				 * missed it somehow. */
 				job_ptr->job_state &= (~JOB_CONFIGURING);
 				last_job_update = time(NULL);
+				job_record_changed(job_ptr);
 				rc = 1;
 			} else if (uid != job_ptr->user_id)
 				rc = 0;
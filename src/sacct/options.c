@@ -529,9 +529,28 @@ void _init_params()
 	params.job_cond->without_usage_truncation = 1;
 }
 
+/* Return true if the page of jobs ends with the same job as the previous
+ * page, which happens if the storage does not return jobs in pages */
+static bool _same_page(slurmdb_job_cond_t *job_cond, slurmdb_job_rec_t *job)
+{
+	if (!job || (job->jobid != job_cond->cursor_jobid))
+		return false;
+	if (!job->cluster || !job_cond->cursor_cluster)
+		return (job->cluster == job_cond->cursor_cluster);
+	return !strcmp(job->cluster, job_cond->cursor_cluster);
+}
+
+/* get_data() -- Get the next page of jobs to list
+ *
+ * Jobs are returned by the database SACCT_PAGE_SIZE at a time, so they
+ * can be listed as they arrive without holding all of them in memory.
+ * Each call frees the previous page, jobs is empty once all jobs were
+ * returned.
+ */
 int get_data(void)
 {
 	slurmdb_job_rec_t *job = NULL;
+	slurmdb_job_rec_t *last_job = NULL;
 	slurmdb_step_rec_t *step = NULL;
 
 	ListIterator itr = NULL;
@@ -541,13 +560,42 @@ int get_data(void)
 	if (params.opt_completion) {
 		jobs = g_slurm_jobcomp_get_jobs(job_cond);
 		return SLURM_SUCCESS;
-	} else {
-		jobs = slurmdb_jobs_get(acct_db_conn, job_cond);
 	}
 
+	if (jobs) {
+		/* continue after the last job of the previous page */
+		itr = list_iterator_create(jobs);
+		while ((job = list_next(itr)))
+			last_job = job;
+		list_iterator_destroy(itr);
+		if (!last_job || (list_count(jobs) > job_cond->page_size)) {
+			/* all jobs were returned in one list */
+			list_flush(jobs);
+			return SLURM_SUCCESS;
+		}
+		xfree(job_cond->cursor_cluster);
+		job_cond->cursor_cluster = xstrdup(last_job->cluster);
+		job_cond->cursor_jobid = last_job->jobid;
+		list_destroy(jobs);
+	}
+
+	job_cond->page_size = SACCT_PAGE_SIZE;
+	jobs = slurmdb_jobs_get(acct_db_conn, job_cond);
 	if (!jobs)
 		return SLURM_ERROR;
 
+	if (job_cond->cursor_cluster) {
+		last_job = NULL;
+		itr = list_iterator_create(jobs);
+		while ((job = list_next(itr)))
+			last_job = job;
+		list_iterator_destroy(itr);
+		if (_same_page(job_cond, last_job)) {
+			list_flush(jobs);
+			return SLURM_SUCCESS;
+		}
+	}
+
 	itr = list_iterator_create(jobs);
 	while((job = list_next(itr))) {
 		if (job->user) {
@@ -148,10 +148,16 @@ int main(int argc, char **argv)
 		print_fields_header(print_fields_list);
 		if (get_data() == SLURM_ERROR)
 			exit(errno);
-		if (params.opt_completion)
+		if (params.opt_completion) {
 			do_list_completion();
-		else
+			break;
+		}
+		/* list each page of jobs as it arrives */
+		while (list_count(jobs)) {
 			do_list();
+			if (get_data() == SLURM_ERROR)
+				exit(errno);
+		}
 		break;
 	case SACCT_HELP:
 		do_help();
@@ -75,6 +75,9 @@
 
 #define STATE_COUNT 10
 
+/* Jobs are requested from the database and listed this many at a time */
+#define SACCT_PAGE_SIZE 1000
+
 #define MAX_PRINTFIELDS 100
 #define FORMAT_STRING_SIZE 34
 
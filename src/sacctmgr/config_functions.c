@@ -160,3 +160,25 @@ extern int sacctmgr_list_config(bool have_db_conn)
 
 	return SLURM_SUCCESS;
 }
+
+extern int sacctmgr_list_stats(void)
+{
+	ListIterator iter = NULL;
+	config_key_pair_t *key_pair;
+	List stats_list = slurmdb_stats_get(db_conn);
+
+	if (!stats_list) {
+		fprintf(stderr, " Problem getting slurmdbd statistics\n");
+		return SLURM_ERROR;
+	}
+
+	printf("SlurmDBD RPC statistics:\n");
+	iter = list_iterator_create(stats_list);
+	while ((key_pair = list_next(iter))) {
+		printf("%-22s = %s\n", key_pair->name, key_pair->value);
+	}
+	list_iterator_destroy(iter);
+	list_destroy(stats_list);
+
+	return SLURM_SUCCESS;
+}
@@ -637,6 +637,8 @@ static void _show_it (int argc, char *argv[])
 		error_code = sacctmgr_list_problem((argc - 1), &argv[1]);
 	} else if (strncasecmp (argv[0], "QOS", MAX(command_len, 1)) == 0) {
 		error_code = sacctmgr_list_qos((argc - 1), &argv[1]);
+	} else if (strncasecmp (argv[0], "Stats", MAX(command_len, 2)) == 0) {
+		error_code = sacctmgr_list_stats();
 	} else if (!strncasecmp (argv[0], "Transactions", MAX(command_len, 1))
 		   || !strncasecmp (argv[0], "Txn", MAX(command_len, 1))) {
 		error_code = sacctmgr_list_txn((argc - 1), &argv[1]);
@@ -651,7 +653,8 @@ static void _show_it (int argc, char *argv[])
 		fprintf(stderr, "Input line must include ");
 		fprintf(stderr, "\"Account\", \"Association\", \"Cluster\", "
 			"\"Configuration\",\n\"Event\", \"Problem\", "
-			"\"QOS\", \"Transaction\", \"User\", or \"WCKey\"\n");
+			"\"QOS\", \"Stats\", \"Transaction\", \"User\", "
+			"or \"WCKey\"\n");
 	}
 
 	if (error_code != SLURM_SUCCESS) {
@@ -822,7 +825,8 @@ sacctmgr [<OPTION>] [<COMMAND>]                                            \n\
                                                                            \n\
   <ENTITY> may be \"account\", \"association\", \"cluster\",               \n\
                   \"configuration\", \"coordinator\", \"event\", \"job\",  \n\
-                  \"problem\", \"qos\", \"transaction\", \"user\" or \"wckey\"\n\
+                  \"problem\", \"qos\", \"stats\", \"transaction\",        \n\
+                  \"user\" or \"wckey\"                                    \n\
                                                                            \n\
   <SPECS> are different for each command entity pair.                      \n\
        list account       - Clusters=, Descriptions=, Format=,             \n\
@@ -223,6 +223,7 @@ extern int sacctmgr_list_config(bool have_db_conn);
 extern int sacctmgr_list_event(int argc, char *argv[]);
 extern int sacctmgr_list_problem(int argc, char *argv[]);
 extern int sacctmgr_list_qos(int argc, char *argv[]);
+extern int sacctmgr_list_stats(void);
 extern int sacctmgr_list_wckey(int argc, char *argv[]);
 
 extern int sacctmgr_modify_association(int argc, char *argv[]);
@@ -64,23 +64,38 @@
 #define MAX_RETRIES     10
 #define MAX_THREADS      8	/* These can be huge messages, so
 				 * only run MAX_THREADS at one time */
+#define MAX_BLOCKS       4	/* Blocks in flight at one time, each
+				 * using up to MAX_THREADS threads */
+
+typedef struct block {
+	file_bcast_msg_t *msg;	/* message to send */
+	int thread_cnt;		/* threads still sending it */
+} block_t;
+
 typedef struct thd {
 	pthread_t thread;	/* thread ID */
 	slurm_msg_t msg;	/* message to send */
-	int rc;			/* highest return codes from RPC */
+	block_t *block;		/* block being sent */
 	char *nodelist;
 } thd_t;
 
 static pthread_mutex_t agent_cnt_mutex = PTHREAD_MUTEX_INITIALIZER;
 static pthread_cond_t  agent_cnt_cond  = PTHREAD_COND_INITIALIZER;
-static int agent_cnt = 0;
+static int block_cnt = 0;		/* blocks in flight */
+static int agent_rc = SLURM_SUCCESS;	/* highest return code from RPCs */
+
+/* Node lists, one per thread sending each block */
+static int    threads_used = 0;
+static char **thread_nodes = NULL;
 
 static void *_agent_thread(void *args);
+static void  _build_node_lists(job_sbcast_cred_msg_t *sbcast_cred);
 
 static void *_agent_thread(void *args)
 {
 	List ret_list = NULL;
 	thd_t *thread_ptr = (thd_t *) args;
+	block_t *block = thread_ptr->block;
 	ListIterator itr;
 	ret_data_info_t *ret_data_info = NULL;
 	int rc = 0, msg_rc;
@@ -106,75 +121,99 @@ static void *_agent_thread(void *args)
 		rc = MAX(rc, msg_rc);
 	}
 
-	thread_ptr->rc = rc;
 	list_iterator_destroy(itr);
 	if (ret_list)
 		list_destroy(ret_list);
+	xfree(thread_ptr);
+
 	slurm_mutex_lock(&agent_cnt_mutex);
-	agent_cnt--;
+	agent_rc = MAX(agent_rc, rc);
+	if (--block->thread_cnt == 0) {
+		xfree(block->msg->block);
+		xfree(block->msg);
+		xfree(block);
+		block_cnt--;
+	}
 	pthread_cond_broadcast(&agent_cnt_cond);
 	slurm_mutex_unlock(&agent_cnt_mutex);
 	return NULL;
 }
 
-/* Issue the RPC to transfer the file's data */
-extern void send_rpc(file_bcast_msg_t *bcast_msg,
-		     job_sbcast_cred_msg_t *sbcast_cred)
+/* Split the job's nodes among up to MAX_THREADS threads (or the fanout),
+ * each of which sends to the first node of its list and has the message
+ * forwarded from there to the rest */
+static void _build_node_lists(job_sbcast_cred_msg_t *sbcast_cred)
 {
-	/* Preserve some data structures across calls for better performance */
-	static int threads_used = 0;
-	static thd_t thread_info[MAX_THREADS];
+	hostlist_t hl;
+	hostlist_t new_hl;
+	int *span = NULL;
+	char *name = NULL;
+	int i, fanout;
 
-	int i, fanout, rc = SLURM_SUCCESS;
-	int retries = 0;
-	pthread_attr_t attr;
+	if (params.fanout)
+		fanout = MIN(MAX_THREADS, params.fanout);
+	else
+		fanout = MAX_THREADS;
 
-	if (threads_used == 0) {
-		hostlist_t hl;
-		hostlist_t new_hl;
-		int *span = NULL;
-		char *name = NULL;
+	span = set_span(sbcast_cred->node_cnt, fanout);
+	thread_nodes = xmalloc(sizeof(char *) * fanout);
 
-		if (params.fanout)
-			fanout = MIN(MAX_THREADS, params.fanout);
-		else
-			fanout = MAX_THREADS;
+	hl = hostlist_create(sbcast_cred->node_list);
 
-		span = set_span(sbcast_cred->node_cnt, fanout);
-
-		hl = hostlist_create(sbcast_cred->node_list);
-
-		i = 0;
-		while (i < sbcast_cred->node_cnt) {
-			int j = 0;
+	i = 0;
+	while (i < sbcast_cred->node_cnt) {
+		int j = 0;
+		name = hostlist_shift(hl);
+		if (!name) {
+			debug3("no more nodes to send to");
+			break;
+		}
+		new_hl = hostlist_create(name);
+		free(name);
+		i++;
+		for(j = 0; j < span[threads_used]; j++) {
 			name = hostlist_shift(hl);
-			if (!name) {
-				debug3("no more nodes to send to");
+			if (!name)
 				break;
-			}
-			new_hl = hostlist_create(name);
+			hostlist_push(new_hl, name);
 			free(name);
 			i++;
-			for(j = 0; j < span[threads_used]; j++) {
-				name = hostlist_shift(hl);
-				if (!name)
-					break;
-				hostlist_push(new_hl, name);
-				free(name);
-				i++;
-			}
-			thread_info[threads_used].nodelist = 
-				hostlist_ranged_string_xmalloc(new_hl);
-			hostlist_destroy(new_hl);
-			slurm_msg_t_init(&thread_info[threads_used].msg);
-			thread_info[threads_used].msg.msg_type =
-				REQUEST_FILE_BCAST;
-			threads_used++;
 		}
-		xfree(span);
-		hostlist_destroy(hl);
-		debug("using %d threads", threads_used);
+		thread_nodes[threads_used] =
+			hostlist_ranged_string_xmalloc(new_hl);
+		hostlist_destroy(new_hl);
+		threads_used++;
 	}
+	xfree(span);
+	hostlist_destroy(hl);
+	debug("using %d threads", threads_used);
+}
+
+/* Issue the RPC to transfer one block of the file's data, waiting only
+ * until fewer than MAX_BLOCKS blocks are in flight. bcast_msg and its
+ * block must be allocated with xmalloc and are freed once sent; the other
+ * data it points to must remain valid until wait_rpcs() returns. */
+extern void send_rpc(file_bcast_msg_t *bcast_msg,
+		     job_sbcast_cred_msg_t *sbcast_cred)
+{
+	block_t *block;
+	thd_t *thread_ptr;
+	int i, retries = 0;
+	pthread_attr_t attr;
+
+	if (threads_used == 0)
+		_build_node_lists(sbcast_cred);
+
+	slurm_mutex_lock(&agent_cnt_mutex);
+	while ((block_cnt >= MAX_BLOCKS) && (agent_rc == SLURM_SUCCESS))
+		pthread_cond_wait(&agent_cnt_cond, &agent_cnt_mutex);
+	if (agent_rc != SLURM_SUCCESS)
+		exit(1);
+	block_cnt++;
+	block = xmalloc(sizeof(block_t));
+	block->msg = bcast_msg;
+	block->thread_cnt = threads_used;
+	slurm_mutex_unlock(&agent_cnt_mutex);
 
 	slurm_attr_init(&attr);
 	if (pthread_attr_setstacksize(&attr, 3 * 1024*1024))
@@ -184,30 +223,35 @@ extern void send_rpc(file_bcast_msg_t *bcast_msg,
 		error("pthread_attr_setdetachstate error %m");
 
 	for (i=0; i<threads_used; i++) {
-		thread_info[i].msg.data = bcast_msg;
-		slurm_mutex_lock(&agent_cnt_mutex);
-		agent_cnt++;
-		slurm_mutex_unlock(&agent_cnt_mutex);
+		thread_ptr = xmalloc(sizeof(thd_t));
+		slurm_msg_t_init(&thread_ptr->msg);
+		thread_ptr->msg.msg_type = REQUEST_FILE_BCAST;
+		thread_ptr->msg.data = bcast_msg;
+		thread_ptr->block = block;
+		thread_ptr->nodelist = thread_nodes[i];
 
-		while (pthread_create(&thread_info[i].thread,
+		while (pthread_create(&thread_ptr->thread,
 				      &attr, _agent_thread,
-				      (void *) &thread_info[i])) {
+				      (void *) thread_ptr)) {
 			error("pthread_create error %m");
 			if (++retries > MAX_RETRIES)
 				fatal("Can't create pthread");
 			sleep(1);	/* sleep and retry */
 		}
 	}
+	pthread_attr_destroy(&attr);
+}
+
+/* Wait for every block in flight to be sent, exit if any RPC failed */
+extern void wait_rpcs(void)
+{
+	int rc;
 
-	/* wait until pthreads complete */
 	slurm_mutex_lock(&agent_cnt_mutex);
-	while (agent_cnt)
+	while (block_cnt && (agent_rc == SLURM_SUCCESS))
 		pthread_cond_wait(&agent_cnt_cond, &agent_cnt_mutex);
+	rc = agent_rc;
 	slurm_mutex_unlock(&agent_cnt_mutex);
-	pthread_attr_destroy(&attr);
-
-	for (i=0; i<threads_used; i++)
-		 rc = MAX(rc, thread_info[i].rc);
 
 	if (rc)
 		exit(1);
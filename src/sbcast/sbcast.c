@@ -43,8 +43,10 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include <unistd.h>
 #include <sys/types.h>
@@ -56,6 +58,7 @@
 #include "src/common/log.h"
 #include "src/common/read_config.h"
 #include "src/common/slurm_cred.h"
+#include "src/common/slurm_lz.h"
 #include "src/common/slurm_protocol_api.h"
 #include "src/common/slurm_protocol_interface.h"
 #include "src/common/uid.h"
@@ -190,19 +193,46 @@ static ssize_t _get_block(char *buffer, size_t buf_size)
 	return buf_used;
 }
 
+/* compress a block's data in place, leaving it as is if it would not
+ * shrink or is too large for slurmd to accept compressed */
+static void _compress_block(file_bcast_msg_t *bcast_msg)
+{
+	char *comp;
+	uint32_t comp_len;
+
+	if ((bcast_msg->block_len == 0) ||
+	    (bcast_msg->block_len > FILE_BCAST_MAX_UNCOMP_LEN))
+		return;
+
+	comp = xmalloc(bcast_msg->block_len);
+	comp_len = slurm_lz_compress(bcast_msg->block, bcast_msg->block_len,
+				     comp, bcast_msg->block_len);
+	if (comp_len == 0) {
+		xfree(comp);
+		return;
+	}
+
+	xfree(bcast_msg->block);
+	bcast_msg->block      = comp;
+	bcast_msg->uncomp_len = bcast_msg->block_len;
+	bcast_msg->block_len  = comp_len;
+	bcast_msg->compress   = FILE_BCAST_COMPRESS_LZ;
+}
+
 /* read and broadcast the file */
 static void _bcast_file(void)
 {
 	int buf_size;
 	ssize_t size_read = 0;
-	file_bcast_msg_t bcast_msg;
-	char *buffer;
+	uint64_t size_sent = 0;
+	file_bcast_msg_t bcast_msg, *block_msg;
 
 	if (params.block_size)
 		buf_size = MIN(params.block_size, f_stat.st_size);
 	else
 		buf_size = MIN((512 * 1024), f_stat.st_size);
 
+	memset(&bcast_msg, 0, sizeof(file_bcast_msg_t));
 	bcast_msg.fname		= params.dst_fname;
 	bcast_msg.block_no	= 1;
 	bcast_msg.last_block	= 0;
@@ -211,9 +241,6 @@ static void _bcast_file(void)
 	bcast_msg.uid		= f_stat.st_uid;
 	bcast_msg.user_name	= uid_to_string(f_stat.st_uid);
 	bcast_msg.gid		= f_stat.st_gid;
-	buffer			= xmalloc(buf_size);
-	bcast_msg.block		= buffer;
-	bcast_msg.block_len	= 0;
 	bcast_msg.cred          = sbcast_cred->sbcast_cred;
 
 	if (params.preserve) {
@@ -224,19 +251,40 @@ static void _bcast_file(void)
 		bcast_msg.mtime     = 0;
 	}
 
+	/* Each block is read, and compressed if requested, while earlier
+	 * blocks are still in flight. Block one starts the writer on each
+	 * node and the last block completes the file, so those are only
+	 * sent once no other block is in flight. */
 	while (1) {
-		bcast_msg.block_len = _get_block(buffer, buf_size);
-		debug("block %d, size %u", bcast_msg.block_no,
-		      bcast_msg.block_len);
-		size_read += bcast_msg.block_len;
+		block_msg = xmalloc(sizeof(file_bcast_msg_t));
+		memcpy(block_msg, &bcast_msg, sizeof(file_bcast_msg_t));
+		block_msg->block        = xmalloc(buf_size);
+		block_msg->block_len    = _get_block(block_msg->block,
+						     buf_size);
+		block_msg->block_offset = size_read;
+		size_read += block_msg->block_len;
 		if (size_read >= f_stat.st_size)
-			bcast_msg.last_block = 1;
+			block_msg->last_block = 1;
+		if (params.compress)
+			_compress_block(block_msg);
+		debug("block %d, size %u", block_msg->block_no,
+		      block_msg->block_len);
+		size_sent += block_msg->block_len;
 
-		send_rpc(&bcast_msg, sbcast_cred);
-		if (bcast_msg.last_block)
+		if (block_msg->last_block) {
+			wait_rpcs();
+			send_rpc(block_msg, sbcast_cred);
+			wait_rpcs();
 			break;	/* end of file */
+		}
+		send_rpc(block_msg, sbcast_cred);
+		if (bcast_msg.block_no == 1)
+			wait_rpcs();
 		bcast_msg.block_no++;
 	}
+	if (params.compress) {
+		verbose("compressed %ld bytes to %"PRIu64" bytes",
+			(long) size_read, size_sent);
+	}
 	xfree(bcast_msg.user_name);
-	xfree(buffer);
 }
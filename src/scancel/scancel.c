@@ -175,7 +175,13 @@ _load_job_records (void)
 {
 	int error_code;
 
-	error_code = slurm_load_jobs ((time_t) NULL, &job_buffer_ptr, 1);
+	/* Jobs of other users are filtered out anyway, so only load the
+	 * specified user's jobs unless job IDs must also be verified */
+	if (opt.user_name && (opt.job_cnt == 0)) {
+		error_code = slurm_load_job_user(&job_buffer_ptr, opt.user_id,
+						 SHOW_ALL);
+	} else
+		error_code = slurm_load_jobs ((time_t) NULL, &job_buffer_ptr, 1);
 
 	if (error_code) {
 		slurm_perror ("slurm_load_jobs error");
@@ -39,6 +39,7 @@
 #  include "config.h"
 #endif
 
+#include <inttypes.h>
 #include <stdlib.h>
 #include <unistd.h>
 
@@ -46,6 +47,8 @@
 #include "src/common/macros.h"
 #include "src/common/read_config.h"
 #include "src/common/slurm_protocol_defs.h"
+#include "src/common/uid.h"
+#include "src/common/xmalloc.h"
 #include "src/common/xstring.h"
 
 /********************
@@ -100,6 +103,10 @@ static int _get_info(void)
 
 static int _print_info(void)
 {
+	static char *lock_names[] = { "config", "job", "node", "partition" };
+	char tmp_str[16], *user_name;
+	int i, j;
+
 	if (!buf) {
 		printf("No data available. Probably slurmctld is not working\n");
 		return -1;
@@ -111,7 +118,12 @@ static int _print_info(void)
 	printf("*******************************************************\n");
 
 	printf("Server thread count: %d\n", buf->server_thread_count);
-	printf("Agent queue size:    %d\n\n", buf->agent_queue_size);
+	printf("Agent queue size:    %d\n", buf->agent_queue_size);
+	printf("DBD Agent queue size: %u\n", buf->dbd_agent_queue_size);
+	printf("DBD Agent spool size: %"PRIu64" bytes\n",
+	       buf->dbd_agent_spool_size);
+	printf("DBD Agent drain rate: %u records per minute\n\n",
+	       buf->dbd_agent_drain_rate);
 	printf("Jobs submitted: %d\n", buf->jobs_submitted);
 	printf("Jobs started:   %d\n", buf->jobs_started);
 	printf("Jobs completed: %d\n", buf->jobs_completed);
@@ -165,6 +177,63 @@ static int _print_info(void)
 		printf("\tQueue length mean: %u\n",
 		       buf->bf_queue_len_sum / buf->bf_cycle_counter);
 	}
+	printf("\tLast cycle table slices reused: %u\n",
+	       buf->bf_last_slices_reused);
+	printf("\tLast cycle table slices rebuilt: %u\n",
+	       buf->bf_last_slices_rebuilt);
+
+	if (buf->lock_stat_cnt) {
+		printf("\nLock wait statistics (microseconds):\n");
+		for (i = 0; i < buf->lock_stat_cnt; i++) {
+			printf("\t%-9s %-5s waits: %-8u total: %-10"PRIu64" "
+			       "max: %u\n",
+			       (i / 2) < 4 ? lock_names[i / 2] : "UNKNOWN",
+			       (i % 2) ? "write" : "read",
+			       buf->lock_wait_cnt[i], buf->lock_wait_time[i],
+			       buf->lock_wait_max[i]);
+		}
+	}
+
+	if (buf->rpc_type_size) {
+		printf("\nRPC statistics by message type (latency in "
+		       "milliseconds):\n");
+		printf("\t%-33s %-9s %-7s %-7s", "Type", "Count", "Queued",
+		       "MaxQue");
+		for (i = 0, j = 1; i < buf->rpc_hist_size; i++, j *= 10) {
+			if (i < (buf->rpc_hist_size - 1))
+				sprintf(tmp_str, "<%u", j);
+			else
+				sprintf(tmp_str, ">=%u", j / 10);
+			printf(" %-8s", tmp_str);
+		}
+		printf("\n");
+		for (i = 0; i < buf->rpc_type_size; i++) {
+			printf("\t%-33s %-9u %-7u %-7u",
+			       rpc_num2string(buf->rpc_type_id[i]),
+			       buf->rpc_type_cnt[i], buf->rpc_type_queued[i],
+			       buf->rpc_type_queued_max[i]);
+			for (j = 0; j < buf->rpc_hist_size; j++) {
+				printf(" %-8u", buf->rpc_latency_hist[
+				       i * buf->rpc_hist_size + j]);
+			}
+			printf("\n");
+		}
+	}
+
+	if (buf->rpc_user_size) {
+		printf("\nRPC statistics by user (defer time in "
+		       "milliseconds):\n");
+		for (i = 0; i < buf->rpc_user_size; i++) {
+			user_name = uid_to_string(buf->rpc_user_id[i]);
+			printf("\t%-16s(%u) count:%-8u deferred:%-8u "
+			       "throttled:%-8u defer time:%u\n",
+			       user_name, buf->rpc_user_id[i],
+			       buf->rpc_user_cnt[i], buf->rpc_user_deferred[i],
+			       buf->rpc_user_throttled[i],
+			       buf->rpc_user_defer_time[i]);
+			xfree(user_name);
+		}
+	}
 	return 0;
 }
 
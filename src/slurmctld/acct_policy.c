@@ -1995,6 +1995,7 @@ extern int acct_policy_update_pending_job(struct job_record *job_ptr)
 
 	if (update_accounting) {
 		last_job_update = time(NULL);
+		job_record_changed(job_ptr);
 		debug("limits changed for job %u: updating accounting",
 		      job_ptr->job_id);
 		if (details_ptr->begin_time) {
@@ -2056,6 +2057,7 @@ extern bool acct_policy_job_time_out(struct job_record *job_ptr)
 		if ((qos->grp_cpu_mins != (uint64_t)INFINITE)
 		    && (usage_mins >= qos->grp_cpu_mins)) {
 			last_job_update = now;
+			job_record_changed(job_ptr);
 			info("Job %u timed out, "
 			     "the job is at or exceeds QOS %s's "
 			     "group max cpu minutes of %"PRIu64" "
@@ -2071,6 +2073,7 @@ extern bool acct_policy_job_time_out(struct job_record *job_ptr)
 		if ((qos->grp_wall != INFINITE)
 		    && (wall_mins >= qos->grp_wall)) {
 			last_job_update = now;
+			job_record_changed(job_ptr);
 			info("Job %u timed out, "
 			     "the job is at or exceeds QOS %s's "
 			     "group wall limit of %u with %u",
@@ -2084,6 +2087,7 @@ extern bool acct_policy_job_time_out(struct job_record *job_ptr)
 		if ((qos->max_cpu_mins_pj != (uint64_t)INFINITE)
 		    && (job_cpu_usage_mins >= qos->max_cpu_mins_pj)) {
 			last_job_update = now;
+			job_record_changed(job_ptr);
 			info("Job %u timed out, "
 			     "the job is at or exceeds QOS %s's "
 			     "max cpu minutes of %"PRIu64" "
@@ -50,15 +50,19 @@
  *  be possible to execute the agent as an pthread, process, or even a daemon
  *  on some other computer.
  *
- *  The main agent thread creates a separate thread for each node to be
- *  communicated with up to AGENT_THREAD_COUNT. A special watchdog thread
- *  sends SIGLARM to any threads that have been active (in DSH_ACTIVE state)
+ *  The main agent thread hands a separate task for each node to be
+ *  communicated with to a persistent pool of RPC worker threads, with up to
+ *  AGENT_THREAD_COUNT tasks per agent active at once. Worker threads are
+ *  created only when every existing worker is busy and never exit until
+ *  shutdown, so a burst of agents (e.g. job termination) does not create a
+ *  thread per node. The main agent thread also acts as watchdog, sending
+ *  SIGUSR1 to any workers whose task has been active (in DSH_ACTIVE state)
  *  for more than COMMAND_TIMEOUT seconds.
  *  The agent responds to slurmctld via a function call or an RPC as required.
  *  For example, informing slurmctld that some node is not responding.
  *
- *  All the state for each thread is maintained in thd_t struct, which is
- *  used by the watchdog thread as well as the communication threads.
+ *  All the state for each task is maintained in thd_t struct, which is
+ *  used by the watchdog as well as the communication threads.
 \*****************************************************************************/
 
 #ifdef HAVE_CONFIG_H
@@ -71,6 +75,7 @@
 #include <signal.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/time.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <unistd.h>
@@ -98,6 +103,7 @@
 #include "src/slurmctld/srun_comm.h"
 
 #define MAX_RETRIES		100
+#define AGENT_POOL_MAX		(MAX_AGENT_CNT * AGENT_THREAD_COUNT)
 
 typedef enum {
 	DSH_NEW,        /* Request not yet started */
@@ -117,8 +123,7 @@ typedef struct thd_complete {
 } thd_complete_t;
 
 typedef struct thd {
-	pthread_t thread;		/* thread ID */
-	pthread_attr_t attr;		/* thread attributes */
+	pthread_t thread;		/* worker thread ID while active */
 	state_t state;			/* thread state */
 	time_t start_time;		/* start time */
 	time_t end_time;		/* end time or delta time
@@ -166,6 +171,7 @@ typedef struct mail_info {
 } mail_info_t;
 
 static void _sig_handler(int dummy);
+static void *_agent_worker(void *args);
 static int  _batch_launch_defer(queued_request_t *queued_req_ptr);
 static inline int _comm_err(char *node_name, slurm_msg_type_t msg_type);
 static void _list_delete_retry(void *retry_entry);
@@ -176,12 +182,13 @@ static void _notify_slurmctld_nodes(agent_info_t *agent_ptr,
 		int no_resp_cnt, int retry_cnt);
 static void _purge_agent_args(agent_arg_t *agent_arg_ptr);
 static void _queue_agent_retry(agent_info_t * agent_info_ptr, int count);
+static void _queue_agent_task(task_info_t *task_ptr);
 static int _setup_requeue(agent_arg_t *agent_arg_ptr, thd_t *thread_ptr,
 			  int count, int *spot);
 static void _spawn_retry_agent(agent_arg_t * agent_arg_ptr);
 static void *_thread_per_group_rpc(void *args);
 static int   _valid_agent_arg(agent_arg_t *agent_arg_ptr);
-static void *_wdog(void *args);
+static void  _wdog(agent_info_t *agent_ptr);
 
 static mail_info_t *_mail_alloc(void);
 static void  _mail_free(void *arg);
@@ -197,6 +204,12 @@ static pthread_mutex_t agent_cnt_mutex = PTHREAD_MUTEX_INITIALIZER;
 static pthread_cond_t  agent_cnt_cond  = PTHREAD_COND_INITIALIZER;
 static int agent_cnt = 0;
 
+static pthread_mutex_t agent_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  agent_pool_cond  = PTHREAD_COND_INITIALIZER;
+static List agent_task_list = NULL;	/* task_info_t awaiting a worker */
+static int agent_pool_cnt  = 0;		/* RPC worker threads */
+static int agent_pool_idle = 0;		/* RPC worker threads awaiting work */
+
 static bool run_scheduler    = false;
 static bool wiki2_sched      = false;
 static bool wiki2_sched_test = false;
@@ -211,13 +224,9 @@ static bool wiki2_sched_test = false;
  */
 void *agent(void *args)
 {
-	int i, delay, rc, retries = 0;
-	pthread_attr_t attr_wdog;
-	pthread_t thread_wdog;
+	int delay;
 	agent_arg_t *agent_arg_ptr = args;
 	agent_info_t *agent_info_ptr = NULL;
-	thd_t *thread_ptr;
-	task_info_t *task_specific_ptr;
 	time_t begin_time;
 
 #if 0
@@ -253,69 +262,13 @@ void *agent(void *args)
 
 	/* initialize the agent data structures */
 	agent_info_ptr = _make_agent_info(agent_arg_ptr);
-	thread_ptr = agent_info_ptr->thread_struct;
-
-	/* start the watchdog thread */
-	slurm_attr_init(&attr_wdog);
-	if (pthread_attr_setdetachstate
-	    (&attr_wdog, PTHREAD_CREATE_JOINABLE))
-		error("pthread_attr_setdetachstate error %m");
-	while (pthread_create(&thread_wdog, &attr_wdog, _wdog,
-				(void *) agent_info_ptr)) {
-		error("pthread_create error %m");
-		if (++retries > MAX_RETRIES)
-			fatal("Can't create pthread");
-		usleep(10000);	/* sleep and retry */
-	}
-	slurm_attr_destroy(&attr_wdog);
 #if 	AGENT_THREAD_COUNT < 1
 	fatal("AGENT_THREAD_COUNT value is invalid");
 #endif
 	debug2("got %d threads to send out",agent_info_ptr->thread_count);
-	/* start all the other threads (up to AGENT_THREAD_COUNT active) */
-	for (i = 0; i < agent_info_ptr->thread_count; i++) {
-
-		/* wait until "room" for another thread */
-		slurm_mutex_lock(&agent_info_ptr->thread_mutex);
-		while (agent_info_ptr->threads_active >=
-		       AGENT_THREAD_COUNT) {
-			pthread_cond_wait(&agent_info_ptr->thread_cond,
-					  &agent_info_ptr->thread_mutex);
-		}
-
-		/* create thread specific data, NOTE: freed from
-		 *      _thread_per_group_rpc() */
-		task_specific_ptr = _make_task_data(agent_info_ptr, i);
 
-		slurm_attr_init(&thread_ptr[i].attr);
-		if (pthread_attr_setdetachstate(&thread_ptr[i].attr,
-						PTHREAD_CREATE_DETACHED))
-			error("pthread_attr_setdetachstate error %m");
-		while ((rc = pthread_create(&thread_ptr[i].thread,
-					    &thread_ptr[i].attr,
-					    _thread_per_group_rpc,
-					    (void *) task_specific_ptr))) {
-			error("pthread_create error %m");
-			if (agent_info_ptr->threads_active)
-				pthread_cond_wait(&agent_info_ptr->
-						  thread_cond,
-						  &agent_info_ptr->
-						  thread_mutex);
-			else {
-				slurm_mutex_unlock(&agent_info_ptr->
-						     thread_mutex);
-				usleep(10000);	/* sleep and retry */
-				slurm_mutex_lock(&agent_info_ptr->
-						   thread_mutex);
-			}
-		}
-		slurm_attr_destroy(&thread_ptr[i].attr);
-		agent_info_ptr->threads_active++;
-		slurm_mutex_unlock(&agent_info_ptr->thread_mutex);
-	}
-
-	/* wait for termination of remaining threads */
-	pthread_join(thread_wdog, NULL);
+	/* hand the tasks to the worker pool and wait for their completion */
+	_wdog(agent_info_ptr);
 	delay = (int) difftime(time(NULL), begin_time);
 	if (delay > (slurm_get_msg_timeout() * 2)) {
 		info("agent msg_type=%u ran for %d seconds",
@@ -514,21 +467,24 @@ static void _update_wdog_state(thd_t *thread_ptr,
 }
 
 /*
- * _wdog - Watchdog thread. Send SIGUSR1 to threads which have been active
- *	for too long.
- * IN args - pointer to agent_info_t with info on threads to watch
- * Sleep between polls with exponential times (from 0.125 to 1.0 second)
+ * _wdog - Hand an agent's tasks to the RPC worker pool, up to
+ *	AGENT_THREAD_COUNT at a time, and send SIGUSR1 to workers whose task
+ *	has been active for too long. Returns once every task completes.
+ * IN agent_ptr - pointer to agent_info_t with info on tasks to watch
+ * Poll with exponential times (from 0.005 to 1.0 second), waking early
+ *	whenever a task completes
  */
-static void *_wdog(void *args)
+static void _wdog(agent_info_t *agent_ptr)
 {
 	bool srun_agent = false;
-	int i;
-	agent_info_t *agent_ptr = (agent_info_t *) args;
+	int i, next_task = 0;
 	thd_t *thread_ptr = agent_ptr->thread_struct;
 	unsigned long usec = 5000;
 	ListIterator itr;
 	thd_complete_t thd_comp;
 	ret_data_info_t *ret_data_info = NULL;
+	struct timeval tv;
+	struct timespec ts;
 
 	if ( (agent_ptr->msg_type == SRUN_JOB_COMPLETE)			||
 	     (agent_ptr->msg_type == SRUN_STEP_MISSING)			||
@@ -543,17 +499,32 @@ static void *_wdog(void *args)
 
 	thd_comp.max_delay = 0;
 
+	slurm_mutex_lock(&agent_ptr->thread_mutex);
 	while (1) {
 		thd_comp.work_done   = true;/* assume all threads complete */
 		thd_comp.fail_cnt    = 0;   /* assume no threads failures */
 		thd_comp.no_resp_cnt = 0;   /* assume all threads respond */
 		thd_comp.retry_cnt   = 0;   /* assume no required retries */
-		thd_comp.now         = time(NULL);
 
-		usleep(usec);
+		/* start more tasks if "room" is available */
+		while ((next_task < agent_ptr->thread_count) &&
+		       (agent_ptr->threads_active < AGENT_THREAD_COUNT)) {
+			/* create thread specific data, NOTE: freed from
+			 *      _thread_per_group_rpc() */
+			_queue_agent_task(_make_task_data(agent_ptr,
+							  next_task++));
+			agent_ptr->threads_active++;
+		}
+
+		gettimeofday(&tv, NULL);
+		tv.tv_usec += usec;
+		ts.tv_sec  = tv.tv_sec + (tv.tv_usec / 1000000);
+		ts.tv_nsec = (tv.tv_usec % 1000000) * 1000;
+		pthread_cond_timedwait(&agent_ptr->thread_cond,
+				       &agent_ptr->thread_mutex, &ts);
 		usec = MIN((usec * 2), 1000000);
 
-		slurm_mutex_lock(&agent_ptr->thread_mutex);
+		thd_comp.now = time(NULL);
 		for (i = 0; i < agent_ptr->thread_count; i++) {
 			//info("thread name %s",thread_ptr[i].node_name);
 			if (!thread_ptr[i].ret_list) {
@@ -573,8 +544,6 @@ static void *_wdog(void *args)
 		}
 		if (thd_comp.work_done)
 			break;
-
-		slurm_mutex_unlock(&agent_ptr->thread_mutex);
 	}
 
 	if (srun_agent) {
@@ -595,7 +564,74 @@ static void *_wdog(void *args)
 		debug2("agent maximum delay %d seconds", thd_comp.max_delay);
 
 	slurm_mutex_unlock(&agent_ptr->thread_mutex);
-	return (void *) NULL;
+}
+
+/* _queue_agent_task - hand a task to the RPC worker pool, creating another
+ *	worker only if every existing worker is busy */
+static void _queue_agent_task(task_info_t *task_ptr)
+{
+	pthread_attr_t attr_worker;
+	pthread_t thread_worker;
+	int rc, retries = 0;
+
+	slurm_mutex_lock(&agent_pool_mutex);
+	if (agent_task_list == NULL) {
+		agent_task_list = list_create(NULL);
+		if (agent_task_list == NULL)
+			fatal("list_create failed");
+	}
+	list_enqueue(agent_task_list, task_ptr);
+	if ((list_count(agent_task_list) > agent_pool_idle) &&
+	    (agent_pool_cnt < AGENT_POOL_MAX)) {
+		slurm_attr_init(&attr_worker);
+		if (pthread_attr_setdetachstate(&attr_worker,
+						PTHREAD_CREATE_DETACHED))
+			error("pthread_attr_setdetachstate error %m");
+		while ((rc = pthread_create(&thread_worker, &attr_worker,
+					    _agent_worker, NULL))) {
+			error("pthread_create error %m");
+			if (agent_pool_cnt)
+				break;	/* an existing worker will run it */
+			if (++retries > MAX_RETRIES)
+				fatal("Can't create pthread");
+			usleep(10000);	/* sleep and retry */
+		}
+		slurm_attr_destroy(&attr_worker);
+		if (rc == 0) {
+			agent_pool_cnt++;
+			debug2("agent worker pool now has %d threads",
+			       agent_pool_cnt);
+		}
+	}
+	pthread_cond_signal(&agent_pool_cond);
+	slurm_mutex_unlock(&agent_pool_mutex);
+}
+
+/* _agent_worker - persistent RPC worker thread, runs queued tasks until
+ *	slurmctld shuts down */
+static void *_agent_worker(void *args)
+{
+	task_info_t *task_ptr;
+
+	while (1) {
+		slurm_mutex_lock(&agent_pool_mutex);
+		while (!(task_ptr = list_dequeue(agent_task_list))) {
+			if (slurmctld_config.shutdown_time)
+				break;
+			agent_pool_idle++;
+			pthread_cond_wait(&agent_pool_cond, &agent_pool_mutex);
+			agent_pool_idle--;
+		}
+		if (task_ptr == NULL) {
+			agent_pool_cnt--;
+			slurm_mutex_unlock(&agent_pool_mutex);
+			break;
+		}
+		slurm_mutex_unlock(&agent_pool_mutex);
+
+		_thread_per_group_rpc(task_ptr);
+	}
+	return NULL;
 }
 
 static void _notify_slurmctld_jobs(agent_info_t *agent_ptr)
@@ -836,6 +872,7 @@ static void *_thread_per_group_rpc(void *args)
 	thread_ptr->start_time = time(NULL);
 
 	slurm_mutex_lock(thread_mutex_ptr);
+	thread_ptr->thread = pthread_self();
 	thread_ptr->state = DSH_ACTIVE;
 	thread_ptr->end_time = thread_ptr->start_time + COMMAND_TIMEOUT;
 	slurm_mutex_unlock(thread_mutex_ptr);
@@ -1381,6 +1418,16 @@ void agent_purge(void)
 		mail_list = NULL;
 		slurm_mutex_unlock(&mail_mutex);
 	}
+	if (slurmctld_config.shutdown_time) {
+		/* idle RPC workers exit */
+		slurm_mutex_lock(&agent_pool_mutex);
+		pthread_cond_broadcast(&agent_pool_cond);
+		if (agent_task_list && (agent_pool_cnt == 0)) {
+			list_destroy(agent_task_list);
+			agent_task_list = NULL;
+		}
+		slurm_mutex_unlock(&agent_pool_mutex);
+	}
 }
 extern int get_agent_count(void)
 {
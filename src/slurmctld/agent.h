@@ -48,9 +48,10 @@
 #define COMMAND_TIMEOUT 	30	/* command requeue or error, seconds */
 #define MAX_AGENT_CNT		(MAX_SERVER_THREADS / (AGENT_THREAD_COUNT + 2))
 					/* maximum simultaneous agents, note
-					 *   total thread count is product of
-					 *   MAX_AGENT_CNT and
-					 *   (AGENT_THREAD_COUNT + 2) */
+					 *   total thread count is at most
+					 *   product of MAX_AGENT_CNT and
+					 *   (AGENT_THREAD_COUNT + 1), RPC
+					 *   worker threads persist */
 
 typedef struct agent_arg {
 	uint32_t	node_count;	/* number of nodes to communicate
@@ -51,6 +51,7 @@
 
 #include <grp.h>
 #include <errno.h>
+#include <poll.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -101,6 +102,7 @@
 #include "src/slurmctld/proc_req.h"
 #include "src/slurmctld/read_config.h"
 #include "src/slurmctld/reservation.h"
+#include "src/slurmctld/rpc_queue.h"
 #include "src/slurmctld/slurmctld.h"
 #include "src/slurmctld/slurmctld_plugstack.h"
 #include "src/slurmctld/sched_plugin.h"
@@ -175,11 +177,11 @@ static int	daemonize = DEFAULT_DAEMONIZE;
 static int	debug_level = 0;
 static char	*debug_logfile = NULL;
 static bool     dump_core = false;
+static uint32_t max_rpc_queue = MAX_RPC_QUEUE;
 static uint32_t max_server_threads = MAX_SERVER_THREADS;
 static int	new_nice = 0;
 static char	node_name[MAX_SLURM_NAME];
 static int	recover   = DEFAULT_RECOVER;
-static pthread_cond_t server_thread_cond = PTHREAD_COND_INITIALIZER;
 static pid_t	slurmctld_pid;
 static char    *slurm_conf_filename;
 static int      primary = 1 ;
@@ -209,7 +211,6 @@ static void         _remove_qos(slurmdb_qos_rec_t *rec);
 static void         _update_assoc(slurmdb_association_rec_t *rec);
 static void         _update_qos(slurmdb_qos_rec_t *rec);
 inline static int   _report_locks_set(void);
-static void *       _service_connection(void *arg);
 static void         _set_work_dir(void);
 static int          _shutdown_backup_controller(int wait_time);
 static void *       _slurmctld_background(void *no_data);
@@ -220,11 +221,12 @@ inline static void  _update_cred_key(void);
 static void         _update_nice(void);
 inline static void  _usage(char *prog_name);
 static bool         _valid_controller(void);
-static bool         _wait_for_server_thread(void);
 
-typedef struct connection_arg {
-	int newsockfd;
-} connection_arg_t;
+/* Accepted connection whose RPC has not yet arrived */
+typedef struct pending_conn {
+	slurm_fd_t newsockfd;
+	time_t accept_time;
+} pending_conn_t;
 
 time_t last_proc_req_start = 0;
 time_t next_stats_reset = 0;
@@ -667,6 +669,9 @@ int main(int argc, char *argv[])
 	slurm_sched_fini();	/* Stop all scheduling */
 
 	/* Purge our local data structures */
+	rpc_cache_fini();
+	sched_queue_fini();
+	depend_graph_fini();
 	job_fini();
 	part_fini();	/* part_fini() must preceed node_fini() */
 	node_fini();
@@ -883,7 +888,8 @@ static void _sig_handler(int signal)
 {
 }
 
-/* _slurmctld_rpc_mgr - Read incoming RPCs and create pthread for each */
+/* _slurmctld_rpc_mgr - Accept incoming connections and queue each for the
+ *	RPC worker threads once its RPC can be read without blocking */
 static void *_slurmctld_rpc_mgr(void *no_data)
 {
 	slurm_fd_t newsockfd;
@@ -891,12 +897,12 @@ static void *_slurmctld_rpc_mgr(void *no_data)
 	slurm_addr_t cli_addr, srv_addr;
 	uint16_t port;
 	char ip[32];
-	pthread_t thread_id_rpc_req;
-	pthread_attr_t thread_attr_rpc_req;
-	int no_thread;
-	int fd_next = 0, i, nports;
-	fd_set rfds;
-	connection_arg_t *conn_arg = NULL;
+	int i, j, k, nports, nfds, pending_cnt = 0;
+	struct pollfd *pfds;
+	pending_conn_t *pending;
+	bool accept_ok;
+	time_t now, last_print_time = 0;
+	uint16_t msg_timeout;
 	/* Locks: Read config */
 	slurmctld_lock_t config_read_lock = {
 		READ_LOCK, NO_LOCK, NO_LOCK, NO_LOCK };
@@ -907,12 +913,6 @@ static void *_slurmctld_rpc_mgr(void *no_data)
 	(void) pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, NULL);
 	debug3("_slurmctld_rpc_mgr pid = %u", getpid());
 
-	/* threads to process individual RPC's are detached */
-	slurm_attr_init(&thread_attr_rpc_req);
-	if (pthread_attr_setdetachstate
-	    (&thread_attr_rpc_req, PTHREAD_CREATE_DETACHED))
-		fatal("pthread_attr_setdetachstate %m");
-
 	/* set node_addr to bind to (NULL means any) */
 	if (slurmctld_conf.backup_controller && slurmctld_conf.backup_addr &&
 	    (strcmp(node_name, slurmctld_conf.backup_controller) == 0) &&
@@ -947,9 +947,10 @@ static void *_slurmctld_rpc_mgr(void *no_data)
 		slurm_get_ip_str(&srv_addr, &port, ip, sizeof(ip));
 		debug2("slurmctld listening on %s:%d", ip, ntohs(port));
 	}
+	msg_timeout = slurmctld_conf.msg_timeout;
 	unlock_slurmctld(config_read_lock);
 
-	/* Prepare to catch SIGUSR1 to interrupt accept().
+	/* Prepare to catch SIGUSR1 to interrupt poll().
 	 * This signal is generated by the slurmctld signal
 	 * handler thread upon receipt of SIGABRT, SIGINT,
 	 * or SIGTERM. That thread does all processing of
@@ -957,160 +958,116 @@ static void *_slurmctld_rpc_mgr(void *no_data)
 	xsignal(SIGUSR1, _sig_handler);
 	xsignal_unblock(sigarray);
 
+	rpc_queue_init(max_server_threads);
+	pfds = xmalloc(sizeof(struct pollfd) * (nports + max_rpc_queue));
+	pending = xmalloc(sizeof(pending_conn_t) * max_rpc_queue);
+
 	/*
 	 * Process incoming RPCs until told to shutdown
 	 */
-	while (_wait_for_server_thread()) {
-		int max_fd = -1;
-		FD_ZERO(&rfds);
-		for (i=0; i<nports; i++) {
-			FD_SET(sockfd[i], &rfds);
-			max_fd = MAX(sockfd[i], max_fd);
+	while (slurmctld_config.shutdown_time == 0) {
+		/* Stop accepting while the queue is full, new connections
+		 * then wait in the listen queue. This is just a delay and
+		 * not an error. It can happen when the epilog completes on
+		 * a bunch of nodes at the same time, which can easily
+		 * happen for highly parallel jobs. */
+		accept_ok = ((rpc_queue_depth() + pending_cnt) <
+			     max_rpc_queue);
+		if (!accept_ok) {
+			now = time(NULL);
+			if (difftime(now, last_print_time) > 2) {
+				verbose("RPC queue over limit (%u), waiting",
+					max_rpc_queue);
+				last_print_time = now;
+			}
+		}
+
+		nfds = 0;
+		if (accept_ok) {
+			for (i = 0; i < nports; i++) {
+				pfds[nfds].fd = sockfd[i];
+				pfds[nfds].events = POLLIN;
+				nfds++;
+			}
+		}
+		for (i = 0; i < pending_cnt; i++) {
+			pfds[nfds].fd = pending[i].newsockfd;
+			pfds[nfds].events = POLLIN;
+			nfds++;
 		}
-		if (select(max_fd+1, &rfds, NULL, NULL, NULL) == -1) {
+		if (poll(pfds, nfds, accept_ok ? 1000 : 10) == -1) {
 			if (errno != EINTR)
-				error("slurm_accept_msg_conn select: %m");
-			_free_server_thread();
+				error("_slurmctld_rpc_mgr poll: %m");
 			continue;
 		}
-		/* find one to process */
-		for (i=0; i<nports; i++) {
-			if (FD_ISSET(sockfd[(fd_next+i) % nports], &rfds)) {
-				i = (fd_next + i) % nports;
-				break;
+		now = time(NULL);
+
+		/* Queue connections whose RPC has arrived and close those
+		 * which sent nothing within MessageTimeout */
+		j = accept_ok ? nports : 0;
+		for (i = 0, k = 0; i < pending_cnt; i++) {
+			if (pfds[j + i].revents) {
+				rpc_queue_add_conn(pending[i].newsockfd);
+				continue;
+			}
+			if (difftime(now, pending[i].accept_time) >
+			    msg_timeout) {
+				debug("closing idle RPC connection");
+				(void) slurm_close_accepted_conn(
+					pending[i].newsockfd);
+				continue;
 			}
+			if (i != k)
+				pending[k] = pending[i];
+			k++;
 		}
-		fd_next = (i + 1) % nports;
-
-		/*
-		 * accept needed for stream implementation is a no-op in
-		 * message implementation that just passes sockfd to newsockfd
-		 */
-		if ((newsockfd = slurm_accept_msg_conn(sockfd[i],
-						       &cli_addr)) ==
-		    SLURM_SOCKET_ERROR) {
-			if (errno != EINTR)
-				error("slurm_accept_msg_conn: %m");
-			_free_server_thread();
+		pending_cnt = k;
+		if (!accept_ok)
 			continue;
-		}
-		fd_set_close_on_exec(newsockfd);
-		conn_arg = xmalloc(sizeof(connection_arg_t));
-		conn_arg->newsockfd = newsockfd;
-		if (slurmctld_config.shutdown_time)
-			no_thread = 1;
-		else if (pthread_create(&thread_id_rpc_req,
-					&thread_attr_rpc_req,
-					_service_connection,
-					(void *) conn_arg)) {
-			error("pthread_create: %m");
-			no_thread = 1;
-		} else
-			no_thread = 0;
 
-		if (no_thread) {
-			slurmctld_diag_stats.proc_req_raw++;
-		       	_service_connection((void *) conn_arg);
-	       	}
+		/* Accept at most one connection per port per pass so
+		 * that no port is starved, stopping at the queue limit
+		 * since pending[] has only max_rpc_queue entries */
+		for (i = 0; i < nports; i++) {
+			if ((pfds[i].revents & POLLIN) == 0)
+				continue;
+			if ((rpc_queue_depth() + pending_cnt) >= max_rpc_queue)
+				break;
+			/*
+			 * accept needed for stream implementation is a no-op
+			 * in message implementation that just passes sockfd
+			 * to newsockfd
+			 */
+			if ((newsockfd = slurm_accept_msg_conn(sockfd[i],
+							       &cli_addr)) ==
+			    SLURM_SOCKET_ERROR) {
+				if (errno != EINTR)
+					error("slurm_accept_msg_conn: %m");
+				continue;
+			}
+			fd_set_close_on_exec(newsockfd);
+			pending[pending_cnt].newsockfd = newsockfd;
+			pending[pending_cnt].accept_time = now;
+			pending_cnt++;
+		}
 	}
 
 	debug3("_slurmctld_rpc_mgr shutting down");
-	slurm_attr_destroy(&thread_attr_rpc_req);
+	for (i = 0; i < pending_cnt; i++)
+		(void) slurm_close_accepted_conn(pending[i].newsockfd);
+	xfree(pending);
+	xfree(pfds);
 	for (i=0; i<nports; i++)
 		(void) slurm_shutdown_msg_engine(sockfd[i]);
 	xfree(sockfd);
+	/* Release this thread's count first, REQUEST_CONTROL waits for
+	 * the count to drop before the worker processing it can exit */
 	_free_server_thread();
+	rpc_queue_fini();
 	pthread_exit((void *) 0);
 	return NULL;
 }
 
-/*
- * _service_connection - service the RPC
- * IN/OUT arg - really just the connection's file descriptor, freed
- *	upon completion
- * RET - NULL
- */
-static void *_service_connection(void *arg)
-{
-	connection_arg_t *conn = (connection_arg_t *) arg;
-	void *return_code = NULL;
-	slurm_msg_t *msg = xmalloc(sizeof(slurm_msg_t));
-
-	slurm_msg_t_init(msg);
-	/*
-	 * slurm_receive_msg sets msg connection fd to accepted fd. This allows
-	 * possibility for slurmctld_req() to close accepted connection.
-	 */
-	if (slurm_receive_msg(conn->newsockfd, msg, 0) != 0) {
-		error("slurm_receive_msg: %m");
-		/* close the new socket */
-		slurm_close_accepted_conn(conn->newsockfd);
-		goto cleanup;
-	}
-
-	if (errno != SLURM_SUCCESS) {
-		if (errno == SLURM_PROTOCOL_VERSION_ERROR) {
-			slurm_send_rc_msg(msg, SLURM_PROTOCOL_VERSION_ERROR);
-		} else
-			info("_service_connection/slurm_receive_msg %m");
-	} else {
-		/* process the request */
-		slurmctld_req(msg);
-	}
-	if ((conn->newsockfd >= 0)
-	    && slurm_close_accepted_conn(conn->newsockfd) < 0)
-		error ("close(%d): %m",  conn->newsockfd);
-
-cleanup:
-	slurm_free_msg(msg);
-	xfree(arg);
-	_free_server_thread();
-	return return_code;
-}
-
-/* Increment slurmctld_config.server_thread_count and don't return
- * until its value is no larger than MAX_SERVER_THREADS,
- * RET true unless shutdown in progress */
-static bool _wait_for_server_thread(void)
-{
-	bool print_it = true;
-	bool rc = true;
-
-	slurm_mutex_lock(&slurmctld_config.thread_count_lock);
-	while (1) {
-		if (slurmctld_config.shutdown_time) {
-			rc = false;
-			break;
-		}
-		if (slurmctld_config.server_thread_count < max_server_threads) {
-			slurmctld_config.server_thread_count++;
-			break;
-		} else {
-			/* wait for state change and retry,
-			 * just a delay and not an error.
-			 * This can happen when the epilog completes
-			 * on a bunch of nodes at the same time, which
-			 * can easily happen for highly parallel jobs. */
-			if (print_it) {
-				static time_t last_print_time = 0;
-				time_t now = time(NULL);
-				if (difftime(now, last_print_time) > 2) {
-					verbose("server_thread_count over "
-						"limit (%d), waiting",
-						slurmctld_config.
-						server_thread_count);
-					last_print_time = now;
-				}
-				print_it = false;
-			}
-			pthread_cond_wait(&server_thread_cond,
-					  &slurmctld_config.thread_count_lock);
-		}
-	}
-	slurm_mutex_unlock(&slurmctld_config.thread_count_lock);
-	return rc;
-}
-
 static void _free_server_thread(void)
 {
 	slurm_mutex_lock(&slurmctld_config.thread_count_lock);
@@ -1118,7 +1075,6 @@ static void _free_server_thread(void)
 		slurmctld_config.server_thread_count--;
 	else
 		error("slurmctld_config.server_thread_count underflow");
-	pthread_cond_broadcast(&server_thread_cond);
 	slurm_mutex_unlock(&slurmctld_config.thread_count_lock);
 }
 
@@ -2284,10 +2240,19 @@ static void _test_thread_limit(void)
 	if (getrlimit(RLIMIT_NOFILE, rlim) < 0)
 		error("Unable to get file count limit");
 	else if ((rlim->rlim_cur != RLIM_INFINITY) &&
-		 (max_server_threads > rlim->rlim_cur)) {
-		max_server_threads = rlim->rlim_cur;
-		info("Reducing max_server_thread to %u due to file count limit "
-		     "of %u", max_server_threads, max_server_threads);
+		 ((max_server_threads + max_rpc_queue) > rlim->rlim_cur)) {
+		/* Each worker thread and each queued connection holds
+		 * one file descriptor */
+		if (max_server_threads > (rlim->rlim_cur / 2)) {
+			max_server_threads = MAX(rlim->rlim_cur / 2, 2);
+			info("Reducing max_server_thread to %u due to file "
+			     "count limit of %u", max_server_threads,
+			     (uint32_t) rlim->rlim_cur);
+		}
+		max_rpc_queue = MAX((uint32_t) rlim->rlim_cur -
+				    max_server_threads, 1);
+		info("Reducing max_rpc_queue to %u due to file count limit "
+		     "of %u", max_rpc_queue, (uint32_t) rlim->rlim_cur);
 	}
 }
 #endif
@@ -1,7 +1,7 @@
 /*****************************************************************************\
  *  job_mgr.c - manage the job information of slurm
  *	Note: there is a global job list (job_list), time stamp
- *	(last_job_update), and hash table (job_hash)
+ *	(last_job_update), and hash tables (job_hash and secondary indexes)
  *****************************************************************************
  *  Copyright (C) 2002-2007 The Regents of the University of California.
  *  Copyright (C) 2008-2010 Lawrence Livermore National Security.
@@ -102,7 +102,17 @@
 #define STEP_FLAG 0xbbbb
 #define TOP_PRIORITY 0xffff0000	/* large, but leave headroom for higher */
 
-#define JOB_HASH_INX(_job_id)	(_job_id % hash_table_size)
+/* Smallest job hash table. Tables are grown to twice their size when half
+ * full, so the initial size only matters for avoiding early rehashes. */
+#define JOB_HASH_MIN_SIZE	1024
+
+/* Number of purged job IDs remembered for pack_jobs_delta(). Clients whose
+ * table predates the oldest remembered purge receive the full table. */
+#define JOB_PURGE_HIST_SIZE	4096
+
+/* Number of jobs processed by long job table traversals between checks for
+ * threads waiting on a write lock, see yield_slurmctld() */
+#define JOB_YIELD_CNT		128
 
 /* Change JOB_STATE_VERSION value when changing the state save format */
 #define JOB_STATE_VERSION       "VER015"
@@ -110,6 +120,16 @@
 #define JOB_2_6_STATE_VERSION   "VER014"	/* SLURM version 2.6 */
 #define JOB_2_5_STATE_VERSION   "VER013"	/* SLURM version 2.5 */
 
+/* Job state journal, appended to job_state between checkpoints. Change
+ * JOB_JOURNAL_VERSION value when changing the journal format. */
+#define JOB_JOURNAL_VERSION	"JNL002"
+#define JOB_JOURNAL_MIN_SIZE	(1024 * 1024)	/* compaction threshold */
+#define JOB_JOURNAL_MAX_AGE	600	/* seconds between checkpoints, which
+					 * save job changes not noted by
+					 * job_record_changed() */
+#define JOB_JOURNAL_SAVE	1	/* record holds job's saved state */
+#define JOB_JOURNAL_PURGE	2	/* record holds purged job's ID */
+
 #define JOB_CKPT_VERSION      "JOB_CKPT_002"
 #define JOB_2_2_CKPT_VERSION  "JOB_CKPT_002"	/* SLURM version 2.2 */
 #define JOB_2_1_CKPT_VERSION  "JOB_CKPT_001"	/* SLURM version 2.1 */
@@ -121,16 +141,83 @@ time_t last_job_update;		/* time of last update to job records */
 /* Local variables */
 static uint32_t highest_prio = 0;
 static uint32_t lowest_prio  = TOP_PRIORITY;
-static int      hash_table_size = 0;
 static int      job_count = 0;		/* job's in the system */
 static uint32_t job_id_sequence = 0;	/* first job_id to assign new job */
-static struct   job_record **job_hash = NULL;
 static bool     wiki_sched = false;
 static bool     wiki2_sched = false;
 static bool     wiki_sched_test = false;
 
+/* Job hash tables use open addressing with linear probing. Keys are stored
+ * in the table so a probe sequence does not touch the job records. */
+typedef struct {
+	uint64_t key;
+	struct job_record *job_ptr;	/* NULL if slot is empty */
+} job_hash_slot_t;
+
+typedef struct {
+	job_hash_slot_t *slot;
+	uint32_t size;			/* slot count, a power of two */
+	uint32_t count;			/* slots in use */
+} job_hash_t;
+
+static job_hash_t job_hash;		/* job_id to job record */
+static job_hash_t job_array_hash;	/* array_job_id/array_task_id to job */
+static job_hash_t job_array_first;	/* array_job_id to array's first job */
+static job_hash_t job_user_hash;	/* user_id to user's first job */
+
+/* Job table generation tracking used by pack_jobs_delta() */
+typedef struct {
+	uint32_t job_id;
+	uint32_t gen;		/* generation in which job was purged */
+} job_purge_rec_t;
+static pthread_mutex_t job_gen_mutex = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t job_gen = 0;		/* current job table generation */
+static time_t   job_gen_epoch = 0;	/* identifies this generation series */
+static uint64_t job_gen_seq = 0;	/* job_change_seq at last scan */
+static bool     job_gen_purged = false;	/* purge since last scan */
+static job_purge_rec_t job_purge_hist[JOB_PURGE_HIST_SIZE];
+static uint32_t job_purge_inx = 0;	/* next job_purge_hist record */
+static uint32_t job_purge_lost_gen = 0;	/* newest overwritten purge gen */
+
+/* Job state file contents, see prefetch_job_state() */
+typedef struct {
+	int error_code;		/* ENOENT if there is no job state file */
+	char *state_data;	/* job_state or job_state.old contents */
+	uint32_t state_size;
+	char *journal_data;	/* job_state.journal contents or NULL */
+	uint32_t journal_size;
+} job_state_files_t;
+static job_state_files_t job_prefetch;
+static pthread_t job_prefetch_tid;
+static bool      job_prefetch_started = false;
+
+/* Job state journal tracking used by dump_all_job_state() */
+typedef struct {
+	uint32_t job_id;
+	uint32_t offset;	/* offset of job state in journal, 0 if purged */
+	uint32_t order;		/* position in journal */
+	struct job_record *job_ptr;	/* checkpointed record being replaced */
+} job_journal_rec_t;
+static pthread_mutex_t job_save_mutex = PTHREAD_MUTEX_INITIALIZER;
+static bool     job_ckpt_needed = true;	/* next save must be a checkpoint */
+static time_t   job_ckpt_time = 0;	/* header time of last checkpoint */
+static uint32_t job_ckpt_size = 0;	/* bytes in last checkpoint */
+static uint32_t job_journal_size = 0;	/* bytes journaled since checkpoint */
+static uint32_t job_journal_seq = 0;	/* job_id_sequence last saved */
+static uint64_t job_save_seq = 0;	/* job_change_seq last saved */
+static uint32_t *job_save_purged = NULL;   /* IDs of saved jobs purged since
+					    * the last save */
+static uint32_t job_save_purged_cnt = 0;
+static uint32_t job_save_purged_size = 0;
+
+/* Count of job record changes, see job_record_changed() */
+static uint64_t job_change_seq = 0;
+
 /* Local functions */
+static void _add_job_array_hash(struct job_record *job_ptr);
 static void _add_job_hash(struct job_record *job_ptr);
+static void _add_job_user_hash(struct job_record *job_ptr);
+static void _attach_job_record(struct job_record *job_ptr);
 static int  _checkpoint_job_record (struct job_record *job_ptr,
 				    char *image_dir);
 static int  _copy_job_desc_files(uint32_t job_id_src, uint32_t job_id_dest);
@@ -144,15 +231,30 @@ static job_desc_msg_t * _copy_job_record_to_job_desc(
 				struct job_record *job_ptr);
 static char *_copy_nodelist_no_dup(char *node_list);
 static void _del_batch_list_rec(void *x);
+static void _del_job_array_hash(struct job_record *job_ptr);
+static void _del_job_user_hash(struct job_record *job_ptr);
 static void _delete_job_desc_files(uint32_t job_id);
+static void _detach_job_record(struct job_record *job_ptr);
 static slurmdb_qos_rec_t *_determine_and_validate_qos(
 	char *resv_name, slurmdb_association_rec_t *assoc_ptr,
 	bool admin, slurmdb_qos_rec_t *qos_rec,	int *error_code);
+static int  _dump_job_checkpoint(time_t now);
 static void _dump_job_details(struct job_details *detail_ptr,
 			      Buf buffer);
+static int  _dump_job_journal(time_t now);
 static void _dump_job_state(struct job_record *dump_job_ptr, Buf buffer);
 static int  _find_batch_dir(void *x, void *key);
+static int  _find_job_journal_rec(const void *x, const void *y);
+static void _free_job_details(struct job_record *job_entry);
+static void _free_job_record(struct job_record *job_ptr);
 static void _get_batch_job_dir_ids(List batch_dirs);
+static void _get_job_state_files(job_state_files_t *files);
+static struct job_record *_job_list_next(ListIterator job_iterator,
+					 uint32_t *job_cnt,
+					 slurmctld_lock_t lock_levels,
+					 bool part_filter, uid_t uid);
+static time_t _job_pack_start(struct job_record *job_ptr, time_t now);
+static bool _job_ready_for_purge(struct job_record *job_ptr, time_t min_age);
 static void _job_timed_out(struct job_record *job_ptr);
 static int  _job_create(job_desc_msg_t * job_specs, int allocate, int will_run,
 			struct job_record **job_rec_ptr, uid_t submit_uid,
@@ -162,12 +264,18 @@ static int  _list_find_job_id(void *job_entry, void *key);
 static int  _list_find_job_old(void *job_entry, void *key);
 static int  _load_job_details(struct job_record *job_ptr, Buf buffer,
 			      uint16_t protocol_version);
+static int  _load_job_journal(char *data, uint32_t data_size,
+			      time_t ckpt_time, bool replay);
+static int  _load_job_journal_batch(Buf buffer, uint32_t batch_end,
+				    job_journal_rec_t **rec_pptr,
+				    uint32_t *rec_cnt, uint32_t *rec_size);
 static int  _load_job_state(Buf buffer,	uint16_t protocol_version);
 static uint32_t _max_switch_wait(uint32_t input_wait);
 static void _notify_srun_missing_step(struct job_record *job_ptr, int node_inx,
 				      time_t now, time_t node_boot_time);
 static int  _open_job_state_file(char **state_file);
 static void _pack_job_for_ckpt (struct job_record *job_ptr, Buf buffer);
+static void *_prefetch_job_state(void *no_data);
 static void _pack_default_job_details(struct job_record *job_ptr,
 				      Buf buffer,
 				      uint16_t protocol_version);
@@ -181,7 +289,10 @@ static void _read_data_array_from_file(char *file_name, char ***data,
  				       struct job_record *job_ptr);
 static void _read_data_from_file(char *file_name, char **data);
 static char *_read_job_ckpt_file(char *ckpt_file, int *size_ptr);
+static char *_read_job_journal(uint32_t *data_size);
+static void _read_job_state_files(job_state_files_t *files);
 static void _remove_defunct_batch_dirs(List batch_dirs);
+static int  _reset_job_journal(time_t ckpt_time);
 static int  _reset_detail_bitmaps(struct job_record *job_ptr);
 static void _reset_step_bitmaps(struct job_record *job_ptr);
 static int  _resume_job_nodes(struct job_record *job_ptr, bool indf_susp);
@@ -189,6 +300,7 @@ static void _send_job_kill(struct job_record *job_ptr);
 static int  _set_job_id(struct job_record *job_ptr);
 static void _signal_batch_job(struct job_record *job_ptr, uint16_t signal);
 static void _signal_job(struct job_record *job_ptr, int signal);
+static int  _sort_job_journal_rec(const void *x, const void *y);
 static void _suspend_job(struct job_record *job_ptr, uint16_t op,
 			 bool indf_susp);
 static int  _suspend_job_nodes(struct job_record *job_ptr, bool indf_susp);
@@ -205,6 +317,7 @@ static int  _validate_job_desc(job_desc_msg_t * job_desc_msg, int allocate,
                                uid_t submit_uid, struct part_record *part_ptr,
                                List part_list);
 static void _validate_job_files(List batch_dirs);
+static int  _write_job_state_buf(int fd, Buf buffer, char *file_name);
 static int  _write_data_to_file(char *file_name, char *data);
 static int  _write_data_array_to_file(char *file_name, char **data,
 				      uint32_t size);
@@ -253,10 +366,23 @@ struct job_record *create_job_record(int *error_code)
 	job_ptr->requid = -1; /* force to -1 for sacct to know this
 			       * hasn't been set yet  */
 	(void) list_append(job_list, job_ptr);
+	job_record_changed(job_ptr);
 
 	return job_ptr;
 }
 
+/*
+ * job_record_changed - note that a job record changed, so that the job is
+ *	included in the next journaled dump_all_job_state(). Callers still
+ *	set last_job_update.
+ * IN job_ptr - pointer to the changed job
+ * NOTE: run lock_slurmctld before entry: write job
+ */
+extern void job_record_changed(struct job_record *job_ptr)
+{
+	job_ptr->change_seq = ++job_change_seq;
+}
+
 
 /*
  * delete_job_details - delete a job's detail record and clear it's pointer
@@ -266,14 +392,23 @@ struct job_record *create_job_record(int *error_code)
  */
 void delete_job_details(struct job_record *job_entry)
 {
-	int i;
-
 	if (job_entry->details == NULL)
 		return;
 
 	xassert (job_entry->details->magic == DETAILS_MAGIC);
 	if (IS_JOB_FINISHED(job_entry))
 		_delete_job_desc_files(job_entry->job_id);
+	_free_job_details(job_entry);
+}
+
+/* _free_job_details - free a job's detail record and clear its pointer,
+ *	leaving the job descriptor files in place, see delete_job_details() */
+static void _free_job_details(struct job_record *job_entry)
+{
+	int i;
+
+	if (job_entry->details == NULL)
+		return;
 
 	xfree(job_entry->details->acctg_freq);
 	for (i=0; i<job_entry->details->argc; i++)
@@ -430,10 +565,39 @@ static slurmdb_qos_rec_t *_determine_and_validate_qos(
 
 /*
  * dump_all_job_state - save the state of all jobs to file for checkpoint
+ *	Jobs changed since the last save are appended to the
+ *	job_state.journal file. Once the journal grows larger than the
+ *	job_state file or JOB_JOURNAL_MAX_AGE passes, all jobs are written
+ *	to job_state and the journal is restarted.
  *	Changes here should be reflected in load_last_job_id() and
  *	load_all_job_state().
  * RET 0 or error code */
 int dump_all_job_state(void)
+{
+	int error_code;
+	time_t now = time(NULL);
+	DEF_TIMERS;
+
+	START_TIMER;
+	slurm_mutex_lock(&job_save_mutex);
+	if (job_ckpt_needed ||
+	    (job_journal_size >= MAX(job_ckpt_size, JOB_JOURNAL_MIN_SIZE)) ||
+	    (difftime(now, job_ckpt_time) >= JOB_JOURNAL_MAX_AGE))
+		error_code = _dump_job_checkpoint(now);
+	else
+		error_code = _dump_job_journal(now);
+	/* A failed write may have left the journal out of step with the
+	 * saved state of each job, start over from a checkpoint */
+	if (error_code)
+		job_ckpt_needed = true;
+	slurm_mutex_unlock(&job_save_mutex);
+	END_TIMER2("dump_all_job_state");
+	return error_code;
+}
+
+/* Write the state of all jobs to the job_state file and restart the job
+ * state journal. Call with job_save_mutex held. */
+static int _dump_job_checkpoint(time_t now)
 {
 	/* Save high-water mark to avoid buffer growth with copies */
 	static int high_buffer_size = (1024 * 1024);
@@ -446,37 +610,49 @@ int dump_all_job_state(void)
 	ListIterator job_iterator;
 	struct job_record *job_ptr;
 	Buf buffer = init_buf(high_buffer_size);
-	time_t min_age = 0, now = time(NULL);
-	DEF_TIMERS;
+	time_t min_age = 0, ckpt_time;
+	uint32_t job_cnt = 0, save_job_id;
+	uint64_t save_seq;
+
+	/* The journal is tied to its checkpoint by the header time, which
+	 * must differ from that of any earlier checkpoint */
+	ckpt_time = MAX(now, job_ckpt_time + 1);
 
-	START_TIMER;
 	/* write header: version, time */
 	packstr(JOB_STATE_VERSION, buffer);
-	pack_time(now, buffer);
+	pack_time(ckpt_time, buffer);
 
 	if (slurmctld_conf.min_job_age > 0)
 		min_age = now  - slurmctld_conf.min_job_age;
 
+	/* write individual job records */
+	lock_slurmctld(job_read_lock);
+
 	/*
 	 * write header: job id
 	 * This is needed so that the job id remains persistent even after
 	 * slurmctld is restarted.
 	 */
-	pack32( job_id_sequence, buffer);
+	save_job_id = job_id_sequence;
+	pack32(save_job_id, buffer);
+	save_seq = job_change_seq;
 
 	debug3("Writing job id %u to header record of job_state file",
-	       job_id_sequence);
+	       save_job_id);
 
-	/* write individual job records */
-	lock_slurmctld(job_read_lock);
+	/* Jobs purged while the locks are yielded below are journaled */
+	job_save_purged_cnt = 0;
 	job_iterator = list_iterator_create(job_list);
-	while ((job_ptr = (struct job_record *) list_next(job_iterator))) {
+	while ((job_ptr = _job_list_next(job_iterator, &job_cnt,
+					 job_read_lock, false, 0))) {
 		xassert (job_ptr->magic == JOB_MAGIC);
-		if ((min_age > 0) && (job_ptr->end_time < min_age) &&
-		    (! IS_JOB_COMPLETING(job_ptr)) && IS_JOB_FINISHED(job_ptr))
+		if (_job_ready_for_purge(job_ptr, min_age)) {
+			job_ptr->state_saved = false;
 			continue;	/* job ready for purging, don't dump */
+		}
 
 		_dump_job_state(job_ptr, buffer);
+		job_ptr->state_saved = true;
 	}
 	list_iterator_destroy(job_iterator);
 
@@ -511,27 +687,10 @@ int dump_all_job_state(void)
 		      new_file);
 		error_code = errno;
 	} else {
-		int pos = 0, nwrite, amount, rc;
-		char *data;
-
 		fd_set_close_on_exec(log_fd);
-		nwrite = get_buf_offset(buffer);
-		data = (char *)get_buf_data(buffer);
-		high_buffer_size = MAX(nwrite, high_buffer_size);
-		while (nwrite > 0) {
-			amount = write(log_fd, &data[pos], nwrite);
-			if ((amount < 0) && (errno != EINTR)) {
-				error("Error writing file %s, %m", new_file);
-				error_code = errno;
-				break;
-			}
-			nwrite -= amount;
-			pos    += amount;
-		}
-
-		rc = fsync_and_close(log_fd, "job");
-		if (rc && !error_code)
-			error_code = rc;
+		high_buffer_size = MAX(get_buf_offset(buffer),
+				       high_buffer_size);
+		error_code = _write_job_state_buf(log_fd, buffer, new_file);
 	}
 	if (error_code)
 		(void) unlink(new_file);
@@ -545,6 +704,19 @@ int dump_all_job_state(void)
 			debug4("unable to create link for %s -> %s: %m",
 			       new_file, reg_file);
 		(void) unlink(new_file);
+
+		/* A journal left from the prior checkpoint is ignored when
+		 * the state is loaded, so the checkpoint is complete even if
+		 * the journal can not be restarted */
+		job_ckpt_time = ckpt_time;
+		job_ckpt_size = get_buf_offset(buffer);
+		job_journal_seq = save_job_id;
+		job_save_seq = save_seq;
+		error_code = _reset_job_journal(ckpt_time);
+		if (!error_code) {
+			job_journal_size = 0;
+			job_ckpt_needed = false;
+		}
 	}
 	xfree(old_file);
 	xfree(reg_file);
@@ -552,7 +724,196 @@ int dump_all_job_state(void)
 	unlock_state_files();
 
 	free_buf(buffer);
-	END_TIMER2("dump_all_job_state");
+	return error_code;
+}
+
+/* Append the state of jobs changed since the last save and the IDs of jobs
+ * purged since the last save to the job state journal. Changed jobs are
+ * those noted by job_record_changed() and those not yet saved, only they
+ * are packed. Call with job_save_mutex held. */
+static int _dump_job_journal(time_t now)
+{
+	/* Save high-water mark to avoid buffer growth with copies */
+	static int high_buffer_size = BUF_SIZE;
+	int error_code = 0, log_fd;
+	char *journal_file;
+	/* Locks: Read config and job */
+	slurmctld_lock_t job_read_lock =
+		{ READ_LOCK, READ_LOCK, NO_LOCK, NO_LOCK };
+	ListIterator job_iterator;
+	struct job_record *job_ptr;
+	Buf buffer = init_buf(high_buffer_size);
+	time_t min_age = 0;
+	uint32_t cnt_offset, end_offset, rec_cnt = 0, save_job_id, i;
+	uint32_t job_cnt = 0, size_offset, state_offset;
+	uint64_t save_seq;
+
+	if (slurmctld_conf.min_job_age > 0)
+		min_age = now  - slurmctld_conf.min_job_age;
+
+	/* write record header: size, time, job id, record count */
+	pack32((uint32_t) 0, buffer);
+	pack_time(now, buffer);
+
+	lock_slurmctld(job_read_lock);
+	save_job_id = job_id_sequence;
+	pack32(save_job_id, buffer);
+	/* Jobs changed while the locks are yielded below are saved again
+	 * by the next save */
+	save_seq = job_change_seq;
+	cnt_offset = get_buf_offset(buffer);
+	pack32(rec_cnt, buffer);
+
+	for (i = 0; i < job_save_purged_cnt; i++) {
+		pack16((uint16_t) JOB_JOURNAL_PURGE, buffer);
+		pack32(job_save_purged[i], buffer);
+		rec_cnt++;
+	}
+	job_save_purged_cnt = 0;
+
+	job_iterator = list_iterator_create(job_list);
+	while ((job_ptr = _job_list_next(job_iterator, &job_cnt,
+					 job_read_lock, false, 0))) {
+		xassert (job_ptr->magic == JOB_MAGIC);
+		if (_job_ready_for_purge(job_ptr, min_age)) {
+			if (job_ptr->state_saved) {
+				pack16((uint16_t) JOB_JOURNAL_PURGE, buffer);
+				pack32(job_ptr->job_id, buffer);
+				job_ptr->state_saved = false;
+				rec_cnt++;
+			}
+			continue;	/* job ready for purging, don't dump */
+		}
+		if (job_ptr->state_saved &&
+		    (job_ptr->change_seq <= job_save_seq))
+			continue;	/* unchanged since last save */
+
+		/* Pack the job's state in place as packmem() would */
+		pack16((uint16_t) JOB_JOURNAL_SAVE, buffer);
+		pack32(job_ptr->job_id, buffer);
+		size_offset = get_buf_offset(buffer);
+		pack32((uint32_t) 0, buffer);
+		state_offset = get_buf_offset(buffer);
+		_dump_job_state(job_ptr, buffer);
+		end_offset = get_buf_offset(buffer);
+		set_buf_offset(buffer, size_offset);
+		pack32(end_offset - state_offset, buffer);
+		set_buf_offset(buffer, end_offset);
+		job_ptr->state_saved = true;
+		rec_cnt++;
+	}
+	list_iterator_destroy(job_iterator);
+	unlock_slurmctld(job_read_lock);
+
+	if ((rec_cnt == 0) && (save_job_id == job_journal_seq)) {
+		job_save_seq = save_seq;
+		free_buf(buffer);
+		return error_code;	/* nothing changed */
+	}
+
+	end_offset = get_buf_offset(buffer);
+	set_buf_offset(buffer, 0);
+	pack32(end_offset - sizeof(uint32_t), buffer);
+	set_buf_offset(buffer, cnt_offset);
+	pack32(rec_cnt, buffer);
+	set_buf_offset(buffer, end_offset);
+	high_buffer_size = MAX(end_offset, high_buffer_size);
+
+	journal_file = xstrdup(slurmctld_conf.state_save_location);
+	xstrcat(journal_file, "/job_state.journal");
+	lock_state_files();
+	/* Without O_CREAT, a journal lost since the checkpoint is detected
+	 * rather than replaced by one lacking its header */
+	log_fd = open(journal_file, O_WRONLY | O_APPEND);
+	if (log_fd < 0) {
+		error("Can't save state, open file %s error %m",
+		      journal_file);
+		error_code = errno;
+	} else {
+		fd_set_close_on_exec(log_fd);
+		error_code = _write_job_state_buf(log_fd, buffer,
+						  journal_file);
+	}
+	if (!error_code) {
+		job_journal_size += end_offset;
+		job_journal_seq = save_job_id;
+		job_save_seq = save_seq;
+		debug3("Journaled %u job records, %u bytes", rec_cnt,
+		       end_offset);
+	}
+	unlock_state_files();
+	xfree(journal_file);
+
+	free_buf(buffer);
+	return error_code;
+}
+
+/* Start a new job state journal for the checkpoint written at ckpt_time.
+ * Call with state files locked. */
+static int _reset_job_journal(time_t ckpt_time)
+{
+	int error_code = 0, log_fd;
+	char *journal_file, *new_file;
+	Buf buffer = init_buf(BUF_SIZE);
+
+	/* write header: version, checkpoint time, protocol version */
+	packstr(JOB_JOURNAL_VERSION, buffer);
+	pack_time(ckpt_time, buffer);
+	pack16((uint16_t) SLURM_PROTOCOL_VERSION, buffer);
+
+	journal_file = xstrdup(slurmctld_conf.state_save_location);
+	xstrcat(journal_file, "/job_state.journal");
+	new_file = xstrdup(journal_file);
+	xstrcat(new_file, ".new");
+	log_fd = creat(new_file, 0600);
+	if (log_fd < 0) {
+		error("Can't save state, create file %s error %m",
+		      new_file);
+		error_code = errno;
+	} else {
+		fd_set_close_on_exec(log_fd);
+		error_code = _write_job_state_buf(log_fd, buffer, new_file);
+	}
+	if (error_code)
+		(void) unlink(new_file);
+	else if (rename(new_file, journal_file)) {
+		error("Can't save state, rename %s to %s error %m",
+		      new_file, journal_file);
+		error_code = errno;
+		(void) unlink(new_file);
+	}
+	xfree(journal_file);
+	xfree(new_file);
+
+	free_buf(buffer);
+	return error_code;
+}
+
+/* Write a buffer's contents to a state save file and close it.
+ * RET 0 or error code */
+static int _write_job_state_buf(int fd, Buf buffer, char *file_name)
+{
+	int error_code = 0, pos = 0, nwrite, amount, rc;
+	char *data;
+
+	nwrite = get_buf_offset(buffer);
+	data = (char *)get_buf_data(buffer);
+	while (nwrite > 0) {
+		amount = write(fd, &data[pos], nwrite);
+		if (amount < 0) {
+			if (errno == EINTR)
+				continue;
+			error("Error writing file %s, %m", file_name);
+			error_code = errno;
+			break;
+		}
+		nwrite -= amount;
+		pos    += amount;
+	}
+
+	rc = fsync_and_close(fd, "job");
+	if (rc && !error_code)
+		error_code = rc;
 	return error_code;
 }
 
@@ -585,6 +946,97 @@ static int _open_job_state_file(char **state_file)
 	return state_fd;
 }
 
+/* Read the job state journal, call with state files locked.
+ * OUT data_size - bytes read
+ * RET the journal contents or NULL if there is no journal */
+static char *_read_job_journal(uint32_t *data_size)
+{
+	int state_fd;
+	char *data = NULL, *journal_file;
+
+	*data_size = 0;
+	journal_file = slurm_get_state_save_location();
+	xstrcat(journal_file, "/job_state.journal");
+	state_fd = open(journal_file, O_RDONLY);
+	if (state_fd < 0)
+		debug("No job state journal (%s) to recover", journal_file);
+	else
+		data = read_state_file(state_fd, journal_file, data_size);
+	xfree(journal_file);
+
+	return data;
+}
+
+/* Read the job state file and its journal */
+static void _read_job_state_files(job_state_files_t *files)
+{
+	int state_fd;
+	char *state_file;
+
+	memset(files, 0, sizeof(job_state_files_t));
+	lock_state_files();
+	state_fd = _open_job_state_file(&state_file);
+	if (state_fd < 0) {
+		info("No job state file (%s) to recover", state_file);
+		files->error_code = ENOENT;
+	} else {
+		files->state_data = read_state_file(state_fd, state_file,
+						    &files->state_size);
+		files->journal_data = _read_job_journal(&files->journal_size);
+	}
+	xfree(state_file);
+	unlock_state_files();
+}
+
+static void *_prefetch_job_state(void *no_data)
+{
+	DEF_TIMERS;
+
+	START_TIMER;
+	_read_job_state_files(&job_prefetch);
+	END_TIMER;
+	debug("Read %u bytes of job state in %s",
+	      job_prefetch.state_size + job_prefetch.journal_size, TIME_STR);
+	return NULL;
+}
+
+/*
+ * prefetch_job_state - start reading the job state files in a separate
+ *	thread, so reading them from a possibly remote StateSaveLocation
+ *	overlaps with the rest of slurmctld's startup. The contents are used
+ *	by the next call to load_all_job_state().
+ */
+extern void prefetch_job_state(void)
+{
+	pthread_attr_t attr;
+
+	if (job_prefetch_started)
+		return;
+
+	slurm_attr_init(&attr);
+	if (pthread_create(&job_prefetch_tid, &attr, _prefetch_job_state,
+			   NULL)) {
+		error("pthread_create error %m");
+	} else
+		job_prefetch_started = true;
+	slurm_attr_destroy(&attr);
+}
+
+/* Get the job state files read by prefetch_job_state() if it was called,
+ * otherwise read them now */
+static void _get_job_state_files(job_state_files_t *files)
+{
+	if (!job_prefetch_started) {
+		_read_job_state_files(files);
+		return;
+	}
+
+	pthread_join(job_prefetch_tid, NULL);
+	job_prefetch_started = false;
+	memcpy(files, &job_prefetch, sizeof(job_state_files_t));
+	memset(&job_prefetch, 0, sizeof(job_state_files_t));
+}
+
 /*
  * load_all_job_state - load the job state from file, recover from last
  *	checkpoint. Execute this after loading the configuration file data.
@@ -593,10 +1045,9 @@ static int _open_job_state_file(char **state_file)
  */
 extern int load_all_job_state(void)
 {
-	int data_allocated, data_read = 0, error_code = SLURM_SUCCESS;
-	uint32_t data_size = 0;
-	int state_fd, job_cnt = 0;
-	char *data = NULL, *state_file;
+	int error_code = SLURM_SUCCESS;
+	int job_cnt = 0;
+	job_state_files_t files;
 	Buf buffer;
 	time_t buf_time;
 	uint32_t saved_job_id;
@@ -604,42 +1055,16 @@ extern int load_all_job_state(void)
 	uint32_t ver_str_len;
 	uint16_t protocol_version = (uint16_t)NO_VAL;
 
-	/* read the file */
-	lock_state_files();
-	state_fd = _open_job_state_file(&state_file);
-	if (state_fd < 0) {
-		info("No job state file (%s) to recover", state_file);
-		error_code = ENOENT;
-	} else {
-		data_allocated = BUF_SIZE;
-		data = xmalloc(data_allocated);
-		while (1) {
-			data_read = read(state_fd, &data[data_size],
-					 BUF_SIZE);
-			if (data_read < 0) {
-				if (errno == EINTR)
-					continue;
-				else {
-					error("Read error on %s: %m",
-					      state_file);
-					break;
-				}
-			} else if (data_read == 0)	/* eof */
-				break;
-			data_size      += data_read;
-			data_allocated += data_read;
-			xrealloc(data, data_allocated);
-		}
-		close(state_fd);
-	}
-	xfree(state_file);
-	unlock_state_files();
+	/* read the files, unless prefetch_job_state() already started */
+	_get_job_state_files(&files);
 
 	job_id_sequence = MAX(job_id_sequence, slurmctld_conf.first_job_id);
-	if (error_code)
-		return error_code;
+	if (files.error_code) {
+		xfree(files.journal_data);
+		return files.error_code;
+	}
 
-	buffer = create_buf(data, data_size);
+	buffer = create_buf(files.state_data, files.state_size);
 	safe_unpackstr_xmalloc(&ver_str, &ver_str_len, buffer);
 	debug3("Version string in job_state header is %s", ver_str);
 	if (ver_str) {
@@ -656,6 +1081,7 @@ extern int load_all_job_state(void)
 		error("Can not recover job state, incompatible version");
 		error("***********************************************");
 		xfree(ver_str);
+		xfree(files.journal_data);
 		free_buf(buffer);
 		return EFAULT;
 	}
@@ -672,15 +1098,21 @@ extern int load_all_job_state(void)
 			goto unpack_error;
 		job_cnt++;
 	}
-	debug3("Set job_id_sequence to %u", job_id_sequence);
-
 	free_buf(buffer);
 	info("Recovered information about %d jobs", job_cnt);
+
+	(void) _load_job_journal(files.journal_data, files.journal_size,
+				 buf_time, true);
+	debug3("Set job_id_sequence to %u", job_id_sequence);
+	slurm_mutex_lock(&job_save_mutex);
+	job_ckpt_time = buf_time;
+	slurm_mutex_unlock(&job_save_mutex);
 	return error_code;
 
 unpack_error:
 	error("Incomplete job data checkpoint file");
 	info("Recovered information about %d jobs", job_cnt);
+	xfree(files.journal_data);
 	free_buf(buffer);
 	return SLURM_FAILURE;
 }
@@ -692,10 +1124,10 @@ unpack_error:
  */
 extern int load_last_job_id( void )
 {
-	int data_allocated, data_read = 0, error_code = SLURM_SUCCESS;
-	uint32_t data_size = 0;
+	int error_code = SLURM_SUCCESS;
+	uint32_t data_size = 0, journal_size = 0;
 	int state_fd;
-	char *data = NULL, *state_file;
+	char *data = NULL, *journal_data = NULL, *state_file;
 	Buf buffer;
 	time_t buf_time;
 	char *ver_str = NULL;
@@ -711,26 +1143,8 @@ extern int load_last_job_id( void )
 		debug("No job state file (%s) to recover", state_file);
 		error_code = ENOENT;
 	} else {
-		data_allocated = BUF_SIZE;
-		data = xmalloc(data_allocated);
-		while (1) {
-			data_read = read(state_fd, &data[data_size],
-					 BUF_SIZE);
-			if (data_read < 0) {
-				if (errno == EINTR)
-					continue;
-				else {
-					error("Read error on %s: %m",
-					      state_file);
-					break;
-				}
-			} else if (data_read == 0)	/* eof */
-				break;
-			data_size      += data_read;
-			data_allocated += data_read;
-			xrealloc(data, data_allocated);
-		}
-		close(state_fd);
+		data = read_state_file(state_fd, state_file, &data_size);
+		journal_data = _read_job_journal(&journal_size);
 	}
 	xfree(state_file);
 	unlock_state_files();
@@ -755,6 +1169,7 @@ extern int load_last_job_id( void )
 		debug("*************************************************");
 		debug("Can not recover last job ID, incompatible version");
 		debug("*************************************************");
+		xfree(journal_data);
 		free_buf(buffer);
 		return EFAULT;
 	}
@@ -766,14 +1181,232 @@ extern int load_last_job_id( void )
 	/* Ignore the state for individual jobs stored here */
 
 	free_buf(buffer);
+	(void) _load_job_journal(journal_data, journal_size, buf_time, false);
 	return error_code;
 
 unpack_error:
 	debug("Invalid job data checkpoint file");
+	xfree(journal_data);
 	free_buf(buffer);
 	return SLURM_FAILURE;
 }
 
+/* Find a journal record by job ID */
+static int _find_job_journal_rec(const void *x, const void *y)
+{
+	const job_journal_rec_t *rec1 = (const job_journal_rec_t *) x;
+	const job_journal_rec_t *rec2 = (const job_journal_rec_t *) y;
+
+	if (rec1->job_id < rec2->job_id)
+		return -1;
+	if (rec1->job_id > rec2->job_id)
+		return 1;
+	return 0;
+}
+
+/* Sort journal records by job ID, then by position in the journal */
+static int _sort_job_journal_rec(const void *x, const void *y)
+{
+	const job_journal_rec_t *rec1 = (const job_journal_rec_t *) x;
+	const job_journal_rec_t *rec2 = (const job_journal_rec_t *) y;
+
+	if (rec1->job_id < rec2->job_id)
+		return -1;
+	if (rec1->job_id > rec2->job_id)
+		return 1;
+	if (rec1->order < rec2->order)
+		return -1;
+	if (rec1->order > rec2->order)
+		return 1;
+	return 0;
+}
+
+/*
+ * _load_job_journal - apply the job state journal written after the
+ *	job_state checkpoint which was just read.
+ *	Changes here should be reflected in _dump_job_journal().
+ * IN data - journal contents from _read_job_journal(), NULL if none,
+ *	xfreed by this function
+ * IN data_size - bytes of data
+ * IN ckpt_time - time in the header of the checkpoint
+ * IN replay - if set, replace the job records with their latest journaled
+ *	state, otherwise only recover job_id_sequence
+ * RET count of job records loaded from the journal
+ */
+static int _load_job_journal(char *data, uint32_t data_size,
+			     time_t ckpt_time, bool replay)
+{
+	int job_cnt = 0;
+	Buf buffer;
+	time_t journal_time;
+	char *ver_str = NULL;
+	uint32_t ver_str_len, batch_size, batch_end;
+	uint32_t i, j, rec_cnt = 0, rec_size = 0;
+	uint16_t protocol_version;
+	job_journal_rec_t *recs = NULL, *rec_ptr, key;
+	ListIterator job_iterator;
+	struct job_record *job_ptr, *old_job_ptr;
+
+	if (!data)
+		return job_cnt;
+
+	buffer = create_buf(data, data_size);
+	safe_unpackstr_xmalloc(&ver_str, &ver_str_len, buffer);
+	if (!ver_str || strcmp(ver_str, JOB_JOURNAL_VERSION)) {
+		error("Ignoring job state journal, incompatible version");
+		goto fini;
+	}
+	safe_unpack_time(&journal_time, buffer);
+	if (journal_time != ckpt_time) {
+		/* Written for a different checkpoint, which happens if
+		 * slurmctld stopped while the journal was being restarted */
+		info("Ignoring job state journal from an earlier checkpoint");
+		goto fini;
+	}
+	safe_unpack16(&protocol_version, buffer);
+	if ((protocol_version < SLURM_2_5_PROTOCOL_VERSION) ||
+	    (protocol_version > SLURM_PROTOCOL_VERSION)) {
+		error("Ignoring job state journal, incompatible protocol "
+		      "version %u", protocol_version);
+		goto fini;
+	}
+
+	while (remaining_buf(buffer) >= sizeof(uint32_t)) {
+		safe_unpack32(&batch_size, buffer);
+		if (batch_size > remaining_buf(buffer)) {
+			error("Incomplete job state journal record discarded");
+			break;
+		}
+		batch_end = get_buf_offset(buffer) + batch_size;
+		if (_load_job_journal_batch(buffer, batch_end, &recs,
+					    &rec_cnt, &rec_size)) {
+			error("Invalid job state journal record discarded");
+			break;
+		}
+	}
+	if (!replay || (rec_cnt == 0))
+		goto fini;
+
+	/* Only the last record of each job is needed */
+	qsort(recs, rec_cnt, sizeof(job_journal_rec_t), _sort_job_journal_rec);
+	for (i = 0, j = 0; i < rec_cnt; i++) {
+		if ((i + 1 < rec_cnt) && (recs[i].job_id == recs[i+1].job_id))
+			continue;
+		recs[j++] = recs[i];
+	}
+	rec_cnt = j;
+
+	/* Set checkpointed records superseded by the journal aside, they are
+	 * kept if their journal record can not be loaded */
+	job_iterator = list_iterator_create(job_list);
+	while ((job_ptr = (struct job_record *) list_next(job_iterator))) {
+		key.job_id = job_ptr->job_id;
+		rec_ptr = bsearch(&key, recs, rec_cnt,
+				  sizeof(job_journal_rec_t),
+				  _find_job_journal_rec);
+		if (!rec_ptr)
+			continue;
+		(void) list_remove(job_iterator);
+		_detach_job_record(job_ptr);
+		rec_ptr->job_ptr = job_ptr;
+	}
+	list_iterator_destroy(job_iterator);
+
+	for (i = 0, rec_ptr = recs; i < rec_cnt; i++, rec_ptr++) {
+		old_job_ptr = rec_ptr->job_ptr;
+		if (rec_ptr->offset == 0) {	/* job purged */
+			if (old_job_ptr) {
+				delete_job_details(old_job_ptr);
+				_free_job_record(old_job_ptr);
+			}
+			continue;
+		}
+		set_buf_offset(buffer, rec_ptr->offset);
+		if (_load_job_state(buffer, protocol_version) !=
+		    SLURM_SUCCESS) {
+			if (old_job_ptr) {
+				error("Invalid job state journal record for "
+				      "job %u, using checkpointed state",
+				      rec_ptr->job_id);
+				_attach_job_record(old_job_ptr);
+			} else {
+				error("Invalid job state journal record for "
+				      "job %u", rec_ptr->job_id);
+			}
+			continue;
+		}
+		if (old_job_ptr)
+			_free_job_record(old_job_ptr);
+		job_cnt++;
+	}
+
+fini:	xfree(ver_str);
+	xfree(recs);
+	free_buf(buffer);
+	if (replay) {
+		info("Recovered information about %d jobs from job state "
+		     "journal", job_cnt);
+	}
+	return job_cnt;
+
+unpack_error:
+	error("Invalid job state journal header");
+	xfree(ver_str);
+	xfree(recs);
+	free_buf(buffer);
+	return job_cnt;
+}
+
+/* Unpack one batch of job state journal records ending at batch_end,
+ * adding them to the rec_pptr array. The array is unchanged if the batch
+ * is incomplete. */
+static int _load_job_journal_batch(Buf buffer, uint32_t batch_end,
+				   job_journal_rec_t **rec_pptr,
+				   uint32_t *rec_cnt, uint32_t *rec_size)
+{
+	time_t batch_time;
+	uint32_t batch_job_id, batch_rec_cnt, job_id, size, i;
+	uint32_t start_cnt = *rec_cnt;
+	uint16_t rec_type;
+	char *job_data;
+	job_journal_rec_t *rec_ptr;
+
+	safe_unpack_time(&batch_time, buffer);
+	safe_unpack32(&batch_job_id, buffer);
+	safe_unpack32(&batch_rec_cnt, buffer);
+	for (i = 0; i < batch_rec_cnt; i++) {
+		safe_unpack16(&rec_type, buffer);
+		safe_unpack32(&job_id, buffer);
+		if (*rec_cnt >= *rec_size) {
+			*rec_size = MAX(1024, *rec_size * 2);
+			xrealloc(*rec_pptr,
+				 sizeof(job_journal_rec_t) * *rec_size);
+		}
+		rec_ptr = *rec_pptr + *rec_cnt;
+		rec_ptr->job_id = job_id;
+		rec_ptr->order  = *rec_cnt;
+		rec_ptr->job_ptr = NULL;
+		if (rec_type == JOB_JOURNAL_SAVE) {
+			safe_unpackmem_ptr(&job_data, &size, buffer);
+			rec_ptr->offset = job_data -
+					  (char *) get_buf_data(buffer);
+		} else if (rec_type == JOB_JOURNAL_PURGE) {
+			rec_ptr->offset = 0;
+		} else
+			goto unpack_error;
+		(*rec_cnt)++;
+	}
+	if (get_buf_offset(buffer) != batch_end)
+		goto unpack_error;
+
+	job_id_sequence = MAX(batch_job_id, job_id_sequence);
+	return SLURM_SUCCESS;
+
+unpack_error:
+	*rec_cnt = start_cnt;
+	return SLURM_ERROR;
+}
+
 /*
  * _dump_job_state - dump the state of a specific job, its details, and
  *	steps to a buffer
@@ -1461,8 +2094,10 @@ static int _load_job_state(Buf buffer, uint16_t protocol_version)
 	alloc_node             = NULL;	/* reused, nothing left to free */
 	job_ptr->alloc_resp_port = alloc_resp_port;
 	job_ptr->alloc_sid    = alloc_sid;
+	_del_job_array_hash(job_ptr);
 	job_ptr->array_job_id = array_job_id;
 	job_ptr->array_task_id = array_task_id;
+	_add_job_array_hash(job_ptr);
 	job_ptr->assoc_id     = assoc_id;
 	job_ptr->batch_flag   = batch_flag;
 	xfree(job_ptr->batch_host);
@@ -1555,7 +2190,9 @@ static int _load_job_state(Buf buffer, uint16_t protocol_version)
 	job_ptr->cpu_cnt      = cpu_cnt;
 	job_ptr->tot_sus_time = tot_sus_time;
 	job_ptr->preempt_time = preempt_time;
+	_del_job_user_hash(job_ptr);
 	job_ptr->user_id      = user_id;
+	_add_job_user_hash(job_ptr);
 	select_g_select_jobinfo_set(job_ptr->select_jobinfo,
 				    SELECT_JOBDATA_USER_NAME, &user_id);
 	job_ptr->wait_all_nodes = wait_all_nodes;
@@ -2012,31 +2649,203 @@ static int _load_job_details(struct job_record *job_ptr, Buf buffer,
 	job_ptr->details->ckpt_dir = ckpt_dir;
 	job_ptr->details->restart_dir = restart_dir;
 
-	return SLURM_SUCCESS;
+	return SLURM_SUCCESS;
+
+unpack_error:
+
+/*	for (i=0; i<argc; i++)
+	xfree(argv[i]);  Don't trust this on unpack error */
+	xfree(acctg_freq);
+	xfree(argv);
+	xfree(cpu_bind);
+	xfree(dependency);
+	xfree(orig_dependency);
+/*	for (i=0; i<env_cnt; i++)
+	xfree(env_sup[i]);  Don't trust this on unpack error */
+	xfree(env_sup);
+	xfree(err);
+	xfree(exc_nodes);
+	xfree(features);
+	xfree(in);
+	xfree(mem_bind);
+	xfree(out);
+	xfree(req_nodes);
+	xfree(work_dir);
+	xfree(ckpt_dir);
+	xfree(restart_dir);
+	return SLURM_FAILURE;
+}
+
+/* Create an empty job hash table with room for at least size entries */
+static void _job_hash_init(job_hash_t *hash, uint32_t size)
+{
+	hash->size = JOB_HASH_MIN_SIZE;
+	while (hash->size < size)
+		hash->size <<= 1;
+	hash->count = 0;
+	hash->slot = xmalloc(sizeof(job_hash_slot_t) * hash->size);
+}
+
+static void _job_hash_free(job_hash_t *hash)
+{
+	xfree(hash->slot);
+	hash->size = 0;
+	hash->count = 0;
+}
+
+/* Fibonacci hashing, spreads sequential job IDs across the table */
+static inline uint32_t _job_hash_inx(job_hash_t *hash, uint64_t key)
+{
+	return (uint32_t) ((key * 0x9e3779b97f4a7c15ULL) >> 32) &
+	       (hash->size - 1);
+}
+
+static struct job_record *_job_hash_find(job_hash_t *hash, uint64_t key)
+{
+	uint32_t inx;
+
+	if (!hash->slot)
+		return NULL;
+	for (inx = _job_hash_inx(hash, key); hash->slot[inx].job_ptr;
+	     inx = (inx + 1) & (hash->size - 1)) {
+		if (hash->slot[inx].key == key)
+			return hash->slot[inx].job_ptr;
+	}
+	return NULL;
+}
+
+static void _job_hash_set(job_hash_t *hash, uint64_t key,
+			  struct job_record *job_ptr);
+
+/* Double the size of a job hash table and reinsert its entries */
+static void _job_hash_grow(job_hash_t *hash)
+{
+	job_hash_slot_t *old_slot = hash->slot;
+	uint32_t i, old_size = hash->size;
+
+	_job_hash_init(hash, old_size * 2);
+	for (i = 0; i < old_size; i++) {
+		if (old_slot[i].job_ptr) {
+			_job_hash_set(hash, old_slot[i].key,
+				      old_slot[i].job_ptr);
+		}
+	}
+	xfree(old_slot);
+}
+
+/* Add an entry to a job hash table or replace the existing entry's job */
+static void _job_hash_set(job_hash_t *hash, uint64_t key,
+			  struct job_record *job_ptr)
+{
+	uint32_t inx;
+
+	if (!hash->slot)
+		_job_hash_init(hash, 0);
+	else if (((hash->count + 1) * 2) > hash->size)
+		_job_hash_grow(hash);
+
+	for (inx = _job_hash_inx(hash, key); hash->slot[inx].job_ptr;
+	     inx = (inx + 1) & (hash->size - 1)) {
+		if (hash->slot[inx].key == key) {
+			hash->slot[inx].job_ptr = job_ptr;
+			return;
+		}
+	}
+	hash->slot[inx].key = key;
+	hash->slot[inx].job_ptr = job_ptr;
+	hash->count++;
+}
+
+/* Remove an entry from a job hash table. Later entries of the same probe
+ * sequence are shifted back into the hole, so no deleted markers are needed
+ * and lookups stay short as jobs come and go. */
+static void _job_hash_del(job_hash_t *hash, uint64_t key)
+{
+	uint32_t hole, inx, home, mask;
 
-unpack_error:
+	if (!hash->slot)
+		return;
+	mask = hash->size - 1;
+	for (hole = _job_hash_inx(hash, key); ; hole = (hole + 1) & mask) {
+		if (!hash->slot[hole].job_ptr)
+			return;
+		if (hash->slot[hole].key == key)
+			break;
+	}
+	hash->count--;
 
-/*	for (i=0; i<argc; i++)
-	xfree(argv[i]);  Don't trust this on unpack error */
-	xfree(acctg_freq);
-	xfree(argv);
-	xfree(cpu_bind);
-	xfree(dependency);
-	xfree(orig_dependency);
-/*	for (i=0; i<env_cnt; i++)
-	xfree(env_sup[i]);  Don't trust this on unpack error */
-	xfree(env_sup);
-	xfree(err);
-	xfree(exc_nodes);
-	xfree(features);
-	xfree(in);
-	xfree(mem_bind);
-	xfree(out);
-	xfree(req_nodes);
-	xfree(work_dir);
-	xfree(ckpt_dir);
-	xfree(restart_dir);
-	return SLURM_FAILURE;
+	for (inx = (hole + 1) & mask; hash->slot[inx].job_ptr;
+	     inx = (inx + 1) & mask) {
+		/* Move the entry unless its home slot lies after the hole */
+		home = _job_hash_inx(hash, hash->slot[inx].key);
+		if (((inx - home) & mask) >= ((inx - hole) & mask)) {
+			hash->slot[hole] = hash->slot[inx];
+			hole = inx;
+		}
+	}
+	hash->slot[hole].job_ptr = NULL;
+}
+
+static inline struct job_record **_job_chain_next(struct job_record *job_ptr,
+						  bool user)
+{
+	return user ? &job_ptr->user_next : &job_ptr->array_next;
+}
+
+static inline struct job_record **_job_chain_prev(struct job_record *job_ptr,
+						  bool user)
+{
+	return user ? &job_ptr->user_prev : &job_ptr->array_prev;
+}
+
+/* Append a job to the circular chain of jobs sharing a key (a job array's
+ * tasks or a user's jobs). The hash table holds the chain's first job.
+ * IN user - true to use the user chain, false for the job array chain */
+static void _job_chain_add(job_hash_t *hash, uint64_t key,
+			   struct job_record *job_ptr, bool user)
+{
+	struct job_record *first, *last;
+
+	first = _job_hash_find(hash, key);
+	if (!first) {
+		*_job_chain_next(job_ptr, user) = job_ptr;
+		*_job_chain_prev(job_ptr, user) = job_ptr;
+		_job_hash_set(hash, key, job_ptr);
+		return;
+	}
+	last = *_job_chain_prev(first, user);
+	*_job_chain_next(last, user)    = job_ptr;
+	*_job_chain_prev(job_ptr, user) = last;
+	*_job_chain_next(job_ptr, user) = first;
+	*_job_chain_prev(first, user)   = job_ptr;
+}
+
+/* Remove a job from its chain, if linked. See _job_chain_add() */
+static void _job_chain_del(job_hash_t *hash, uint64_t key,
+			   struct job_record *job_ptr, bool user)
+{
+	struct job_record *next, *prev;
+
+	next = *_job_chain_next(job_ptr, user);
+	prev = *_job_chain_prev(job_ptr, user);
+	if (!next)
+		return;
+	if (next == job_ptr) {
+		_job_hash_del(hash, key);
+	} else {
+		*_job_chain_next(prev, user) = next;
+		*_job_chain_prev(next, user) = prev;
+		if (_job_hash_find(hash, key) == job_ptr)
+			_job_hash_set(hash, key, next);
+	}
+	*_job_chain_next(job_ptr, user) = NULL;
+	*_job_chain_prev(job_ptr, user) = NULL;
+}
+
+static inline uint64_t _job_array_key(uint32_t array_job_id,
+				      uint32_t array_task_id)
+{
+	return ((uint64_t) array_job_id << 32) | array_task_id;
 }
 
 /* _add_job_hash - add a job hash entry for given job record, job_id must
@@ -2044,13 +2853,56 @@ unpack_error:
  * IN job_ptr - pointer to job record
  * Globals: hash table updated
  */
-void _add_job_hash(struct job_record *job_ptr)
+static void _add_job_hash(struct job_record *job_ptr)
+{
+	_job_hash_set(&job_hash, job_ptr->job_id, job_ptr);
+}
+
+/* _add_job_array_hash - add job array hash entries for given job record,
+ *	array_job_id and array_task_id must already be set. No effect on
+ *	jobs which are not part of a job array.
+ * IN job_ptr - pointer to job record
+ * Globals: job array hash tables updated
+ */
+static void _add_job_array_hash(struct job_record *job_ptr)
+{
+	if (job_ptr->array_task_id == NO_VAL)
+		return;
+	_job_hash_set(&job_array_hash,
+		      _job_array_key(job_ptr->array_job_id,
+				     job_ptr->array_task_id), job_ptr);
+	_job_chain_add(&job_array_first, job_ptr->array_job_id, job_ptr,
+		       false);
+}
+
+/* _del_job_array_hash - remove a job's job array hash entries, if any */
+static void _del_job_array_hash(struct job_record *job_ptr)
+{
+	uint64_t key;
+
+	if (job_ptr->array_task_id == NO_VAL)
+		return;
+	key = _job_array_key(job_ptr->array_job_id, job_ptr->array_task_id);
+	if (_job_hash_find(&job_array_hash, key) == job_ptr)
+		_job_hash_del(&job_array_hash, key);
+	_job_chain_del(&job_array_first, job_ptr->array_job_id, job_ptr,
+		       false);
+}
+
+/* _add_job_user_hash - add a job to its user's chain of jobs, user_id must
+ *	already be set
+ * IN job_ptr - pointer to job record
+ * Globals: user hash table updated
+ */
+static void _add_job_user_hash(struct job_record *job_ptr)
 {
-	int inx;
+	_job_chain_add(&job_user_hash, job_ptr->user_id, job_ptr, true);
+}
 
-	inx = JOB_HASH_INX(job_ptr->job_id);
-	job_ptr->job_next = job_hash[inx];
-	job_hash[inx] = job_ptr;
+/* _del_job_user_hash - remove a job from its user's chain of jobs, if any */
+static void _del_job_user_hash(struct job_record *job_ptr)
+{
+	_job_chain_del(&job_user_hash, job_ptr->user_id, job_ptr, true);
 }
 
 /*
@@ -2063,30 +2915,41 @@ void _add_job_hash(struct job_record *job_ptr)
 extern struct job_record *find_job_array_rec(uint32_t array_job_id,
 					     uint32_t array_task_id)
 {
-	ListIterator job_iterator;
-	struct job_record *job_ptr, *match_job_ptr = NULL;
+	struct job_record *job_ptr, *first_job_ptr, *match_job_ptr = NULL;
 
 	if (array_task_id == NO_VAL)
 		return find_job_record(array_job_id);
 
-	job_iterator = list_iterator_create(job_list);
-	while ((job_ptr = (struct job_record *) list_next(job_iterator))) {
-		if (job_ptr->array_job_id != array_job_id)
-			continue;
+	if (array_task_id != INFINITE) {
+		return _job_hash_find(&job_array_hash,
+				      _job_array_key(array_job_id,
+						     array_task_id));
+	}
 
-		if (array_task_id == INFINITE) {
-			match_job_ptr = job_ptr;
-			if (!IS_JOB_FINISHED(job_ptr))
-				break;
-		} else if (job_ptr->array_task_id == array_task_id) {
-			match_job_ptr = job_ptr;
+	job_ptr = first_job_ptr = find_job_array_first(array_job_id);
+	while (job_ptr) {
+		match_job_ptr = job_ptr;
+		if (!IS_JOB_FINISHED(job_ptr))
+			break;
+		job_ptr = job_ptr->array_next;
+		if (job_ptr == first_job_ptr)
 			break;
-		}
 	}
-	list_iterator_destroy(job_iterator);
 	return match_job_ptr;
 }
 
+/*
+ * find_job_array_first - return a pointer to the first job record of the
+ *	given job array. The array's other records are reached by following
+ *	job_ptr->array_next until it returns to the first record.
+ * IN array_job_id - requested job array's id
+ * RET pointer to the job's record, NULL if no such job array
+ */
+extern struct job_record *find_job_array_first(uint32_t array_job_id)
+{
+	return _job_hash_find(&job_array_first, array_job_id);
+}
+
 /*
  * find_job_record - return a pointer to the job record with the given job_id
  * IN job_id - requested job's id
@@ -2094,16 +2957,7 @@ extern struct job_record *find_job_array_rec(uint32_t array_job_id,
  */
 struct job_record *find_job_record(uint32_t job_id)
 {
-	struct job_record *job_ptr;
-
-	job_ptr = job_hash[JOB_HASH_INX(job_id)];
-	while (job_ptr) {
-		if (job_ptr->job_id == job_id)
-			return job_ptr;
-		job_ptr = job_ptr->job_next;
-	}
-
-	return NULL;
+	return _job_hash_find(&job_hash, job_id);
 }
 
 /* rebuild a job's partition name list based upon the contents of its
@@ -2137,6 +2991,7 @@ static void _rebuild_part_name_list(struct job_record  *job_ptr)
 	}
 	list_iterator_destroy(part_iterator);
 	last_job_update = time(NULL);
+	job_record_changed(job_ptr);
 }
 
 /*
@@ -2203,6 +3058,7 @@ extern int kill_job_by_part_name(char *part_name)
 		}
 		if (IS_JOB_RUNNING(job_ptr) || suspended) {
 			job_count++;
+			job_record_changed(job_ptr);
 			info("Killing job_id %u on defunct partition %s",
 			     job_ptr->job_id, part_name);
 			job_ptr->job_state = JOB_NODE_FAIL | JOB_COMPLETING;
@@ -2222,6 +3078,7 @@ extern int kill_job_by_part_name(char *part_name)
 						 false);
 		} else if (pending) {
 			job_count++;
+			job_record_changed(job_ptr);
 			info("Killing job_id %u on defunct partition %s",
 			     job_ptr->job_id, part_name);
 			job_ptr->job_state	= JOB_CANCELLED;
@@ -2282,6 +3139,7 @@ extern int kill_job_by_front_end_name(char *node_name)
 		}
 		if (IS_JOB_COMPLETING(job_ptr)) {
 			job_count++;
+			job_record_changed(job_ptr);
 			while ((i = bit_ffs(job_ptr->node_bitmap_cg)) >= 0) {
 				bit_clear(job_ptr->node_bitmap_cg, i);
 				job_update_cpu_cnt(job_ptr, i);
@@ -2307,6 +3165,7 @@ extern int kill_job_by_front_end_name(char *node_name)
 			}
 		} else if (IS_JOB_RUNNING(job_ptr) || suspended) {
 			job_count++;
+			job_record_changed(job_ptr);
 			if (job_ptr->batch_flag && job_ptr->details &&
 			    slurmctld_conf.job_requeue &&
 			    (job_ptr->details->requeue > 0)) {
@@ -2351,6 +3210,7 @@ extern int kill_job_by_front_end_name(char *node_name)
 				job_ptr->job_state = JOB_PENDING;
 				if (job_ptr->node_cnt)
 					job_ptr->job_state |= JOB_COMPLETING;
+				sched_queue_update(job_ptr);
 
 				/* restart from periodic checkpoint */
 				if (job_ptr->ckpt_interval &&
@@ -2509,6 +3369,7 @@ extern int kill_running_job_by_node_name(char *node_name)
 			if (!bit_test(job_ptr->node_bitmap_cg, bit_position))
 				continue;
 			job_count++;
+			job_record_changed(job_ptr);
 			bit_clear(job_ptr->node_bitmap_cg, bit_position);
 			job_update_cpu_cnt(job_ptr, bit_position);
 			if (job_ptr->node_cnt)
@@ -2531,6 +3392,7 @@ extern int kill_running_job_by_node_name(char *node_name)
 			}
 		} else if (IS_JOB_RUNNING(job_ptr) || suspended) {
 			job_count++;
+			job_record_changed(job_ptr);
 			if ((job_ptr->details) &&
 			    (job_ptr->kill_on_node_fail == 0) &&
 			    (job_ptr->node_cnt > 1)) {
@@ -2585,6 +3447,7 @@ extern int kill_running_job_by_node_name(char *node_name)
 				job_ptr->job_state = JOB_PENDING;
 				if (job_ptr->node_cnt)
 					job_ptr->job_state |= JOB_COMPLETING;
+				sched_queue_update(job_ptr);
 
 				/* restart from periodic checkpoint */
 				if (job_ptr->ckpt_interval &&
@@ -2864,7 +3727,6 @@ void dump_job_desc(job_desc_msg_t * job_specs)
  *	this should be called after creating node information, but
  *	before creating any job entries. Pre-existing job entries are
  *	left unchanged.
- *	NOTE: The job hash table size does not change after initial creation.
  * RET 0 if no error, otherwise an error code
  * global: last_job_update - time of last job table update
  *	job_list - pointer to global job list
@@ -2881,30 +3743,21 @@ int init_job_conf(void)
 }
 
 /*
- * rehash_jobs - Create or rebuild the job hash table.
+ * rehash_jobs - Create the job hash tables, sized from MaxJobCount. The
+ *	tables grow as needed, so later calls have no effect.
  * NOTE: run lock_slurmctld before entry: Read config, write job
  */
 extern void rehash_jobs(void)
 {
-	if (job_hash == NULL) {
-		hash_table_size = slurmctld_conf.max_job_cnt;
-		job_hash = (struct job_record **)
-			xmalloc(hash_table_size * sizeof(struct job_record *));
-	} else if (hash_table_size < (slurmctld_conf.max_job_cnt / 2)) {
-		/* If the MaxJobCount grows by too much, the hash table will
-		 * be ineffective without rebuilding. We don't presently bother
-		 * to rebuild the hash table, but cut MaxJobCount back as
-		 * needed. */
-		error ("MaxJobCount reset too high, restart slurmctld");
-		slurmctld_conf.max_job_cnt = hash_table_size;
-	}
+	if (job_hash.slot == NULL)
+		_job_hash_init(&job_hash, slurmctld_conf.max_job_cnt * 2);
 }
 
 /* Create an exact copy of an existing job record for a job array.
  * Assumes the job has no resource allocaiton */
 struct job_record *_job_rec_copy(struct job_record *job_ptr)
 {
-	struct job_record *job_ptr_new = NULL, *save_job_next;
+	struct job_record *job_ptr_new = NULL;
 	struct job_details *job_details, *details_new, *save_details;
 	uint32_t save_job_id;
 	priority_factors_object_t *save_prio_factors;
@@ -2926,16 +3779,22 @@ struct job_record *_job_rec_copy(struct job_record *job_ptr)
 	/* Copy most of original job data.
 	 * This could be done in parallel, but performance was worse. */
 	save_job_id   = job_ptr_new->job_id;
-	save_job_next = job_ptr_new->job_next;
 	save_details  = job_ptr_new->details;
 	save_prio_factors = job_ptr_new->prio_factors;
 	save_step_list = job_ptr_new->step_list;
 	memcpy(job_ptr_new, job_ptr, sizeof(struct job_record));
 	job_ptr_new->job_id   = save_job_id;
-	job_ptr_new->job_next = save_job_next;
 	job_ptr_new->details  = save_details;
 	job_ptr_new->prio_factors = save_prio_factors;
 	job_ptr_new->step_list = save_step_list;
+	/* The copy is added to the job array chain by the caller */
+	job_ptr_new->array_next = NULL;
+	job_ptr_new->array_prev = NULL;
+	job_ptr_new->user_next = NULL;
+	job_ptr_new->user_prev = NULL;
+	_add_job_user_hash(job_ptr_new);
+	job_ptr_new->state_saved = false;
+	job_record_changed(job_ptr_new);
 
 	job_ptr_new->account = xstrdup(job_ptr->account);
 	job_ptr_new->alias_list = xstrdup(job_ptr->alias_list);
@@ -3079,6 +3938,7 @@ static void _create_job_array(struct job_record *job_ptr,
 	}
 	job_ptr->array_job_id  = job_ptr->job_id;
 	job_ptr->array_task_id = i_first;
+	_add_job_array_hash(job_ptr);
 
 	i_last = bit_fls(job_specs->array_bitmap);
 	for (i = (i_first + 1); i <= i_last; i++) {
@@ -3089,6 +3949,8 @@ static void _create_job_array(struct job_record *job_ptr,
 			break;
 		job_ptr_new->array_job_id  = job_ptr->job_id;
 		job_ptr_new->array_task_id = i;
+		_add_job_array_hash(job_ptr_new);
+		sched_queue_update(job_ptr_new);
 	}
 }
 
@@ -3260,6 +4122,7 @@ extern int job_allocate(job_desc_msg_t * job_specs, int immediate,
 	error_code = _select_nodes_parts(job_ptr, no_alloc, NULL);
 	if (!test_only) {
 		last_job_update = now;
+		job_record_changed(job_ptr);
 		slurm_sched_g_schedule();	/* work for external scheduler */
 	}
 
@@ -3360,6 +4223,7 @@ extern int job_fail(uint32_t job_id, uint16_t job_state)
 		} else
 			job_ptr->end_time       = now;
 		last_job_update                 = now;
+		job_record_changed(job_ptr);
 		job_ptr->job_state = job_state | JOB_COMPLETING;
 		job_ptr->exit_code = 1;
 		job_ptr->state_reason = FAIL_LAUNCH;
@@ -3412,21 +4276,20 @@ extern int job_signal(uint32_t job_id, uint16_t signal, uint16_t flags,
 	if ((flags & KILL_JOB_ARRAY) &&		/* signal entire job array */
 	    ((job_ptr == NULL) || (job_ptr->array_task_id != NO_VAL))) {
 		int rc = SLURM_SUCCESS, rc1;
-		ListIterator job_iter;
+		struct job_record *first_job_ptr;
 
 		flags &= (~KILL_JOB_ARRAY);
-		job_iter = list_iterator_create(job_list);
-		while ((job_ptr = (struct job_record *) list_next(job_iter))) {
-			if ((job_ptr->array_job_id != job_id) ||
-			    (job_ptr->array_task_id == NO_VAL))
-				continue;
-			if (IS_JOB_FINISHED(job_ptr))
-				continue;
-			rc1 = job_signal(job_ptr->job_id, signal, flags,
-					 uid, preempt);
-			rc = MAX(rc, rc1);
+		job_ptr = first_job_ptr = find_job_array_first(job_id);
+		while (job_ptr) {
+			if (!IS_JOB_FINISHED(job_ptr)) {
+				rc1 = job_signal(job_ptr->job_id, signal,
+						 flags, uid, preempt);
+				rc = MAX(rc, rc1);
+			}
+			job_ptr = job_ptr->array_next;
+			if (job_ptr == first_job_ptr)
+				break;
 		}
-		list_iterator_destroy(job_iter);
 		return rc;
 	}
 	if (job_ptr == NULL) {
@@ -3471,6 +4334,7 @@ extern int job_signal(uint32_t job_id, uint16_t signal, uint16_t flags,
 
 	if (IS_JOB_PENDING(job_ptr) && (signal == SIGKILL)) {
 		last_job_update		= now;
+		job_record_changed(job_ptr);
 		job_ptr->job_state	= JOB_CANCELLED;
 		job_ptr->start_time	= now;
 		job_ptr->end_time	= now;
@@ -3486,6 +4350,7 @@ extern int job_signal(uint32_t job_id, uint16_t signal, uint16_t flags,
 		job_term_state = JOB_CANCELLED;
 	if (IS_JOB_SUSPENDED(job_ptr) &&  (signal == SIGKILL)) {
 		last_job_update         = now;
+		job_record_changed(job_ptr);
 		job_ptr->end_time       = job_ptr->suspend_time;
 		job_ptr->tot_sus_time  += difftime(now, job_ptr->suspend_time);
 		job_ptr->job_state      = job_term_state | JOB_COMPLETING;
@@ -3504,6 +4369,7 @@ extern int job_signal(uint32_t job_id, uint16_t signal, uint16_t flags,
 			job_ptr->time_last_active	= now;
 			job_ptr->end_time		= now;
 			last_job_update			= now;
+			job_record_changed(job_ptr);
 			job_ptr->job_state = job_term_state | JOB_COMPLETING;
 			build_cg_bitmap(job_ptr);
 			job_completion_logger(job_ptr, false);
@@ -3682,6 +4548,7 @@ extern int job_complete(uint32_t job_id, uid_t uid, bool requeue,
 		job_ptr->batch_flag++;	/* only one retry */
 		job_ptr->restart_cnt++;
 		job_ptr->job_state = JOB_PENDING | job_comp_flag;
+		sched_queue_update(job_ptr);
 		/* Since the job completion logger removes the job submit
 		 * information, we need to add it again. */
 		acct_policy_add_job_submit(job_ptr);
@@ -3735,6 +4602,7 @@ extern int job_complete(uint32_t job_id, uid_t uid, bool requeue,
 	}
 
 	last_job_update = now;
+	job_record_changed(job_ptr);
 	job_ptr->time_last_active = now;   /* Timer for resending kill RPC */
 	if (job_comp_flag) {	/* job was running */
 		build_cg_bitmap(job_ptr);
@@ -5385,8 +6253,10 @@ _copy_job_desc_to_job_record(job_desc_msg_t * job_desc,
 	_add_job_hash(job_ptr);
 
 	job_ptr->user_id    = (uid_t) job_desc->user_id;
+	_add_job_user_hash(job_ptr);
 	job_ptr->group_id   = (gid_t) job_desc->group_id;
 	job_ptr->job_state  = JOB_PENDING;
+	sched_queue_update(job_ptr);
 	job_ptr->time_limit = job_desc->time_limit;
 	if (job_desc->time_min != NO_VAL)
 		job_ptr->time_min = job_desc->time_min;
@@ -5677,6 +6547,7 @@ void job_time_limit(void)
 		if (job_ptr->time_limit != INFINITE) {
 			if (job_ptr->end_time <= over_run) {
 				last_job_update = now;
+				job_record_changed(job_ptr);
 				info("Time limit exhausted for JobId=%u",
 				     job_ptr->job_id);
 				_job_timed_out(job_ptr);
@@ -5699,6 +6570,7 @@ void job_time_limit(void)
 
 		if (resv_status != SLURM_SUCCESS) {
 			last_job_update = now;
+			job_record_changed(job_ptr);
 			info("Reservation ended for JobId=%u",
 			     job_ptr->job_id);
 			_job_timed_out(job_ptr);
@@ -5717,6 +6589,7 @@ void job_time_limit(void)
 
 		if (job_ptr->state_reason == FAIL_TIMEOUT) {
 			last_job_update = now;
+			job_record_changed(job_ptr);
 			_job_timed_out(job_ptr);
 			xfree(job_ptr->state_desc);
 			continue;
@@ -5920,35 +6793,110 @@ _validate_min_mem_partition(job_desc_msg_t *job_desc_msg,
  * IN job_entry - pointer to job_record to delete
  * global: job_list - pointer to global job list
  *	job_count - count of job list entries
- *	job_hash - hash table into job records
+ *	job_hash - hash tables into job records
  */
 static void _list_delete_job(void *job_entry)
 {
 	struct job_record *job_ptr = (struct job_record *) job_entry;
-	struct job_record **job_pptr;
 	int i;
 
 	xassert(job_entry);
 	xassert (job_ptr->magic == JOB_MAGIC);
 	job_ptr->magic = 0;	/* make sure we don't delete record twice */
 
-	/* Remove the record from the hash table */
-	job_pptr = &job_hash[JOB_HASH_INX(job_ptr->job_id)];
-	while ((job_pptr != NULL) &&
-	       ((job_ptr = *job_pptr) != (struct job_record *) job_entry)) {
-		job_pptr = &job_ptr->job_next;
+	/* Remember the purge for pack_jobs_delta(). The job write lock held
+	 * here excludes generation scans, which hold the job read lock. */
+	i = job_purge_inx % JOB_PURGE_HIST_SIZE;
+	if (job_purge_inx >= JOB_PURGE_HIST_SIZE)
+		job_purge_lost_gen = job_purge_hist[i].gen;
+	job_purge_hist[i].job_id = job_ptr->job_id;
+	job_purge_hist[i].gen = job_gen + 1;
+	job_purge_inx++;
+	job_gen_purged = true;
+
+	/* Remember the purge for the job state journal if the job's state
+	 * was saved. The job write lock also excludes state saves. */
+	if (job_ptr->state_saved) {
+		if (job_save_purged_cnt >= job_save_purged_size) {
+			job_save_purged_size = MAX(1024,
+						   job_save_purged_size * 2);
+			xrealloc(job_save_purged, sizeof(uint32_t) *
+						  job_save_purged_size);
+		}
+		job_save_purged[job_save_purged_cnt++] = job_ptr->job_id;
 	}
-	if (job_pptr == NULL) {
+
+	/* Lift dependencies upon the job */
+	depend_job_purge(job_ptr);
+
+	/* Keep schedule() from comparing queued records of the job */
+	sched_queue_job_delete();
+
+	/* Remove the record from the hash tables */
+	if (_job_hash_find(&job_hash, job_ptr->job_id) != job_ptr) {
 		fatal("job hash error");
 		return;	/* Fix CLANG false positive error */
 	}
-	*job_pptr = job_ptr->job_next;
+	_job_hash_del(&job_hash, job_ptr->job_id);
+	_del_job_array_hash(job_ptr);
+	_del_job_user_hash(job_ptr);
+
+	delete_job_details(job_ptr);
+	job_count--;
+	_free_job_record(job_ptr);
+}
+
+/* _detach_job_record - remove a job record which was taken off job_list
+ *	from the hash tables without freeing it, so that it can be replaced.
+ *	Either _attach_job_record() or _free_job_record() must follow.
+ * IN job_ptr - pointer to job record
+ * global: job_count - count of job list entries
+ *	job_hash - hash tables into job records
+ */
+static void _detach_job_record(struct job_record *job_ptr)
+{
+	xassert (job_ptr->magic == JOB_MAGIC);
+	if (_job_hash_find(&job_hash, job_ptr->job_id) == job_ptr)
+		_job_hash_del(&job_hash, job_ptr->job_id);
+	_del_job_array_hash(job_ptr);
+	_del_job_user_hash(job_ptr);
+	job_count--;
+}
+
+/* _attach_job_record - restore a job record removed by
+ *	_detach_job_record() to job_list and the hash tables
+ * IN job_ptr - pointer to job record
+ * global: job_list - pointer to global job list
+ *	job_count - count of job list entries
+ *	job_hash - hash tables into job records
+ */
+static void _attach_job_record(struct job_record *job_ptr)
+{
+	xassert (job_ptr->magic == JOB_MAGIC);
+	(void) list_append(job_list, job_ptr);
+	_add_job_hash(job_ptr);
+	_add_job_array_hash(job_ptr);
+	_add_job_user_hash(job_ptr);
+	job_count++;
+}
+
+/* _free_job_record - free a job record which is not in job_list or the
+ *	hash tables, see _list_delete_job() and _detach_job_record(). The job
+ *	descriptor files are left in place unless delete_job_details() was
+ *	called first.
+ * IN job_ptr - pointer to job record
+ */
+static void _free_job_record(struct job_record *job_ptr)
+{
+	int i;
+
+	job_ptr->magic = 0;	/* make sure we don't delete record twice */
 
 /*
  * NOTE: Anything you free here also needs to be allocated memory copied
  * when a job array is created in _job_rec_copy() above
  */
-	delete_job_details(job_ptr);
+	_free_job_details(job_ptr);
 	xfree(job_ptr->account);
 	xfree(job_ptr->alias_list);
 	xfree(job_ptr->alloc_node);
@@ -5988,7 +6936,6 @@ static void _list_delete_job(void *job_entry)
 	   afterwards */
 	select_g_select_jobinfo_free(job_ptr->select_jobinfo);
 	xfree(job_ptr->wckey);
-	job_count--;
 	xfree(job_ptr);
 }
 
@@ -6070,6 +7017,119 @@ static bool _hide_job(struct job_record *job_ptr, uid_t uid)
 	return false;
 }
 
+/* Return true if a job should be excluded from a job information response
+ * for the specified user. Call between part_filter_set() and
+ * part_filter_clear(). min_age is the end time before which finished jobs
+ * are no longer reported, zero if MinJobAge is not set. */
+static bool _filter_packed_job(struct job_record *job_ptr,
+			       uint16_t show_flags, uid_t uid, time_t min_age)
+{
+	if (((show_flags & SHOW_ALL) == 0) && (uid != 0) &&
+	    (job_ptr->part_ptr) &&
+	    (job_ptr->part_ptr->flags & PART_FLAG_HIDDEN))
+		return true;
+
+	if (_hide_job(job_ptr, uid))
+		return true;
+
+	if (_job_ready_for_purge(job_ptr, min_age))
+		return true;	/* job ready for purging, don't dump */
+
+	return false;
+}
+
+/*
+ * _job_list_next - return the next job from a job_list iterator. Every
+ *	JOB_YIELD_CNT jobs, the locks held by the caller are released if a
+ *	writer is waiting for them, so pointers to job records must not be
+ *	kept across calls. The list iterator remains valid.
+ * IN job_iterator - job_list iterator
+ * IN/OUT job_cnt - count of jobs returned so far
+ * IN lock_levels - locks held by the caller
+ * IN part_filter - set if the caller holds part_filter_set(uid), which is
+ *	cleared while the locks are released
+ * IN uid - user passed to part_filter_set()
+ */
+static struct job_record *_job_list_next(ListIterator job_iterator,
+					 uint32_t *job_cnt,
+					 slurmctld_lock_t lock_levels,
+					 bool part_filter, uid_t uid)
+{
+	if ((++(*job_cnt) % JOB_YIELD_CNT) == 0) {
+		if (part_filter)
+			part_filter_clear();
+		(void) yield_slurmctld(lock_levels);
+		if (part_filter)
+			part_filter_set(uid);
+	}
+	return (struct job_record *) list_next(job_iterator);
+}
+
+/* Return true if a finished job is older than MinJobAge and no longer
+ * reported to users */
+static bool _job_ready_for_purge(struct job_record *job_ptr, time_t min_age)
+{
+	if ((min_age > 0) && (job_ptr->end_time < min_age) &&
+	    (! IS_JOB_COMPLETING(job_ptr)) && IS_JOB_FINISHED(job_ptr))
+		return true;
+	return false;
+}
+
+/* Return the start time which pack_job() would report for a job */
+static time_t _job_pack_start(struct job_record *job_ptr, time_t now)
+{
+	time_t begin_time = 0;
+
+	if (job_ptr->details)
+		begin_time = job_ptr->details->begin_time;
+	if (job_ptr->start_time || (begin_time <= now))
+		return job_ptr->start_time;
+	return begin_time;
+}
+
+/*
+ * Advance the job table generation, assigning it to every job which has
+ * changed since the last scan. Changes are noted through job_record_changed()
+ * at each modification. The priority, reason and expected start time of
+ * pending jobs are reset by every scheduling pass without being noted, and
+ * purge eligibility depends upon the current time, so those are compared
+ * with their values at the last scan. Call with job_gen_mutex and the job
+ * read lock held.
+ */
+static void _job_gen_scan(time_t now, time_t min_age)
+{
+	ListIterator job_iterator;
+	struct job_record *job_ptr;
+	uint32_t new_gen = job_gen + 1;
+	bool changed = job_gen_purged, purge;
+	time_t start_time;
+
+	job_iterator = list_iterator_create(job_list);
+	while ((job_ptr = (struct job_record *) list_next(job_iterator))) {
+		purge = _job_ready_for_purge(job_ptr, min_age);
+		start_time = _job_pack_start(job_ptr, now);
+		if (job_ptr->pack_gen &&
+		    (job_ptr->change_seq <= job_gen_seq) &&
+		    (job_ptr->pack_priority == job_ptr->priority) &&
+		    (job_ptr->pack_purge == purge) &&
+		    (job_ptr->pack_reason == job_ptr->state_reason) &&
+		    (job_ptr->pack_start == start_time))
+			continue;
+		job_ptr->pack_gen = new_gen;
+		job_ptr->pack_priority = job_ptr->priority;
+		job_ptr->pack_purge = purge;
+		job_ptr->pack_reason = job_ptr->state_reason;
+		job_ptr->pack_start = start_time;
+		changed = true;
+	}
+	list_iterator_destroy(job_iterator);
+
+	if (changed)
+		job_gen = new_gen;
+	job_gen_purged = false;
+	job_gen_seq = job_change_seq;
+}
+
 /*
  * pack_all_jobs - dump all job information for all jobs in
  *	machine independent form (for network transmission)
@@ -6080,6 +7140,9 @@ static bool _hide_job(struct job_record *job_ptr, uid_t uid)
  * IN filter_uid - pack only jobs belonging to this user if not NO_VAL
  * global: job_list - global list of job records
  * NOTE: the buffer at *buffer_ptr must be xfreed by the caller
+ * NOTE: call with config and job read locks and partition write lock held,
+ *	they are released while other threads wait for write locks, so jobs
+ *	may change while being packed
  * NOTE: change _unpack_job_desc_msg() in common/slurm_protocol_pack.c
  *	whenever the data format changes
  */
@@ -6088,8 +7151,11 @@ extern void pack_all_jobs(char **buffer_ptr, int *buffer_size,
 			  uint16_t protocol_version)
 {
 	ListIterator job_iterator;
-	struct job_record *job_ptr;
-	uint32_t jobs_packed = 0, tmp_offset;
+	/* Locks: Held by caller, used to yield to writers */
+	slurmctld_lock_t job_read_lock =
+		{ READ_LOCK, READ_LOCK, NO_LOCK, WRITE_LOCK };
+	struct job_record *job_ptr, *first_job_ptr;
+	uint32_t job_cnt = 0, jobs_packed = 0, tmp_offset;
 	Buf buffer;
 	time_t min_age = 0, now = time(NULL);
 
@@ -6108,31 +7174,159 @@ extern void pack_all_jobs(char **buffer_ptr, int *buffer_size,
 
 	/* write individual job records */
 	part_filter_set(uid);
+	if (filter_uid != NO_VAL) {
+		/* only walk the user's own jobs */
+		job_ptr = first_job_ptr =
+			_job_hash_find(&job_user_hash, filter_uid);
+		while (job_ptr) {
+			xassert (job_ptr->magic == JOB_MAGIC);
+			if (!_filter_packed_job(job_ptr, show_flags, uid,
+						min_age)) {
+				pack_job(job_ptr, show_flags, buffer,
+					 protocol_version, uid);
+				jobs_packed++;
+			}
+			job_ptr = job_ptr->user_next;
+			if (job_ptr == first_job_ptr)
+				break;
+		}
+	} else {
+		job_iterator = list_iterator_create(job_list);
+		while ((job_ptr = _job_list_next(job_iterator, &job_cnt,
+						 job_read_lock, true, uid))) {
+			xassert (job_ptr->magic == JOB_MAGIC);
+
+			if (_filter_packed_job(job_ptr, show_flags, uid,
+					       min_age))
+				continue;
+
+			pack_job(job_ptr, show_flags, buffer,
+				 protocol_version, uid);
+			jobs_packed++;
+		}
+		list_iterator_destroy(job_iterator);
+	}
+	part_filter_clear();
+
+	/* put the real record count in the message body header */
+	tmp_offset = get_buf_offset(buffer);
+	set_buf_offset(buffer, 0);
+	pack32(jobs_packed, buffer);
+	set_buf_offset(buffer, tmp_offset);
+
+	*buffer_size = get_buf_offset(buffer);
+	buffer_ptr[0] = xfer_buf_data(buffer);
+}
+
+/*
+ * pack_jobs_delta - dump information for jobs which have changed since a
+ *	client's copy of the job table was built, in machine independent form
+ *	(for network transmission)
+ * OUT buffer_ptr - the pointer is set to the allocated buffer.
+ * OUT buffer_size - set to size of the buffer in bytes
+ * IN req - client's table generation, its epoch, update time and show_flags
+ * IN uid - uid of user making request (for partition filtering)
+ * IN protocol_version - slurm protocol version of client
+ * global: job_list - global list of job records
+ * NOTE: the buffer at *buffer_ptr must be xfreed by the caller
+ * NOTE: change _unpack_job_info_delta_msg() in common/slurm_protocol_pack.c
+ *	whenever the data format changes
+ */
+extern void pack_jobs_delta(char **buffer_ptr, int *buffer_size,
+			    job_info_delta_request_msg_t *req, uid_t uid,
+			    uint16_t protocol_version)
+{
+	ListIterator job_iterator;
+	struct job_record *job_ptr;
+	uint32_t jobs_packed = 0, removed_cnt = 0, removed_size = 0;
+	uint32_t *removed_ids = NULL, tmp_offset, i;
+	uint16_t full = 0;
+	Buf buffer;
+	time_t min_age = 0, now = time(NULL);
+
+	buffer_ptr[0] = NULL;
+	*buffer_size = 0;
+
+	if (slurmctld_conf.min_job_age > 0)
+		min_age = now  - slurmctld_conf.min_job_age;
+
+	slurm_mutex_lock(&job_gen_mutex);
+	if (job_gen_epoch == 0)
+		job_gen_epoch = now;
+	_job_gen_scan(now, min_age);
+
+	/* Send the full table if the client's table was not built from this
+	 * generation series, if purge records it needs have been discarded,
+	 * or if partition or configuration changes may have altered which
+	 * jobs this user can see */
+	if ((req->generation == 0) || (req->generation > job_gen) ||
+	    (req->gen_epoch != job_gen_epoch) ||
+	    (req->generation < job_purge_lost_gen) ||
+	    (req->last_update < last_part_update) ||
+	    (req->last_update < slurmctld_conf.last_update))
+		full = 1;
+
+	buffer = init_buf(BUF_SIZE);
+
+	/* write message body header : size, time and generation */
+	/* put in a place holder job record count of 0 for now */
+	pack32(jobs_packed, buffer);
+	pack_time(now, buffer);
+	pack32(job_gen, buffer);
+	pack_time(job_gen_epoch, buffer);
+	pack16(full, buffer);
+
+	/* write individual job records, jobs which have changed but are
+	 * no longer visible to this user are reported as removed */
+	part_filter_set(uid);
 	job_iterator = list_iterator_create(job_list);
 	while ((job_ptr = (struct job_record *) list_next(job_iterator))) {
 		xassert (job_ptr->magic == JOB_MAGIC);
 
-		if (((show_flags & SHOW_ALL) == 0) && (uid != 0) &&
-		    (job_ptr->part_ptr) &&
-		    (job_ptr->part_ptr->flags & PART_FLAG_HIDDEN))
-			continue;
-
-		if (_hide_job(job_ptr, uid))
+		if (!full && (job_ptr->pack_gen <= req->generation))
 			continue;
 
-		if ((min_age > 0) && (job_ptr->end_time < min_age) &&
-		    (! IS_JOB_COMPLETING(job_ptr)) && IS_JOB_FINISHED(job_ptr))
-			continue;	/* job ready for purging, don't dump */
-
-		if ((filter_uid != NO_VAL) && (filter_uid != job_ptr->user_id))
+		if (_filter_packed_job(job_ptr, req->show_flags, uid,
+				       min_age)) {
+			if (full)
+				continue;
+			if (removed_cnt >= removed_size) {
+				removed_size += 1024;
+				xrealloc(removed_ids,
+					 sizeof(uint32_t) * removed_size);
+			}
+			removed_ids[removed_cnt++] = job_ptr->job_id;
 			continue;
+		}
 
-		pack_job(job_ptr, show_flags, buffer, protocol_version, uid);
+		pack_job(job_ptr, req->show_flags, buffer, protocol_version,
+			 uid);
 		jobs_packed++;
 	}
 	part_filter_clear();
 	list_iterator_destroy(job_iterator);
 
+	/* add jobs purged since the client's generation */
+	if (!full) {
+		i = (job_purge_inx > JOB_PURGE_HIST_SIZE) ?
+		    (job_purge_inx - JOB_PURGE_HIST_SIZE) : 0;
+		for ( ; i < job_purge_inx; i++) {
+			job_purge_rec_t *purge_ptr =
+				&job_purge_hist[i % JOB_PURGE_HIST_SIZE];
+			if (purge_ptr->gen <= req->generation)
+				continue;
+			if (removed_cnt >= removed_size) {
+				removed_size += 1024;
+				xrealloc(removed_ids,
+					 sizeof(uint32_t) * removed_size);
+			}
+			removed_ids[removed_cnt++] = purge_ptr->job_id;
+		}
+	}
+	slurm_mutex_unlock(&job_gen_mutex);
+	pack32_array(removed_ids, removed_cnt, buffer);
+	xfree(removed_ids);
+
 	/* put the real record count in the message body header */
 	tmp_offset = get_buf_offset(buffer);
 	set_buf_offset(buffer, 0);
@@ -6159,8 +7353,7 @@ extern int pack_one_job(char **buffer_ptr, int *buffer_size,
 			uint32_t job_id, uint16_t show_flags, uid_t uid,
 			uint16_t protocol_version)
 {
-	ListIterator job_iterator;
-	struct job_record *job_ptr;
+	struct job_record *job_ptr, *first_job_ptr;
 	uint32_t jobs_packed = 0, tmp_offset;
 	Buf buffer;
 
@@ -6182,23 +7375,26 @@ extern int pack_one_job(char **buffer_ptr, int *buffer_size,
 			jobs_packed++;
 		}
 	} else {
-		/* Job ID not found. It could reference a job array. */
-		job_iterator = list_iterator_create(job_list);
-		while ((job_ptr = (struct job_record *) 
-				  list_next(job_iterator))) {
-			if ((job_ptr->job_id != job_id) &&
-			    ((job_ptr->array_task_id ==  NO_VAL) ||
-			     (job_ptr->array_job_id  != job_id)))
-				continue;
-
+		/* Job ID not found. It could reference a job array, or be
+		 * one task of a job array with a different ID. */
+		if (job_ptr && (job_ptr->array_job_id != job_id) &&
+		    !_hide_job(job_ptr, uid)) {
+			pack_job(job_ptr, show_flags, buffer, protocol_version,
+				 uid);
+			jobs_packed++;
+		}
+		job_ptr = first_job_ptr = find_job_array_first(job_id);
+		while (job_ptr) {
 			if (_hide_job(job_ptr, uid))
 				break;
 
 			pack_job(job_ptr, show_flags, buffer, protocol_version,
 				 uid);
 			jobs_packed++;
+			job_ptr = job_ptr->array_next;
+			if (job_ptr == first_job_ptr)
+				break;
 		}
-		list_iterator_destroy(job_iterator);
 	}
 
 	if (jobs_packed == 0) {
@@ -6931,6 +8127,7 @@ void purge_old_job(void)
 			job_ptr->end_time	= now;
 			job_completion_logger(job_ptr, false);
 			last_job_update		= now;
+			job_record_changed(job_ptr);
 			srun_allocate_abort(job_ptr);
 		}
 	}
@@ -7220,6 +8417,7 @@ extern void set_job_prio(struct job_record *job_ptr)
 		return;
 	job_ptr->priority = slurm_sched_g_initial_priority(lowest_prio,
 							 job_ptr);
+	sched_queue_update(job_ptr);
 	if ((job_ptr->priority == 0)   ||
 	    (job_ptr->direct_set_prio) ||
 	    (job_ptr->details && (job_ptr->details->nice != NICE_OFFSET)))
@@ -7464,6 +8662,7 @@ int update_job(job_desc_msg_t * job_specs, uid_t uid)
 	if (detail_ptr)
 		mc_ptr = detail_ptr->mc_ptr;
 	last_job_update = now;
+	job_record_changed(job_ptr);
 
 	if (job_specs->account) {
 		if (!IS_JOB_PENDING(job_ptr))
@@ -8993,6 +10192,10 @@ fini:
 	    strcmp(slurmctld_conf.priority_type, "priority/basic"))
 		set_job_prio(job_ptr);
 
+	/* Partial updates may have been made even on failure */
+	if (IS_JOB_PENDING(job_ptr))
+		sched_queue_update(job_ptr);
+
 	return error_code;
 }
 
@@ -9818,7 +11021,13 @@ void job_fini (void)
 		list_destroy(job_list);
 		job_list = NULL;
 	}
-	xfree(job_hash);
+	_job_hash_free(&job_hash);
+	_job_hash_free(&job_array_hash);
+	_job_hash_free(&job_array_first);
+	_job_hash_free(&job_user_hash);
+	xfree(job_save_purged);
+	job_save_purged_cnt = 0;
+	job_save_purged_size = 0;
 }
 
 /* log the completion of the specified job */
@@ -9827,6 +11036,7 @@ extern void job_completion_logger(struct job_record  *job_ptr, bool requeue)
 	int base_state;
 
 	xassert(job_ptr);
+	job_record_changed(job_ptr);
 
 #ifdef HAVE_BG
 	/* If on a bluegene system we want to remove the job_resrcs so
@@ -9836,6 +11046,7 @@ extern void job_completion_logger(struct job_record  *job_ptr, bool requeue)
 		free_job_resources(&job_ptr->job_resrcs);
 #endif
 	acct_policy_remove_job_submit(job_ptr);
+	depend_job_state_change(job_ptr);
 
 	if (!IS_JOB_RESIZING(job_ptr)) {
 		/* Remove configuring state just to make sure it isn't there
@@ -10207,6 +11418,7 @@ static int _suspend_job_nodes(struct job_record *job_ptr, bool indf_susp)
 		}
 	}
 	last_job_update = last_node_update = now;
+	job_record_changed(job_ptr);
 	return rc;
 }
 
@@ -10255,6 +11467,7 @@ static int _resume_job_nodes(struct job_record *job_ptr, bool indf_susp)
 		node_ptr->node_state = NODE_STATE_ALLOCATED | node_flags;
 	}
 	last_job_update = last_node_update = time(NULL);
+	job_record_changed(job_ptr);
 	return rc;
 }
 
@@ -10467,6 +11680,7 @@ extern int job_requeue(uid_t uid,
 
 	slurm_sched_g_requeue(job_ptr, "Job requeued by user/admin");
 	last_job_update = now;
+	job_record_changed(job_ptr);
 
 	if (IS_JOB_SUSPENDED(job_ptr)) {
 		enum job_states suspend_job_state = job_ptr->job_state;
@@ -10516,6 +11730,7 @@ extern int job_requeue(uid_t uid,
 	job_ptr->job_state = JOB_PENDING;
 	if (job_ptr->node_cnt)
 		job_ptr->job_state |= JOB_COMPLETING;
+	sched_queue_update(job_ptr);
 
 	job_ptr->pre_sus_time = (time_t) 0;
 	job_ptr->suspend_time = (time_t) 0;
@@ -10766,6 +11981,7 @@ extern int update_job_account(char *module, struct job_record *job_ptr,
 	job_ptr->assoc_id = assoc_rec.id;
 
 	last_job_update = time(NULL);
+	job_record_changed(job_ptr);
 
 	return SLURM_SUCCESS;
 }
@@ -10830,6 +12046,7 @@ extern int update_job_wckey(char *module, struct job_record *job_ptr,
 	}
 
 	last_job_update = time(NULL);
+	job_record_changed(job_ptr);
 
 	return SLURM_SUCCESS;
 }
@@ -10958,6 +12175,7 @@ extern int job_checkpoint(checkpoint_msg_t *ckpt_ptr, uid_t uid,
 		info("checkpoint_op %u of %u.%u complete, rc=%d",
 		     ckpt_ptr->op, ckpt_ptr->job_id, ckpt_ptr->step_id, rc);
 		last_job_update = time(NULL);
+		job_record_changed(job_ptr);
 	} else {		/* operate on all of a job's steps */
 		int update_rc = -2;
 		ListIterator step_iterator;
@@ -10990,8 +12208,10 @@ extern int job_checkpoint(checkpoint_msg_t *ckpt_ptr, uid_t uid,
 			rc = MAX(rc, update_rc);
 			xfree(image_dir);
 		}
-		if (update_rc != -2)	/* some work done */
+		if (update_rc != -2) {	/* some work done */
 			last_job_update = time(NULL);
+			job_record_changed(job_ptr);
+		}
 		list_iterator_destroy (step_iterator);
 	}
 
@@ -11407,6 +12627,7 @@ extern int job_restart(checkpoint_msg_t *ckpt_ptr, uid_t uid, slurm_fd_t conn_fd
 		image_dir = NULL;	/* Nothing left to xfree */
 
 		last_job_update = time(NULL);
+		job_record_changed(job_ptr);
 	}
 
  unpack_error:
@@ -11517,6 +12738,7 @@ job_hold_requeue(struct job_record *job_ptr)
 	 */
 	flags = job_ptr->job_state & JOB_STATE_FLAGS;
 	job_ptr->job_state = JOB_PENDING | flags;
+	sched_queue_update(job_ptr);
 
 	/* Test if user wants to requeue the job
 	 * in hold or with a special exit value.
@@ -11529,6 +12751,8 @@ job_hold_requeue(struct job_record *job_ptr)
 		job_ptr->job_state |= JOB_SPECIAL_EXIT;
 		job_ptr->state_reason = WAIT_HELD_USER;
 		job_ptr->priority = 0;
+		/* satisfies afternotok dependencies */
+		depend_job_state_change(job_ptr);
 	}
 
 	if (state & JOB_REQUEUE_HOLD) {
@@ -85,6 +85,38 @@
 #define _DEBUG 0
 #define MAX_RETRIES 10
 
+/* The queue of runnable pending jobs used by schedule() is kept between
+ * passes, with a binary heap of job_queue_rec_t for each partition ordered
+ * by sort_job_queue2(). It is rebuilt from job_list at least this often
+ * (in seconds) to pick up priority recalculations and other changes not
+ * reported through sched_queue_update(). */
+#define SCHED_QUEUE_REBUILD_TIME 60
+
+typedef struct sched_heap {
+	struct part_record *part_ptr;
+	job_queue_rec_t **rec;		/* rec[0] is the best record */
+	uint32_t rec_cnt;
+	uint32_t rec_size;
+} sched_heap_t;
+
+typedef struct sched_job_ref {
+	uint32_t job_id;
+	uint32_t seq;			/* job's sched_seq when noted */
+} sched_job_ref_t;
+
+/* Reverse job dependency graph: for each job ID depended upon (or job array
+ * ID for dependencies upon all of an array's tasks), the IDs of jobs which
+ * depend upon it. Edges are added by update_job_dependency() and are not
+ * removed when a dependency is lifted, so users of the graph confirm that
+ * the dependency still exists. */
+typedef struct depend_rev {
+	uint32_t job_id;		/* job depended upon */
+	uint32_t *dep_id;		/* jobs depending upon job_id */
+	uint32_t dep_cnt;
+	uint32_t dep_size;
+	struct depend_rev *next;	/* next entry in same hash bucket */
+} depend_rev_t;
+
 typedef struct epilog_arg {
 	char *epilog_slurmctld;
 	uint32_t job_id;
@@ -96,6 +128,9 @@ static void	_depend_list_del(void *dep_ptr);
 static void	_feature_list_delete(void *x);
 static void	_job_queue_append(List job_queue, struct job_record *job_ptr,
 				  struct part_record *part_ptr, uint32_t priority);
+static int	_job_queue_build_job(List job_queue,
+				     struct job_record *job_ptr,
+				     bool clear_start, bool backfill);
 static void	_job_queue_rec_del(void *x);
 static bool	_job_runnable_test1(struct job_record *job_ptr,
 				    bool clear_start);
@@ -103,12 +138,32 @@ static bool	_job_runnable_test2(struct job_record *job_ptr,
 				    bool check_min_time);
 static void *	_run_epilog(void *arg);
 static void *	_run_prolog(void *arg);
-static bool	_scan_depend(List dependency_list, uint32_t job_id);
+static bool	_depend_cycle(struct job_record *job_ptr,
+			      List new_depend_list);
 static int	_valid_feature_list(uint32_t job_id, List feature_list);
 static int	_valid_node_feature(char *feature);
 
 static int	save_last_part_update = 0;
 
+/* Queue kept by schedule(), protected by the job write lock */
+static sched_heap_t *	sched_heap = NULL;	/* one per partition */
+static int		sched_heap_cnt = 0;
+static time_t		sched_queue_time = 0;	/* time of last rebuild */
+static time_t		sched_queue_part_update = 0;
+static time_t		sched_queue_conf_update = 0;
+static uint32_t		sched_seq = 0;		/* last sched_seq assigned */
+static sched_job_ref_t *sched_changed = NULL;	/* jobs to retest */
+static uint32_t		sched_changed_cnt = 0, sched_changed_size = 0;
+static sched_job_ref_t *sched_blocked = NULL;	/* pending, not runnable */
+static uint32_t		sched_blocked_cnt = 0, sched_blocked_size = 0;
+static bool		sched_job_deleted = false; /* records may refer to
+						    * freed jobs */
+
+/* Reverse job dependency graph, protected by the job write lock */
+static depend_rev_t **	depend_rev_hash = NULL;
+static uint32_t		depend_rev_size = 0;	/* hash bucket count */
+static uint32_t		depend_rev_cnt = 0;	/* entry count */
+
 extern diag_stats_t slurmctld_diag_stats;
 
 /*
@@ -141,17 +196,355 @@ static List _build_user_job_list(uint32_t user_id, char* job_name)
 	return job_queue;
 }
 
+/* Add a record to a partition's heap in the schedule() queue */
+static void _sched_heap_push(sched_heap_t *heap, job_queue_rec_t *rec)
+{
+	uint32_t inx, parent;
+
+	if (heap->rec_cnt >= heap->rec_size) {
+		heap->rec_size = MAX(heap->rec_size * 2, 64);
+		xrealloc(heap->rec, sizeof(job_queue_rec_t *) * heap->rec_size);
+	}
+	for (inx = heap->rec_cnt++; inx > 0; inx = parent) {
+		parent = (inx - 1) / 2;
+		if (sort_job_queue2(&rec, &heap->rec[parent]) >= 0)
+			break;
+		heap->rec[inx] = heap->rec[parent];
+	}
+	heap->rec[inx] = rec;
+}
+
+/* Remove and return the best record of a partition's heap */
+static job_queue_rec_t *_sched_heap_pop(sched_heap_t *heap)
+{
+	job_queue_rec_t *top, *last;
+	uint32_t inx, child;
+
+	if (heap->rec_cnt == 0)
+		return NULL;
+	top = heap->rec[0];
+	last = heap->rec[--heap->rec_cnt];
+	for (inx = 0; (child = (inx * 2) + 1) < heap->rec_cnt; inx = child) {
+		if (((child + 1) < heap->rec_cnt) &&
+		    (sort_job_queue2(&heap->rec[child + 1],
+				     &heap->rec[child]) < 0))
+			child++;
+		if (sort_job_queue2(&last, &heap->rec[child]) <= 0)
+			break;
+		heap->rec[inx] = heap->rec[child];
+	}
+	heap->rec[inx] = last;
+	return top;
+}
+
+static sched_heap_t *_sched_heap_find(struct part_record *part_ptr)
+{
+	int i;
+
+	for (i = 0; i < sched_heap_cnt; i++) {
+		if (sched_heap[i].part_ptr == part_ptr)
+			return &sched_heap[i];
+	}
+	return NULL;
+}
+
+static void _sched_job_ref_add(sched_job_ref_t **refs, uint32_t *cnt,
+			       uint32_t *size, struct job_record *job_ptr)
+{
+	if (*cnt >= *size) {
+		*size = MAX(*size * 2, 64);
+		xrealloc(*refs, sizeof(sched_job_ref_t) * *size);
+	}
+	(*refs)[*cnt].job_id = job_ptr->job_id;
+	(*refs)[*cnt].seq = job_ptr->sched_seq;
+	(*cnt)++;
+}
+
+/* Free all records of the schedule() queue */
+static void _sched_queue_clear(void)
+{
+	int i;
+	uint32_t j;
+
+	for (i = 0; i < sched_heap_cnt; i++) {
+		for (j = 0; j < sched_heap[i].rec_cnt; j++)
+			xfree(sched_heap[i].rec[j]);
+		xfree(sched_heap[i].rec);
+	}
+	xfree(sched_heap);
+	sched_heap_cnt = 0;
+	xfree(sched_changed);
+	sched_changed_cnt = sched_changed_size = 0;
+	xfree(sched_blocked);
+	sched_blocked_cnt = sched_blocked_size = 0;
+	sched_job_deleted = false;
+}
+
+/* Remove the records of jobs deleted since the last sweep, which must be
+ * done before any heap operation since comparing records reads the job
+ * records. See sched_queue_job_delete(). */
+static void _sched_queue_sweep(void)
+{
+	sched_heap_t *heap;
+	job_queue_rec_t *rec;
+	uint32_t j, k;
+	int i;
+
+	if (!sched_job_deleted)
+		return;
+	sched_job_deleted = false;
+
+	for (i = 0; i < sched_heap_cnt; i++) {
+		heap = &sched_heap[i];
+		for (j = 0, k = 0; j < heap->rec_cnt; j++) {
+			rec = heap->rec[j];
+			if (find_job_record(rec->job_id) != rec->job_ptr) {
+				xfree(rec);
+				continue;
+			}
+			heap->rec[k++] = rec;
+		}
+		if (k == heap->rec_cnt)
+			continue;
+		/* Restore the heap order of the remaining records */
+		heap->rec_cnt = 0;
+		for (j = 0; j < k; j++)
+			_sched_heap_push(heap, heap->rec[j]);
+	}
+}
+
+/* Return true if a job waits only for dependencies upon other jobs' state,
+ * whose changes are reported through depend_job_state_change() */
+static bool _depend_tracked(struct job_record *job_ptr)
+{
+	ListIterator iter;
+	struct depend_spec *dep_ptr;
+	bool tracked = false;
+
+	if ((job_ptr->state_reason != WAIT_DEPENDENCY) ||
+	    !job_ptr->details || !job_ptr->details->depend_list)
+		return false;
+	iter = list_iterator_create(job_ptr->details->depend_list);
+	while ((dep_ptr = (struct depend_spec *) list_next(iter))) {
+		if ((dep_ptr->depend_type == SLURM_DEPEND_SINGLETON) ||
+		    (dep_ptr->depend_type == SLURM_DEPEND_EXPAND)) {
+			tracked = false;
+			break;
+		}
+		tracked = true;
+	}
+	list_iterator_destroy(iter);
+	return tracked;
+}
+
+/* Add a job's records to the schedule() queue, or remember it as blocked if
+ * it is pending but can not run now for a reason other than a hold or a
+ * dependency tracked by the reverse dependency graph */
+static void _sched_queue_test(struct job_record *job_ptr)
+{
+	if ((_job_queue_build_job(NULL, job_ptr, false, false) == 0) &&
+	    IS_JOB_PENDING(job_ptr) && (job_ptr->priority != 0) &&
+	    !_depend_tracked(job_ptr)) {
+		_sched_job_ref_add(&sched_blocked, &sched_blocked_cnt,
+				   &sched_blocked_size, job_ptr);
+	}
+}
+
+/* Rebuild the schedule() queue from job_list */
+static void _sched_queue_build(time_t now)
+{
+	ListIterator iter;
+	struct part_record *part_ptr;
+	struct job_record *job_ptr;
+
+	_sched_queue_clear();
+	sched_heap = xmalloc(sizeof(sched_heap_t) * list_count(part_list));
+	iter = list_iterator_create(part_list);
+	while ((part_ptr = (struct part_record *) list_next(iter)))
+		sched_heap[sched_heap_cnt++].part_ptr = part_ptr;
+	list_iterator_destroy(iter);
+
+	iter = list_iterator_create(job_list);
+	while ((job_ptr = (struct job_record *) list_next(iter)))
+		_sched_queue_test(job_ptr);
+	list_iterator_destroy(iter);
+
+	sched_queue_time = now;
+	sched_queue_part_update = last_part_update;
+	sched_queue_conf_update = slurmctld_conf.last_update;
+}
+
+/* Bring the schedule() queue up to date, retesting only jobs reported by
+ * sched_queue_update() and jobs which could not run on the last pass.
+ * RET count of records in the queue */
+static uint32_t _sched_queue_refresh(time_t now)
+{
+	sched_job_ref_t *refs;
+	struct job_record *job_ptr;
+	uint32_t i, cnt, rec_cnt = 0;
+
+	if ((sched_heap == NULL) ||
+	    (sched_queue_part_update != last_part_update) ||
+	    (sched_queue_conf_update != slurmctld_conf.last_update) ||
+	    ((now - sched_queue_time) >= SCHED_QUEUE_REBUILD_TIME)) {
+		_sched_queue_build(now);
+	} else {
+		_sched_queue_sweep();
+		/* Jobs whose sched_seq changed since being noted here were
+		 * also noted by sched_queue_update() */
+		refs = sched_blocked;
+		cnt  = sched_blocked_cnt;
+		sched_blocked = NULL;
+		sched_blocked_cnt = sched_blocked_size = 0;
+		for (i = 0; i < cnt; i++) {
+			job_ptr = find_job_record(refs[i].job_id);
+			if (job_ptr && (job_ptr->sched_seq == refs[i].seq))
+				_sched_queue_test(job_ptr);
+		}
+		xfree(refs);
+
+		for (i = 0; i < sched_changed_cnt; i++) {
+			job_ptr = find_job_record(sched_changed[i].job_id);
+			if (job_ptr &&
+			    (job_ptr->sched_seq == sched_changed[i].seq))
+				_sched_queue_test(job_ptr);
+		}
+		sched_changed_cnt = 0;
+	}
+
+	for (i = 0; i < sched_heap_cnt; i++)
+		rec_cnt += sched_heap[i].rec_cnt;
+	return rec_cnt;
+}
+
+/* Remove and return the best record of the schedule() queue. Records of
+ * jobs no longer pending or changed since queued are discarded, records of
+ * jobs whose priority was recalculated are moved within their heap. */
+static job_queue_rec_t *_sched_queue_pop(void)
+{
+	sched_heap_t *heap, *best_heap = NULL;
+	job_queue_rec_t *rec;
+	struct job_record *job_ptr;
+	int i;
+
+	_sched_queue_sweep();
+	for (i = 0; i < sched_heap_cnt; i++) {
+		heap = &sched_heap[i];
+		while (heap->rec_cnt) {
+			rec = heap->rec[0];
+			job_ptr = find_job_record(rec->job_id);
+			if ((job_ptr != rec->job_ptr) ||
+			    (job_ptr->sched_seq != rec->seq) ||
+			    !IS_JOB_PENDING(job_ptr) ||
+			    (job_ptr->priority == 0)) {
+				_sched_heap_pop(heap);
+				xfree(rec);
+				continue;
+			}
+			if (!job_ptr->priority_array &&
+			    (rec->priority != job_ptr->priority)) {
+				_sched_heap_pop(heap);
+				rec->priority = job_ptr->priority;
+				_sched_heap_push(heap, rec);
+				continue;
+			}
+			break;
+		}
+		if (heap->rec_cnt &&
+		    (!best_heap ||
+		     (sort_job_queue2(&heap->rec[0], &best_heap->rec[0]) < 0)))
+			best_heap = heap;
+	}
+	if (!best_heap)
+		return NULL;
+	return _sched_heap_pop(best_heap);
+}
+
+/* Return records popped by schedule() to the queue if their jobs are still
+ * pending, for testing again on later passes */
+static void _sched_queue_restore(job_queue_rec_t **recs, uint32_t cnt)
+{
+	struct job_record *job_ptr;
+	sched_heap_t *heap;
+	uint32_t i;
+
+	_sched_queue_sweep();
+	for (i = 0; i < cnt; i++) {
+		job_ptr = find_job_record(recs[i]->job_id);
+		if ((job_ptr == recs[i]->job_ptr) &&
+		    (job_ptr->sched_seq == recs[i]->seq) &&
+		    IS_JOB_PENDING(job_ptr) &&
+		    (heap = _sched_heap_find(recs[i]->part_ptr))) {
+			_sched_heap_push(heap, recs[i]);
+		} else
+			xfree(recs[i]);
+	}
+}
+
+/*
+ * sched_queue_job_delete - note that a job record is being deleted, so that
+ *	schedule() drops any queued records of the job before it next
+ *	compares records
+ * NOTE: run lock_slurmctld before entry: write job
+ */
+extern void sched_queue_job_delete(void)
+{
+	if (sched_heap)
+		sched_job_deleted = true;
+}
+
+/*
+ * sched_queue_update - note that a job became pending or that its priority,
+ *	partitions, dependencies or other scheduling state changed, so that
+ *	schedule() retests the job rather than using its queued records.
+ *	Also notes the change with job_record_changed().
+ * NOTE: run lock_slurmctld before entry: write job
+ */
+extern void sched_queue_update(struct job_record *job_ptr)
+{
+	job_record_changed(job_ptr);
+	if (++sched_seq == 0)	/* zero is never assigned */
+		sched_seq = 1;
+	job_ptr->sched_seq = sched_seq;
+	if (sched_heap == NULL)	/* queue rebuilt on next pass anyway */
+		return;
+	if (sched_changed_cnt >= MAX(list_count(job_list), 1024)) {
+		/* cheaper to rebuild the whole queue */
+		_sched_queue_clear();
+		return;
+	}
+	_sched_job_ref_add(&sched_changed, &sched_changed_cnt,
+			   &sched_changed_size, job_ptr);
+}
+
+/* sched_queue_fini - free memory of the queue maintained by schedule() */
+extern void sched_queue_fini(void)
+{
+	_sched_queue_clear();
+}
+
+/* Add a job record to job_queue, or to the schedule() queue if NULL */
 static void _job_queue_append(List job_queue, struct job_record *job_ptr,
 			      struct part_record *part_ptr, uint32_t prio)
 {
 	job_queue_rec_t *job_queue_rec;
+	sched_heap_t *heap = NULL;
+
+	if (!job_queue && !(heap = _sched_heap_find(part_ptr))) {
+		sched_queue_time = 0;	/* partition added, rebuild queue */
+		return;
+	}
 
 	job_queue_rec = xmalloc(sizeof(job_queue_rec_t));
 	job_queue_rec->job_id   = job_ptr->job_id;
 	job_queue_rec->job_ptr  = job_ptr;
 	job_queue_rec->part_ptr = part_ptr;
 	job_queue_rec->priority = prio;
-	list_append(job_queue, job_queue_rec);
+	job_queue_rec->seq      = job_ptr->sched_seq;
+	if (job_queue)
+		list_append(job_queue, job_queue_rec);
+	else
+		_sched_heap_push(heap, job_queue_rec);
 }
 
 static void _job_queue_rec_del(void *x)
@@ -226,6 +619,76 @@ static bool _job_runnable_test2(struct job_record *job_ptr, bool check_min_time)
 	return true;
 }
 
+/*
+ * Add records for each partition a pending job can run in now
+ * IN job_queue - list to add records to, NULL for the schedule() queue
+ * IN job_ptr - job to test
+ * IN clear_start - if set then clear the start_time for pending jobs
+ * IN backfill - true if running backfill scheduler, enforce min time limit
+ * RET count of records added
+ */
+static int _job_queue_build_job(List job_queue, struct job_record *job_ptr,
+				bool clear_start, bool backfill)
+{
+	ListIterator part_iterator;
+	struct part_record *part_ptr;
+	int reason, rec_cnt = 0;
+
+	if (!_job_runnable_test1(job_ptr, clear_start))
+		return 0;
+
+	if (job_ptr->part_ptr_list) {
+		int inx = -1;
+		part_iterator = list_iterator_create(job_ptr->part_ptr_list);
+		while ((part_ptr = (struct part_record *)
+			list_next(part_iterator))) {
+			job_ptr->part_ptr = part_ptr;
+			reason = job_limits_check(&job_ptr, backfill);
+			if ((reason != WAIT_NO_REASON) &&
+			    (reason != job_ptr->state_reason) &&
+			    (!part_policy_job_runnable_state(job_ptr))){
+				job_ptr->state_reason = reason;
+				xfree(job_ptr->state_desc);
+			}
+			/* priority_array index matches part_ptr_list
+			 * position: increment inx*/
+			inx++;
+			if (reason != WAIT_NO_REASON)
+				continue;
+			if (job_ptr->priority_array) {
+				_job_queue_append(job_queue, job_ptr, part_ptr,
+						  job_ptr->priority_array[inx]);
+			} else {
+				_job_queue_append(job_queue, job_ptr, part_ptr,
+						  job_ptr->priority);
+			}
+			rec_cnt++;
+		}
+		list_iterator_destroy(part_iterator);
+	} else {
+		if (job_ptr->part_ptr == NULL) {
+			part_ptr = find_part_record(job_ptr->partition);
+			if (part_ptr == NULL) {
+				error("Could not find partition %s "
+				      "for job %u", job_ptr->partition,
+				      job_ptr->job_id);
+				return 0;
+			}
+			job_ptr->part_ptr = part_ptr;
+			error("partition pointer reset for job %u, "
+			      "part %s", job_ptr->job_id,
+			      job_ptr->partition);
+		}
+		if (!_job_runnable_test2(job_ptr, backfill))
+			return 0;
+		_job_queue_append(job_queue, job_ptr,
+				  job_ptr->part_ptr, job_ptr->priority);
+		rec_cnt++;
+	}
+
+	return rec_cnt;
+}
+
 /*
  * build_job_queue - build (non-priority ordered) list of pending jobs
  * IN clear_start - if set then clear the start_time for pending jobs
@@ -236,67 +699,14 @@ static bool _job_runnable_test2(struct job_record *job_ptr, bool check_min_time)
 extern List build_job_queue(bool clear_start, bool backfill)
 {
 	List job_queue;
-	ListIterator job_iterator, part_iterator;
+	ListIterator job_iterator;
 	struct job_record *job_ptr = NULL;
-	struct part_record *part_ptr;
-	int reason;
 
 	job_queue = list_create(_job_queue_rec_del);
 	job_iterator = list_iterator_create(job_list);
 	while ((job_ptr = (struct job_record *) list_next(job_iterator))) {
-		if (!_job_runnable_test1(job_ptr, clear_start))
-			continue;
-
-		if (job_ptr->part_ptr_list) {
-			int inx = -1;
-			part_iterator = list_iterator_create(
-				job_ptr->part_ptr_list);
-			while ((part_ptr = (struct part_record *)
-				list_next(part_iterator))) {
-				job_ptr->part_ptr = part_ptr;
-				reason = job_limits_check(&job_ptr, backfill);
-				if ((reason != WAIT_NO_REASON) &&
-				    (reason != job_ptr->state_reason) &&
-				    (!part_policy_job_runnable_state(job_ptr))){
-					job_ptr->state_reason = reason;
-					xfree(job_ptr->state_desc);
-				}
-				/* priority_array index matches part_ptr_list
-				 * position: increment inx*/
-				inx++;
-				if (reason != WAIT_NO_REASON)
-					continue;
-				if (job_ptr->priority_array) {
-					_job_queue_append(job_queue, job_ptr,
-							  part_ptr,
-							  job_ptr->
-							  priority_array[inx]);
-				} else {
-					_job_queue_append(job_queue, job_ptr,
-							  part_ptr,
-							  job_ptr->priority);
-				}
-			}
-			list_iterator_destroy(part_iterator);
-		} else {
-			if (job_ptr->part_ptr == NULL) {
-				part_ptr = find_part_record(job_ptr->partition);
-				if (part_ptr == NULL) {
-					error("Could not find partition %s "
-					      "for job %u", job_ptr->partition,
-					      job_ptr->job_id);
-					continue;
-				}
-				job_ptr->part_ptr = part_ptr;
-				error("partition pointer reset for job %u, "
-				      "part %s", job_ptr->job_id,
-				      job_ptr->partition);
-			}
-			if (!_job_runnable_test2(job_ptr, backfill))
-				continue;
-			_job_queue_append(job_queue, job_ptr,
-					  job_ptr->part_ptr, job_ptr->priority);
-		}
+		(void) _job_queue_build_job(job_queue, job_ptr, clear_start,
+					    backfill);
 	}
 	list_iterator_destroy(job_iterator);
 
@@ -588,6 +998,7 @@ next_part:		part_ptr = (struct part_record *)
 			info("sched: JobId=%u has invalid account",
 			     job_ptr->job_id);
 			last_job_update = now;
+			job_record_changed(job_ptr);
 			job_ptr->state_reason = FAIL_ACCOUNT;
 			xfree(job_ptr->state_desc);
 			continue;
@@ -619,6 +1030,7 @@ next_part:		part_ptr = (struct part_record *)
 		job_ptr->details->exc_node_bitmap = orig_exc_bitmap;
 		if (error_code == SLURM_SUCCESS) {
 			last_job_update = now;
+			job_record_changed(job_ptr);
 			info("sched: Allocate JobId=%u NodeList=%s #CPUs=%u",
 			     job_ptr->job_id, job_ptr->nodes,
 			     job_ptr->total_cpus);
@@ -682,18 +1094,19 @@ static bool _all_partition_priorities_same(void)
  *		  queue on every job submit (0 means to use the system default,
  *		  SchedulerParameters for default_queue_depth)
  * RET count of jobs scheduled
- * Note: We re-build the queue every time. Jobs can not only be added
- *	or removed from the queue, but have their priority or partition
- *	changed with the update_job RPC. In general nodes will be in priority
- *	order (by submit time), so the sorting should be pretty fast.
+ * Note: Runnable pending jobs are kept in a priority queue for each
+ *	partition between calls. Jobs are only retested when reported by
+ *	sched_queue_update() (submit, update, hold, release or requeue), when
+ *	they could not run on the previous pass (e.g. dependencies or begin
+ *	time) or when the queue is rebuilt after partition or configuration
+ *	changes and at least every SCHED_QUEUE_REBUILD_TIME seconds.
  */
 extern int schedule(uint32_t job_limit)
 {
 	ListIterator job_iterator = NULL, part_iterator = NULL;
-	List job_queue = NULL;
 	int error_code, failed_part_cnt = 0, job_cnt = 0, i;
-	uint32_t job_depth = 0;
-	job_queue_rec_t *job_queue_rec;
+	uint32_t job_depth = 0, tested_cnt = 0, tested_size = 0;
+	job_queue_rec_t *job_queue_rec, **tested_recs = NULL;
 	struct job_record *job_ptr = NULL;
 	struct part_record *part_ptr, **failed_parts = NULL;
 	bitstr_t *save_avail_node_bitmap;
@@ -811,17 +1224,19 @@ extern int schedule(uint32_t job_limit)
 	 * If we are doing FIFO scheduling, use the job records right off the
 	 * job list.
 	 *
-	 * If a job is submitted to multiple partitions then build_job_queue()
-	 * will return a separate record for each job:partition pair.
+	 * If a job is submitted to multiple partitions then the queue
+	 * has a separate record for each job:partition pair.
 	 *
 	 * In both cases, we test each partition associated with the job.
 	 */
 	if (fifo_sched) {
+		if (sched_heap)		/* queue not maintained in FIFO mode */
+			_sched_queue_clear();
 		slurmctld_diag_stats.schedule_queue_len = list_count(job_list);
 		job_iterator = list_iterator_create(job_list);
 	} else {
-		job_queue = build_job_queue(false, false);
-		slurmctld_diag_stats.schedule_queue_len = list_count(job_queue);
+		slurmctld_diag_stats.schedule_queue_len =
+			_sched_queue_refresh(now);
 	}
 	while (1) {
 		if (fifo_sched) {
@@ -857,13 +1272,19 @@ next_part:			part_ptr = (struct part_record *)
 					continue;
 			}
 		} else {
-			job_queue_rec = list_pop_bottom(job_queue,
-			                                sort_job_queue2);
+			job_queue_rec = _sched_queue_pop();
 			if (!job_queue_rec)
 				break;
+			/* returned to the queue after this pass if the job
+			 * is still pending */
+			if (tested_cnt >= tested_size) {
+				tested_size = MAX(tested_size * 2, 64);
+				xrealloc(tested_recs, sizeof(job_queue_rec_t *)
+					 * tested_size);
+			}
+			tested_recs[tested_cnt++] = job_queue_rec;
 			job_ptr  = job_queue_rec->job_ptr;
 			part_ptr = job_queue_rec->part_ptr;
-			xfree(job_queue_rec);
 			if (!avail_front_end(job_ptr)) {
 				job_ptr->state_reason = WAIT_FRONT_END;
 				continue;
@@ -986,6 +1407,7 @@ next_part:			part_ptr = (struct part_record *)
 			info("sched: JobId=%u has invalid account",
 			     job_ptr->job_id);
 			last_job_update = time(NULL);
+			job_record_changed(job_ptr);
 			job_ptr->state_reason = FAIL_ACCOUNT;
 			xfree(job_ptr->state_desc);
 			continue;
@@ -1049,6 +1471,7 @@ next_part:			part_ptr = (struct part_record *)
 			/* job initiated */
 			debug3("sched: JobId=%u initiated", job_ptr->job_id);
 			last_job_update = now;
+			job_record_changed(job_ptr);
 #ifdef HAVE_BG
 			select_g_select_jobinfo_get(job_ptr->select_jobinfo,
 						    SELECT_JOBDATA_IONODES,
@@ -1087,6 +1510,7 @@ next_part:			part_ptr = (struct part_record *)
 			     job_ptr->job_id, slurm_strerror(error_code));
 			if (!wiki_sched) {
 				last_job_update = now;
+				job_record_changed(job_ptr);
 				job_ptr->job_state = JOB_FAILED;
 				job_ptr->exit_code = 1;
 				job_ptr->state_reason = FAIL_BAD_CONSTRAINTS;
@@ -1108,7 +1532,8 @@ next_part:			part_ptr = (struct part_record *)
 		if (part_iterator)
 			list_iterator_destroy(part_iterator);
 	} else {
-		FREE_NULL_LIST(job_queue);
+		_sched_queue_restore(tested_recs, tested_cnt);
+		xfree(tested_recs);
 	}
 	unlock_slurmctld(job_write_lock);
 	END_TIMER2("schedule");
@@ -1158,19 +1583,11 @@ extern int sort_job_queue2(void *x, void *y)
 	if (!has_resv1 && has_resv2)
 		return 1;
 
-	if (job_rec1->job_ptr->part_ptr_list &&
-	    job_rec1->job_ptr->priority_array)
-		p1 = job_rec1->priority;
-	else
-		p1 = job_rec1->job_ptr->priority;
-
-
-	if (job_rec2->job_ptr->part_ptr_list &&
-	    job_rec2->job_ptr->priority_array)
-		p2 = job_rec2->priority;
-	else
-		p2 = job_rec2->job_ptr->priority;
-
+	/* Use the priority recorded with the queue record rather than the
+	 * job's current priority, so the order of a queue kept between
+	 * passes of schedule() stays consistent */
+	p1 = job_rec1->priority;
+	p2 = job_rec2->priority;
 
 	if (p1 < p2)
 		return 1;
@@ -1441,6 +1858,186 @@ static void _rm_dependency(struct job_record *job_ptr,
 	xfree(rmv_dep);
 }
 
+static depend_rev_t *_depend_rev_find(uint32_t job_id)
+{
+	depend_rev_t *rev_ptr;
+
+	if (depend_rev_hash == NULL)
+		return NULL;
+	rev_ptr = depend_rev_hash[job_id % depend_rev_size];
+	while (rev_ptr && (rev_ptr->job_id != job_id))
+		rev_ptr = rev_ptr->next;
+	return rev_ptr;
+}
+
+/* Double the reverse dependency graph's bucket count */
+static void _depend_rev_grow(void)
+{
+	depend_rev_t **old_hash = depend_rev_hash, *rev_ptr, *next_ptr;
+	uint32_t i, inx, old_size = depend_rev_size;
+
+	depend_rev_size = MAX(old_size * 2, 1024);
+	depend_rev_hash = xmalloc(sizeof(depend_rev_t *) * depend_rev_size);
+	for (i = 0; i < old_size; i++) {
+		for (rev_ptr = old_hash[i]; rev_ptr; rev_ptr = next_ptr) {
+			next_ptr = rev_ptr->next;
+			inx = rev_ptr->job_id % depend_rev_size;
+			rev_ptr->next = depend_rev_hash[inx];
+			depend_rev_hash[inx] = rev_ptr;
+		}
+	}
+	xfree(old_hash);
+}
+
+/* Record that job dep_id depends upon job (or job array) job_id */
+static void _depend_rev_add(uint32_t job_id, uint32_t dep_id)
+{
+	depend_rev_t *rev_ptr;
+	uint32_t i, inx;
+
+	if (!(rev_ptr = _depend_rev_find(job_id))) {
+		if (depend_rev_cnt >= depend_rev_size)
+			_depend_rev_grow();
+		rev_ptr = xmalloc(sizeof(depend_rev_t));
+		rev_ptr->job_id = job_id;
+		inx = job_id % depend_rev_size;
+		rev_ptr->next = depend_rev_hash[inx];
+		depend_rev_hash[inx] = rev_ptr;
+		depend_rev_cnt++;
+	} else {
+		/* Search newest edges first, a dependency is most often
+		 * updated soon after it was set */
+		for (i = rev_ptr->dep_cnt; i > 0; i--) {
+			if (rev_ptr->dep_id[i - 1] == dep_id)
+				return;	/* edge already present */
+		}
+	}
+	if (rev_ptr->dep_cnt >= rev_ptr->dep_size) {
+		rev_ptr->dep_size = MAX(rev_ptr->dep_size * 2, 8);
+		xrealloc(rev_ptr->dep_id, sizeof(uint32_t) * rev_ptr->dep_size);
+	}
+	rev_ptr->dep_id[rev_ptr->dep_cnt++] = dep_id;
+}
+
+static void _depend_rev_del(uint32_t job_id)
+{
+	depend_rev_t **rev_pptr, *rev_ptr;
+
+	if (depend_rev_hash == NULL)
+		return;
+	rev_pptr = &depend_rev_hash[job_id % depend_rev_size];
+	while ((rev_ptr = *rev_pptr)) {
+		if (rev_ptr->job_id == job_id) {
+			*rev_pptr = rev_ptr->next;
+			xfree(rev_ptr->dep_id);
+			xfree(rev_ptr);
+			depend_rev_cnt--;
+			return;
+		}
+		rev_pptr = &rev_ptr->next;
+	}
+}
+
+/* Return true if pending job dep_job_ptr still depends upon job_id. If
+ * purge_job_ptr is set, clear that job's pointers from the dependencies. */
+static bool _depends_upon(struct job_record *dep_job_ptr, uint32_t job_id,
+			  struct job_record *purge_job_ptr)
+{
+	ListIterator iter;
+	struct depend_spec *dep_ptr;
+	bool rc = false;
+
+	if (!IS_JOB_PENDING(dep_job_ptr) || !dep_job_ptr->details ||
+	    !dep_job_ptr->details->depend_list)
+		return false;
+	iter = list_iterator_create(dep_job_ptr->details->depend_list);
+	while ((dep_ptr = (struct depend_spec *) list_next(iter))) {
+		if (dep_ptr->job_id != job_id)
+			continue;
+		rc = true;
+		if (purge_job_ptr && (dep_ptr->job_ptr == purge_job_ptr))
+			dep_ptr->job_ptr = NULL;
+	}
+	list_iterator_destroy(iter);
+	return rc;
+}
+
+/* Have schedule() retest pending jobs which depend upon job_id */
+static void _depend_notify(uint32_t job_id, struct job_record *purge_job_ptr)
+{
+	depend_rev_t *rev_ptr;
+	struct job_record *dep_job_ptr;
+	uint32_t i;
+
+	if (!(rev_ptr = _depend_rev_find(job_id)))
+		return;
+	for (i = 0; i < rev_ptr->dep_cnt; i++) {
+		dep_job_ptr = find_job_record(rev_ptr->dep_id[i]);
+		if (dep_job_ptr &&
+		    _depends_upon(dep_job_ptr, job_id, purge_job_ptr))
+			sched_queue_update(dep_job_ptr);
+	}
+}
+
+/*
+ * depend_job_state_change - report that a job started, finished or was
+ *	requeued, so that jobs depending upon it (or upon all tasks of its job
+ *	array) are retested by schedule()
+ * NOTE: run lock_slurmctld before entry: write job
+ */
+extern void depend_job_state_change(struct job_record *job_ptr)
+{
+	_depend_notify(job_ptr->job_id, NULL);
+	if ((job_ptr->array_task_id != NO_VAL) &&
+	    (job_ptr->array_job_id != job_ptr->job_id))
+		_depend_notify(job_ptr->array_job_id, NULL);
+}
+
+/*
+ * depend_job_purge - remove a job about to be purged from the reverse
+ *	dependency graph, lifting dependencies upon it
+ * NOTE: run lock_slurmctld before entry: write job
+ */
+extern void depend_job_purge(struct job_record *job_ptr)
+{
+	struct job_record *array_job_ptr;
+
+	if (depend_rev_cnt == 0)
+		return;
+	_depend_notify(job_ptr->job_id, job_ptr);
+	if (job_ptr->array_task_id != NO_VAL)
+		_depend_notify(job_ptr->array_job_id, job_ptr);
+
+	/* Keep a job array's entry until its last task is purged */
+	if (job_ptr->array_task_id == NO_VAL) {
+		_depend_rev_del(job_ptr->job_id);
+		return;
+	}
+	array_job_ptr = find_job_array_first(job_ptr->array_job_id);
+	if (!array_job_ptr ||
+	    ((array_job_ptr == job_ptr) && (job_ptr->array_next == job_ptr)))
+		_depend_rev_del(job_ptr->array_job_id);
+	if (job_ptr->job_id != job_ptr->array_job_id)
+		_depend_rev_del(job_ptr->job_id);
+}
+
+/* depend_graph_fini - free the reverse dependency graph */
+extern void depend_graph_fini(void)
+{
+	depend_rev_t *rev_ptr, *next_ptr;
+	uint32_t i;
+
+	for (i = 0; i < depend_rev_size; i++) {
+		for (rev_ptr = depend_rev_hash[i]; rev_ptr; rev_ptr = next_ptr) {
+			next_ptr = rev_ptr->next;
+			xfree(rev_ptr->dep_id);
+			xfree(rev_ptr);
+		}
+	}
+	xfree(depend_rev_hash);
+	depend_rev_size = depend_rev_cnt = 0;
+}
+
 /*
  * Determine if a job's dependencies are met
  * RET: 0 = no dependencies
@@ -1775,12 +2372,19 @@ extern int update_job_dependency(struct job_record *job_ptr, char *new_depend)
 
 	if (rc == SLURM_SUCCESS) {
 		/* test for circular dependencies (e.g. A -> B -> A) */
-		(void) _scan_depend(NULL, job_ptr->job_id);
-		if (_scan_depend(new_depend_list, job_ptr->job_id))
+		if (_depend_cycle(job_ptr, new_depend_list))
 			rc = ESLURM_CIRCULAR_DEPENDENCY;
 	}
 
 	if (rc == SLURM_SUCCESS) {
+		ListIterator iter = list_iterator_create(new_depend_list);
+		while ((dep_ptr = (struct depend_spec *) list_next(iter))) {
+			if (dep_ptr->job_id)	/* not singleton */
+				_depend_rev_add(dep_ptr->job_id,
+						job_ptr->job_id);
+		}
+		list_iterator_destroy(iter);
+
 		xfree(job_ptr->details->dependency);
 		job_ptr->details->dependency = xstrdup(new_depend);
 		if (job_ptr->details->depend_list)
@@ -1795,17 +2399,44 @@ extern int update_job_dependency(struct job_record *job_ptr, char *new_depend)
 	return rc;
 }
 
-/* Return TRUE if job_id is found in dependency_list.
- * Pass NULL dependency list to clear the counter.
- * Execute recursively for each dependent job */
-static bool _scan_depend(List dependency_list, uint32_t job_id)
+/* Return true if job dep_job_ptr is, or is a task of, a job (or job array)
+ * in new_depend_list */
+static bool _depend_listed(List new_depend_list,
+			   struct job_record *dep_job_ptr)
+{
+	ListIterator iter;
+	struct depend_spec *dep_ptr;
+	bool rc = false;
+
+	iter = list_iterator_create(new_depend_list);
+	while ((dep_ptr = (struct depend_spec *) list_next(iter))) {
+		if (dep_ptr->job_id == 0)	/* Singleton */
+			continue;
+		if ((dep_ptr->job_id == dep_job_ptr->job_id) ||
+		    ((dep_job_ptr->array_task_id != NO_VAL) &&
+		     (dep_ptr->job_id == dep_job_ptr->array_job_id))) {
+			rc = true;
+			break;
+		}
+	}
+	list_iterator_destroy(iter);
+	return rc;
+}
+
+/* Return true if giving job_ptr the dependencies in new_depend_list would
+ * create a circular dependency (e.g. A -> B -> A). Rather than following
+ * each new dependency recursively, walk the reverse dependency graph from
+ * job_ptr: a newly submitted job has no dependents, so nothing is scanned
+ * at submit time. Stop after max_depend_depth jobs have been tested. */
+static bool _depend_cycle(struct job_record *job_ptr, List new_depend_list)
 {
 	static time_t sched_update = 0;
 	static int max_depend_depth = 10;
-	static int job_counter = 0;
+	uint32_t *queue, queue_cnt = 0, queue_size, i, inx;
+	depend_rev_t *rev_ptr;
+	struct job_record *dep_job_ptr;
+	int tested = 0;
 	bool rc = false;
-	ListIterator iter;
-	struct depend_spec *dep_ptr;
 
 	if (sched_update != slurmctld_conf.last_update) {
 		char *sched_params, *tmp_ptr;
@@ -1814,47 +2445,56 @@ static bool _scan_depend(List dependency_list, uint32_t job_id)
 		if (sched_params &&
 		    (tmp_ptr = strstr(sched_params, "max_depend_depth="))) {
 		/*                                   01234567890123456 */
-			int i = atoi(tmp_ptr + 17);
-			if (i < 0) {
+			int depth = atoi(tmp_ptr + 17);
+			if (depth < 0) {
 				error("ignoring SchedulerParameters: "
-				      "max_depend_depth value of %d", i);
+				      "max_depend_depth value of %d", depth);
 			} else {
-				      max_depend_depth = i;
+				max_depend_depth = depth;
 			}
 		}
 		xfree(sched_params);
 		sched_update = slurmctld_conf.last_update;
 	}
 
-	if (dependency_list == NULL) {
-		job_counter = 0;
-		return FALSE;
-	} else if (job_counter++ >= max_depend_depth) {
-		return FALSE;
-	}
+	/* IDs whose dependents remain to be tested */
+	queue_size = 16;
+	queue = xmalloc(sizeof(uint32_t) * queue_size);
+	queue[queue_cnt++] = job_ptr->job_id;
+	if ((job_ptr->array_task_id != NO_VAL) &&
+	    (job_ptr->array_job_id != job_ptr->job_id))
+		queue[queue_cnt++] = job_ptr->array_job_id;
 
-	xassert(job_id);
-	iter = list_iterator_create(dependency_list);
-	while (!rc && (dep_ptr = (struct depend_spec *) list_next(iter))) {
-		if (dep_ptr->job_id == 0)	/* Singleton */
+	for (inx = 0; !rc && (inx < queue_cnt); inx++) {
+		if (!(rev_ptr = _depend_rev_find(queue[inx])))
 			continue;
-		if (dep_ptr->job_id == job_id)
-			rc = true;
-		else if ((dep_ptr->job_id != dep_ptr->job_ptr->job_id) ||
-			 (dep_ptr->job_ptr->magic != JOB_MAGIC))
-			continue;	/* purged job, ptr not yet cleared */
-		else if (!IS_JOB_FINISHED(dep_ptr->job_ptr) &&
-			 dep_ptr->job_ptr->details &&
-			 dep_ptr->job_ptr->details->depend_list) {
-			rc = _scan_depend(dep_ptr->job_ptr->details->
-					  depend_list, job_id);
-			if (rc) {
+		for (i = 0; i < rev_ptr->dep_cnt; i++) {
+			if (tested++ >= max_depend_depth)
+				goto fini;
+			dep_job_ptr = find_job_record(rev_ptr->dep_id[i]);
+			if (!dep_job_ptr ||
+			    !_depends_upon(dep_job_ptr, queue[inx], NULL))
+				continue;
+			if ((dep_job_ptr == job_ptr) ||
+			    _depend_listed(new_depend_list, dep_job_ptr)) {
 				info("circular dependency: job %u is dependent "
-				     "upon job %u", dep_ptr->job_id, job_id);
+				     "upon job %u", dep_job_ptr->job_id,
+				     job_ptr->job_id);
+				rc = true;
+				break;
+			}
+			if ((queue_cnt + 2) > queue_size) {
+				queue_size *= 2;
+				xrealloc(queue, sizeof(uint32_t) * queue_size);
 			}
+			queue[queue_cnt++] = dep_job_ptr->job_id;
+			if ((dep_job_ptr->array_task_id != NO_VAL) &&
+			    (dep_job_ptr->array_job_id != dep_job_ptr->job_id))
+				queue[queue_cnt++] = dep_job_ptr->array_job_id;
 		}
 	}
-	list_iterator_destroy(iter);
+
+fini:	xfree(queue);
 	return rc;
 }
 
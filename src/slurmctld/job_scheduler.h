@@ -49,6 +49,7 @@ typedef struct job_queue_rec {
 	struct job_record *job_ptr;
 	struct part_record *part_ptr;
 	uint32_t priority;
+	uint32_t seq;		/* job's sched_seq when record was made */
 } job_queue_rec_t;
 
 /*
@@ -144,13 +145,34 @@ extern bool replace_batch_job(slurm_msg_t * msg, void *fini_job);
  *		  queue on every job submit (0 means to use the system default,
  *		  SchedulerParameters for default_queue_depth)
  * RET count of jobs scheduled
- * Note: We re-build the queue every time. Jobs can not only be added
- *	or removed from the queue, but have their priority or partition
- *	changed with the update_job RPC. In general nodes will be in priority
- *	order (by submit time), so the sorting should be pretty fast.
+ * Note: Runnable pending jobs are kept in a priority queue for each
+ *	partition between calls. Jobs are only retested when reported by
+ *	sched_queue_update() (submit, update, hold, release or requeue), when
+ *	they could not run on the previous pass (e.g. dependencies or begin
+ *	time) or when the queue is rebuilt after partition or configuration
+ *	changes and at least every 60 seconds.
  */
 extern int schedule(uint32_t job_limit);
 
+/*
+ * sched_queue_job_delete - note that a job record is being deleted, so that
+ *	schedule() drops any queued records of the job before it next
+ *	compares records
+ * NOTE: run lock_slurmctld before entry: write job
+ */
+extern void sched_queue_job_delete(void);
+
+/*
+ * sched_queue_update - note that a job became pending or that its priority,
+ *	partitions, dependencies or other scheduling state changed, so that
+ *	schedule() retests the job rather than using its queued records
+ * NOTE: run lock_slurmctld before entry: write job
+ */
+extern void sched_queue_update(struct job_record *job_ptr);
+
+/* sched_queue_fini - free memory of the queue maintained by schedule() */
+extern void sched_queue_fini(void);
+
 /*
  * set_job_elig_time - set the eligible time for pending jobs once their
  *	dependencies are lifted (in job->details->begin_time)
@@ -167,6 +189,26 @@ extern void sort_job_queue(List job_queue);
  *	in order of decreasing priority */
 extern int sort_job_queue2(void *x, void *y);
 
+/*
+ * depend_graph_fini - free the reverse job dependency graph
+ */
+extern void depend_graph_fini(void);
+
+/*
+ * depend_job_purge - remove a job about to be purged from the reverse
+ *	dependency graph, lifting dependencies upon it
+ * NOTE: run lock_slurmctld before entry: write job
+ */
+extern void depend_job_purge(struct job_record *job_ptr);
+
+/*
+ * depend_job_state_change - report that a job started, finished or was
+ *	requeued, so that jobs depending upon it (or upon all tasks of its job
+ *	array) are retested by schedule()
+ * NOTE: run lock_slurmctld before entry: write job
+ */
+extern void depend_job_state_change(struct job_record *job_ptr);
+
 /*
  * Determine if a job's dependencies are met
  * RET: 0 = no dependencies
@@ -47,18 +47,29 @@
 
 #include <errno.h>
 #include <string.h>
+#include <sys/time.h>
 #include <sys/types.h>
 
 #include "src/slurmctld/locks.h"
 #include "src/slurmctld/slurmctld.h"
 
-static pthread_mutex_t locks_mutex = PTHREAD_MUTEX_INITIALIZER;
-static pthread_cond_t locks_cond = PTHREAD_COND_INITIALIZER;
+/* Each data type has its own mutex and condition variable so that releasing
+ * one lock only wakes threads waiting on that same data type */
+static pthread_mutex_t locks_mutex[ENTITY_COUNT] = {
+	PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER,
+	PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER };
+static pthread_cond_t locks_cond[ENTITY_COUNT] = {
+	PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER,
+	PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER };
 static pthread_mutex_t state_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 static slurmctld_lock_flags_t slurmctld_locks;
+static slurmctld_lock_stats_t slurmctld_lock_stats;
 static int kill_thread = 0;
 
+static void _lock_wait_record(int stat_inx, struct timeval *wait_start);
+
+static bool _write_wait(lock_datatype_t datatype);
 static bool _wr_rdlock(lock_datatype_t datatype, bool wait_lock);
 static void _wr_rdunlock(lock_datatype_t datatype);
 static bool _wr_wrlock(lock_datatype_t datatype, bool wait_lock);
@@ -70,6 +81,27 @@ void init_locks(void)
 {
 	/* just clear all semaphores */
 	memset((void *) &slurmctld_locks, 0, sizeof(slurmctld_locks));
+	reset_lock_stats();
+}
+
+/* Record time spent waiting for a lock, called with the data type's mutex
+ * held. wait_start is zero if the lock was granted without waiting. */
+static void _lock_wait_record(int stat_inx, struct timeval *wait_start)
+{
+	struct timeval now;
+	uint32_t delta_t;
+
+	if (wait_start->tv_sec == 0)
+		return;
+
+	gettimeofday(&now, NULL);
+	delta_t  = (now.tv_sec  - wait_start->tv_sec) * 1000000;
+	delta_t +=  now.tv_usec - wait_start->tv_usec;
+
+	slurmctld_lock_stats.wait_cnt[stat_inx]++;
+	slurmctld_lock_stats.wait_time[stat_inx] += delta_t;
+	if (slurmctld_lock_stats.wait_max[stat_inx] < delta_t)
+		slurmctld_lock_stats.wait_max[stat_inx] = delta_t;
 }
 
 /* lock_slurmctld - Issue the required lock requests in a well defined order */
@@ -196,8 +228,9 @@ extern void unlock_slurmctld(slurmctld_lock_t lock_levels)
 static bool _wr_rdlock(lock_datatype_t datatype, bool wait_lock)
 {
 	bool success = true;
+	struct timeval wait_start = {0, 0};
 
-	slurm_mutex_lock(&locks_mutex);
+	slurm_mutex_lock(&locks_mutex[datatype]);
 	while (1) {
 #if 1
 		if ((slurmctld_locks.entity[write_lock(datatype)] == 0) &&
@@ -210,35 +243,40 @@ static bool _wr_rdlock(lock_datatype_t datatype, bool wait_lock)
 #endif
 			slurmctld_locks.entity[read_lock(datatype)]++;
 			slurmctld_locks.entity[write_cnt_lock(datatype)] = 0;
+			_lock_wait_record(read_stat(datatype), &wait_start);
 			break;
 		} else if (!wait_lock) {
 			success = false;
 			break;
 		} else {	/* wait for state change and retry */
-			pthread_cond_wait(&locks_cond, &locks_mutex);
+			if (wait_start.tv_sec == 0)
+				gettimeofday(&wait_start, NULL);
+			pthread_cond_wait(&locks_cond[datatype],
+					  &locks_mutex[datatype]);
 			if (kill_thread)
 				pthread_exit(NULL);
 		}
 	}
-	slurm_mutex_unlock(&locks_mutex);
+	slurm_mutex_unlock(&locks_mutex[datatype]);
 	return success;
 }
 
 /* _wr_rdunlock - Issue a read unlock on the specified data type */
 static void _wr_rdunlock(lock_datatype_t datatype)
 {
-	slurm_mutex_lock(&locks_mutex);
+	slurm_mutex_lock(&locks_mutex[datatype]);
 	slurmctld_locks.entity[read_lock(datatype)]--;
-	pthread_cond_broadcast(&locks_cond);
-	slurm_mutex_unlock(&locks_mutex);
+	pthread_cond_broadcast(&locks_cond[datatype]);
+	slurm_mutex_unlock(&locks_mutex[datatype]);
 }
 
 /* _wr_wrlock - Issue a write lock on the specified data type */
 static bool _wr_wrlock(lock_datatype_t datatype, bool wait_lock)
 {
 	bool success = true;
+	struct timeval wait_start = {0, 0};
 
-	slurm_mutex_lock(&locks_mutex);
+	slurm_mutex_lock(&locks_mutex[datatype]);
 	slurmctld_locks.entity[write_wait_lock(datatype)]++;
 
 	while (1) {
@@ -247,44 +285,129 @@ static bool _wr_wrlock(lock_datatype_t datatype, bool wait_lock)
 			slurmctld_locks.entity[write_lock(datatype)]++;
 			slurmctld_locks.entity[write_wait_lock(datatype)]--;
 			slurmctld_locks.entity[write_cnt_lock(datatype)]++;
+			_lock_wait_record(write_stat(datatype), &wait_start);
 			break;
 		} else if (!wait_lock) {
 			slurmctld_locks.entity[write_wait_lock(datatype)]--;
 			success = false;
 			break;
 		} else {	/* wait for state change and retry */
-			pthread_cond_wait(&locks_cond, &locks_mutex);
+			if (wait_start.tv_sec == 0)
+				gettimeofday(&wait_start, NULL);
+			pthread_cond_wait(&locks_cond[datatype],
+					  &locks_mutex[datatype]);
 			if (kill_thread)
 				pthread_exit(NULL);
 		}
 	}
-	slurm_mutex_unlock(&locks_mutex);
+	slurm_mutex_unlock(&locks_mutex[datatype]);
 	return success;
 }
 
 /* _wr_wrunlock - Issue a write unlock on the specified data type */
 static void _wr_wrunlock(lock_datatype_t datatype)
 {
-	slurm_mutex_lock(&locks_mutex);
+	slurm_mutex_lock(&locks_mutex[datatype]);
 	slurmctld_locks.entity[write_lock(datatype)]--;
-	pthread_cond_broadcast(&locks_cond);
-	slurm_mutex_unlock(&locks_mutex);
+	pthread_cond_broadcast(&locks_cond[datatype]);
+	slurm_mutex_unlock(&locks_mutex[datatype]);
+}
+
+/* yield_slurmctld - If another thread is waiting for a write lock on data
+ *	locked by the caller, release the caller's locks and reacquire them
+ *	after the writer is done */
+extern int yield_slurmctld(slurmctld_lock_t lock_levels)
+{
+	if (((lock_levels.config    == NO_LOCK) || !_write_wait(CONFIG_LOCK)) &&
+	    ((lock_levels.job       == NO_LOCK) || !_write_wait(JOB_LOCK))    &&
+	    ((lock_levels.node      == NO_LOCK) || !_write_wait(NODE_LOCK))   &&
+	    ((lock_levels.partition == NO_LOCK) || !_write_wait(PART_LOCK)))
+		return 0;
+
+	/* Pending write locks are granted before new read locks, so the
+	 * writer runs before the locks are reacquired here */
+	unlock_slurmctld(lock_levels);
+	lock_slurmctld(lock_levels);
+	return 1;
+}
+
+/* Return true if any thread is waiting for a write lock on datatype */
+static bool _write_wait(lock_datatype_t datatype)
+{
+	bool waiting;
+
+	slurm_mutex_lock(&locks_mutex[datatype]);
+	waiting = (slurmctld_locks.entity[write_wait_lock(datatype)] > 0);
+	slurm_mutex_unlock(&locks_mutex[datatype]);
+	return waiting;
 }
 
 /* get_lock_values - Get the current value of all locks
  * OUT lock_flags - a copy of the current lock values */
 void get_lock_values(slurmctld_lock_flags_t * lock_flags)
 {
+	int i;
+
 	xassert(lock_flags);
-	memcpy((void *) lock_flags, (void *) &slurmctld_locks,
-	       sizeof(slurmctld_locks));
+	for (i = 0; i < ENTITY_COUNT; i++) {
+		slurm_mutex_lock(&locks_mutex[i]);
+		memcpy((void *) &lock_flags->entity[read_lock(i)],
+		       (void *) &slurmctld_locks.entity[read_lock(i)],
+		       sizeof(int) * 4);
+		slurm_mutex_unlock(&locks_mutex[i]);
+	}
+}
+
+/* get_lock_stats - Get a copy of the lock wait statistics
+ * OUT lock_stats - time spent waiting for each lock type */
+extern void get_lock_stats(slurmctld_lock_stats_t *lock_stats)
+{
+	int i;
+
+	xassert(lock_stats);
+	for (i = 0; i < ENTITY_COUNT; i++) {
+		slurm_mutex_lock(&locks_mutex[i]);
+		lock_stats->wait_cnt[read_stat(i)] =
+			slurmctld_lock_stats.wait_cnt[read_stat(i)];
+		lock_stats->wait_cnt[write_stat(i)] =
+			slurmctld_lock_stats.wait_cnt[write_stat(i)];
+		lock_stats->wait_time[read_stat(i)] =
+			slurmctld_lock_stats.wait_time[read_stat(i)];
+		lock_stats->wait_time[write_stat(i)] =
+			slurmctld_lock_stats.wait_time[write_stat(i)];
+		lock_stats->wait_max[read_stat(i)] =
+			slurmctld_lock_stats.wait_max[read_stat(i)];
+		lock_stats->wait_max[write_stat(i)] =
+			slurmctld_lock_stats.wait_max[write_stat(i)];
+		slurm_mutex_unlock(&locks_mutex[i]);
+	}
+}
+
+/* reset_lock_stats - Clear the lock wait statistics */
+extern void reset_lock_stats(void)
+{
+	int i;
+
+	for (i = 0; i < ENTITY_COUNT; i++) {
+		slurm_mutex_lock(&locks_mutex[i]);
+		slurmctld_lock_stats.wait_cnt[read_stat(i)]   = 0;
+		slurmctld_lock_stats.wait_cnt[write_stat(i)]  = 0;
+		slurmctld_lock_stats.wait_time[read_stat(i)]  = 0;
+		slurmctld_lock_stats.wait_time[write_stat(i)] = 0;
+		slurmctld_lock_stats.wait_max[read_stat(i)]   = 0;
+		slurmctld_lock_stats.wait_max[write_stat(i)]  = 0;
+		slurm_mutex_unlock(&locks_mutex[i]);
+	}
 }
 
 /* kill_locked_threads - Kill all threads waiting on semaphores */
 extern void kill_locked_threads(void)
 {
+	int i;
+
 	kill_thread = 1;
-	pthread_cond_broadcast(&locks_cond);
+	for (i = 0; i < ENTITY_COUNT; i++)
+		pthread_cond_broadcast(&locks_cond[i]);
 }
 
 /* un/lock semaphore used for saving state of slurmctld */
@@ -87,6 +87,17 @@
 #ifndef _SLURMCTLD_LOCKS_H
 #define _SLURMCTLD_LOCKS_H
 
+#if HAVE_CONFIG_H
+#  include "config.h"
+#  if HAVE_INTTYPES_H
+#    include <inttypes.h>
+#  else
+#    if HAVE_STDINT_H
+#      include <stdint.h>
+#    endif
+#  endif			/* HAVE_INTTYPES_H */
+#endif
+
 /* levels of locking required for each data structure */
 typedef enum {
 	NO_LOCK,
@@ -128,11 +139,32 @@ typedef struct {
 	int entity[ENTITY_COUNT * 4];
 }	slurmctld_lock_flags_t;
 
+/* Lock wait statistics, in microseconds, indexed by data type and mode
+ *	(lock_datatype_t * 2 + 0) = read_stat		read lock requests
+ *	(lock_datatype_t * 2 + 1) = write_stat		write lock requests
+ * Only requests which could not be satisfied immediately are counted */
+#define LOCK_STAT_COUNT			(ENTITY_COUNT * 2)
+#define read_stat(data_type)		(data_type * 2 + 0)
+#define write_stat(data_type)		(data_type * 2 + 1)
+
+typedef struct {
+	uint32_t wait_cnt[LOCK_STAT_COUNT];	/* requests which waited */
+	uint64_t wait_time[LOCK_STAT_COUNT];	/* total time waiting */
+	uint32_t wait_max[LOCK_STAT_COUNT];	/* longest single wait */
+}	slurmctld_lock_stats_t;
+
 
 /* get_lock_values - Get the current value of all locks
  * OUT lock_flags - a copy of the current lock values */
 extern void get_lock_values (slurmctld_lock_flags_t *lock_flags);
 
+/* get_lock_stats - Get a copy of the lock wait statistics
+ * OUT lock_stats - time spent waiting for each lock type */
+extern void get_lock_stats (slurmctld_lock_stats_t *lock_stats);
+
+/* reset_lock_stats - Clear the lock wait statistics */
+extern void reset_lock_stats (void);
+
 /* init_locks - create locks used for slurmctld data structure access
  *	control */
 extern void init_locks ( void );
@@ -151,6 +183,15 @@ extern int try_lock_slurmctld (slurmctld_lock_t lock_levels);
  *	defined order */
 extern void unlock_slurmctld (slurmctld_lock_t lock_levels);
 
+/* yield_slurmctld - If another thread is waiting for a write lock on data
+ *	locked by the caller, release the caller's locks and reacquire them
+ *	after the writer is done. This lets long traversals of the job table
+ *	proceed without blocking writers for their full duration. Records may
+ *	be modified, added or deleted while the locks are released.
+ * IN lock_levels - the locks held by the caller
+ * RET 1 if the locks were released, 0 otherwise */
+extern int yield_slurmctld (slurmctld_lock_t lock_levels);
+
 /* un/lock semaphore used for saving state of slurmctld */
 inline extern void lock_state_files ( void );
 inline extern void unlock_state_files ( void );
@@ -465,6 +465,7 @@ extern void deallocate_nodes(struct job_record *job_ptr, bool timeout,
 
 	xassert(job_ptr);
 	xassert(job_ptr->details);
+	job_record_changed(job_ptr);
 
 	if (select_serial == -1) {
 		if (strcmp(slurmctld_conf.select_type, "select/serial"))
@@ -1639,6 +1640,7 @@ extern int select_nodes(struct job_record *job_ptr, bool test_only,
 			job_ptr->state_reason = WAIT_PART_NODE_LIMIT;
 			xfree(job_ptr->state_desc);
 			last_job_update = now;
+			job_record_changed(job_ptr);
 
 		/* Non-fatal errors for job below */
 		} else if (error_code == ESLURM_NODE_NOT_AVAIL) {
@@ -1648,6 +1650,7 @@ extern int select_nodes(struct job_record *job_ptr, bool test_only,
 			job_ptr->state_reason = WAIT_NODE_NOT_AVAIL;
 			xfree(job_ptr->state_desc);
 			last_job_update = now;
+			job_record_changed(job_ptr);
 		} else if (error_code == ESLURM_RESERVATION_NOT_USABLE) {
 			job_ptr->state_reason = WAIT_RESERVATION;
 			xfree(job_ptr->state_desc);
@@ -1727,6 +1730,8 @@ extern int select_nodes(struct job_record *job_ptr, bool test_only,
 	configuring = IS_JOB_CONFIGURING(job_ptr);
 
 	job_ptr->job_state = JOB_RUNNING;
+	job_record_changed(job_ptr);
+	depend_job_state_change(job_ptr);	/* "after" dependencies */
 	if (nonstop_ops.job_begin)
 		(nonstop_ops.job_begin)(job_ptr);
 
@@ -92,6 +92,33 @@
 
 #include "src/plugins/select/bluegene/bg_enums.h"
 
+/* Packed responses to job, node and partition information requests are
+ * cached for a short time so that many clients polling together (e.g. squeue
+ * or sinfo run from monitoring scripts) can be answered without repacking
+ * the data or waiting for slurmctld locks. An entry is only used for the same
+ * user, show_flags and protocol version and only if no configuration, job,
+ * node or partition change has been recorded since it was packed. */
+#define RPC_CACHE_SIZE	4	/* entries per message type */
+#define RPC_CACHE_AGE	1	/* seconds an entry remains usable */
+
+typedef struct {
+	char *dump;
+	int dump_size;
+	time_t pack_time;
+	time_t conf_update;
+	time_t job_update;
+	time_t node_update;
+	time_t part_update;
+	uint16_t protocol_version;
+	uint16_t show_flags;
+	uid_t uid;
+} rpc_cache_t;
+
+static pthread_mutex_t rpc_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static rpc_cache_t job_info_cache[RPC_CACHE_SIZE];
+static rpc_cache_t node_info_cache[RPC_CACHE_SIZE];
+static rpc_cache_t part_info_cache[RPC_CACHE_SIZE];
+
 static pthread_mutex_t throttle_mutex = PTHREAD_MUTEX_INITIALIZER;
 static pthread_cond_t throttle_cond = PTHREAD_COND_INITIALIZER;
 
@@ -102,6 +129,14 @@ static int 	    _launch_batch_step(job_desc_msg_t *job_desc_msg,
 				       uid_t uid, uint32_t *step_id);
 static int          _make_step_cred(struct step_record *step_rec,
 				    slurm_cred_t **slurm_cred);
+static bool         _rpc_cache_get(rpc_cache_t *cache, uid_t uid,
+				   uint16_t show_flags,
+				   uint16_t protocol_version,
+				   char **dump, int *dump_size);
+static void         _rpc_cache_set(rpc_cache_t *cache, uid_t uid,
+				   uint16_t show_flags,
+				   uint16_t protocol_version,
+				   char *dump, int dump_size);
 static void         _throttle_fini(int *active_rpc_cnt);
 static void         _throttle_start(int *active_rpc_cnt);
 
@@ -119,6 +154,7 @@ inline static void  _slurm_rpc_complete_prolog(slurm_msg_t * msg);
 inline static void  _slurm_rpc_dump_conf(slurm_msg_t * msg);
 inline static void  _slurm_rpc_dump_front_end(slurm_msg_t * msg);
 inline static void  _slurm_rpc_dump_jobs(slurm_msg_t * msg);
+inline static void  _slurm_rpc_dump_jobs_delta(slurm_msg_t * msg);
 inline static void  _slurm_rpc_dump_jobs_user(slurm_msg_t * msg);
 inline static void  _slurm_rpc_dump_job_single(slurm_msg_t * msg);
 inline static void  _slurm_rpc_dump_nodes(slurm_msg_t * msg);
@@ -207,6 +243,10 @@ void slurmctld_req (slurm_msg_t * msg)
 		_slurm_rpc_dump_jobs(msg);
 		slurm_free_job_info_request_msg(msg->data);
 		break;
+	case REQUEST_JOB_INFO_DELTA:
+		_slurm_rpc_dump_jobs_delta(msg);
+		slurm_free_job_info_delta_request_msg(msg->data);
+		break;
 	case REQUEST_JOB_USER_INFO:
 		_slurm_rpc_dump_jobs_user(msg);
 		slurm_free_job_user_id_msg(msg->data);
@@ -502,6 +542,113 @@ static void _throttle_fini(int *active_rpc_cnt)
 	slurm_mutex_unlock(&throttle_mutex);
 }
 
+/* Return true if a cache entry may be used at time "now". The update times
+ * are read without slurmctld locks; a change in progress is equivalent to
+ * the request having arrived just before it. */
+static bool _rpc_cache_valid(rpc_cache_t *cache_ptr, time_t now)
+{
+	if (!cache_ptr->dump ||
+	    ((cache_ptr->pack_time + RPC_CACHE_AGE) <= now) ||
+	    (cache_ptr->conf_update != slurmctld_conf.last_update) ||
+	    (cache_ptr->job_update  != last_job_update)  ||
+	    (cache_ptr->node_update != last_node_update) ||
+	    (cache_ptr->part_update != last_part_update))
+		return false;
+	return true;
+}
+
+/*
+ * _rpc_cache_get - Find a cached response for an information request
+ * IN cache - cache for the request's message type
+ * IN uid, show_flags, protocol_version - identify the request
+ * OUT dump, dump_size - copy of the cached response, xfree dump when done
+ * RET true if a usable response was found
+ */
+static bool _rpc_cache_get(rpc_cache_t *cache, uid_t uid,
+			   uint16_t show_flags, uint16_t protocol_version,
+			   char **dump, int *dump_size)
+{
+	bool found = false;
+	time_t now = time(NULL);
+	int i;
+
+	slurm_mutex_lock(&rpc_cache_mutex);
+	for (i = 0; i < RPC_CACHE_SIZE; i++) {
+		if ((cache[i].uid != uid) ||
+		    (cache[i].show_flags != show_flags) ||
+		    (cache[i].protocol_version != protocol_version) ||
+		    !_rpc_cache_valid(&cache[i], now))
+			continue;
+		*dump = xmalloc(cache[i].dump_size);
+		memcpy(*dump, cache[i].dump, cache[i].dump_size);
+		*dump_size = cache[i].dump_size;
+		found = true;
+		break;
+	}
+	slurm_mutex_unlock(&rpc_cache_mutex);
+
+	return found;
+}
+
+/*
+ * _rpc_cache_set - Save a copy of a packed response for reuse by
+ *	_rpc_cache_get(). Call with the slurmctld locks used to pack the
+ *	response still held so the recorded update times match its contents.
+ * IN cache - cache for the request's message type
+ * IN uid, show_flags, protocol_version - identify the request
+ * IN dump, dump_size - packed response
+ */
+static void _rpc_cache_set(rpc_cache_t *cache, uid_t uid,
+			   uint16_t show_flags, uint16_t protocol_version,
+			   char *dump, int dump_size)
+{
+	time_t now = time(NULL);
+	int i, oldest = 0;
+
+	slurm_mutex_lock(&rpc_cache_mutex);
+	for (i = 0; i < RPC_CACHE_SIZE; i++) {
+		/* Release memory held by stale entries */
+		if (cache[i].dump && !_rpc_cache_valid(&cache[i], now))
+			xfree(cache[i].dump);
+		if (cache[i].pack_time < cache[oldest].pack_time)
+			oldest = i;
+	}
+	for (i = 0; i < RPC_CACHE_SIZE; i++) {
+		if (!cache[i].dump) {
+			oldest = i;
+			break;
+		}
+	}
+
+	xfree(cache[oldest].dump);
+	cache[oldest].dump = xmalloc(dump_size);
+	memcpy(cache[oldest].dump, dump, dump_size);
+	cache[oldest].dump_size = dump_size;
+	cache[oldest].pack_time = now;
+	cache[oldest].conf_update = slurmctld_conf.last_update;
+	cache[oldest].job_update  = last_job_update;
+	cache[oldest].node_update = last_node_update;
+	cache[oldest].part_update = last_part_update;
+	cache[oldest].protocol_version = protocol_version;
+	cache[oldest].show_flags = show_flags;
+	cache[oldest].uid = uid;
+	slurm_mutex_unlock(&rpc_cache_mutex);
+}
+
+/* rpc_cache_fini - Free all cached information responses */
+extern void rpc_cache_fini(void)
+{
+	int i;
+
+	slurm_mutex_lock(&rpc_cache_mutex);
+	for (i = 0; i < RPC_CACHE_SIZE; i++) {
+		xfree(job_info_cache[i].dump);
+		xfree(node_info_cache[i].dump);
+		xfree(part_info_cache[i].dump);
+	}
+	slurm_mutex_unlock(&rpc_cache_mutex);
+}
+
 /*
  * _fill_ctld_conf - make a copy of current slurm configuration
  *	this is done with locks set so the data can change at other times
@@ -1049,39 +1196,102 @@ static void _slurm_rpc_dump_jobs(slurm_msg_t * msg)
 	slurmctld_lock_t job_read_lock = {
 		READ_LOCK, READ_LOCK, NO_LOCK, WRITE_LOCK };
 	uid_t uid = g_slurm_auth_get_uid(msg->auth_cred, NULL);
+	time_t conf_update, job_update, node_update, part_update;
 
 	START_TIMER;
 	debug3("Processing RPC: REQUEST_JOB_INFO from uid=%d", uid);
-	lock_slurmctld(job_read_lock);
 
-	if ((job_info_request_msg->last_update - 1) >= last_job_update) {
-		unlock_slurmctld(job_read_lock);
-		debug3("_slurm_rpc_dump_jobs, no change");
-		slurm_send_rc_msg(msg, SLURM_NO_CHANGE_IN_DATA);
+	if (((job_info_request_msg->last_update - 1) < last_job_update) &&
+	    _rpc_cache_get(job_info_cache, uid,
+			   job_info_request_msg->show_flags,
+			   msg->protocol_version, &dump, &dump_size)) {
+		debug3("_slurm_rpc_dump_jobs, using cached response");
 	} else {
+		lock_slurmctld(job_read_lock);
+		if ((job_info_request_msg->last_update - 1) >=
+		    last_job_update) {
+			unlock_slurmctld(job_read_lock);
+			debug3("_slurm_rpc_dump_jobs, no change");
+			slurm_send_rc_msg(msg, SLURM_NO_CHANGE_IN_DATA);
+			return;
+		}
+		conf_update = slurmctld_conf.last_update;
+		job_update  = last_job_update;
+		node_update = last_node_update;
+		part_update = last_part_update;
 		pack_all_jobs(&dump, &dump_size,
 			      job_info_request_msg->show_flags,
-			      g_slurm_auth_get_uid(msg->auth_cred, NULL),
-			      NO_VAL, msg->protocol_version);
+			      uid, NO_VAL, msg->protocol_version);
+		/* Locks may have been yielded to writers while packing,
+		 * only cache a response which matches the update times */
+		if ((conf_update == slurmctld_conf.last_update) &&
+		    (job_update  == last_job_update)  &&
+		    (node_update == last_node_update) &&
+		    (part_update == last_part_update)) {
+			_rpc_cache_set(job_info_cache, uid,
+				       job_info_request_msg->show_flags,
+				       msg->protocol_version, dump,
+				       dump_size);
+		}
 		unlock_slurmctld(job_read_lock);
-		END_TIMER2("_slurm_rpc_dump_jobs");
+	}
+	END_TIMER2("_slurm_rpc_dump_jobs");
 #if 0
-		info("_slurm_rpc_dump_jobs, size=%d %s", dump_size, TIME_STR);
+	info("_slurm_rpc_dump_jobs, size=%d %s", dump_size, TIME_STR);
 #endif
 
-		/* init response_msg structure */
-		slurm_msg_t_init(&response_msg);
-		response_msg.flags = msg->flags;
-		response_msg.protocol_version = msg->protocol_version;
-		response_msg.address = msg->address;
-		response_msg.msg_type = RESPONSE_JOB_INFO;
-		response_msg.data = dump;
-		response_msg.data_size = dump_size;
+	/* init response_msg structure */
+	slurm_msg_t_init(&response_msg);
+	response_msg.flags = msg->flags;
+	response_msg.protocol_version = msg->protocol_version;
+	response_msg.address = msg->address;
+	response_msg.msg_type = RESPONSE_JOB_INFO;
+	response_msg.data = dump;
+	response_msg.data_size = dump_size;
 
-		/* send message */
-		slurm_send_node_msg(msg->conn_fd, &response_msg);
-		xfree(dump);
-	}
+	/* send message */
+	slurm_send_node_msg(msg->conn_fd, &response_msg);
+	xfree(dump);
+}
+
+/* _slurm_rpc_dump_jobs_delta - process RPC for job state information
+ *	changed since the client's job table generation */
+static void _slurm_rpc_dump_jobs_delta(slurm_msg_t * msg)
+{
+	DEF_TIMERS;
+	char *dump;
+	int dump_size;
+	slurm_msg_t response_msg;
+	job_info_delta_request_msg_t *job_info_request_msg =
+		(job_info_delta_request_msg_t *) msg->data;
+	/* Locks: Read config job, write node (for hiding) */
+	slurmctld_lock_t job_read_lock = {
+		READ_LOCK, READ_LOCK, NO_LOCK, WRITE_LOCK };
+	uid_t uid = g_slurm_auth_get_uid(msg->auth_cred, NULL);
+
+	START_TIMER;
+	debug3("Processing RPC: REQUEST_JOB_INFO_DELTA from uid=%d", uid);
+	lock_slurmctld(job_read_lock);
+	pack_jobs_delta(&dump, &dump_size, job_info_request_msg, uid,
+			msg->protocol_version);
+	unlock_slurmctld(job_read_lock);
+	END_TIMER2("_slurm_rpc_dump_jobs_delta");
+#if 0
+	info("_slurm_rpc_dump_jobs_delta, size=%d %s", dump_size, TIME_STR);
+#endif
+
+	/* init response_msg structure */
+	slurm_msg_t_init(&response_msg);
+	response_msg.flags = msg->flags;
+	response_msg.protocol_version = msg->protocol_version;
+	response_msg.address = msg->address;
+	response_msg.msg_type = RESPONSE_JOB_INFO_DELTA;
+	response_msg.data = dump;
+	response_msg.data_size = dump_size;
+
+	/* send message */
+	slurm_send_node_msg(msg->conn_fd, &response_msg);
+	xfree(dump);
 }
 
 /* _slurm_rpc_dump_jobs - process RPC for job state information */
@@ -1321,45 +1531,56 @@ static void _slurm_rpc_dump_nodes(slurm_msg_t * msg)
 
 	START_TIMER;
 	debug3("Processing RPC: REQUEST_NODE_INFO from uid=%d", uid);
-	lock_slurmctld(node_write_lock);
 
-	if ((slurmctld_conf.private_data & PRIVATE_DATA_NODES) &&
-	    (!validate_operator(uid))) {
-		unlock_slurmctld(node_write_lock);
-		error("Security violation, REQUEST_NODE_INFO RPC from uid=%d",
-		      uid);
-		slurm_send_rc_msg(msg, ESLURM_ACCESS_DENIED);
-		return;
-	}
+	/* Cached responses have already passed the private data test below
+	 * under the same configuration */
+	if (((node_req_msg->last_update - 1) < last_node_update) &&
+	    _rpc_cache_get(node_info_cache, uid, node_req_msg->show_flags,
+			   msg->protocol_version, &dump, &dump_size)) {
+		debug3("_slurm_rpc_dump_nodes, using cached response");
+	} else {
+		lock_slurmctld(node_write_lock);
 
-	select_g_select_nodeinfo_set_all();
+		if ((slurmctld_conf.private_data & PRIVATE_DATA_NODES) &&
+		    (!validate_operator(uid))) {
+			unlock_slurmctld(node_write_lock);
+			error("Security violation, REQUEST_NODE_INFO RPC "
+			      "from uid=%d", uid);
+			slurm_send_rc_msg(msg, ESLURM_ACCESS_DENIED);
+			return;
+		}
 
-	if ((node_req_msg->last_update - 1) >= last_node_update) {
-		unlock_slurmctld(node_write_lock);
-		debug3("_slurm_rpc_dump_nodes, no change");
-		slurm_send_rc_msg(msg, SLURM_NO_CHANGE_IN_DATA);
-	} else {
+		select_g_select_nodeinfo_set_all();
+
+		if ((node_req_msg->last_update - 1) >= last_node_update) {
+			unlock_slurmctld(node_write_lock);
+			debug3("_slurm_rpc_dump_nodes, no change");
+			slurm_send_rc_msg(msg, SLURM_NO_CHANGE_IN_DATA);
+			return;
+		}
 		pack_all_node(&dump, &dump_size, node_req_msg->show_flags,
 			      uid, msg->protocol_version);
+		_rpc_cache_set(node_info_cache, uid, node_req_msg->show_flags,
+			       msg->protocol_version, dump, dump_size);
 		unlock_slurmctld(node_write_lock);
-		END_TIMER2("_slurm_rpc_dump_nodes");
+	}
+	END_TIMER2("_slurm_rpc_dump_nodes");
 #if 0
-		info("_slurm_rpc_dump_nodes, size=%d %s", dump_size, TIME_STR);
+	info("_slurm_rpc_dump_nodes, size=%d %s", dump_size, TIME_STR);
 #endif
 
-		/* init response_msg structure */
-		slurm_msg_t_init(&response_msg);
-		response_msg.flags = msg->flags;
-		response_msg.protocol_version = msg->protocol_version;
-		response_msg.address = msg->address;
-		response_msg.msg_type = RESPONSE_NODE_INFO;
-		response_msg.data = dump;
-		response_msg.data_size = dump_size;
+	/* init response_msg structure */
+	slurm_msg_t_init(&response_msg);
+	response_msg.flags = msg->flags;
+	response_msg.protocol_version = msg->protocol_version;
+	response_msg.address = msg->address;
+	response_msg.msg_type = RESPONSE_NODE_INFO;
+	response_msg.data = dump;
+	response_msg.data_size = dump_size;
 
-		/* send message */
-		slurm_send_node_msg(msg->conn_fd, &response_msg);
-		xfree(dump);
-	}
+	/* send message */
+	slurm_send_node_msg(msg->conn_fd, &response_msg);
+	xfree(dump);
 }
 
 /* _slurm_rpc_dump_node_single - done RPC state information for one node */
@@ -1434,39 +1655,52 @@ static void _slurm_rpc_dump_partitions(slurm_msg_t * msg)
 	START_TIMER;
 	debug2("Processing RPC: REQUEST_PARTITION_INFO uid=%d", uid);
 	part_req_msg = (part_info_request_msg_t  *) msg->data;
-	lock_slurmctld(part_read_lock);
 
-	if ((slurmctld_conf.private_data & PRIVATE_DATA_PARTITIONS) &&
-	    !validate_operator(uid)) {
-		unlock_slurmctld(part_read_lock);
-		debug2("Security violation, PARTITION_INFO RPC from uid=%d",
-		       uid);
-		slurm_send_rc_msg(msg, ESLURM_ACCESS_DENIED);
-	} else if ((part_req_msg->last_update - 1) >= last_part_update) {
-		unlock_slurmctld(part_read_lock);
-		debug2("_slurm_rpc_dump_partitions, no change");
-		slurm_send_rc_msg(msg, SLURM_NO_CHANGE_IN_DATA);
+	/* Cached responses have already passed the private data test below
+	 * under the same configuration */
+	if (((part_req_msg->last_update - 1) < last_part_update) &&
+	    _rpc_cache_get(part_info_cache, uid, part_req_msg->show_flags,
+			   msg->protocol_version, &dump, &dump_size)) {
+		debug2("_slurm_rpc_dump_partitions, using cached response");
 	} else {
+		lock_slurmctld(part_read_lock);
+
+		if ((slurmctld_conf.private_data & PRIVATE_DATA_PARTITIONS) &&
+		    !validate_operator(uid)) {
+			unlock_slurmctld(part_read_lock);
+			debug2("Security violation, PARTITION_INFO RPC "
+			       "from uid=%d", uid);
+			slurm_send_rc_msg(msg, ESLURM_ACCESS_DENIED);
+			return;
+		} else if ((part_req_msg->last_update - 1) >=
+			   last_part_update) {
+			unlock_slurmctld(part_read_lock);
+			debug2("_slurm_rpc_dump_partitions, no change");
+			slurm_send_rc_msg(msg, SLURM_NO_CHANGE_IN_DATA);
+			return;
+		}
 		pack_all_part(&dump, &dump_size, part_req_msg->show_flags,
 			      uid, msg->protocol_version);
+		_rpc_cache_set(part_info_cache, uid, part_req_msg->show_flags,
+			       msg->protocol_version, dump, dump_size);
 		unlock_slurmctld(part_read_lock);
-		END_TIMER2("_slurm_rpc_dump_partitions");
-		debug2("_slurm_rpc_dump_partitions, size=%d %s",
-		       dump_size, TIME_STR);
+	}
+	END_TIMER2("_slurm_rpc_dump_partitions");
+	debug2("_slurm_rpc_dump_partitions, size=%d %s",
+	       dump_size, TIME_STR);
 
-		/* init response_msg structure */
-		slurm_msg_t_init(&response_msg);
-		response_msg.flags = msg->flags;
-		response_msg.protocol_version = msg->protocol_version;
-		response_msg.address = msg->address;
-		response_msg.msg_type = RESPONSE_PARTITION_INFO;
-		response_msg.data = dump;
-		response_msg.data_size = dump_size;
+	/* init response_msg structure */
+	slurm_msg_t_init(&response_msg);
+	response_msg.flags = msg->flags;
+	response_msg.protocol_version = msg->protocol_version;
+	response_msg.address = msg->address;
+	response_msg.msg_type = RESPONSE_PARTITION_INFO;
+	response_msg.data = dump;
+	response_msg.data_size = dump_size;
 
-		/* send message */
-		slurm_send_node_msg(msg->conn_fd, &response_msg);
-		xfree(dump);
-	}
+	/* send message */
+	slurm_send_node_msg(msg->conn_fd, &response_msg);
+	xfree(dump);
 }
 
 /* _slurm_rpc_epilog_complete - process RPC noting the completion of
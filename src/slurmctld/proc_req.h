@@ -73,6 +73,9 @@ extern int slurm_drain_nodes(char *node_list, char *reason,
  */
 extern int slurm_fail_job(uint32_t job_id, uint16_t job_state);
 
+/* rpc_cache_fini - Free all cached information responses */
+extern void rpc_cache_fini(void);
+
 /* Copy an array of type char **, xmalloc() the array and xstrdup() the
  * strings in the array */
 extern char **xduparray(uint32_t size, char ** array);
@@ -55,6 +55,7 @@
 #include <syslog.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 #include <time.h>
 #include <unistd.h>
 
@@ -96,6 +97,8 @@ static int  _build_bitmaps(void);
 static void _build_bitmaps_pre_select(void);
 static void _gres_reconfig(bool reconfig);
 static int  _init_all_slurm_conf(void);
+static void _phase_time(struct timeval *phase_tv, char *phase,
+			bool reconfig);
 static int  _preserve_select_type_param(slurm_ctl_conf_t * ctl_conf_ptr,
 					uint16_t old_select_type_p);
 static int  _preserve_plugins(slurm_ctl_conf_t * ctl_conf_ptr,
@@ -853,9 +856,11 @@ int read_slurm_conf(int recover, bool reconfig)
 	char *state_save_dir      = xstrdup(slurmctld_conf.state_save_location);
 	char *mpi_params;
 	uint16_t old_select_type_p = slurmctld_conf.select_type_param;
+	struct timeval phase_tv;
 
 	/* initialization */
 	START_TIMER;
+	gettimeofday(&phase_tv, NULL);
 
 	if (reconfig) {
 		/* in order to re-use job state information,
@@ -890,6 +895,10 @@ int read_slurm_conf(int recover, bool reconfig)
 		return error_code;
 	}
 
+	/* Read job state while the configuration is processed */
+	if (!reconfig && (recover >= 1))
+		prefetch_job_state();
+
 	if (slurm_topo_init() != SLURM_SUCCESS)
 		fatal("Failed to initialize topology plugin");
 
@@ -948,6 +957,7 @@ int read_slurm_conf(int recover, bool reconfig)
 	rehash_node();
 	rehash_jobs();
 	set_slurmd_addr();
+	_phase_time(&phase_tv, "configuration", reconfig);
 
 	_stat_slurm_dirs();
 	if (reconfig) {		/* Preserve state from memory */
@@ -982,15 +992,19 @@ int read_slurm_conf(int recover, bool reconfig)
 	} else if (recover == 1) {	/* Load job & node state files */
 		(void) load_all_node_state(true);
 		(void) load_all_front_end_state(true);
+		_phase_time(&phase_tv, "node state recovery", reconfig);
 		load_job_ret = load_all_job_state();
 		sync_job_priorities();
 	} else if (recover > 1) {	/* Load node, part & job state files */
 		(void) load_all_node_state(false);
 		(void) load_all_front_end_state(false);
 		(void) load_all_part_state();
+		_phase_time(&phase_tv, "node and partition state recovery",
+			    reconfig);
 		load_job_ret = load_all_job_state();
 		sync_job_priorities();
 	}
+	_phase_time(&phase_tv, "job state recovery", reconfig);
 
 	_sync_part_prio();
 	_build_bitmaps_pre_select();
@@ -1003,11 +1017,13 @@ int read_slurm_conf(int recover, bool reconfig)
 		      "Clean start required.");
 	}
 	xfree(state_save_dir);
+	_phase_time(&phase_tv, "node selection plugin state", reconfig);
 	_gres_reconfig(reconfig);
 	reset_job_bitmaps();		/* must follow select_g_job_init() */
 
 	(void) _sync_nodes_to_jobs();
 	(void) sync_job_files();
+	_phase_time(&phase_tv, "job and node synchronization", reconfig);
 	_purge_old_node_state(old_node_table_ptr, old_node_record_count);
 	_purge_old_part_state(old_part_list, old_def_part_name);
 
@@ -1029,6 +1045,7 @@ int read_slurm_conf(int recover, bool reconfig)
 #endif
 	(void) _sync_nodes_to_comp_job();/* must follow select_g_node_init() */
 	load_part_uid_allow_list(1);
+	_phase_time(&phase_tv, "job dependencies and features", reconfig);
 
 	if (reconfig) {
 		load_all_resv_state(0);
@@ -1039,6 +1056,8 @@ int read_slurm_conf(int recover, bool reconfig)
 			(void) slurm_sched_g_reconfig();
 		}
 	}
+	_phase_time(&phase_tv, "reservation and trigger state recovery",
+		    reconfig);
 
 	/* sort config_list by weight for scheduling */
 	list_sort(config_list, &list_compare_config);
@@ -1079,9 +1098,29 @@ int read_slurm_conf(int recover, bool reconfig)
 
 	slurmctld_conf.last_update = time(NULL);
 	END_TIMER2("read_slurm_conf");
+	if (!reconfig)
+		info("read_slurm_conf: total %s", TIME_STR);
 	return error_code;
 }
 
+/* Log the time taken by a phase of read_slurm_conf(), at info level when
+ * recovering state at startup, then restart the timer for the next phase */
+static void _phase_time(struct timeval *phase_tv, char *phase,
+			bool reconfig)
+{
+	struct timeval now;
+	long delta_t;
+
+	gettimeofday(&now, NULL);
+	delta_t  = (now.tv_sec  - phase_tv->tv_sec) * 1000000;
+	delta_t +=  now.tv_usec - phase_tv->tv_usec;
+	if (reconfig)
+		debug("read_slurm_conf: %s usec=%ld", phase, delta_t);
+	else
+		info("read_slurm_conf: %s usec=%ld", phase, delta_t);
+	*phase_tv = now;
+}
+
 static void _gres_reconfig(bool reconfig)
 {
 	struct node_record *node_ptr;
@@ -1889,6 +1928,8 @@ static int _restore_job_dependencies(void)
 	List license_list;
 
 	assoc_mgr_clear_used_info();
+	/* Rebuilt from every job's dependencies below */
+	depend_graph_fini();
 	job_iterator = list_iterator_create(job_list);
 	while ((job_ptr = (struct job_record *) list_next(job_iterator))) {
 		(void) build_feature_list(job_ptr);
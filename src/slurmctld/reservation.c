@@ -2728,7 +2728,7 @@ extern int load_all_resv_state(int recover)
 	char *state_file, *data = NULL, *ver_str = NULL;
 	time_t now;
 	uint32_t data_size = 0, uint32_tmp;
-	int data_allocated, data_read = 0, error_code = 0, state_fd;
+	int error_code = 0, state_fd;
 	Buf buffer;
 	slurmctld_resv_t *resv_ptr = NULL;
 	uint16_t protocol_version = (uint16_t) NO_VAL;
@@ -2752,28 +2752,8 @@ extern int load_all_resv_state(int recover)
 		info("No reservation state file (%s) to recover",
 		     state_file);
 		error_code = ENOENT;
-	} else {
-		data_allocated = BUF_SIZE;
-		data = xmalloc(data_allocated);
-		while (1) {
-			data_read = read(state_fd, &data[data_size],
-					BUF_SIZE);
-			if (data_read < 0) {
-				if  (errno == EINTR)
-					continue;
-				else {
-					error("Read error on %s: %m",
-						state_file);
-					break;
-				}
-			} else if (data_read == 0)     /* eof */
-				break;
-			data_size      += data_read;
-			data_allocated += data_read;
-			xrealloc(data, data_allocated);
-		}
-		close(state_fd);
-	}
+	} else
+		data = read_state_file(state_fd, state_file, &data_size);
 	xfree(state_file);
 	unlock_state_files();
 
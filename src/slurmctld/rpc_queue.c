@@ -0,0 +1,751 @@
+/*****************************************************************************\
+ *  rpc_queue.c - queue incoming RPCs by message type for a fixed pool of
+ *	slurmctld worker threads
+ *****************************************************************************
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "src/common/list.h"
+#include "src/common/log.h"
+#include "src/common/macros.h"
+#include "src/common/slurm_auth.h"
+#include "src/common/slurm_protocol_api.h"
+#include "src/common/xmalloc.h"
+
+#include "src/slurmctld/proc_req.h"
+#include "src/slurmctld/rpc_queue.h"
+#include "src/slurmctld/slurmctld.h"
+
+/* RPC classes, each with its own queue. Workers serve the classes in this
+ * order, reading newly ready connections after RPC_CLASS_URGENT. */
+#define RPC_CLASS_URGENT	0	/* pings, registrations, completions */
+#define RPC_CLASS_NORMAL	1	/* everything else */
+#define RPC_CLASS_DUMP		2	/* expensive information dumps */
+#define RPC_CLASS_COUNT		3
+
+/* Workers which never start RPC_CLASS_NORMAL or RPC_CLASS_DUMP work, so
+ * urgent RPCs and new connections are served even when every other worker
+ * is busy with a long running RPC */
+#define RPC_RESERVED_WORKERS	4
+
+#define RPC_USER_HASH_SIZE	64
+#define RPC_USER_HASH_INX(_uid)	(_uid % RPC_USER_HASH_SIZE)
+
+typedef struct rpc_queue_rec {
+	slurm_fd_t newsockfd;
+	slurm_msg_t *msg;	/* NULL until the connection is read */
+	struct timeval recv_time; /* time connection was ready to read */
+	double defer_start;	/* time the RPC was deferred */
+	double defer_until;	/* not to be processed before this time */
+	int rpc_class;
+	int type_inx;		/* index into rpc_type_stats */
+	struct rpc_user_rec *user_ptr;	/* NULL if RPC was not deferred */
+} rpc_queue_rec_t;
+
+/* Per user RPC rate limit state and statistics. Separate token buckets
+ * are kept for RPC_CLASS_NORMAL and RPC_CLASS_DUMP, so a user's status
+ * polling does not delay that user's job submissions. */
+typedef struct rpc_user_rec {
+	uint32_t uid;
+	double tokens[RPC_CLASS_COUNT];	/* RPCs which may start now */
+	double refill_time[RPC_CLASS_COUNT]; /* time tokens last updated */
+	uint32_t count;		/* RPCs received */
+	uint32_t deferred;	/* RPCs delayed by rate limit */
+	uint32_t throttled;	/* RPCs rejected by rate limit */
+	uint32_t defer_msec;	/* total time RPCs spent deferred */
+	struct rpc_user_rec *next;	/* next record in hash chain */
+} rpc_user_rec_t;
+
+typedef struct {
+	uint16_t msg_type;
+	uint32_t count;
+	uint32_t depth;
+	uint32_t depth_max;
+	uint32_t latency_hist[RPC_HIST_BUCKETS];
+} rpc_type_stats_t;
+
+static pthread_mutex_t rpc_queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  rpc_queue_cond  = PTHREAD_COND_INITIALIZER;
+static List      conn_queue = NULL;		/* connections to read */
+static List      rpc_queue[RPC_CLASS_COUNT];	/* RPCs by class */
+static int       rpc_queue_cnt = 0;		/* records in all queues */
+static int       rpc_busy[RPC_CLASS_COUNT];	/* workers by class */
+static int       rpc_bulk_limit = 0;		/* max NORMAL + DUMP workers */
+static int       rpc_dump_limit = 0;		/* max DUMP workers */
+static bool      rpc_shutdown = false;
+static int       worker_cnt = 0;
+static pthread_t *worker_ids = NULL;
+
+static rpc_type_stats_t *rpc_type_stats = NULL;
+static int       rpc_type_cnt = 0;
+static int       rpc_type_size = 0;
+
+static List      defer_queue = NULL;	/* rate limited RPCs, sorted by
+					 * defer_until */
+static rpc_user_rec_t *rpc_user_hash[RPC_USER_HASH_SIZE];
+static int       rpc_user_cnt = 0;
+static uint32_t  rpc_user_rate = 0;	/* RPCs per second, 0 if no limit */
+static double    rpc_max_defer = 5.0;	/* longest deferral, seconds */
+static time_t    rpc_config_update = 0;
+
+static void   _busy_server_thread(bool busy);
+static void   _close_rec(rpc_queue_rec_t *rec);
+static void   _defer_rec(rpc_queue_rec_t *rec);
+static double _defer_time(rpc_queue_rec_t *rec, uid_t uid, double now);
+static void   _dequeue_stats(rpc_queue_rec_t *rec);
+static void   _load_config(void);
+static rpc_queue_rec_t *_next_rec(void);
+static double _now(void);
+static void   _process_rec(rpc_queue_rec_t *rec);
+static void   _read_rec(rpc_queue_rec_t *rec);
+static int    _rpc_class(uint16_t msg_type);
+static void * _rpc_worker(void *no_data);
+static int    _type_inx(uint16_t msg_type);
+static rpc_user_rec_t *_user_rec(uint32_t uid);
+
+/* Return the queue class of an RPC */
+static int _rpc_class(uint16_t msg_type)
+{
+	switch (msg_type) {
+	case REQUEST_PING:
+	case MESSAGE_NODE_REGISTRATION_STATUS:
+	case MESSAGE_EPILOG_COMPLETE:
+	case REQUEST_COMPLETE_PROLOG:
+	case REQUEST_COMPLETE_BATCH_JOB:
+	case REQUEST_COMPLETE_BATCH_SCRIPT:
+	case REQUEST_COMPLETE_JOB_ALLOCATION:
+	case REQUEST_STEP_COMPLETE:
+	case REQUEST_STATS_INFO:
+		return RPC_CLASS_URGENT;
+	case REQUEST_BLOCK_INFO:
+	case REQUEST_BUILD_INFO:
+	case REQUEST_FRONT_END_INFO:
+	case REQUEST_JOB_INFO:
+	case REQUEST_JOB_INFO_DELTA:
+	case REQUEST_JOB_INFO_SINGLE:
+	case REQUEST_JOB_STEP_INFO:
+	case REQUEST_JOB_USER_INFO:
+	case REQUEST_LICENSE_INFO:
+	case REQUEST_NODE_INFO:
+	case REQUEST_NODE_INFO_SINGLE:
+	case REQUEST_PARTITION_INFO:
+	case REQUEST_PRIORITY_FACTORS:
+	case REQUEST_RESERVATION_INFO:
+	case REQUEST_SHARE_INFO:
+	case REQUEST_TOPO_INFO:
+	case REQUEST_TRIGGER_GET:
+		return RPC_CLASS_DUMP;
+	default:
+		return RPC_CLASS_NORMAL;
+	}
+}
+
+/* Return the rpc_type_stats index for a message type, adding a record if
+ * needed. Call with rpc_queue_mutex held. */
+static int _type_inx(uint16_t msg_type)
+{
+	int i;
+
+	for (i = 0; i < rpc_type_cnt; i++) {
+		if (rpc_type_stats[i].msg_type == msg_type)
+			return i;
+	}
+	if (rpc_type_cnt >= rpc_type_size) {
+		rpc_type_size += 32;
+		xrealloc(rpc_type_stats,
+			 sizeof(rpc_type_stats_t) * rpc_type_size);
+	}
+	rpc_type_stats[rpc_type_cnt].msg_type = msg_type;
+	return rpc_type_cnt++;
+}
+
+/* Return the rate limit record for a user, adding one if needed. Call with
+ * rpc_queue_mutex held. */
+static rpc_user_rec_t *_user_rec(uint32_t uid)
+{
+	rpc_user_rec_t *user_ptr;
+
+	user_ptr = rpc_user_hash[RPC_USER_HASH_INX(uid)];
+	while (user_ptr) {
+		if (user_ptr->uid == uid)
+			return user_ptr;
+		user_ptr = user_ptr->next;
+	}
+	user_ptr = xmalloc(sizeof(rpc_user_rec_t));
+	user_ptr->uid = uid;
+	user_ptr->next = rpc_user_hash[RPC_USER_HASH_INX(uid)];
+	rpc_user_hash[RPC_USER_HASH_INX(uid)] = user_ptr;
+	rpc_user_cnt++;
+	return user_ptr;
+}
+
+static double _now(void)
+{
+	struct timeval now;
+
+	gettimeofday(&now, NULL);
+	return (double) now.tv_sec + ((double) now.tv_usec / 1000000.0);
+}
+
+/* Load the RPC rate limit from SchedulerParameters if the configuration
+ * has changed */
+static void _load_config(void)
+{
+	char *sched_params, *tmp_ptr;
+	uint32_t rate = 0;
+	int i;
+
+	if (rpc_config_update == slurmctld_conf.last_update)
+		return;
+	rpc_config_update = slurmctld_conf.last_update;
+
+	sched_params = slurm_get_sched_params();
+	if (sched_params &&
+	    (tmp_ptr = strstr(sched_params, "rpc_user_rate="))) {
+	/*                                   01234567890123 */
+		i = atoi(tmp_ptr + 14);
+		if (i < 0) {
+			error("ignoring SchedulerParameters: "
+			      "rpc_user_rate value of %d", i);
+		} else
+			rate = i;
+	}
+	xfree(sched_params);
+
+	slurm_mutex_lock(&rpc_queue_mutex);
+	rpc_user_rate = rate;
+	/* Reject rather than defer RPCs which would wait long enough for
+	 * the client to give up */
+	rpc_max_defer = MAX(slurm_get_msg_timeout() / 2, 1);
+	slurm_mutex_unlock(&rpc_queue_mutex);
+}
+
+/* Charge an RPC to its user's token bucket. Return the time at which the
+ * RPC may start, which is later than now if the user is over the rate
+ * limit, or zero if the RPC should be rejected. Call with rpc_queue_mutex
+ * held. */
+static double _defer_time(rpc_queue_rec_t *rec, uid_t uid, double now)
+{
+	rpc_user_rec_t *user_ptr = _user_rec(uid);
+	int rpc_class = rec->rpc_class;
+	double start_time;
+
+	user_ptr->count++;
+	if ((rpc_user_rate == 0) || (rpc_class == RPC_CLASS_URGENT) ||
+	    (uid == 0) || (uid == slurmctld_conf.slurm_user_id))
+		return now;
+
+	if (user_ptr->refill_time[rpc_class] == 0) {
+		user_ptr->tokens[rpc_class] = rpc_user_rate;
+	} else {
+		user_ptr->tokens[rpc_class] += rpc_user_rate *
+			(now - user_ptr->refill_time[rpc_class]);
+		if (user_ptr->tokens[rpc_class] > rpc_user_rate)
+			user_ptr->tokens[rpc_class] = rpc_user_rate;
+	}
+	user_ptr->refill_time[rpc_class] = now;
+
+	if (user_ptr->tokens[rpc_class] >= 1.0) {
+		user_ptr->tokens[rpc_class] -= 1.0;
+		return now;
+	}
+	start_time = now + (1.0 - user_ptr->tokens[rpc_class]) /
+			   rpc_user_rate;
+	if ((start_time - now) > rpc_max_defer) {
+		user_ptr->throttled++;
+		return 0;
+	}
+	user_ptr->tokens[rpc_class] -= 1.0;
+	user_ptr->deferred++;
+	rec->user_ptr = user_ptr;
+	return start_time;
+}
+
+/* Add a rate limited RPC to defer_queue, which is kept in order of
+ * defer_until. Call with rpc_queue_mutex held. */
+static void _defer_rec(rpc_queue_rec_t *rec)
+{
+	ListIterator iter;
+	rpc_queue_rec_t *next_rec;
+
+	iter = list_iterator_create(defer_queue);
+	while ((next_rec = (rpc_queue_rec_t *) list_next(iter))) {
+		if (next_rec->defer_until > rec->defer_until)
+			break;
+	}
+	list_insert(iter, rec);
+	list_iterator_destroy(iter);
+}
+
+/* Track the count of workers servicing an RPC, this is the count reported
+ * as server_thread_count and checked before slurmctld saves state */
+static void _busy_server_thread(bool busy)
+{
+	slurm_mutex_lock(&slurmctld_config.thread_count_lock);
+	if (busy)
+		slurmctld_config.server_thread_count++;
+	else if (slurmctld_config.server_thread_count > 0)
+		slurmctld_config.server_thread_count--;
+	else
+		error("slurmctld_config.server_thread_count underflow");
+	slurm_mutex_unlock(&slurmctld_config.thread_count_lock);
+}
+
+/* Close a queued connection without processing it */
+static void _close_rec(rpc_queue_rec_t *rec)
+{
+	if (rec->newsockfd >= 0)
+		(void) slurm_close_accepted_conn(rec->newsockfd);
+	if (rec->msg)
+		slurm_free_msg(rec->msg);
+	xfree(rec);
+}
+
+/* Remove a dequeued RPC from its message type's queue depth. Call with
+ * rpc_queue_mutex held. */
+static void _dequeue_stats(rpc_queue_rec_t *rec)
+{
+	rpc_queue_cnt--;
+	if (rec->msg && rpc_type_stats[rec->type_inx].depth)
+		rpc_type_stats[rec->type_inx].depth--;
+}
+
+/* Return the next record a worker should service, or NULL if none is
+ * available to it. Call with rpc_queue_mutex held. */
+static rpc_queue_rec_t *_next_rec(void)
+{
+	rpc_queue_rec_t *rec;
+	double now;
+
+	/* Release deferred RPCs whose time has come to their class and
+	 * record how long they were held back */
+	if (list_count(defer_queue)) {
+		now = _now();
+		while ((rec = list_peek(defer_queue)) &&
+		       (rec->defer_until <= now)) {
+			rec = list_dequeue(defer_queue);
+			rec->user_ptr->defer_msec += (uint32_t)
+				((now - rec->defer_start) * 1000);
+			list_enqueue(rpc_queue[rec->rpc_class], rec);
+		}
+	}
+
+	if ((rec = list_dequeue(rpc_queue[RPC_CLASS_URGENT])) ||
+	    (rec = list_dequeue(conn_queue)))
+		goto found;
+
+	if ((rpc_busy[RPC_CLASS_NORMAL] + rpc_busy[RPC_CLASS_DUMP]) >=
+	    rpc_bulk_limit)
+		return NULL;
+	if ((rec = list_dequeue(rpc_queue[RPC_CLASS_NORMAL])))
+		goto found;
+	if ((rpc_busy[RPC_CLASS_DUMP] < rpc_dump_limit) &&
+	    (rec = list_dequeue(rpc_queue[RPC_CLASS_DUMP])))
+		goto found;
+	return NULL;
+
+found:	_dequeue_stats(rec);
+	return rec;
+}
+
+/* Read the RPC from a ready connection and queue it by message type */
+static void _read_rec(rpc_queue_rec_t *rec)
+{
+	uid_t uid;
+	double now;
+
+	rec->msg = xmalloc(sizeof(slurm_msg_t));
+	slurm_msg_t_init(rec->msg);
+	/*
+	 * slurm_receive_msg sets msg connection fd to accepted fd. This allows
+	 * possibility for slurmctld_req() to close accepted connection.
+	 */
+	if (slurm_receive_msg(rec->newsockfd, rec->msg, 0) != 0) {
+		error("slurm_receive_msg: %m");
+		_close_rec(rec);
+		return;
+	}
+	if (errno != SLURM_SUCCESS) {
+		if (errno == SLURM_PROTOCOL_VERSION_ERROR) {
+			slurm_send_rc_msg(rec->msg,
+					  SLURM_PROTOCOL_VERSION_ERROR);
+		} else
+			info("_read_rec/slurm_receive_msg %m");
+		_close_rec(rec);
+		return;
+	}
+
+	rec->rpc_class = _rpc_class(rec->msg->msg_type);
+	uid = g_slurm_auth_get_uid(rec->msg->auth_cred, NULL);
+	_load_config();
+	now = _now();
+
+	slurm_mutex_lock(&rpc_queue_mutex);
+	if (rpc_shutdown) {
+		slurm_mutex_unlock(&rpc_queue_mutex);
+		_close_rec(rec);
+		return;
+	}
+	rec->defer_until = _defer_time(rec, uid, now);
+	if (rec->defer_until == 0) {
+		slurm_mutex_unlock(&rpc_queue_mutex);
+		debug2("RPC %s from uid=%u rejected by rpc_user_rate",
+		       rpc_num2string(rec->msg->msg_type), uid);
+		slurm_send_rc_msg(rec->msg, EAGAIN);
+		_close_rec(rec);
+		return;
+	}
+	rec->type_inx = _type_inx(rec->msg->msg_type);
+	rpc_type_stats[rec->type_inx].depth++;
+	if (rpc_type_stats[rec->type_inx].depth_max <
+	    rpc_type_stats[rec->type_inx].depth) {
+		rpc_type_stats[rec->type_inx].depth_max =
+			rpc_type_stats[rec->type_inx].depth;
+	}
+	if (rec->defer_until > now) {
+		rec->defer_start = now;
+		_defer_rec(rec);
+	} else
+		list_enqueue(rpc_queue[rec->rpc_class], rec);
+	rpc_queue_cnt++;
+	pthread_cond_signal(&rpc_queue_cond);
+	slurm_mutex_unlock(&rpc_queue_mutex);
+}
+
+/* Process a queued RPC and record its latency */
+static void _process_rec(rpc_queue_rec_t *rec)
+{
+	struct timeval now;
+	uint32_t delta_msec, limit_msec;
+	int i;
+
+	slurmctld_req(rec->msg);
+	if ((rec->newsockfd >= 0) &&
+	    (slurm_close_accepted_conn(rec->newsockfd) < 0))
+		error ("close(%d): %m",  rec->newsockfd);
+
+	gettimeofday(&now, NULL);
+	delta_msec  = (now.tv_sec  - rec->recv_time.tv_sec) * 1000;
+	delta_msec += (now.tv_usec - rec->recv_time.tv_usec) / 1000;
+	for (i = 0, limit_msec = 1; i < (RPC_HIST_BUCKETS - 1);
+	     i++, limit_msec *= 10) {
+		if (delta_msec < limit_msec)
+			break;
+	}
+
+	slurm_mutex_lock(&rpc_queue_mutex);
+	rpc_type_stats[rec->type_inx].count++;
+	rpc_type_stats[rec->type_inx].latency_hist[i]++;
+	slurm_mutex_unlock(&rpc_queue_mutex);
+
+	slurm_free_msg(rec->msg);
+	xfree(rec);
+}
+
+/* _rpc_worker - read connections and process RPCs until shutdown */
+static void *_rpc_worker(void *no_data)
+{
+	rpc_queue_rec_t *rec;
+	int rpc_class;
+
+	slurm_mutex_lock(&rpc_queue_mutex);
+	while (1) {
+		if (rpc_shutdown)
+			break;
+		if (!(rec = _next_rec())) {
+			if ((rec = list_peek(defer_queue))) {
+				/* Wake when the next deferred RPC may start */
+				struct timespec ts;
+				ts.tv_sec  = (time_t) rec->defer_until;
+				ts.tv_nsec = (long) ((rec->defer_until -
+						      ts.tv_sec) * 1000000000);
+				pthread_cond_timedwait(&rpc_queue_cond,
+						       &rpc_queue_mutex, &ts);
+			} else {
+				pthread_cond_wait(&rpc_queue_cond,
+						  &rpc_queue_mutex);
+			}
+			continue;
+		}
+
+		rpc_class = rec->msg ? rec->rpc_class : -1;
+		if (rpc_class >= 0)
+			rpc_busy[rpc_class]++;
+		slurm_mutex_unlock(&rpc_queue_mutex);
+
+		_busy_server_thread(true);
+		if (rec->msg)
+			_process_rec(rec);
+		else
+			_read_rec(rec);
+		_busy_server_thread(false);
+
+		slurm_mutex_lock(&rpc_queue_mutex);
+		if (rpc_class >= 0) {
+			rpc_busy[rpc_class]--;
+			/* Wake a worker which may have been held off by
+			 * the NORMAL and DUMP worker limits */
+			if (rpc_class != RPC_CLASS_URGENT)
+				pthread_cond_signal(&rpc_queue_cond);
+		}
+	}
+	slurm_mutex_unlock(&rpc_queue_mutex);
+
+	return NULL;
+}
+
+/*
+ * rpc_queue_init - start the RPC worker threads
+ * IN thread_cnt - number of worker threads
+ */
+extern void rpc_queue_init(int thread_cnt)
+{
+	pthread_attr_t thread_attr;
+	int i;
+
+	slurm_mutex_lock(&rpc_queue_mutex);
+	conn_queue = list_create(NULL);
+	defer_queue = list_create(NULL);
+	for (i = 0; i < RPC_CLASS_COUNT; i++) {
+		rpc_queue[i] = list_create(NULL);
+		rpc_busy[i] = 0;
+	}
+	rpc_queue_cnt = 0;
+	rpc_shutdown = false;
+
+	worker_cnt = MAX(thread_cnt, 2);
+	if (worker_cnt > (RPC_RESERVED_WORKERS * 2))
+		rpc_bulk_limit = worker_cnt - RPC_RESERVED_WORKERS;
+	else
+		rpc_bulk_limit = worker_cnt - 1;
+	rpc_dump_limit = MAX(rpc_bulk_limit / 2, 1);
+	debug("RPC worker threads:%d normal limit:%d dump limit:%d",
+	      worker_cnt, rpc_bulk_limit, rpc_dump_limit);
+
+	worker_ids = xmalloc(sizeof(pthread_t) * worker_cnt);
+	slurm_attr_init(&thread_attr);
+	for (i = 0; i < worker_cnt; i++) {
+		while (pthread_create(&worker_ids[i], &thread_attr,
+				      _rpc_worker, NULL)) {
+			error("pthread_create error %m");
+			sleep(1);
+		}
+	}
+	slurm_attr_destroy(&thread_attr);
+	slurm_mutex_unlock(&rpc_queue_mutex);
+}
+
+/*
+ * rpc_queue_fini - stop the RPC worker threads once their current RPC
+ *	completes and close any connections still queued
+ */
+extern void rpc_queue_fini(void)
+{
+	rpc_queue_rec_t *rec;
+	int i;
+
+	slurm_mutex_lock(&rpc_queue_mutex);
+	if (!worker_ids) {
+		slurm_mutex_unlock(&rpc_queue_mutex);
+		return;
+	}
+	rpc_shutdown = true;
+	pthread_cond_broadcast(&rpc_queue_cond);
+	slurm_mutex_unlock(&rpc_queue_mutex);
+
+	for (i = 0; i < worker_cnt; i++)
+		pthread_join(worker_ids[i], NULL);
+	xfree(worker_ids);
+
+	slurm_mutex_lock(&rpc_queue_mutex);
+	while ((rec = list_dequeue(conn_queue)))
+		_close_rec(rec);
+	list_destroy(conn_queue);
+	conn_queue = NULL;
+	while ((rec = list_dequeue(defer_queue))) {
+		_dequeue_stats(rec);
+		_close_rec(rec);
+	}
+	list_destroy(defer_queue);
+	defer_queue = NULL;
+	for (i = 0; i < RPC_CLASS_COUNT; i++) {
+		while ((rec = list_dequeue(rpc_queue[i]))) {
+			_dequeue_stats(rec);
+			_close_rec(rec);
+		}
+		list_destroy(rpc_queue[i]);
+		rpc_queue[i] = NULL;
+	}
+	rpc_queue_cnt = 0;
+	slurm_mutex_unlock(&rpc_queue_mutex);
+}
+
+/*
+ * rpc_queue_depth - count of connections and RPCs waiting for a worker
+ */
+extern int rpc_queue_depth(void)
+{
+	int depth;
+
+	slurm_mutex_lock(&rpc_queue_mutex);
+	depth = rpc_queue_cnt;
+	slurm_mutex_unlock(&rpc_queue_mutex);
+
+	return depth;
+}
+
+/*
+ * rpc_queue_add_conn - queue an accepted connection which has data ready to
+ *	be read. A worker reads the message and queues it by message type.
+ * IN newsockfd - the connection's file descriptor, closed by the worker
+ */
+extern void rpc_queue_add_conn(slurm_fd_t newsockfd)
+{
+	rpc_queue_rec_t *rec = xmalloc(sizeof(rpc_queue_rec_t));
+
+	rec->newsockfd = newsockfd;
+	gettimeofday(&rec->recv_time, NULL);
+
+	slurm_mutex_lock(&rpc_queue_mutex);
+	if (rpc_shutdown || !conn_queue) {
+		slurm_mutex_unlock(&rpc_queue_mutex);
+		_close_rec(rec);
+		return;
+	}
+	list_enqueue(conn_queue, rec);
+	rpc_queue_cnt++;
+	pthread_cond_signal(&rpc_queue_cond);
+	slurm_mutex_unlock(&rpc_queue_mutex);
+}
+
+/*
+ * get_rpc_queue_stats - Get a copy of the RPC queue statistics
+ * OUT rpc_stats - per message type statistics, free the arrays with
+ *	free_rpc_queue_stats()
+ */
+extern void get_rpc_queue_stats(rpc_queue_stats_t *rpc_stats)
+{
+	rpc_user_rec_t *user_ptr;
+	int i, j;
+
+	xassert(rpc_stats);
+	slurm_mutex_lock(&rpc_queue_mutex);
+	rpc_stats->type_cnt = rpc_type_cnt;
+	rpc_stats->type_id   = xmalloc(sizeof(uint32_t) * (rpc_type_cnt + 1));
+	rpc_stats->count     = xmalloc(sizeof(uint32_t) * (rpc_type_cnt + 1));
+	rpc_stats->depth     = xmalloc(sizeof(uint32_t) * (rpc_type_cnt + 1));
+	rpc_stats->depth_max = xmalloc(sizeof(uint32_t) * (rpc_type_cnt + 1));
+	rpc_stats->latency_hist = xmalloc(sizeof(uint32_t) *
+					  (rpc_type_cnt + 1) *
+					  RPC_HIST_BUCKETS);
+	rpc_stats->user_cnt = rpc_user_cnt;
+	rpc_stats->user_id    = xmalloc(sizeof(uint32_t) * (rpc_user_cnt + 1));
+	rpc_stats->user_count = xmalloc(sizeof(uint32_t) * (rpc_user_cnt + 1));
+	rpc_stats->user_deferred  = xmalloc(sizeof(uint32_t) *
+					    (rpc_user_cnt + 1));
+	rpc_stats->user_throttled = xmalloc(sizeof(uint32_t) *
+					    (rpc_user_cnt + 1));
+	rpc_stats->user_defer_msec = xmalloc(sizeof(uint32_t) *
+					     (rpc_user_cnt + 1));
+	for (i = 0, j = 0; i < RPC_USER_HASH_SIZE; i++) {
+		for (user_ptr = rpc_user_hash[i]; user_ptr;
+		     user_ptr = user_ptr->next, j++) {
+			rpc_stats->user_id[j]    = user_ptr->uid;
+			rpc_stats->user_count[j] = user_ptr->count;
+			rpc_stats->user_deferred[j]  = user_ptr->deferred;
+			rpc_stats->user_throttled[j] = user_ptr->throttled;
+			rpc_stats->user_defer_msec[j] = user_ptr->defer_msec;
+		}
+	}
+
+	for (i = 0; i < rpc_type_cnt; i++) {
+		rpc_stats->type_id[i]   = rpc_type_stats[i].msg_type;
+		rpc_stats->count[i]     = rpc_type_stats[i].count;
+		rpc_stats->depth[i]     = rpc_type_stats[i].depth;
+		rpc_stats->depth_max[i] = rpc_type_stats[i].depth_max;
+		for (j = 0; j < RPC_HIST_BUCKETS; j++) {
+			rpc_stats->latency_hist[i * RPC_HIST_BUCKETS + j] =
+				rpc_type_stats[i].latency_hist[j];
+		}
+	}
+	slurm_mutex_unlock(&rpc_queue_mutex);
+}
+
+/* free_rpc_queue_stats - Free arrays allocated by get_rpc_queue_stats() */
+extern void free_rpc_queue_stats(rpc_queue_stats_t *rpc_stats)
+{
+	xfree(rpc_stats->type_id);
+	xfree(rpc_stats->count);
+	xfree(rpc_stats->depth);
+	xfree(rpc_stats->depth_max);
+	xfree(rpc_stats->latency_hist);
+	rpc_stats->type_cnt = 0;
+	xfree(rpc_stats->user_id);
+	xfree(rpc_stats->user_count);
+	xfree(rpc_stats->user_deferred);
+	xfree(rpc_stats->user_throttled);
+	xfree(rpc_stats->user_defer_msec);
+	rpc_stats->user_cnt = 0;
+}
+
+/* reset_rpc_queue_stats - Clear RPC counts, maximum depths and latencies */
+extern void reset_rpc_queue_stats(void)
+{
+	rpc_user_rec_t *user_ptr;
+	int i;
+
+	slurm_mutex_lock(&rpc_queue_mutex);
+	for (i = 0; i < rpc_type_cnt; i++) {
+		rpc_type_stats[i].count = 0;
+		rpc_type_stats[i].depth_max = rpc_type_stats[i].depth;
+		memset(rpc_type_stats[i].latency_hist, 0,
+		       sizeof(rpc_type_stats[i].latency_hist));
+	}
+	for (i = 0; i < RPC_USER_HASH_SIZE; i++) {
+		for (user_ptr = rpc_user_hash[i]; user_ptr;
+		     user_ptr = user_ptr->next) {
+			user_ptr->count = 0;
+			user_ptr->deferred = 0;
+			user_ptr->throttled = 0;
+			user_ptr->defer_msec = 0;
+		}
+	}
+	slurm_mutex_unlock(&rpc_queue_mutex);
+}
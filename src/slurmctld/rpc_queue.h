@@ -0,0 +1,101 @@
+/*****************************************************************************\
+ *  rpc_queue.h - queue incoming RPCs by message type for a fixed pool of
+ *	slurmctld worker threads
+ *****************************************************************************
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#ifndef _HAVE_RPC_QUEUE_H
+#define _HAVE_RPC_QUEUE_H
+
+#include "src/common/slurm_protocol_defs.h"
+
+/* Latency histogram buckets, upper bounds in milliseconds. The last bucket
+ * counts RPCs taking RPC_HIST_MAX_MSEC or longer. */
+#define RPC_HIST_BUCKETS	6
+#define RPC_HIST_MAX_MSEC	10000
+
+/* Per message type statistics, each array has type_cnt elements except
+ * latency_hist, which has type_cnt * RPC_HIST_BUCKETS elements. Per user
+ * statistics, each array has user_cnt elements. */
+typedef struct {
+	uint32_t type_cnt;	/* count of message types seen */
+	uint32_t *type_id;	/* slurm_msg_type_t of each entry */
+	uint32_t *count;	/* RPCs processed */
+	uint32_t *depth;	/* RPCs currently queued */
+	uint32_t *depth_max;	/* largest queue depth */
+	uint32_t *latency_hist;	/* RPCs by time from receipt to completion */
+
+	uint32_t user_cnt;	/* count of users seen */
+	uint32_t *user_id;	/* uid of each entry */
+	uint32_t *user_count;	/* RPCs received */
+	uint32_t *user_deferred;   /* RPCs delayed by rpc_user_rate */
+	uint32_t *user_throttled;  /* RPCs rejected by rpc_user_rate */
+	uint32_t *user_defer_msec; /* latency of deferred RPCs, msec */
+}	rpc_queue_stats_t;
+
+/*
+ * rpc_queue_init - start the RPC worker threads
+ * IN thread_cnt - number of worker threads
+ */
+extern void rpc_queue_init(int thread_cnt);
+
+/*
+ * rpc_queue_fini - stop the RPC worker threads once their current RPC
+ *	completes and close any connections still queued
+ */
+extern void rpc_queue_fini(void);
+
+/*
+ * rpc_queue_depth - count of connections and RPCs waiting for a worker
+ */
+extern int rpc_queue_depth(void);
+
+/*
+ * rpc_queue_add_conn - queue an accepted connection which has data ready to
+ *	be read. A worker reads the message and queues it by message type.
+ * IN newsockfd - the connection's file descriptor, closed by the worker
+ */
+extern void rpc_queue_add_conn(slurm_fd_t newsockfd);
+
+/*
+ * get_rpc_queue_stats - Get a copy of the RPC queue statistics
+ * OUT rpc_stats - per message type statistics, free the arrays with
+ *	free_rpc_queue_stats()
+ */
+extern void get_rpc_queue_stats(rpc_queue_stats_t *rpc_stats);
+
+/* free_rpc_queue_stats - Free arrays allocated by get_rpc_queue_stats() */
+extern void free_rpc_queue_stats(rpc_queue_stats_t *rpc_stats);
+
+/* reset_rpc_queue_stats - Clear RPC counts, maximum depths and latencies */
+extern void reset_rpc_queue_stats(void);
+
+#endif /* !_HAVE_RPC_QUEUE_H */
@@ -97,6 +97,13 @@
 #define MAX_SERVER_THREADS 256
 #endif
 
+/* Maximum connections accepted but not yet being serviced by one of the
+ * MAX_SERVER_THREADS threads. Once reached, new connections wait in the
+ * listen queue. */
+#ifndef MAX_RPC_QUEUE
+#define MAX_RPC_QUEUE (MAX_SERVER_THREADS * 4)
+#endif
+
 /* Perform full slurmctld's state every PERIODIC_CHECKPOINT seconds */
 #ifndef PERIODIC_CHECKPOINT
 #define	PERIODIC_CHECKPOINT	300
@@ -206,6 +213,8 @@ typedef struct diag_stats {
 	uint32_t bf_queue_len_sum;
 	time_t   bf_when_last_cycle;
 	uint32_t bf_active;
+	uint32_t bf_last_slices_reused;
+	uint32_t bf_last_slices_rebuilt;
 } diag_stats_t;
 
 extern diag_stats_t slurmctld_diag_stats;
@@ -500,6 +509,9 @@ struct job_record {
 	uint32_t alloc_sid;		/* local sid making resource alloc */
 	uint32_t array_job_id;		/* job_id of a job array or 0 if N/A */
 	uint32_t array_task_id;		/* task_id of a job array */
+	struct job_record *array_next;	/* next task of the same job array,
+					 * circular, see find_job_array_first */
+	struct job_record *array_prev;	/* previous task of the same job array */
 	uint32_t assoc_id;              /* used for accounting plugins */
 	void    *assoc_ptr;		/* job's association record ptr, it is
 					 * void* because of interdependencies
@@ -508,6 +520,8 @@ struct job_record {
 	uint16_t batch_flag;		/* 1 or 2 if batch job (with script),
 					 * 2 indicates retry mode (one retry) */
 	char *batch_host;		/* host executing batch script */
+	uint64_t change_seq;		/* sequence number of the job's last
+					 * change, see job_record_changed() */
 	check_jobinfo_t check_job;      /* checkpoint context, opaque */
 	uint16_t ckpt_interval;		/* checkpoint interval in minutes */
 	time_t ckpt_time;		/* last time job was periodically
@@ -548,7 +562,6 @@ struct job_record {
 					 * to be passed to slurmdbd */
 	uint32_t group_id;		/* group submitted under */
 	uint32_t job_id;		/* job ID */
-	struct job_record *job_next;	/* next entry with same hash index */
 	job_resources_t *job_resrcs;	/* details of allocated cores */
 	uint16_t job_state;		/* state of the job */
 	uint16_t kill_on_node_fail;	/* 1 if job should be killed on
@@ -586,6 +599,13 @@ struct job_record {
 					 * for this job, used to insure
 					 * epilog is not re-run for job */
 	uint16_t other_port;		/* port for client communications */
+	uint32_t pack_gen;		/* job table generation in which the
+					 * job's packed state last changed */
+	uint32_t pack_priority;		/* priority at last generation scan,
+					 * see pack_jobs_delta() */
+	bool pack_purge;		/* ready for purge at last scan */
+	uint16_t pack_reason;		/* state_reason at last scan */
+	time_t pack_start;		/* packed start time at last scan */
 	char *partition;		/* name of job partition(s) */
 	List part_ptr_list;		/* list of pointers to partition recs */
 	bool part_nodes_missing;	/* set if job's nodes removed from this
@@ -596,6 +616,9 @@ struct job_record {
 	uint32_t priority;		/* relative priority of the job,
 					 * zero == held (don't initiate) */
 	uint32_t *priority_array;	/* partition based priority */
+	uint32_t sched_seq;		/* schedule() queue records of this
+					 * job are valid only if they match,
+					 * see sched_queue_update() */
 	priority_factors_object_t *prio_factors; /* cached value used
 						  * by sprio command */
 	uint32_t profile;		/* Acct_gather_profile option */
@@ -622,6 +645,9 @@ struct job_record {
 	time_t start_time;		/* time execution begins,
 					 * actual or expected */
 	char *state_desc;		/* optional details for state_reason */
+	bool state_saved;		/* set if the job's state is in the
+					 * job_state file or its journal, see
+					 * dump_all_job_state() */
 	uint16_t state_reason;		/* reason job still pending or failed
 					 * see slurm.h:enum job_wait_reason */
 	List step_list;			/* list of job's steps */
@@ -638,6 +664,8 @@ struct job_record {
 	uint32_t total_nodes;		/* number of allocated nodes
 					 * for accounting */
 	uint32_t user_id;		/* user the job runs as */
+	struct job_record *user_next;	/* next job of the same user, circular */
+	struct job_record *user_prev;	/* previous job of the same user */
 	uint16_t wait_all_nodes;	/* if set, wait for all nodes to boot
 					 * before starting the job */
 	uint16_t warn_flags;		/* flags for signal to send */
@@ -908,6 +936,15 @@ extern List feature_list_copy(List feature_list_src);
 extern struct job_record *find_job_array_rec(uint32_t array_job_id,
 					     uint32_t array_task_id);
 
+/*
+ * find_job_array_first - return a pointer to the first job record of the
+ *	given job array. The array's other records are reached by following
+ *	job_ptr->array_next until it returns to the first record.
+ * IN array_job_id - requested job array's id
+ * RET pointer to the job's record, NULL if no such job array
+ */
+extern struct job_record *find_job_array_first(uint32_t array_job_id);
+
 /*
  * find_job_record - return a pointer to the job record with the given job_id
  * IN job_id - requested job's id
@@ -1081,6 +1118,15 @@ extern int job_checkpoint(checkpoint_msg_t *ckpt_ptr, uid_t uid,
 /* log the completion of the specified job */
 extern void job_completion_logger(struct job_record  *job_ptr, bool requeue);
 
+/*
+ * job_record_changed - note that a job record changed, so that the job is
+ *	included in the next journaled dump_all_job_state(). Callers still
+ *	set last_job_update.
+ * IN job_ptr - pointer to the changed job
+ * NOTE: run lock_slurmctld before entry: write job
+ */
+extern void job_record_changed(struct job_record *job_ptr);
+
 /*
  * job_epilog_complete - Note the completion of the epilog script for a
  *	given job
@@ -1476,6 +1522,9 @@ extern void node_no_resp_msg(void);
  * IN protocol_version - slurm protocol version of client
  * global: job_list - global list of job records
  * NOTE: the buffer at *buffer_ptr must be xfreed by the caller
+ * NOTE: call with config and job read locks and partition write lock held,
+ *	they are released while other threads wait for write locks, so jobs
+ *	may change while being packed
  * NOTE: change _unpack_job_desc_msg() in common/slurm_protocol_pack.c
  *	whenever the data format changes
  */
@@ -1483,6 +1532,24 @@ extern void pack_all_jobs(char **buffer_ptr, int *buffer_size,
 			  uint16_t show_flags, uid_t uid, uint32_t filter_uid,
 			  uint16_t protocol_version);
 
+/*
+ * pack_jobs_delta - dump information for jobs which have changed since a
+ *	client's copy of the job table was built, in machine independent form
+ *	(for network transmission)
+ * OUT buffer_ptr - the pointer is set to the allocated buffer.
+ * OUT buffer_size - set to size of the buffer in bytes
+ * IN req - client's table generation, its epoch, update time and show_flags
+ * IN uid - uid of user making request (for partition filtering)
+ * IN protocol_version - slurm protocol version of client
+ * global: job_list - global list of job records
+ * NOTE: the buffer at *buffer_ptr must be xfreed by the caller
+ * NOTE: change _unpack_job_info_delta_msg() in common/slurm_protocol_pack.c
+ *	whenever the data format changes
+ */
+extern void pack_jobs_delta(char **buffer_ptr, int *buffer_size,
+			    job_info_delta_request_msg_t *req, uid_t uid,
+			    uint16_t protocol_version);
+
 /*
  * pack_all_node - dump all configuration and node information for all nodes
  *	in machine independent form (for network transmission)
@@ -1643,7 +1710,8 @@ void purge_old_job(void);
 extern void qos_list_build(char *qos, bitstr_t **qos_bits);
 
 /*
- * rehash_jobs - Create or rebuild the job hash table.
+ * rehash_jobs - Create the job hash tables, sized from MaxJobCount. The
+ *	tables grow as needed, so later calls have no effect.
  * NOTE: run lock_slurmctld before entry: Read config, write job
  */
 extern void rehash_jobs(void);
@@ -1662,6 +1730,13 @@ extern void rebuild_step_bitmaps(struct job_record *job_ptr,
  */
 extern int post_job_step(struct step_record *step_ptr);
 
+/*
+ * prefetch_job_state - start reading the job state files in a separate
+ *	thread, overlapping the I/O with the rest of slurmctld's startup.
+ *	The contents are used by the next call to load_all_job_state().
+ */
+extern void prefetch_job_state(void);
+
 /* update first assigned job id as needed on reconfigure */
 extern void reset_first_job_id(void);
 
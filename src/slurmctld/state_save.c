@@ -45,7 +45,13 @@
 #  include <pthread.h>
 #endif                          /* WITH_PTHREADS */
 
+#include <errno.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include "src/common/macros.h"
+#include "src/common/pack.h"
+#include "src/common/xmalloc.h"
 #include "src/slurmctld/front_end.h"
 #include "src/slurmctld/reservation.h"
 #include "src/slurmctld/slurmctld.h"
@@ -94,6 +100,47 @@ extern int fsync_and_close(int fd, char *file_type)
 	return rc;
 }
 
+/* Read the full contents of a state save file. The buffer is sized from
+ * the file's size, so the file is read with few system calls and no
+ * reallocation.
+ * IN fd - file descriptor, closed before returning
+ * IN file_name - name of the file, for error messages
+ * OUT data_size - count of bytes read
+ * RET the file contents, pass to create_buf() or xfree() */
+extern char *read_state_file(int fd, char *file_name, uint32_t *data_size)
+{
+	struct stat stat_buf;
+	uint32_t data_allocated = BUF_SIZE;
+	int data_read;
+	char *data;
+
+	if ((fstat(fd, &stat_buf) == 0) && (stat_buf.st_size > 0))
+		data_allocated = stat_buf.st_size + BUF_SIZE;
+	data = xmalloc(data_allocated);
+	*data_size = 0;
+	while (1) {
+		if (*data_size >= data_allocated) {	/* file grew */
+			data_allocated += BUF_SIZE;
+			xrealloc(data, data_allocated);
+		}
+		data_read = read(fd, &data[*data_size],
+				 data_allocated - *data_size);
+		if (data_read < 0) {
+			if (errno == EINTR)
+				continue;
+			else {
+				error("Read error on %s: %m", file_name);
+				break;
+			}
+		} else if (data_read == 0)	/* eof */
+			break;
+		*data_size += data_read;
+	}
+	close(fd);
+
+	return data;
+}
+
 /* Queue saving of front_end state information */
 extern void schedule_front_end_save(void)
 {
@@ -45,6 +45,13 @@
  * RET 0 on success or -1 on error */
 extern int fsync_and_close(int fd, char *file_type);
 
+/* Read the full contents of a state save file
+ * IN fd - file descriptor, closed before returning
+ * IN file_name - name of the file, for error messages
+ * OUT data_size - count of bytes read
+ * RET the file contents, pass to create_buf() or xfree() */
+extern char *read_state_file(int fd, char *file_name, uint32_t *data_size);
+
 /* Queue saving of front_end state information */
 extern void schedule_front_end_save(void);
 
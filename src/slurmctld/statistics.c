@@ -43,10 +43,13 @@
 #include <stdio.h>
 
 #include "src/slurmctld/agent.h"
+#include "src/slurmctld/locks.h"
+#include "src/slurmctld/rpc_queue.h"
 #include "src/slurmctld/slurmctld.h"
 #include "src/common/pack.h"
 #include "src/common/xstring.h"
 #include "src/common/list.h"
+#include "src/common/slurmdbd_defs.h"
 
 extern int retry_list_size(void);
 
@@ -59,6 +62,10 @@ extern void pack_all_stat(int resp, char **buffer_ptr, int *buffer_size,
 	Buf buffer;
 	int parts_packed;
 	int agent_queue_size;
+	slurmctld_lock_stats_t lock_stats;
+	rpc_queue_stats_t rpc_stats;
+	uint32_t dbd_queue_size, dbd_drain_rate;
+	uint64_t dbd_spool_size;
 	time_t now = time(NULL);
 
 	buffer_ptr[0] = NULL;
@@ -118,6 +125,53 @@ extern void pack_all_stat(int resp, char **buffer_ptr, int *buffer_size,
 			pack32(slurmctld_diag_stats.bf_depth_try_sum, buffer);
 			pack32(slurmctld_diag_stats.bf_queue_len_sum, buffer);
 			pack32(slurmctld_diag_stats.bf_active,	 buffer);
+			if (protocol_version >= SLURM_14_03_PROTOCOL_VERSION) {
+				pack32(slurmctld_diag_stats.
+				       bf_last_slices_reused, buffer);
+				pack32(slurmctld_diag_stats.
+				       bf_last_slices_rebuilt, buffer);
+
+				get_lock_stats(&lock_stats);
+				pack32_array(lock_stats.wait_cnt,
+					     LOCK_STAT_COUNT, buffer);
+				pack64_array(lock_stats.wait_time,
+					     LOCK_STAT_COUNT, buffer);
+				pack32_array(lock_stats.wait_max,
+					     LOCK_STAT_COUNT, buffer);
+
+				get_rpc_queue_stats(&rpc_stats);
+				pack32_array(rpc_stats.type_id,
+					     rpc_stats.type_cnt, buffer);
+				pack32_array(rpc_stats.count,
+					     rpc_stats.type_cnt, buffer);
+				pack32_array(rpc_stats.depth,
+					     rpc_stats.type_cnt, buffer);
+				pack32_array(rpc_stats.depth_max,
+					     rpc_stats.type_cnt, buffer);
+				pack32(RPC_HIST_BUCKETS, buffer);
+				pack32_array(rpc_stats.latency_hist,
+					     rpc_stats.type_cnt *
+					     RPC_HIST_BUCKETS, buffer);
+
+				pack32_array(rpc_stats.user_id,
+					     rpc_stats.user_cnt, buffer);
+				pack32_array(rpc_stats.user_count,
+					     rpc_stats.user_cnt, buffer);
+				pack32_array(rpc_stats.user_deferred,
+					     rpc_stats.user_cnt, buffer);
+				pack32_array(rpc_stats.user_throttled,
+					     rpc_stats.user_cnt, buffer);
+				pack32_array(rpc_stats.user_defer_msec,
+					     rpc_stats.user_cnt, buffer);
+				free_rpc_queue_stats(&rpc_stats);
+
+				slurmdbd_agent_stats(&dbd_queue_size,
+						     &dbd_spool_size,
+						     &dbd_drain_rate);
+				pack32(dbd_queue_size, buffer);
+				pack64(dbd_spool_size, buffer);
+				pack32(dbd_drain_rate, buffer);
+			}
 		}
 	}
 
@@ -157,4 +211,9 @@ extern void reset_stats(int level)
 	slurmctld_diag_stats.bf_last_depth = 0;
 	slurmctld_diag_stats.bf_last_depth_try = 0;
 	slurmctld_diag_stats.bf_active = 0;
+	slurmctld_diag_stats.bf_last_slices_reused = 0;
+	slurmctld_diag_stats.bf_last_slices_rebuilt = 0;
+
+	reset_lock_stats();
+	reset_rpc_queue_stats();
 }
@@ -176,6 +176,7 @@ static struct step_record * _create_step_record(struct job_record *job_ptr)
 	step_ptr = (struct step_record *) xmalloc(sizeof(struct step_record));
 
 	last_job_update = time(NULL);
+	job_record_changed(job_ptr);
 	step_ptr->job_ptr    = job_ptr;
 	step_ptr->exit_code  = NO_VAL;
 	step_ptr->time_limit = INFINITE;
@@ -245,6 +246,7 @@ extern void delete_step_records (struct job_record *job_ptr)
 	step_iterator = list_iterator_create (job_ptr->step_list);
 
 	last_job_update = time(NULL);
+	job_record_changed(job_ptr);
 	while ((step_ptr = (struct step_record *) list_next (step_iterator))) {
 		uint16_t cleaning = 0;
 		select_g_select_jobinfo_get(step_ptr->select_jobinfo,
@@ -319,6 +321,7 @@ delete_step_record (struct job_record *job_ptr, uint32_t step_id)
 
 	step_iterator = list_iterator_create (job_ptr->step_list);
 	last_job_update = time(NULL);
+	job_record_changed(job_ptr);
 	while ((step_ptr = (struct step_record *) list_next (step_iterator))) {
 		if (step_ptr->step_id == step_id) {
 			list_remove (step_iterator);
@@ -661,6 +664,7 @@ int job_step_complete(uint32_t job_id, uint32_t step_id, uid_t uid,
 	_internal_step_complete(job_ptr, step_ptr, false);
 
 	last_job_update = time(NULL);
+	job_record_changed(job_ptr);
 
 	return SLURM_SUCCESS;
 }
@@ -2596,6 +2600,40 @@ static void _pack_ctld_job_step_info(struct step_record *step_ptr, Buf buffer,
 	}
 }
 
+/* Pack the job steps of one job visible to the requesting user,
+ * RET true if the job is visible */
+static bool _pack_job_steps(struct job_record *job_ptr, uint32_t step_id,
+			    uid_t uid, uint16_t show_flags, Buf buffer,
+			    uint16_t protocol_version, uint32_t *steps_packed)
+{
+	ListIterator step_iterator;
+	struct step_record *step_ptr;
+
+	if (((show_flags & SHOW_ALL) == 0) &&
+	    (job_ptr->part_ptr) &&
+	    (job_ptr->part_ptr->flags & PART_FLAG_HIDDEN))
+		return false;
+
+	if ((slurmctld_conf.private_data & PRIVATE_DATA_JOBS) &&
+	    (job_ptr->user_id != uid) && !validate_operator(uid) &&
+	    !assoc_mgr_is_user_acct_coord(acct_db_conn, uid,
+					  job_ptr->account))
+		return false;
+
+	step_iterator = list_iterator_create(job_ptr->step_list);
+	while ((step_ptr = list_next(step_iterator))) {
+		if ((step_id != NO_VAL) &&
+		    (step_ptr->step_id != step_id))
+			continue;
+		_pack_ctld_job_step_info(step_ptr, buffer,
+					 protocol_version);
+		(*steps_packed)++;
+	}
+	list_iterator_destroy(step_iterator);
+
+	return true;
+}
+
 /*
  * pack_ctld_job_step_info_response_msg - packs job step info
  * IN job_id - specific id or NO_VAL for all
@@ -2611,11 +2649,9 @@ extern int pack_ctld_job_step_info_response_msg(
 	uint16_t show_flags, Buf buffer, uint16_t protocol_version)
 {
 	ListIterator job_iterator;
-	ListIterator step_iterator;
 	int error_code = 0;
 	uint32_t steps_packed = 0, tmp_offset;
-	struct step_record *step_ptr;
-	struct job_record *job_ptr;
+	struct job_record *job_ptr, *first_job_ptr;
 	time_t now = time(NULL);
 	int valid_job = 0;
 
@@ -2624,37 +2660,34 @@ extern int pack_ctld_job_step_info_response_msg(
 
 	part_filter_set(uid);
 
-	job_iterator = list_iterator_create(job_list);
-	while ((job_ptr = list_next(job_iterator))) {
-		if ((job_id != NO_VAL) && (job_id != job_ptr->job_id) &&
-		    (job_id != job_ptr->array_job_id))
-			continue;
-
-		if (((show_flags & SHOW_ALL) == 0) &&
-		    (job_ptr->part_ptr) &&
-		    (job_ptr->part_ptr->flags & PART_FLAG_HIDDEN))
-			continue;
-
-		if ((slurmctld_conf.private_data & PRIVATE_DATA_JOBS) &&
-		    (job_ptr->user_id != uid) && !validate_operator(uid) &&
-		    !assoc_mgr_is_user_acct_coord(acct_db_conn, uid,
-						  job_ptr->account))
-			continue;
-
-		valid_job = 1;
-
-		step_iterator = list_iterator_create(job_ptr->step_list);
-		while ((step_ptr = list_next(step_iterator))) {
-			if ((step_id != NO_VAL) &&
-			    (step_ptr->step_id != step_id))
-				continue;
-			_pack_ctld_job_step_info(step_ptr, buffer,
-						 protocol_version);
-			steps_packed++;
+	if (job_id == NO_VAL) {
+		job_iterator = list_iterator_create(job_list);
+		while ((job_ptr = list_next(job_iterator))) {
+			if (_pack_job_steps(job_ptr, step_id, uid, show_flags,
+					    buffer, protocol_version,
+					    &steps_packed))
+				valid_job = 1;
+		}
+		list_iterator_destroy(job_iterator);
+	} else {
+		/* The job itself, unless it is packed with its job array
+		 * below, then the tasks of any job array with this ID */
+		job_ptr = find_job_record(job_id);
+		if (job_ptr && (job_ptr->array_job_id != job_id) &&
+		    _pack_job_steps(job_ptr, step_id, uid, show_flags,
+				    buffer, protocol_version, &steps_packed))
+			valid_job = 1;
+		job_ptr = first_job_ptr = find_job_array_first(job_id);
+		while (job_ptr) {
+			if (_pack_job_steps(job_ptr, step_id, uid, show_flags,
+					    buffer, protocol_version,
+					    &steps_packed))
+				valid_job = 1;
+			job_ptr = job_ptr->array_next;
+			if (job_ptr == first_job_ptr)
+				break;
 		}
-		list_iterator_destroy(step_iterator);
 	}
-	list_iterator_destroy(job_iterator);
 
 	if (list_count(job_list) && !valid_job && !steps_packed)
 		error_code = ESLURM_INVALID_JOB_ID;
@@ -2772,6 +2805,7 @@ extern int job_step_checkpoint(checkpoint_msg_t *ckpt_ptr,
 				   &resp_data.error_code,
 				   &resp_data.error_msg);
 		last_job_update = time(NULL);
+		job_record_changed(job_ptr);
 	}
 
     reply:
@@ -2838,6 +2872,7 @@ extern int job_step_checkpoint_comp(checkpoint_comp_msg_t *ckpt_ptr,
 		rc = checkpoint_comp((void *)step_ptr, ckpt_ptr->begin_time,
 			ckpt_ptr->error_code, ckpt_ptr->error_msg);
 		last_job_update = time(NULL);
+		job_record_changed(job_ptr);
 	}
 
     reply:
@@ -2897,6 +2932,7 @@ extern int job_step_checkpoint_task_comp(checkpoint_task_comp_msg_t *ckpt_ptr,
 			ckpt_ptr->task_id, ckpt_ptr->begin_time,
 			ckpt_ptr->error_code, ckpt_ptr->error_msg);
 		last_job_update = time(NULL);
+		job_record_changed(job_ptr);
 	}
 
     reply:
@@ -3584,6 +3620,7 @@ extern void step_checkpoint(void)
 				       (uint16_t)NO_VAL);
 			job_ptr->ckpt_time = now;
 			last_job_update = now;
+			job_record_changed(job_ptr);
 			continue; /* ignore periodic step ckpt */
 		}
 		step_iterator = list_iterator_create (job_ptr->step_list);
@@ -3610,6 +3647,7 @@ extern void step_checkpoint(void)
 
 			step_ptr->ckpt_time = now;
 			last_job_update = now;
+			job_record_changed(job_ptr);
 			image_dir = xstrdup(step_ptr->ckpt_dir);
 			xstrfmtcat(image_dir, "/%u.%u", job_ptr->job_id,
 				   step_ptr->step_id);
@@ -3868,8 +3906,10 @@ extern int update_step(step_update_request_msg_t *req, uid_t uid)
 			     req->job_id, req->step_id, req->time_limit);
 		}
 	}
-	if (mod_cnt)
+	if (mod_cnt) {
 		last_job_update = time(NULL);
+		job_record_changed(job_ptr);
+	}
 
 	return SLURM_SUCCESS;
 }
@@ -3968,6 +4008,7 @@ extern int post_job_step(struct step_record *step_ptr)
 				 step_ptr->step_id);
 
 	last_job_update = time(NULL);
+	job_record_changed(job_ptr);
 	step_ptr->state = JOB_COMPLETE;
 
 	error_code = delete_step_record(job_ptr, step_ptr->step_id);
@@ -0,0 +1,539 @@
+/*****************************************************************************\
+ *  src/slurmd/slurmd/file_bcast.c - per-file writer processes for sbcast
+ *****************************************************************************
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+
+#if HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <grp.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <utime.h>
+
+#include "src/common/fd.h"
+#include "src/common/list.h"
+#include "src/common/log.h"
+#include "src/common/macros.h"
+#include "src/common/slurm_lz.h"
+#include "src/common/xmalloc.h"
+#include "src/common/xstring.h"
+#include "src/slurmd/common/job_container_plugin.h"
+#include "src/slurmd/slurmd/file_bcast.h"
+
+/* Writers which receive no block for this many seconds are assumed to
+ * have been abandoned by sbcast and are stopped */
+#define BCAST_IDLE_TIMEOUT	600
+
+/* Header sent to a writer process ahead of each block's data */
+typedef struct {
+	uint64_t offset;	/* file offset of the block */
+	uint32_t block_len;	/* bytes of data following the header */
+	uint16_t last_block;	/* set modes and times once written */
+} bcast_block_hdr_t;
+
+typedef struct {
+	uint32_t job_id;
+	uid_t uid;
+	char *fname;
+	pid_t pid;		/* writer process */
+	int to_fd;		/* pipe carrying blocks to the writer */
+	int from_fd;		/* pipe carrying return codes back */
+	uint32_t block_cnt;	/* blocks written */
+	uint64_t bytes;		/* bytes written */
+	uint64_t sent_bytes;	/* bytes received, after any compression */
+	struct timeval start;	/* time block one arrived */
+	time_t last_use;	/* time the last block arrived */
+	bool busy;		/* an RPC is passing a block to the writer */
+	bool removed;		/* no longer in bcast_list */
+	int ref_cnt;		/* RPCs holding a pointer to this record */
+} bcast_file_t;
+
+static List bcast_list = NULL;
+static pthread_mutex_t bcast_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  bcast_cond  = PTHREAD_COND_INITIALIZER;
+
+static void _close_file(bcast_file_t *file);
+static void _close_files(List stale);
+static bcast_file_t *_find_file(uint32_t job_id, uid_t uid, char *fname);
+static int  _find_ptr(void *x, void *key);
+static void _finish_file(int fd, file_bcast_msg_t *req, uid_t uid);
+static void _purge_files(List stale, uint32_t job_id, time_t idle_before);
+static void _remove_file(bcast_file_t *file, List stale);
+static int  _send_block(bcast_file_t *file, bcast_block_hdr_t *hdr,
+			char *data);
+static void _writer(file_bcast_msg_t *req, uint32_t job_id, uid_t uid,
+		    gid_t gid, int ngroups, gid_t *groups,
+		    int in_fd, int out_fd);
+
+/* Stop a writer and free its record. The writer has normally exited on
+ * its own by now, otherwise it is killed. Call without bcast_mutex. */
+static void _close_file(bcast_file_t *file)
+{
+	close(file->to_fd);
+	close(file->from_fd);
+	if (file->pid > 0) {
+		kill(file->pid, SIGKILL);
+		if (waitpid(file->pid, NULL, 0) < 0)
+			error("sbcast: waitpid(%d): %m", (int) file->pid);
+	}
+	xfree(file->fname);
+	xfree(file);
+}
+
+static void _close_files(List stale)
+{
+	bcast_file_t *file;
+
+	while ((file = list_pop(stale)))
+		_close_file(file);
+	list_destroy(stale);
+}
+
+/* Call with bcast_mutex locked */
+static bcast_file_t *_find_file(uint32_t job_id, uid_t uid, char *fname)
+{
+	ListIterator iter;
+	bcast_file_t *file;
+
+	if (!bcast_list)
+		return NULL;
+	iter = list_iterator_create(bcast_list);
+	while ((file = list_next(iter))) {
+		if ((file->job_id == job_id) && (file->uid == uid) &&
+		    !strcmp(file->fname, fname))
+			break;
+	}
+	list_iterator_destroy(iter);
+	return file;
+}
+
+static int _find_ptr(void *x, void *key)
+{
+	return (x == key);
+}
+
+/* Remove a record from bcast_list. It is added to the stale list for
+ * closing once bcast_mutex is released, unless an RPC is still using it,
+ * in which case the last such RPC closes it. Call with bcast_mutex locked */
+static void _remove_file(bcast_file_t *file, List stale)
+{
+	list_delete_all(bcast_list, _find_ptr, file);
+	file->removed = true;
+	if (file->ref_cnt == 0)
+		list_append(stale, file);
+	pthread_cond_broadcast(&bcast_cond);
+}
+
+/* Remove records for the given job (any job if NO_VAL) which have been
+ * idle since before idle_before (regardless of use if zero).
+ * Call with bcast_mutex locked */
+static void _purge_files(List stale, uint32_t job_id, time_t idle_before)
+{
+	ListIterator iter;
+	bcast_file_t *file;
+
+	if (!bcast_list)
+		return;
+	iter = list_iterator_create(bcast_list);
+	while ((file = list_next(iter))) {
+		if ((job_id != NO_VAL) && (file->job_id != job_id))
+			continue;
+		if (idle_before && (file->last_use >= idle_before))
+			continue;
+		debug("sbcast: stopping writer for job %u file %s",
+		      file->job_id, file->fname);
+		list_remove(iter);
+		file->removed = true;
+		if (file->ref_cnt == 0)
+			list_append(stale, file);
+	}
+	list_iterator_destroy(iter);
+	pthread_cond_broadcast(&bcast_cond);
+}
+
+/* Pass one block to a writer and return its return code */
+static int _send_block(bcast_file_t *file, bcast_block_hdr_t *hdr,
+		       char *data)
+{
+	int rc;
+
+	safe_write(file->to_fd, hdr, sizeof(bcast_block_hdr_t));
+	safe_write(file->to_fd, data, hdr->block_len);
+	safe_read(file->from_fd, &rc, sizeof(int));
+	return rc;
+
+rwfail:
+	error("sbcast: lost writer for job %u file %s: %m",
+	      file->job_id, file->fname);
+	return SLURM_ERROR;
+}
+
+/* Set the modes, owner and times of a completely written file */
+static void _finish_file(int fd, file_bcast_msg_t *req, uid_t uid)
+{
+	if (fchmod(fd, (req->modes & 0777))) {
+		error("sbcast: uid:%u can't chmod `%s`: %s",
+		      uid, req->fname, strerror(errno));
+	}
+	if (fchown(fd, req->uid, req->gid)) {
+		error("sbcast: uid:%u can't chown `%s`: %s",
+		      uid, req->fname, strerror(errno));
+	}
+	close(fd);
+	if (req->atime) {
+		struct utimbuf time_buf;
+		time_buf.actime  = req->atime;
+		time_buf.modtime = req->mtime;
+		if (utime(req->fname, &time_buf)) {
+			error("sbcast: uid:%u can't utime `%s`: %s",
+			      uid, req->fname, strerror(errno));
+		}
+	}
+}
+
+/* Body of the writer process: drop privileges, open the file, then write
+ * each block received from slurmd at its offset and reply with a return
+ * code. A writer which could not open the file still reads the first
+ * block so that slurmd always finds a reply. Exits after the last block,
+ * on error, or when slurmd closes the pipe. */
+static void _writer(file_bcast_msg_t *req, uint32_t job_id, uid_t uid,
+		    gid_t gid, int ngroups, gid_t *groups,
+		    int in_fd, int out_fd)
+{
+	bcast_block_hdr_t hdr;
+	char *data = NULL;
+	uint32_t data_size = 0, done;
+	ssize_t inx;
+	int fd = -1, flags, rc = SLURM_SUCCESS;
+
+	/*********************************************************************\
+	 * NOTE: As with other processes forked by slurmd without an exec(),
+	 * the logging performed by error() should be safe due to the use of
+	 * atfork_install_handlers() as defined in src/common/log.c. Do not
+	 * use other locks here.
+	\*********************************************************************/
+
+	/* container_g_add_pid needs to be called in the forked process to
+	 * avoid a race condition where the file is created before the pid
+	 * is added to the container */
+	if (container_g_add_pid(job_id, getpid(), uid) != SLURM_SUCCESS)
+		error("container_g_add_pid(%u): %m", job_id);
+
+	if (setgroups(ngroups, groups) < 0) {
+		error("sbcast: uid: %u setgroups: %s", uid, strerror(errno));
+		rc = errno;
+	} else if (setgid(gid) < 0) {
+		error("sbcast: uid:%u setgid(%u): %s", uid, gid,
+		      strerror(errno));
+		rc = errno;
+	} else if (setuid(uid) < 0) {
+		error("sbcast: getuid(%u): %s", uid, strerror(errno));
+		rc = errno;
+	} else {
+		flags = O_WRONLY | O_CREAT;
+		if (req->force)
+			flags |= O_TRUNC;
+		else
+			flags |= O_EXCL;
+		fd = open(req->fname, flags, 0700);
+		if (fd == -1) {
+			error("sbcast: uid:%u can't open `%s`: %s",
+			      uid, req->fname, strerror(errno));
+			rc = errno;
+		}
+	}
+
+	while (1) {
+		safe_read(in_fd, &hdr, sizeof(bcast_block_hdr_t));
+		if (hdr.block_len > data_size) {
+			data_size = hdr.block_len;
+			xrealloc(data, data_size);
+		}
+		safe_read(in_fd, data, hdr.block_len);
+
+		done = 0;
+		while ((rc == SLURM_SUCCESS) && (done < hdr.block_len)) {
+			inx = pwrite(fd, data + done, hdr.block_len - done,
+				     hdr.offset + done);
+			if (inx == -1) {
+				if ((errno == EINTR) || (errno == EAGAIN))
+					continue;
+				error("sbcast: uid:%u can't write `%s`: %s",
+				      uid, req->fname, strerror(errno));
+				rc = errno;
+			} else
+				done += inx;
+		}
+		if ((rc == SLURM_SUCCESS) && hdr.last_block) {
+			_finish_file(fd, req, uid);
+			fd = -1;
+		}
+
+		safe_write(out_fd, &rc, sizeof(int));
+		if ((rc != SLURM_SUCCESS) || hdr.last_block)
+			break;
+	}
+
+rwfail:
+	if (fd >= 0)
+		close(fd);
+	exit(rc);
+}
+
+extern int file_bcast_open(file_bcast_msg_t *req, uint32_t job_id,
+			   uid_t uid, gid_t gid, int ngroups, gid_t *groups)
+{
+	int to_pipe[2], from_pipe[2];
+	bcast_file_t *file;
+	ListIterator iter;
+	List stale;
+	pid_t pid;
+	int rc = SLURM_SUCCESS;
+
+	stale = list_create(NULL);
+	slurm_mutex_lock(&bcast_mutex);
+	if (!bcast_list)
+		bcast_list = list_create(NULL);
+	_purge_files(stale, NO_VAL, time(NULL) - BCAST_IDLE_TIMEOUT);
+	if ((file = _find_file(job_id, uid, req->fname))) {
+		debug("sbcast: restarting transfer of job %u file %s",
+		      job_id, req->fname);
+		_remove_file(file, stale);
+	}
+
+	if (pipe(to_pipe) < 0) {
+		error("sbcast: pipe: %m");
+		rc = errno;
+		goto fini;
+	}
+	if (pipe(from_pipe) < 0) {
+		error("sbcast: pipe: %m");
+		rc = errno;
+		close(to_pipe[0]);
+		close(to_pipe[1]);
+		goto fini;
+	}
+
+	/* Fork with bcast_mutex held so the child can safely walk the lists
+	 * and close the pipes of the other writers */
+	pid = fork();
+	if (pid == 0) {
+		close(to_pipe[1]);
+		close(from_pipe[0]);
+		iter = list_iterator_create(bcast_list);
+		while ((file = list_next(iter))) {
+			close(file->to_fd);
+			close(file->from_fd);
+		}
+		list_iterator_destroy(iter);
+		iter = list_iterator_create(stale);
+		while ((file = list_next(iter))) {
+			close(file->to_fd);
+			close(file->from_fd);
+		}
+		list_iterator_destroy(iter);
+		_writer(req, job_id, uid, gid, ngroups, groups,
+			to_pipe[0], from_pipe[1]);
+	}
+	if (pid < 0) {
+		error("sbcast: fork failure: %m");
+		rc = errno;
+	}
+	close(to_pipe[0]);
+	close(from_pipe[1]);
+	if (pid < 0) {
+		close(to_pipe[1]);
+		close(from_pipe[0]);
+		goto fini;
+	}
+
+	/* Keep the pipes out of slurmstepd and scripts run by slurmd */
+	fd_set_close_on_exec(to_pipe[1]);
+	fd_set_close_on_exec(from_pipe[0]);
+
+	file = xmalloc(sizeof(bcast_file_t));
+	file->job_id     = job_id;
+	file->uid        = uid;
+	file->fname      = xstrdup(req->fname);
+	file->pid        = pid;
+	file->to_fd      = to_pipe[1];
+	file->from_fd    = from_pipe[0];
+	file->last_use   = time(NULL);
+	gettimeofday(&file->start, NULL);
+	list_append(bcast_list, file);
+
+fini:
+	slurm_mutex_unlock(&bcast_mutex);
+	_close_files(stale);
+	return rc;
+}
+
+extern int file_bcast_write(file_bcast_msg_t *req, uint32_t job_id,
+			    uid_t uid)
+{
+	bcast_block_hdr_t hdr;
+	bcast_file_t *file;
+	struct timeval now;
+	double secs;
+	char *data = req->block, *uncomp = NULL;
+	uint32_t data_len = req->block_len;
+	bool close_it = false;
+	int rc = SLURM_SUCCESS;
+
+	/* Decompress before taking any lock, so that blocks of a file which
+	 * arrive together are decompressed in parallel */
+	if (req->compress == FILE_BCAST_COMPRESS_LZ) {
+		/* Bound the allocation by what the block could hold */
+		if ((req->uncomp_len > FILE_BCAST_MAX_UNCOMP_LEN) ||
+		    ((uint64_t) req->uncomp_len >
+		     ((uint64_t) req->block_len * SLURM_LZ_MAX_RATIO))) {
+			error("sbcast: job %u file %s block %u has invalid "
+			      "uncompressed length %u", job_id, req->fname,
+			      req->block_no, req->uncomp_len);
+			return SLURM_ERROR;
+		}
+		uncomp = xmalloc(req->uncomp_len);
+		data_len = slurm_lz_decompress(req->block, req->block_len,
+					       uncomp, req->uncomp_len);
+		if (data_len != req->uncomp_len) {
+			error("sbcast: job %u file %s block %u is corrupt",
+			      job_id, req->fname, req->block_no);
+			xfree(uncomp);
+			return SLURM_ERROR;
+		}
+		data = uncomp;
+	} else if (req->compress != FILE_BCAST_COMPRESS_NONE) {
+		error("sbcast: job %u file %s block %u has unknown "
+		      "compression %u", job_id, req->fname, req->block_no,
+		      req->compress);
+		return SLURM_ERROR;
+	}
+
+	slurm_mutex_lock(&bcast_mutex);
+	if (!(file = _find_file(job_id, uid, req->fname))) {
+		slurm_mutex_unlock(&bcast_mutex);
+		error("sbcast: no transfer of job %u file %s in progress "
+		      "for block %u", job_id, req->fname, req->block_no);
+		xfree(uncomp);
+		return SLURM_ERROR;
+	}
+
+	/* Blocks of one file are written one at a time */
+	file->ref_cnt++;
+	while (file->busy && !file->removed)
+		pthread_cond_wait(&bcast_cond, &bcast_mutex);
+	if (file->removed) {
+		error("sbcast: transfer of job %u file %s ended before "
+		      "block %u", job_id, req->fname, req->block_no);
+		rc = SLURM_ERROR;
+		goto fini;
+	}
+	/* Clients which predate block_offset send blocks strictly in order.
+	 * Others may have several blocks in flight, but send the last block,
+	 * which completes the file, only once all others are written. */
+	if ((!req->block_offset || req->last_block) &&
+	    (req->block_no != file->block_cnt + 1)) {
+		error("sbcast: job %u file %s received block %u, expected %u",
+		      job_id, req->fname, req->block_no, file->block_cnt + 1);
+		rc = SLURM_ERROR;
+		list_delete_all(bcast_list, _find_ptr, file);
+		file->removed = true;
+		goto fini;
+	}
+
+	if (req->block_offset)
+		hdr.offset = req->block_offset;
+	else
+		hdr.offset = file->bytes;
+	hdr.block_len  = data_len;
+	hdr.last_block = req->last_block;
+	file->busy = true;
+	slurm_mutex_unlock(&bcast_mutex);
+
+	rc = _send_block(file, &hdr, data);
+
+	slurm_mutex_lock(&bcast_mutex);
+	file->busy = false;
+	if (rc == SLURM_SUCCESS) {
+		file->block_cnt++;
+		file->bytes      += data_len;
+		file->sent_bytes += req->block_len;
+		file->last_use    = time(NULL);
+	}
+	if ((rc == SLURM_SUCCESS) && req->last_block) {
+		gettimeofday(&now, NULL);
+		secs = (now.tv_sec - file->start.tv_sec) +
+		       ((now.tv_usec - file->start.tv_usec) / 1000000.0);
+		info("sbcast: job %u file %s: %"PRIu64" bytes (%"PRIu64" "
+		     "received) in %u blocks, %.3f sec, %.2f MB/sec",
+		     job_id, file->fname, file->bytes, file->sent_bytes,
+		     file->block_cnt, secs,
+		     (secs > 0) ? (file->bytes / secs / 1048576.0) : 0.0);
+	}
+	if (((rc != SLURM_SUCCESS) || req->last_block) && !file->removed) {
+		list_delete_all(bcast_list, _find_ptr, file);
+		file->removed = true;
+	}
+
+fini:
+	file->ref_cnt--;
+	if (file->removed && (file->ref_cnt == 0))
+		close_it = true;
+	pthread_cond_broadcast(&bcast_cond);
+	slurm_mutex_unlock(&bcast_mutex);
+	if (close_it)
+		_close_file(file);
+	xfree(uncomp);
+	return rc;
+}
+
+extern void file_bcast_purge(uint32_t job_id)
+{
+	List stale = list_create(NULL);
+
+	slurm_mutex_lock(&bcast_mutex);
+	_purge_files(stale, job_id, (time_t) 0);
+	slurm_mutex_unlock(&bcast_mutex);
+	_close_files(stale);
+}
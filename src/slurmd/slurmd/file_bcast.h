@@ -0,0 +1,74 @@
+/*****************************************************************************\
+ *  src/slurmd/slurmd/file_bcast.h - per-file writer processes for sbcast
+ *****************************************************************************
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#ifndef _FILE_BCAST_H
+#define _FILE_BCAST_H
+
+#include <sys/types.h>
+
+#include "src/common/slurm_protocol_defs.h"
+
+/*
+ * file_bcast_open - Start a writer process for the file named in the first
+ *	block of an sbcast. The writer runs as the requesting user inside the
+ *	job's container and keeps the file open until the last block arrives.
+ *	Any writer left over from an earlier transfer of the same file is
+ *	stopped first.
+ * IN req - block number one of the file
+ * IN job_id - job the credential was issued for
+ * IN uid, gid, ngroups, groups - identity of the writer process
+ * RET SLURM_SUCCESS or an errno value
+ */
+extern int file_bcast_open(file_bcast_msg_t *req, uint32_t job_id,
+			   uid_t uid, gid_t gid, int ngroups, gid_t *groups);
+
+/*
+ * file_bcast_write - Pass one block of a file to its writer process and
+ *	wait for the block to be written. Compressed blocks are expanded
+ *	first. The writer exits after the last block or any error.
+ * IN req - the block to write. Blocks with a block_offset may arrive in
+ *	any order after block one, but the last block must arrive last.
+ * IN job_id - job the credential was issued for
+ * IN uid - requesting user
+ * RET SLURM_SUCCESS or an errno value
+ */
+extern int file_bcast_write(file_bcast_msg_t *req, uint32_t job_id,
+			    uid_t uid);
+
+/*
+ * file_bcast_purge - Stop the writer processes of a job, or of all jobs
+ *	if job_id is NO_VAL. Partially written files are left in place.
+ */
+extern void file_bcast_purge(uint32_t job_id);
+
+#endif /* !_FILE_BCAST_H */
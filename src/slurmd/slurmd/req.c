@@ -83,8 +83,13 @@
 #include "src/common/xmalloc.h"
 #include "src/common/plugstack.h"
 
+#include "src/slurmd/slurmd/file_bcast.h"
 #include "src/slurmd/slurmd/get_mach_stat.h"
 #include "src/slurmd/slurmd/slurmd.h"
+#include "src/slurmd/slurmd/step_registry.h"
+#include "src/slurmd/slurmd/rpc_queue.h"
+#include "src/slurmd/slurmd/req.h"
+#include "src/slurmd/slurmd/stepd_pool.h"
 #include "src/slurmd/slurmd/reverse_tree_math.h"
 #include "src/slurmd/slurmd/xcpu.h"
 
@@ -204,6 +209,7 @@ static gids_t *_gids_cache_lookup(char *user, gid_t gid);
 
 static int  _add_starting_step(slurmd_step_type_t type, void *req);
 static int  _remove_starting_step(slurmd_step_type_t type, void *req);
+static void _register_step(slurmd_step_type_t type, void *req);
 static int  _compare_starting_steps(void *s0, void *s1);
 static int  _wait_for_starting_step(uint32_t job_id, uint32_t step_id);
 static bool _step_is_starting(uint32_t job_id, uint32_t step_id);
@@ -378,7 +384,6 @@ slurmd_req(slurm_msg_t *msg)
 		break;
 	case REQUEST_PING:
 		_rpc_ping(msg);
-		last_slurmctld_msg = time(NULL);
 		/* No body to free */
 		break;
 	case REQUEST_HEALTH_CHECK:
@@ -676,155 +681,80 @@ rwfail:
 
 
 /*
- * Fork and exec the slurmstepd, then send the slurmstepd its
+ * Get a slurmstepd from stepd_pool_get(), then send the slurmstepd its
  * initialization data.  Then wait for slurmstepd to send an "ok"
  * message before returning.  When the "ok" message is received,
  * the slurmstepd has created and begun listening on its unix
  * domain socket.
- *
- * Note that this code forks twice and it is the grandchild that
- * becomes the slurmstepd process, so the slurmstepd's parent process
- * will be init, not slurmd.
  */
 static int
 _forkexec_slurmstepd(slurmd_step_type_t type, void *req,
 		     slurm_addr_t *cli, slurm_addr_t *self,
 		     const hostset_t step_hset)
 {
-	pid_t pid;
-	int to_stepd[2] = {-1, -1};
-	int to_slurmd[2] = {-1, -1};
-
-	if (pipe(to_stepd) < 0 || pipe(to_slurmd) < 0) {
-		error("_forkexec_slurmstepd pipe failed: %m");
-		return SLURM_FAILURE;
-	}
+	int to_stepd = -1, to_slurmd = -1;
+	int rc = 0;
+	bool spare = false;
+	struct timeval start_tv;
+#ifndef SLURMSTEPD_MEMCHECK
+	time_t start_time = time(NULL);
+#endif
 
+	gettimeofday(&start_tv, NULL);
 	if (_add_starting_step(type, req)) {
 		error("_forkexec_slurmstepd failed in _add_starting_step: %m");
 		return SLURM_FAILURE;
 	}
 
-	if ((pid = fork()) < 0) {
-		error("_forkexec_slurmstepd: fork: %m");
-		close(to_stepd[0]);
-		close(to_stepd[1]);
-		close(to_slurmd[0]);
-		close(to_slurmd[1]);
+	if (stepd_pool_get(&to_stepd, &to_slurmd, &spare) != SLURM_SUCCESS) {
 		_remove_starting_step(type, req);
 		return SLURM_FAILURE;
-	} else if (pid > 0) {
-		int rc = 0;
-#ifndef SLURMSTEPD_MEMCHECK
-		time_t start_time = time(NULL);
-#endif
-		/*
-		 * Parent sends initialization data to the slurmstepd
-		 * over the to_stepd pipe, and waits for the return code
-		 * reply on the to_slurmd pipe.
-		 */
-		if (close(to_stepd[0]) < 0)
-			error("Unable to close read to_stepd in parent: %m");
-		if (close(to_slurmd[1]) < 0)
-			error("Unable to close write to_slurmd in parent: %m");
-
-		if ((rc = _send_slurmstepd_init(to_stepd[1], type,
-						req, cli, self,
-						step_hset)) != 0) {
-			error("Unable to init slurmstepd");
-			goto done;
-		}
+	}
 
-		/* If running under memcheck stdout doesn't work correctly so
-		 * just skip it.
-		 */
+	/*
+	 * Send initialization data to the slurmstepd over the to_stepd
+	 * pipe, and wait for the return code reply on the to_slurmd pipe.
+	 */
+	if ((rc = _send_slurmstepd_init(to_stepd, type,
+					req, cli, self,
+					step_hset)) != 0) {
+		error("Unable to init slurmstepd");
+		goto done;
+	}
+
+	/* If running under memcheck stdout doesn't work correctly so
+	 * just skip it.
+	 */
 #ifndef SLURMSTEPD_MEMCHECK
-		if (read(to_slurmd[0], &rc, sizeof(int)) != sizeof(int)) {
-			error("Error reading return code message "
-			      "from slurmstepd: %m");
-			rc = SLURM_FAILURE;
-		} else {
-			int delta_time = time(NULL) - start_time;
-			if (delta_time > 5) {
-				info("Warning: slurmstepd startup took %d sec, "
-				     "possible file system problem or full "
-				     "memory", delta_time);
-			}
-		}
-#endif
-	done:
-		if (_remove_starting_step(type, req))
-			error("Error cleaning up starting_step list");
-
-		/* Reap child */
-		if (waitpid(pid, NULL, 0) < 0)
-			error("Unable to reap slurmd child process");
-		if (close(to_stepd[1]) < 0)
-			error("close write to_stepd in parent: %m");
-		if (close(to_slurmd[0]) < 0)
-			error("close read to_slurmd in parent: %m");
-		return rc;
+	if (read(to_slurmd, &rc, sizeof(int)) != sizeof(int)) {
+		error("Error reading return code message "
+		      "from slurmstepd: %m");
+		rc = SLURM_FAILURE;
 	} else {
-#ifndef SLURMSTEPD_MEMCHECK
-		char *const argv[2] = { (char *)conf->stepd_loc, NULL};
-#else
-		char *const argv[3] = {"memcheck",
-				       (char *)conf->stepd_loc, NULL};
-#endif
-		int failed = 0;
-		/* inform slurmstepd about our config */
-		setenv("SLURM_CONF", conf->conffile, 1);
-
-		/*
-		 * Child forks and exits
-		 */
-		if (setsid() < 0) {
-			error("_forkexec_slurmstepd: setsid: %m");
-			failed = 1;
-		}
-		if ((pid = fork()) < 0) {
-			error("_forkexec_slurmstepd: "
-			      "Unable to fork grandchild: %m");
-			failed = 2;
-		} else if (pid > 0) { /* child */
-			exit(0);
-		}
-
-		/*
-		 * Grandchild exec's the slurmstepd
-		 */
-		slurm_shutdown_msg_engine(conf->lfd);
-
-		if (close(to_stepd[1]) < 0)
-			error("close write to_stepd in grandchild: %m");
-		if (close(to_slurmd[0]) < 0)
-			error("close read to_slurmd in parent: %m");
-
-		(void) close(STDIN_FILENO); /* ignore return */
-		if (dup2(to_stepd[0], STDIN_FILENO) == -1) {
-			error("dup2 over STDIN_FILENO: %m");
-			exit(1);
-		}
-		fd_set_close_on_exec(to_stepd[0]);
-		(void) close(STDOUT_FILENO); /* ignore return */
-		if (dup2(to_slurmd[1], STDOUT_FILENO) == -1) {
-			error("dup2 over STDOUT_FILENO: %m");
-			exit(1);
+		int delta_time = time(NULL) - start_time;
+		if (delta_time > 5) {
+			info("Warning: slurmstepd startup took %d sec, "
+			     "possible file system problem or full "
+			     "memory", delta_time);
 		}
-		fd_set_close_on_exec(to_slurmd[1]);
-		(void) close(STDERR_FILENO); /* ignore return */
-		if (dup2(devnull, STDERR_FILENO) == -1) {
-			error("dup2 /dev/null to STDERR_FILENO: %m");
-			exit(1);
-		}
-		fd_set_noclose_on_exec(STDERR_FILENO);
-		log_fini();
-		if (!failed) {
-			execvp(argv[0], argv);
-			error("exec of slurmstepd failed: %m");
-		}
-		exit(2);
 	}
+#endif
+	if (rc == SLURM_SUCCESS)
+		stepd_pool_launch_done(&start_tv, spare);
+
+done:
+	/* Register the step before it leaves the starting_steps
+	 * list, so it is always found in one or the other */
+	if (rc == SLURM_SUCCESS)
+		_register_step(type, req);
+	if (_remove_starting_step(type, req))
+		error("Error cleaning up starting_step list");
+
+	if (close(to_stepd) < 0)
+		error("close write to_stepd in parent: %m");
+	if (close(to_slurmd) < 0)
+		error("close read to_slurmd in parent: %m");
+	return rc;
 }
 
 
@@ -1664,7 +1594,7 @@ _rpc_job_notify(slurm_msg_t *msg)
 		return;
 	}
 
-	steps = stepd_available(conf->spooldir, conf->node_name);
+	steps = step_registry_available(req->job_id);
 	i = list_iterator_create(steps);
 	while ((stepd = list_next(i))) {
 		if ((stepd->jobid  != req->job_id) ||
@@ -1846,7 +1776,7 @@ _load_job_limits(void)
 		job_limits_list = list_create(_job_limits_free);
 	job_limits_loaded = true;
 
-	steps = stepd_available(conf->spooldir, conf->node_name);
+	steps = step_registry_available(NO_VAL);
 	step_iter = list_iterator_create(steps);
 	while ((stepd = list_next(step_iter))) {
 		job_limits_ptr = list_find_first(job_limits_list,
@@ -1973,7 +1903,7 @@ _enforce_job_mem_limit(void)
 		job_mem_info_ptr[i].vsize_limit *= (vsize_factor / 100.0);
 	}
 
-	steps = stepd_available(conf->spooldir, conf->node_name);
+	steps = step_registry_available(NO_VAL);
 	step_iter = list_iterator_create(steps);
 	while ((stepd = list_next(step_iter))) {
 		for (job_inx=0; job_inx<job_cnt; job_inx++) {
@@ -2065,6 +1995,16 @@ _enforce_job_mem_limit(void)
 
 static int
 _rpc_ping(slurm_msg_t *msg)
+{
+	int rc, reply_rc;
+
+	rc = slurmd_ping_reply(msg, &reply_rc);
+	slurmd_ping_finish(reply_rc);
+	return rc;
+}
+
+extern int
+slurmd_ping_reply(slurm_msg_t *msg, int *reply_rc)
 {
 	int        rc = SLURM_SUCCESS;
 	uid_t req_uid = g_slurm_auth_get_uid(msg->auth_cred, NULL);
@@ -2081,6 +2021,7 @@ _rpc_ping(slurm_msg_t *msg)
 	}
 	first_msg = false;
 
+	*reply_rc = SLURM_SUCCESS;
 	if (rc != SLURM_SUCCESS) {
 		/* Return result. If the reply can't be sent this indicates
 		 * 1. The network is broken OR
@@ -2089,10 +2030,10 @@ _rpc_ping(slurm_msg_t *msg)
 		 * If the reply request fails, we send an registration message
 		 * to slurmctld in hopes of avoiding having the node set DOWN
 		 * due to slurmd paging and not being able to respond in a
-		 * timely fashion. */
+		 * timely fashion, see slurmd_ping_finish(). */
 		if (slurm_send_rc_msg(msg, rc) < 0) {
 			error("Error responding to ping: %m");
-			send_registration_msg(SLURM_SUCCESS, false);
+			*reply_rc = SLURM_ERROR;
 		}
 	} else {
 		slurm_msg_t resp_msg;
@@ -2105,9 +2046,18 @@ _rpc_ping(slurm_msg_t *msg)
 		slurm_send_node_msg(msg->conn_fd, &resp_msg);
 	}
 
+	last_slurmctld_msg = time(NULL);
+	return rc;
+}
+
+extern void
+slurmd_ping_finish(int reply_rc)
+{
+	if (reply_rc != SLURM_SUCCESS)
+		send_registration_msg(SLURM_SUCCESS, false);
+
 	/* Take this opportunity to enforce any job memory limits */
 	_enforce_job_mem_limit();
-	return rc;
 }
 
 static int
@@ -2465,7 +2415,7 @@ _get_step_list(void)
 	ListIterator i;
 	step_loc_t *stepd;
 
-	steps = stepd_available(conf->spooldir, conf->node_name);
+	steps = step_registry_available(NO_VAL);
 	i = list_iterator_create(steps);
 	while ((stepd = list_next(i))) {
 		int fd;
@@ -2523,6 +2473,8 @@ _rpc_daemon_status(slurm_msg_t *msg)
 	resp->slurmd_debug       = conf->debug_level;
 	resp->slurmd_logfile     = xstrdup(conf->logfile);
 	resp->version            = xstrdup(SLURM_VERSION_STRING);
+	stepd_pool_get_stats(resp);
+	rpc_queue_get_stats(resp);
 
 	slurm_msg_t_copy(&resp_msg, msg);
 	resp_msg.msg_type = RESPONSE_SLURMD_STATUS;
@@ -2778,7 +2730,7 @@ static void  _rpc_pid2jid(slurm_msg_t *msg)
 	ListIterator i;
 	step_loc_t *stepd;
 
-	steps = stepd_available(conf->spooldir, conf->node_name);
+	steps = step_registry_available(NO_VAL);
 	i = list_iterator_create(steps);
 	while ((stepd = list_next(i))) {
 		int fd;
@@ -2883,12 +2835,11 @@ static int
 _rpc_file_bcast(slurm_msg_t *msg)
 {
 	file_bcast_msg_t *req = msg->data;
-	int fd, flags, offset, inx, rc;
+	int rc;
 	int ngroups = 16;
 	gid_t *groups;
 	uid_t req_uid = g_slurm_auth_get_uid(msg->auth_cred, NULL);
 	gid_t req_gid = g_slurm_auth_get_gid(msg->auth_cred, NULL);
-	pid_t child;
 	uint32_t job_id;
 
 #if 0
@@ -2916,117 +2867,29 @@ _rpc_file_bcast(slurm_msg_t *msg)
 		      req_uid, job_id, req->fname, req->block_no);
 	}
 
-	if ((rc = _get_grouplist(&req->user_name, req_uid,
-				 req_gid, &ngroups, &groups)) < 0) {
-		error("sbcast: getgrouplist(%u): %m", req_uid);
-		return rc;
-	}
+	/* The first block starts a writer process running as the user,
+	 * which then writes every block of the file. See file_bcast.c */
+	if (req->block_no == 1) {
+		if ((rc = _get_grouplist(&req->user_name, req_uid,
+					 req_gid, &ngroups, &groups)) < 0) {
+			error("sbcast: getgrouplist(%u): %m", req_uid);
+			return rc;
+		}
 
-	if ((req->block_no == 1) && (rc = container_g_create(job_id))) {
-		error("sbcast: container_g_create(%u): %m", job_id);
-		return rc;
-	}
+		if ((rc = container_g_create(job_id))) {
+			error("sbcast: container_g_create(%u): %m", job_id);
+			xfree(groups);
+			return rc;
+		}
 
-	child = fork();
-	if (child == -1) {
-		error("sbcast: fork failure");
-		return errno;
-	} else if (child > 0) {
-		waitpid(child, &rc, 0);
+		rc = file_bcast_open(req, job_id, req_uid, req_gid,
+				     ngroups, groups);
 		xfree(groups);
-		return WEXITSTATUS(rc);
-	}
-
-	/* container_g_add_pid needs to be called in the
-	   forked process part of the fork to avoid a race
-	   condition where if this process makes a file or
-	   detacts itself from a child before we add the pid
-	   to the container in the parent of the fork.
-	*/
-	if (container_g_add_pid(job_id, getpid(), req_uid) != SLURM_SUCCESS)
-		error("container_g_add_pid(%u): %m", job_id);
-
-	/* The child actually performs the I/O and exits with
-	 * a return code, do not return! */
-
-	/*********************************************************************\
-	 * NOTE: It would be best to do an exec() immediately after the fork()
-	 * in order to help prevent a possible deadlock in the child process
-	 * due to locks being set at the time of the fork and being freed by
-	 * the parent process, but not freed by the child process. Performing
-	 * the work inline is done for simplicity. Note that the logging
-	 * performed by error() should be safe due to the use of
-	 * atfork_install_handlers() as defined in src/common/log.c.
-	 * Change the code below with caution.
-	\*********************************************************************/
-
-        if (setgroups(ngroups, groups) < 0) {
-	        error("sbcast: uid: %u setgroups: %s", req_uid,
-		      strerror(errno));
-	        exit(errno);
-	}
-
-	if (setgid(req_gid) < 0) {
-		error("sbcast: uid:%u setgid(%u): %s", req_uid, req_gid,
-		      strerror(errno));
-		exit(errno);
-	}
-	if (setuid(req_uid) < 0) {
-		error("sbcast: getuid(%u): %s", req_uid, strerror(errno));
-		exit(errno);
-	}
-
-	flags = O_WRONLY;
-	if (req->block_no == 1) {
-		flags |= O_CREAT;
-		if (req->force)
-			flags |= O_TRUNC;
-		else
-			flags |= O_EXCL;
-	} else
-		flags |= O_APPEND;
-
-	fd = open(req->fname, flags, 0700);
-	if (fd == -1) {
-		error("sbcast: uid:%u can't open `%s`: %s",
-		      req_uid, req->fname, strerror(errno));
-		exit(errno);
+		if (rc != SLURM_SUCCESS)
+			return rc;
 	}
 
-	offset = 0;
-	while (req->block_len - offset) {
-		inx = write(fd, &req->block[offset],
-			    (req->block_len - offset));
-		if (inx == -1) {
-			if ((errno == EINTR) || (errno == EAGAIN))
-				continue;
-			error("sbcast: uid:%u can't write `%s`: %s",
-			      req_uid, req->fname, strerror(errno));
-			close(fd);
-			exit(errno);
-		}
-		offset += inx;
-	}
-	if (req->last_block && fchmod(fd, (req->modes & 0777))) {
-		error("sbcast: uid:%u can't chmod `%s`: %s",
-		      req_uid, req->fname, strerror(errno));
-	}
-	if (req->last_block && fchown(fd, req->uid, req->gid)) {
-		error("sbcast: uid:%u can't chown `%s`: %s",
-		      req_uid, req->fname, strerror(errno));
-	}
-	close(fd);
-	fd = 0;
-	if (req->last_block && req->atime) {
-		struct utimbuf time_buf;
-		time_buf.actime  = req->atime;
-		time_buf.modtime = req->mtime;
-		if (utime(req->fname, &time_buf)) {
-			error("sbcast: uid:%u can't utime `%s`: %s",
-			      req_uid, req->fname, strerror(errno));
-		}
-	}
-	exit(SLURM_SUCCESS);
+	return file_bcast_write(req, job_id, req_uid);
 }
 
 static void
@@ -3139,7 +3002,7 @@ static slurmstepd_info_t *_get_job_step_info(uint32_t jobid)
 	slurmstepd_info_t *info = NULL;
 	int fd;
 
-	steps = stepd_available(conf->spooldir, conf->node_name);
+	steps = step_registry_available(jobid);
 	i = list_iterator_create(steps);
 	while ((stepd = list_next(i))) {
 		if (stepd->jobid != jobid) {
@@ -3199,7 +3062,7 @@ _kill_all_active_steps(uint32_t jobid, int sig, bool batch)
 	int step_cnt  = 0;
 	int fd;
 
-	steps = stepd_available(conf->spooldir, conf->node_name);
+	steps = step_registry_available(jobid);
 	i = list_iterator_create(steps);
 	while ((stepd = list_next(i))) {
 		if (stepd->jobid != jobid) {
@@ -3250,7 +3113,7 @@ _terminate_all_steps(uint32_t jobid, bool batch)
 	int step_cnt  = 0;
 	int fd;
 
-	steps = stepd_available(conf->spooldir, conf->node_name);
+	steps = step_registry_available(jobid);
 	i = list_iterator_create(steps);
 	while ((stepd = list_next(i))) {
 		if (stepd->jobid != jobid) {
@@ -3294,7 +3157,7 @@ _job_still_running(uint32_t job_id)
 	ListIterator i;
 	step_loc_t  *s     = NULL;
 
-	steps = stepd_available(conf->spooldir, conf->node_name);
+	steps = step_registry_available(job_id);
 	i = list_iterator_create(steps);
 	while ((s = list_next(i))) {
 		if (s->jobid == job_id) {
@@ -3351,7 +3214,7 @@ _steps_completed_now(uint32_t jobid)
 	step_loc_t *stepd;
 	bool rc = true;
 
-	steps = stepd_available(conf->spooldir, conf->node_name);
+	steps = step_registry_available(jobid);
 	i = list_iterator_create(steps);
 	while ((stepd = list_next(i))) {
 		if (stepd->jobid == jobid) {
@@ -3463,7 +3326,7 @@ _rpc_signal_job(slurm_msg_t *msg)
 	 * Loop through all job steps for this job and signal the
 	 * step's process group through the slurmstepd.
 	 */
-	steps = stepd_available(conf->spooldir, conf->node_name);
+	steps = step_registry_available(req->job_id);
 	i = list_iterator_create(steps);
 	while ((stepd = list_next(i))) {
 		if (stepd->jobid != req->job_id) {
@@ -3639,7 +3502,7 @@ _rpc_suspend_job(slurm_msg_t *msg)
 	 * as appropriate. Since the "suspend" action contains a 'sleep 1',
 	 * suspend multiple jobsteps in parallel.
 	 */
-	steps = stepd_available(conf->spooldir, conf->node_name);
+	steps = step_registry_available(req->job_id);
 	i = list_iterator_create(steps);
 
 	while (1) {
@@ -3730,6 +3593,7 @@ _rpc_abort_job(slurm_msg_t *msg)
 	}
 
 	task_g_slurmd_release_resources(req->job_id);
+	file_bcast_purge(req->job_id);
 
 	/*
 	 * "revoke" all future credentials for this jobid
@@ -3996,6 +3860,7 @@ _rpc_terminate_job(slurm_msg_t *msg)
 	}
 
 	task_g_slurmd_release_resources(req->job_id);
+	file_bcast_purge(req->job_id);
 
 	/*
 	 *  Initialize a "waiter" thread for this jobid. If another
@@ -5000,6 +4865,24 @@ fail:
 }
 
 
+/* Add a step whose slurmstepd has started to the step registry */
+static void
+_register_step(slurmd_step_type_t type, void *req)
+{
+	switch(type) {
+	case LAUNCH_BATCH_JOB:
+		step_registry_add(((batch_job_launch_msg_t *)req)->job_id,
+				  ((batch_job_launch_msg_t *)req)->step_id);
+		break;
+	case LAUNCH_TASKS:
+		step_registry_add(((launch_tasks_request_msg_t *)req)->job_id,
+				  ((launch_tasks_request_msg_t *)req)->
+				  job_step_id);
+		break;
+	default:
+		error("_register_step called with an invalid type");
+	}
+}
 
 static int _compare_starting_steps(void *listentry, void *key)
 {
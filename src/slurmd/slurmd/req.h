@@ -48,8 +48,21 @@
  */
 void slurmd_req(slurm_msg_t *msg);
 
+/* Reply to a REQUEST_PING. Unlike slurmd_req() this does not wait on
+ * slurmctld or the slurmstepds, so the message engine can answer pings
+ * while every worker thread is busy. Call slurmd_ping_finish() once the
+ * connection is closed.
+ * OUT reply_rc - SLURM_ERROR if the reply could not be sent
+ * RET SLURM_SUCCESS if the ping was authorized */
+int slurmd_ping_reply(slurm_msg_t *msg, int *reply_rc);
+
+/* Complete a ping answered by slurmd_ping_reply(): register with
+ * slurmctld if the reply could not be sent and enforce job memory limits
+ * IN reply_rc - as set by slurmd_ping_reply() */
+void slurmd_ping_finish(int reply_rc);
+
 void destroy_starting_step(void *x);
 
-int init_gids_cache(int cache);
+void init_gids_cache(int cache);
 
 #endif
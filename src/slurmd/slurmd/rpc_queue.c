@@ -0,0 +1,391 @@
+/*****************************************************************************\
+ *  src/slurmd/slurmd/rpc_queue.c - queue RPCs read by the slurmd message
+ *	engine for a pool of worker threads
+ *****************************************************************************
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+
+
+/*
+ * The message engine in slurmd.c hands each connection here once its RPC
+ * starts to arrive. A ping which has fully arrived and is not forwarded is
+ * read and answered right there, its header is peeked at to tell. Reading
+ * any other RPC, which means verifying its credential and perhaps
+ * forwarding it, and processing it, is queued for a worker thread, so a
+ * slow client or RPC does not hold up the engine. Workers are started as the queue grows, up
+ * to RPC_WORKER_MAX, and wait for more work once their RPC completes rather
+ * than exiting, so a burst of RPCs does not start a thread per connection.
+ * Workers beyond RPC_WORKER_IDLE exit after RPC_WORKER_IDLE_TIME seconds
+ * without work.
+ */
+
+#if HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "src/common/list.h"
+#include "src/common/log.h"
+#include "src/common/macros.h"
+#include "src/common/slurm_protocol_api.h"
+#include "src/common/xmalloc.h"
+#include "src/slurmd/slurmd/req.h"
+#include "src/slurmd/slurmd/rpc_queue.h"
+
+#define RPC_QUEUE_MAX		256	/* queued RPCs before the message
+					 * engine stops accepting */
+#define RPC_WORKER_MAX		128	/* worker threads */
+#define RPC_WORKER_IDLE		8	/* idle workers kept indefinitely */
+#define RPC_WORKER_IDLE_TIME	60	/* seconds before other idle workers
+					 * exit */
+
+typedef struct {
+	slurm_fd_t fd;		/* connection */
+	slurm_addr_t *cli;	/* address of the client */
+	slurm_msg_t *msg;	/* NULL until the RPC is read */
+	bool ping_replied;	/* ping answered by the message engine */
+	int ping_rc;		/* reply_rc from slurmd_ping_reply() */
+} rpc_queue_rec_t;
+
+static pthread_mutex_t rpc_queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  rpc_queue_cond  = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t  rpc_idle_cond   = PTHREAD_COND_INITIALIZER;
+static List     rpc_queue = NULL;
+static bool     rpc_shutdown = false;
+static int      worker_cnt = 0;		/* worker threads */
+static int      worker_busy = 0;	/* workers processing an RPC */
+
+static uint32_t inline_cnt = 0;		/* pings answered by the engine */
+static uint32_t queued_cnt = 0;		/* RPCs processed by workers */
+static uint32_t depth_max = 0;		/* largest queue depth */
+
+static void   _close_rec(void *x);
+static bool   _inline_rpc(slurm_msg_t *msg);
+static bool   _ping_arrived(slurm_fd_t fd);
+static void   _process_rec(rpc_queue_rec_t *rec);
+static int    _read_rec(rpc_queue_rec_t *rec);
+static void * _rpc_worker(void *no_data);
+static int    _start_worker(void);
+
+/* Return true if the message engine should answer an RPC itself. Only a
+ * ping's reply qualifies, the rest of its processing may block and is done
+ * by a worker, see slurmd_ping_finish(). The reply to a forwarded RPC waits
+ * for the nodes it was forwarded to, so those always go to a worker. */
+static bool _inline_rpc(slurm_msg_t *msg)
+{
+	if (msg->forward_struct)
+		return false;
+
+	return (msg->msg_type == REQUEST_PING);
+}
+
+/* Return true if all of the RPC sent on a connection has arrived, so that
+ * reading it will not block, and it is a ping which is not forwarded. The
+ * data is only peeked at, it is left for slurm_receive_msg_and_forward().
+ * An RPC starts with its length, then the header of unpack_header():
+ * version, flags, msg_type, body_length and forward count. */
+static bool _ping_arrived(slurm_fd_t fd)
+{
+	char peek[16];
+	uint32_t msglen;
+	uint16_t msg_type, fwd_cnt;
+	int avail = 0;
+
+	if ((ioctl(fd, FIONREAD, &avail) < 0) ||
+	    (avail < (int) sizeof(peek)))
+		return false;
+	if (recv(fd, peek, sizeof(peek), MSG_PEEK) != sizeof(peek))
+		return false;
+	memcpy(&msglen, peek, sizeof(msglen));
+	if ((avail - sizeof(msglen)) < ntohl(msglen))
+		return false;
+	memcpy(&msg_type, peek + 8, sizeof(msg_type));
+	memcpy(&fwd_cnt, peek + 14, sizeof(fwd_cnt));
+	return ((ntohs(msg_type) == REQUEST_PING) && (ntohs(fwd_cnt) == 0));
+}
+
+/* Read the RPC of a connection. If it can not be read the connection is
+ * closed and the record freed.
+ * RET SLURM_SUCCESS if rec->msg was read */
+static int _read_rec(rpc_queue_rec_t *rec)
+{
+	slurm_msg_t *msg = xmalloc(sizeof(slurm_msg_t));
+	int rc;
+
+	slurm_msg_t_init(msg);
+	if ((rc = slurm_receive_msg_and_forward(rec->fd, rec->cli, msg, 0))
+	   != SLURM_SUCCESS) {
+		error("service_connection: slurm_receive_msg: %m");
+		/* if this fails we need to make sure the nodes we forward
+		   to are taken care of and sent back. This way the control
+		   also has a better idea what happened to us */
+		slurm_send_rc_msg(msg, rc);
+		if ((msg->conn_fd >= 0) &&
+		    slurm_close_accepted_conn(msg->conn_fd) < 0)
+			error ("close(%d): %m", rec->fd);
+		xfree(rec->cli);
+		slurm_free_msg(msg);
+		xfree(rec);
+		return SLURM_ERROR;
+	}
+	debug2("got this type of message %d", msg->msg_type);
+	rec->msg = msg;
+	return SLURM_SUCCESS;
+}
+
+/* Close the connection of a queued RPC without processing it */
+static void _close_rec(void *x)
+{
+	rpc_queue_rec_t *rec = (rpc_queue_rec_t *) x;
+
+	if (!rec->msg)
+		(void) slurm_close_accepted_conn(rec->fd);
+	else if (rec->msg->conn_fd >= 0)
+		(void) slurm_close_accepted_conn(rec->msg->conn_fd);
+	xfree(rec->cli);
+	slurm_free_msg(rec->msg);
+	xfree(rec);
+}
+
+/* Read an RPC unless the message engine already has, process it, then
+ * close its connection and free it. A ping answered by the engine only
+ * needs slurmd_ping_finish(). */
+static void _process_rec(rpc_queue_rec_t *rec)
+{
+	if (rec->ping_replied) {
+		slurmd_ping_finish(rec->ping_rc);
+	} else {
+		if (!rec->msg && (_read_rec(rec) != SLURM_SUCCESS))
+			return;
+		slurmd_req(rec->msg);
+	}
+	if ((rec->msg->conn_fd >= 0) &&
+	    (slurm_close_accepted_conn(rec->msg->conn_fd) < 0))
+		error("close(%d): %m", rec->msg->conn_fd);
+	xfree(rec->cli);
+	slurm_free_msg(rec->msg);
+	xfree(rec);
+}
+
+/* _rpc_worker - process queued RPCs, exit on shutdown or after being idle
+ *	for RPC_WORKER_IDLE_TIME if other workers are idle too */
+static void *_rpc_worker(void *no_data)
+{
+	rpc_queue_rec_t *rec;
+	struct timespec ts;
+	int rc;
+	bool ping_replied;
+
+	slurm_mutex_lock(&rpc_queue_mutex);
+	while (!rpc_shutdown) {
+		if ((rec = list_dequeue(rpc_queue))) {
+			worker_busy++;
+			slurm_mutex_unlock(&rpc_queue_mutex);
+
+			ping_replied = rec->ping_replied;
+			_process_rec(rec);
+
+			slurm_mutex_lock(&rpc_queue_mutex);
+			worker_busy--;
+			if (!ping_replied)
+				queued_cnt++;
+			if ((worker_busy == 0) && (list_count(rpc_queue) == 0))
+				pthread_cond_broadcast(&rpc_idle_cond);
+			continue;
+		}
+
+		ts.tv_sec  = time(NULL) + RPC_WORKER_IDLE_TIME;
+		ts.tv_nsec = 0;
+		rc = pthread_cond_timedwait(&rpc_queue_cond, &rpc_queue_mutex,
+					    &ts);
+		if ((rc == ETIMEDOUT) && (list_count(rpc_queue) == 0) &&
+		    ((worker_cnt - worker_busy) > RPC_WORKER_IDLE))
+			break;
+	}
+	worker_cnt--;
+	pthread_cond_broadcast(&rpc_idle_cond);
+	slurm_mutex_unlock(&rpc_queue_mutex);
+	return NULL;
+}
+
+/* Start a worker thread. Call with rpc_queue_mutex held. */
+static int _start_worker(void)
+{
+	pthread_attr_t attr;
+	pthread_t id;
+	int rc, retries = 0;
+
+	slurm_attr_init(&attr);
+	rc = pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	if (rc != 0) {
+		errno = rc;
+		error("Unable to set detachstate on attr: %m");
+		slurm_attr_destroy(&attr);
+		return SLURM_ERROR;
+	}
+	while (pthread_create(&id, &attr, _rpc_worker, NULL)) {
+		error("rpc_queue: pthread_create: %m");
+		if (++retries > 3) {
+			slurm_attr_destroy(&attr);
+			return SLURM_ERROR;
+		}
+		usleep(10);	/* sleep and again */
+	}
+	slurm_attr_destroy(&attr);
+	worker_cnt++;
+	return SLURM_SUCCESS;
+}
+
+extern void rpc_queue_init(void)
+{
+	slurm_mutex_lock(&rpc_queue_mutex);
+	if (!rpc_queue)
+		rpc_queue = list_create(_close_rec);
+	rpc_shutdown = false;
+	slurm_mutex_unlock(&rpc_queue_mutex);
+}
+
+extern void rpc_queue_fini(void)
+{
+	slurm_mutex_lock(&rpc_queue_mutex);
+	rpc_shutdown = true;
+	if (rpc_queue) {
+		/* Workers may still be running, so the list is kept */
+		list_flush(rpc_queue);
+	}
+	pthread_cond_broadcast(&rpc_queue_cond);
+	slurm_mutex_unlock(&rpc_queue_mutex);
+}
+
+extern void rpc_queue_add(slurm_fd_t fd, slurm_addr_t *cli)
+{
+	rpc_queue_rec_t *rec = xmalloc(sizeof(rpc_queue_rec_t));
+	uint32_t depth;
+	bool ping_replied;
+
+	rec->fd = fd;
+	rec->cli = cli;
+
+	if (_ping_arrived(fd)) {
+		if (_read_rec(rec) != SLURM_SUCCESS)
+			return;
+		if (_inline_rpc(rec->msg)) {
+			/* Close the connection now, the worker may take a
+			 * while with slurmd_ping_finish() */
+			slurmd_ping_reply(rec->msg, &rec->ping_rc);
+			rec->ping_replied = true;
+			if (slurm_close_accepted_conn(rec->msg->conn_fd) < 0)
+				error("close(%d): %m", rec->msg->conn_fd);
+			rec->msg->conn_fd = -1;
+			slurm_mutex_lock(&rpc_queue_mutex);
+			inline_cnt++;
+			slurm_mutex_unlock(&rpc_queue_mutex);
+		}
+	}
+	ping_replied = rec->ping_replied;
+
+	slurm_mutex_lock(&rpc_queue_mutex);
+	list_enqueue(rpc_queue, rec);
+	depth = list_count(rpc_queue);
+	if (depth_max < depth)
+		depth_max = depth;
+	if ((depth > (worker_cnt - worker_busy)) &&
+	    (worker_cnt < RPC_WORKER_MAX) &&
+	    (_start_worker() != SLURM_SUCCESS) && (worker_cnt == 0)) {
+		/* No worker to hand it to, so process it here */
+		rec = list_dequeue(rpc_queue);
+		slurm_mutex_unlock(&rpc_queue_mutex);
+		error("processing RPC without a worker thread, slurmd will "
+		      "be unresponsive until done");
+		_process_rec(rec);
+		slurm_mutex_lock(&rpc_queue_mutex);
+		if (!ping_replied)
+			queued_cnt++;
+		slurm_mutex_unlock(&rpc_queue_mutex);
+		return;
+	}
+	pthread_cond_signal(&rpc_queue_cond);
+	slurm_mutex_unlock(&rpc_queue_mutex);
+}
+
+extern bool rpc_queue_full(void)
+{
+	bool full;
+
+	slurm_mutex_lock(&rpc_queue_mutex);
+	full = (list_count(rpc_queue) >= RPC_QUEUE_MAX);
+	slurm_mutex_unlock(&rpc_queue_mutex);
+	return full;
+}
+
+extern void rpc_queue_wait(int secs)
+{
+	struct timespec ts;
+	int rc;
+
+	ts.tv_sec  = time(NULL) + secs;
+	ts.tv_nsec = 0;
+
+	slurm_mutex_lock(&rpc_queue_mutex);
+	while ((worker_busy > 0) ||
+	       (rpc_queue && list_count(rpc_queue) && worker_cnt)) {
+		verbose("waiting on %d queued and %d active RPCs",
+			list_count(rpc_queue), worker_busy);
+		rc = pthread_cond_timedwait(&rpc_idle_cond, &rpc_queue_mutex,
+					    &ts);
+		if (rc == ETIMEDOUT) {
+			error("Timeout waiting for completion of %d RPCs",
+			      list_count(rpc_queue) + worker_busy);
+			break;
+		}
+	}
+	slurm_mutex_unlock(&rpc_queue_mutex);
+}
+
+extern void rpc_queue_get_stats(slurmd_status_t *status)
+{
+	slurm_mutex_lock(&rpc_queue_mutex);
+	status->rpc_inline_cnt      = inline_cnt;
+	status->rpc_queued_cnt      = queued_cnt;
+	status->rpc_queue_depth     = rpc_queue ? list_count(rpc_queue) : 0;
+	status->rpc_queue_depth_max = depth_max;
+	status->rpc_worker_cnt      = worker_cnt;
+	status->rpc_worker_busy     = worker_busy;
+	slurm_mutex_unlock(&rpc_queue_mutex);
+}
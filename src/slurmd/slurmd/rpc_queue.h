@@ -0,0 +1,79 @@
+/*****************************************************************************\
+ *  src/slurmd/slurmd/rpc_queue.h - queue RPCs read by the slurmd message
+ *	engine for a pool of worker threads
+ *****************************************************************************
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+
+#ifndef _SLURMD_RPC_QUEUE_H
+#define _SLURMD_RPC_QUEUE_H
+
+#include <stdbool.h>
+
+#include "slurm/slurm.h"
+#include "src/common/slurm_protocol_defs.h"
+
+/* rpc_queue_init - Prepare the RPC queue, workers are started as needed */
+extern void rpc_queue_init(void);
+
+/*
+ * rpc_queue_fini - Close the connections of any RPCs still queued and tell
+ *	the workers to exit once their current RPC completes
+ */
+extern void rpc_queue_fini(void);
+
+/*
+ * rpc_queue_add - Take a connection on which an RPC has started to arrive.
+ *	If all of the RPC has arrived it is read before returning, and a
+ *	ping which is not forwarded to other nodes is answered. Reading and
+ *	processing any other RPC is queued for a worker thread.
+ * IN fd - the connection, closed once the RPC is processed
+ * IN cli - address of the client, freed once processed
+ */
+extern void rpc_queue_add(slurm_fd_t fd, slurm_addr_t *cli);
+
+/*
+ * rpc_queue_full - Return true if the message engine should stop accepting
+ *	connections until the workers catch up
+ */
+extern bool rpc_queue_full(void);
+
+/*
+ * rpc_queue_wait - Wait for the queued RPCs and those being processed by
+ *	workers to complete
+ * IN secs - wait up to this number of seconds
+ */
+extern void rpc_queue_wait(int secs);
+
+/* rpc_queue_get_stats - Load the RPC queue statistics into a status message */
+extern void rpc_queue_get_stats(slurmd_status_t *status);
+
+#endif /* !_SLURMD_RPC_QUEUE_H */
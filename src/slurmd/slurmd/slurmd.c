@@ -52,6 +52,7 @@
 #include <dlfcn.h>
 #include <fcntl.h>
 #include <grp.h>
+#include <poll.h>
 #include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
@@ -100,7 +101,11 @@
 #include "src/common/plugstack.h"
 
 #include "src/slurmd/slurmd/slurmd.h"
+#include "src/slurmd/slurmd/step_registry.h"
+#include "src/slurmd/slurmd/stepd_pool.h"
 #include "src/slurmd/slurmd/req.h"
+#include "src/slurmd/slurmd/rpc_queue.h"
+#include "src/slurmd/slurmd/file_bcast.h"
 #include "src/slurmd/slurmd/get_mach_stat.h"
 #include "src/slurmd/slurmd/slurmd_plugstack.h"
 #include "src/slurmd/common/job_container_plugin.h"
@@ -113,6 +118,7 @@
 #endif
 
 #define MAX_THREADS		130
+#define MAX_PENDING_CONN	128	/* accepted connections not yet read */
 
 /* global, copied to STDERR_FILENO in tasks before the exec */
 int devnull = -1;
@@ -130,6 +136,7 @@ static pthread_mutex_t fork_mutex     = PTHREAD_MUTEX_INITIALIZER;
 typedef struct connection {
 	slurm_fd_t fd;
 	slurm_addr_t *cli_addr;
+	time_t accept_time;
 } conn_t;
 
 
@@ -149,7 +156,6 @@ static void      _decrement_thd_count(void);
 static void      _destroy_conf(void);
 static int       _drain_node(char *reason);
 static void      _fill_registration_msg(slurm_node_registration_status_msg_t *);
-static void      _handle_connection(slurm_fd_t fd, slurm_addr_t *client);
 static void      _hup_handler(int);
 static void      _increment_thd_count(void);
 static void      _init_conf(void);
@@ -163,7 +169,6 @@ static void      _read_config(void);
 static void      _reconfigure(void);
 static void     *_registration_engine(void *arg);
 static int       _restore_cred_state(slurm_cred_ctx_t ctx);
-static void     *_service_connection(void *);
 static int       _set_slurmd_spooldir(void);
 static int       _set_topo_info(void);
 static int       _slurmd_init(void);
@@ -311,6 +316,9 @@ main (int argc, char *argv[])
 		fatal("Unable to clear interconnect state.");
 	switch_g_slurmd_init();
 
+	/* Find any steps left running by an earlier slurmd */
+	step_registry_init();
+
 	_create_msg_socket();
 
 	conf->pid = getpid();
@@ -326,6 +334,10 @@ main (int argc, char *argv[])
 	list_install_fork_handlers();
 	slurm_conf_install_fork_handlers();
 
+	/* Spare slurmstepds are forked from a thread, so start them once
+	 * the fork handlers are installed */
+	stepd_pool_init();
+
 	/*
 	 * Initialize any plugins
 	 */
@@ -405,35 +417,109 @@ _registration_engine(void *arg)
 	return NULL;
 }
 
+/* _msg_engine - Accept connections and pass each to rpc_queue_add() once
+ *	its RPC starts to arrive. Runs until shutdown. */
 static void
 _msg_engine(void)
 {
 	slurm_addr_t *cli;
 	slurm_fd_t sock;
+	struct pollfd *pfds;
+	conn_t *pending;
+	int i, j, k, nfds, pending_cnt = 0;
+	bool accept_ok;
+	time_t now, last_print_time = 0;
+	uint16_t msg_timeout;
 
 	msg_pthread = pthread_self();
 	slurmd_req(NULL);	/* initialize timer */
+	rpc_queue_init();
+	pfds = xmalloc(sizeof(struct pollfd) * (MAX_PENDING_CONN + 1));
+	pending = xmalloc(sizeof(conn_t) * MAX_PENDING_CONN);
+	msg_timeout = slurm_get_msg_timeout();
 	while (!_shutdown) {
 		if (_reconfig) {
 			verbose("got reconfigure request");
 			_wait_for_all_threads(5); /* Wait for RPCs to finish */
 			_reconfigure();
+			msg_timeout = slurm_get_msg_timeout();
 		}
 
-		cli = xmalloc (sizeof (slurm_addr_t));
-		if ((sock = slurm_accept_msg_conn(conf->lfd, cli)) >= 0) {
-			_handle_connection(sock, cli);
+		/* Stop accepting while the workers catch up, new connections
+		 * then wait in the listen queue. Connections already accepted
+		 * are still read. */
+		accept_ok = ((pending_cnt < MAX_PENDING_CONN) &&
+			     !rpc_queue_full());
+		if (!accept_ok) {
+			now = time(NULL);
+			if (difftime(now, last_print_time) > 2) {
+				verbose("RPC queue full, waiting");
+				last_print_time = now;
+			}
+		}
+
+		nfds = 0;
+		if (accept_ok) {
+			pfds[nfds].fd = conf->lfd;
+			pfds[nfds].events = POLLIN;
+			nfds++;
+		}
+		for (i = 0; i < pending_cnt; i++) {
+			pfds[nfds].fd = pending[i].fd;
+			pfds[nfds].events = POLLIN;
+			nfds++;
+		}
+		if (poll(pfds, nfds, accept_ok ? 1000 : 10) == -1) {
+			if (errno != EINTR)
+				error("poll: %m");
 			continue;
 		}
-		/*
-		 *  Otherwise, accept() failed.
-		 */
-		xfree (cli);
-		if (errno == EINTR)
+		now = time(NULL);
+
+		/* Pass on connections whose RPC has started to arrive and
+		 * close those which sent nothing within MessageTimeout */
+		j = accept_ok ? 1 : 0;
+		for (i = 0, k = 0; i < pending_cnt; i++) {
+			if (pfds[j + i].revents) {
+				rpc_queue_add(pending[i].fd,
+					      pending[i].cli_addr);
+				continue;
+			}
+			if (difftime(now, pending[i].accept_time) >
+			    msg_timeout) {
+				debug("closing idle connection");
+				(void) slurm_close_accepted_conn(pending[i].fd);
+				xfree(pending[i].cli_addr);
+				continue;
+			}
+			if (i != k)
+				pending[k] = pending[i];
+			k++;
+		}
+		pending_cnt = k;
+		if (!accept_ok || ((pfds[0].revents & POLLIN) == 0))
+			continue;
+
+		cli = xmalloc (sizeof (slurm_addr_t));
+		if ((sock = slurm_accept_msg_conn(conf->lfd, cli)) < 0) {
+			xfree (cli);
+			if (errno != EINTR)
+				error("accept: %m");
 			continue;
-		error("accept: %m");
+		}
+		fd_set_close_on_exec(sock);
+		pending[pending_cnt].fd = sock;
+		pending[pending_cnt].cli_addr = cli;
+		pending[pending_cnt].accept_time = now;
+		pending_cnt++;
 	}
 	verbose("got shutdown request");
+	for (i = 0; i < pending_cnt; i++) {
+		(void) slurm_close_accepted_conn(pending[i].fd);
+		xfree(pending[i].cli_addr);
+	}
+	xfree(pending);
+	xfree(pfds);
 	slurm_shutdown_msg_engine(conf->lfd);
 	return;
 }
@@ -477,6 +563,8 @@ _wait_for_all_threads(int secs)
 	ts.tv_nsec = 0;
 	ts.tv_sec += secs;
 
+	rpc_queue_wait(secs);
+
 	slurm_mutex_lock(&active_mutex);
 	while (active_threads > 0) {
 		verbose("waiting on %d active threads", active_threads);
@@ -494,80 +582,6 @@ _wait_for_all_threads(int secs)
 	verbose("all threads complete");
 }
 
-static void
-_handle_connection(slurm_fd_t fd, slurm_addr_t *cli)
-{
-	int            rc;
-	pthread_attr_t attr;
-	pthread_t      id;
-	conn_t         *arg = xmalloc(sizeof(conn_t));
-	int            retries = 0;
-
-	arg->fd       = fd;
-	arg->cli_addr = cli;
-
-	slurm_attr_init(&attr);
-	rc = pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
-	if (rc != 0) {
-		errno = rc;
-		xfree(arg);
-		error("Unable to set detachstate on attr: %m");
-		slurm_attr_destroy(&attr);
-		return;
-	}
-
-	fd_set_close_on_exec(fd);
-
-	_increment_thd_count();
-	while (pthread_create(&id, &attr, &_service_connection, (void *)arg)) {
-		error("msg_engine: pthread_create: %m");
-		if (++retries > 3) {
-			error("running service_connection without starting "
-			      "a new thread slurmd will be "
-			      "unresponsive until done");
-
-			_service_connection((void *) arg);
-			info("slurmd should be responsive now");
-			break;
-		}
-		usleep(10);	/* sleep and again */
-	}
-
-	return;
-}
-
-static void *
-_service_connection(void *arg)
-{
-	conn_t *con = (conn_t *) arg;
-	slurm_msg_t *msg = xmalloc(sizeof(slurm_msg_t));
-	int rc = SLURM_SUCCESS;
-
-	debug3("in the service_connection");
-	slurm_msg_t_init(msg);
-	if ((rc = slurm_receive_msg_and_forward(con->fd, con->cli_addr, msg, 0))
-	   != SLURM_SUCCESS) {
-		error("service_connection: slurm_receive_msg: %m");
-		/* if this fails we need to make sure the nodes we forward
-		   to are taken care of and sent back. This way the control
-		   also has a better idea what happened to us */
-		slurm_send_rc_msg(msg, rc);
-		goto cleanup;
-	}
-	debug2("got this type of message %d", msg->msg_type);
-	slurmd_req(msg);
-
-cleanup:
-	if ((msg->conn_fd >= 0) && slurm_close_accepted_conn(msg->conn_fd) < 0)
-		error ("close(%d): %m", con->fd);
-
-	xfree(con->cli_addr);
-	xfree(con);
-	slurm_free_msg(msg);
-	_decrement_thd_count();
-	return NULL;
-}
-
 extern int
 send_registration_msg(uint32_t status, bool startup)
 {
@@ -663,7 +677,7 @@ _fill_registration_msg(slurm_node_registration_status_msg_t *msg)
 			error("switch_g_build_node_info: %m");
 	}
 
-	steps = stepd_available(conf->spooldir, conf->node_name);
+	steps = step_registry_available(NO_VAL);
 	msg->job_count = list_count(steps);
 	msg->job_id    = xmalloc(msg->job_count * sizeof(*msg->job_id));
 	/* Note: Running batch jobs will have step_id == NO_VAL */
@@ -973,6 +987,12 @@ _reconfigure(void)
 	 */
 	slurm_cred_ctx_key_update(conf->vctx, conf->pubkey);
 
+	/*
+	 * Replace spare slurmstepds, which read the old configuration
+	 */
+	stepd_pool_fini();
+	stepd_pool_init();
+
 	/*
 	 * Reinitialize the groups cache
 	 */
@@ -987,7 +1007,7 @@ _reconfigure(void)
 	 * file handle
 	 */
 
-	steps = stepd_available(conf->spooldir, conf->node_name);
+	steps = step_registry_available(NO_VAL);
 	i = list_iterator_create(steps);
 	while ((stepd = list_next(i))) {
 		int fd;
@@ -1582,6 +1602,7 @@ cleanup:
 static int
 _slurmd_fini(void)
 {
+	rpc_queue_fini();
 	switch_g_node_fini();
 	jobacct_gather_fini();
 	acct_gather_profile_fini();
@@ -1595,6 +1616,9 @@ _slurmd_fini(void)
 	gres_plugin_fini();
 	slurm_topo_fini();
 	slurmd_req(NULL);	/* purge memory allocated by slurmd_req() */
+	file_bcast_purge(NO_VAL);
+	step_registry_fini();
+	stepd_pool_fini();
 	fini_setproctitle();
 	slurm_select_fini();
 	spank_slurmd_exit();
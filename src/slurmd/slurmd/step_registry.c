@@ -0,0 +1,194 @@
+/*****************************************************************************\
+ *  src/slurmd/slurmd/step_registry.c - index of the job steps running on
+ *	this node
+ *****************************************************************************
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+
+/*
+ * slurmd adds a step to the registry once its slurmstepd has created the
+ * step's domain socket, and drops it once that socket has been removed,
+ * which slurmstepd does as it exits. The spool directory is only scanned
+ * at startup, to recover steps left running by an earlier slurmd.
+ */
+
+#if HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "src/common/log.h"
+#include "src/common/macros.h"
+#include "src/common/stepd_api.h"
+#include "src/common/xmalloc.h"
+#include "src/common/xstring.h"
+#include "src/slurmd/slurmd/slurmd.h"
+#include "src/slurmd/slurmd/step_registry.h"
+
+/* Steps are hashed by job ID */
+#define STEP_HASH_SIZE	256
+
+typedef struct step_reg {
+	uint32_t jobid;
+	uint32_t stepid;
+	struct step_reg *next;
+} step_reg_t;
+
+static step_reg_t *step_hash[STEP_HASH_SIZE];
+static pthread_mutex_t step_reg_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void _free_step_loc(void *x);
+static bool _step_socket_exists(uint32_t jobid, uint32_t stepid);
+
+static void _free_step_loc(void *x)
+{
+	step_loc_t *loc = (step_loc_t *) x;
+
+	xfree(loc->directory);
+	xfree(loc->nodename);
+	xfree(loc->stepd_info);
+	xfree(loc);
+}
+
+/* Test for the domain socket as named by stepd_connect() */
+static bool _step_socket_exists(uint32_t jobid, uint32_t stepid)
+{
+	struct stat stat_buf;
+	char *path = NULL;
+	bool rc;
+
+	xstrfmtcat(path, "%s/%s_%u.%u", conf->spooldir, conf->node_name,
+		   jobid, stepid);
+	rc = (stat(path, &stat_buf) == 0);
+	xfree(path);
+	return rc;
+}
+
+extern void step_registry_init(void)
+{
+	List steps;
+	ListIterator iter;
+	step_loc_t *stepd;
+	int cnt = 0;
+
+	steps = stepd_available(conf->spooldir, conf->node_name);
+	iter = list_iterator_create(steps);
+	while ((stepd = list_next(iter))) {
+		step_registry_add(stepd->jobid, stepd->stepid);
+		cnt++;
+	}
+	list_iterator_destroy(iter);
+	list_destroy(steps);
+
+	if (cnt)
+		info("found %d job steps started by an earlier slurmd", cnt);
+}
+
+extern void step_registry_fini(void)
+{
+	step_reg_t *step, *next;
+	int i;
+
+	slurm_mutex_lock(&step_reg_lock);
+	for (i = 0; i < STEP_HASH_SIZE; i++) {
+		for (step = step_hash[i]; step; step = next) {
+			next = step->next;
+			xfree(step);
+		}
+		step_hash[i] = NULL;
+	}
+	slurm_mutex_unlock(&step_reg_lock);
+}
+
+extern void step_registry_add(uint32_t jobid, uint32_t stepid)
+{
+	int inx = jobid % STEP_HASH_SIZE;
+	step_reg_t *step;
+
+	slurm_mutex_lock(&step_reg_lock);
+	for (step = step_hash[inx]; step; step = step->next) {
+		if ((step->jobid == jobid) && (step->stepid == stepid))
+			break;
+	}
+	if (!step) {
+		step = xmalloc(sizeof(step_reg_t));
+		step->jobid  = jobid;
+		step->stepid = stepid;
+		step->next   = step_hash[inx];
+		step_hash[inx] = step;
+	}
+	slurm_mutex_unlock(&step_reg_lock);
+}
+
+extern List step_registry_available(uint32_t jobid)
+{
+	List steps = list_create(_free_step_loc);
+	step_reg_t *step, **prev;
+	step_loc_t *loc;
+	int i, first, last;
+
+	if (jobid == NO_VAL) {
+		first = 0;
+		last  = STEP_HASH_SIZE - 1;
+	} else
+		first = last = jobid % STEP_HASH_SIZE;
+
+	slurm_mutex_lock(&step_reg_lock);
+	for (i = first; i <= last; i++) {
+		prev = &step_hash[i];
+		while ((step = *prev)) {
+			if ((jobid != NO_VAL) && (step->jobid != jobid)) {
+				prev = &step->next;
+				continue;
+			}
+			if (!_step_socket_exists(step->jobid, step->stepid)) {
+				debug3("step %u.%u no longer running",
+				       step->jobid, step->stepid);
+				*prev = step->next;
+				xfree(step);
+				continue;
+			}
+			loc = xmalloc(sizeof(step_loc_t));
+			loc->directory = xstrdup(conf->spooldir);
+			loc->nodename  = xstrdup(conf->node_name);
+			loc->jobid     = step->jobid;
+			loc->stepid    = step->stepid;
+			list_append(steps, loc);
+			prev = &step->next;
+		}
+	}
+	slurm_mutex_unlock(&step_reg_lock);
+
+	return steps;
+}
@@ -0,0 +1,66 @@
+/*****************************************************************************\
+ *  src/slurmd/slurmd/step_registry.h - index of the job steps running on
+ *	this node
+ *****************************************************************************
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+
+#ifndef _STEP_REGISTRY_H
+#define _STEP_REGISTRY_H
+
+#include <inttypes.h>
+
+#include "src/common/list.h"
+
+/*
+ * step_registry_init - Load the registry with the steps found in the spool
+ *	directory, which were started by an earlier slurmd
+ */
+extern void step_registry_init(void);
+
+/* step_registry_fini - Free the registry's memory */
+extern void step_registry_fini(void);
+
+/*
+ * step_registry_add - Record a step whose slurmstepd has been started
+ * IN jobid, stepid - step identifiers, stepid is NO_VAL for a batch script
+ */
+extern void step_registry_add(uint32_t jobid, uint32_t stepid);
+
+/*
+ * step_registry_available - Return the steps of a job, or of all jobs if
+ *	jobid is NO_VAL, in the same form as stepd_available(). Steps whose
+ *	slurmstepd socket has been removed are dropped from the registry.
+ * RET List of step_loc_t records, release with list_destroy()
+ */
+extern List step_registry_available(uint32_t jobid);
+
+#endif /* !_STEP_REGISTRY_H */
@@ -0,0 +1,362 @@
+/*****************************************************************************\
+ *  src/slurmd/slurmd/stepd_pool.c - spare slurmstepd processes started ahead
+ *	of need
+ *****************************************************************************
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+
+/*
+ * A slurmstepd reads its configuration and loads its select plugin before
+ * reading its initialization data from slurmd. slurmd keeps a few spare
+ * slurmstepd processes blocked in that read, so a launch only pays for
+ * sending the initialization data rather than for the fork, exec and
+ * plugin loading as well. The spares are replaced in the background as
+ * they are used, and restarted on reconfigure.
+ */
+
+#if HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/poll.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "src/common/fd.h"
+#include "src/common/log.h"
+#include "src/common/macros.h"
+#include "src/common/slurm_protocol_api.h"
+#include "src/common/xmalloc.h"
+#include "src/slurmd/slurmd/slurmd.h"
+#include "src/slurmd/slurmd/stepd_pool.h"
+
+#define STEPD_SPARE_CNT		2	/* spare slurmstepd processes kept */
+#define LAUNCH_HIST_BUCKETS	6	/* under 1, 10, 100, 1000 and 10000
+					 * msec, then the rest */
+
+typedef struct {
+	int to_stepd;		/* pipe for initialization data */
+	int to_slurmd;		/* pipe for the slurmstepd's reply */
+} stepd_spare_t;
+
+static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static stepd_spare_t spares[STEPD_SPARE_CNT];
+static int  spare_cnt = 0;
+static bool pool_enabled = false;
+static bool refill_running = false;
+static uint32_t pool_gen = 0;		/* incremented by stepd_pool_fini() */
+
+static uint32_t launch_cnt = 0;
+static uint32_t launch_spare_cnt = 0;
+static uint32_t launch_hist[LAUNCH_HIST_BUCKETS];
+
+static void  _close_spare(stepd_spare_t *spare);
+static void *_refill_thread(void *arg);
+static bool  _spare_alive(stepd_spare_t *spare);
+static int   _start_refill(void);
+static int   _start_stepd(int *to_stepd_fd, int *to_slurmd_fd);
+
+static void _close_spare(stepd_spare_t *spare)
+{
+	/* The spare exits when it reads end of file */
+	if (close(spare->to_stepd) < 0)
+		error("close write to_stepd of spare: %m");
+	if (close(spare->to_slurmd) < 0)
+		error("close read to_slurmd of spare: %m");
+}
+
+/* A spare writes nothing until it has its initialization data, so any
+ * event on its reply pipe means it has exited */
+static bool _spare_alive(stepd_spare_t *spare)
+{
+	struct pollfd pfd;
+
+	pfd.fd = spare->to_slurmd;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+	if (poll(&pfd, 1, 0) != 0) {
+		debug("spare slurmstepd exited");
+		return false;
+	}
+	return true;
+}
+
+/* Start a thread to replace used spares. Call with pool_mutex locked */
+static int _start_refill(void)
+{
+	pthread_attr_t attr;
+	pthread_t tid;
+	int rc = SLURM_SUCCESS;
+
+	if (!pool_enabled || refill_running || (spare_cnt >= STEPD_SPARE_CNT))
+		return rc;
+
+	slurm_attr_init(&attr);
+	if (pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED))
+		error("pthread_attr_setdetachstate %m");
+	if (pthread_create(&tid, &attr, _refill_thread, NULL)) {
+		error("Unable to start spare slurmstepd thread: %m");
+		rc = SLURM_ERROR;
+	} else
+		refill_running = true;
+	slurm_attr_destroy(&attr);
+	return rc;
+}
+
+static void *_refill_thread(void *arg)
+{
+	stepd_spare_t spare;
+	uint32_t gen;
+
+	slurm_mutex_lock(&pool_mutex);
+	while (pool_enabled && (spare_cnt < STEPD_SPARE_CNT)) {
+		gen = pool_gen;
+		slurm_mutex_unlock(&pool_mutex);
+
+		if (_start_stepd(&spare.to_stepd, &spare.to_slurmd) !=
+		    SLURM_SUCCESS) {
+			/* Retry when the next spare is used */
+			slurm_mutex_lock(&pool_mutex);
+			break;
+		}
+
+		slurm_mutex_lock(&pool_mutex);
+		/* Discard a spare started before a reconfigure */
+		if (pool_enabled && (gen == pool_gen) &&
+		    (spare_cnt < STEPD_SPARE_CNT))
+			spares[spare_cnt++] = spare;
+		else
+			_close_spare(&spare);
+	}
+	refill_running = false;
+	slurm_mutex_unlock(&pool_mutex);
+
+	return NULL;
+}
+
+/*
+ * Fork and exec a slurmstepd, which then waits for its initialization
+ * data on to_stepd_fd.
+ *
+ * Note that this code forks twice and it is the grandchild that
+ * becomes the slurmstepd process, so the slurmstepd's parent process
+ * will be init, not slurmd.
+ */
+static int _start_stepd(int *to_stepd_fd, int *to_slurmd_fd)
+{
+	pid_t pid;
+	int to_stepd[2] = {-1, -1};
+	int to_slurmd[2] = {-1, -1};
+
+	if (pipe(to_stepd) < 0) {
+		error("_start_stepd pipe failed: %m");
+		return SLURM_FAILURE;
+	}
+	if (pipe(to_slurmd) < 0) {
+		error("_start_stepd pipe failed: %m");
+		close(to_stepd[0]);
+		close(to_stepd[1]);
+		return SLURM_FAILURE;
+	}
+	/* Keep the pipes out of slurmstepds which other threads fork while
+	 * this one starts, the grandchild's dup2() clears the flag on its
+	 * stdin and stdout */
+	fd_set_close_on_exec(to_stepd[0]);
+	fd_set_close_on_exec(to_stepd[1]);
+	fd_set_close_on_exec(to_slurmd[0]);
+	fd_set_close_on_exec(to_slurmd[1]);
+
+	if ((pid = fork()) < 0) {
+		error("_start_stepd: fork: %m");
+		close(to_stepd[0]);
+		close(to_stepd[1]);
+		close(to_slurmd[0]);
+		close(to_slurmd[1]);
+		return SLURM_FAILURE;
+	} else if (pid > 0) {
+		if (close(to_stepd[0]) < 0)
+			error("Unable to close read to_stepd in parent: %m");
+		if (close(to_slurmd[1]) < 0)
+			error("Unable to close write to_slurmd in parent: %m");
+
+		/* Reap child, which exits once it has forked the
+		 * slurmstepd */
+		if (waitpid(pid, NULL, 0) < 0)
+			error("Unable to reap slurmd child process");
+
+		*to_stepd_fd  = to_stepd[1];
+		*to_slurmd_fd = to_slurmd[0];
+		return SLURM_SUCCESS;
+	} else {
+#ifndef SLURMSTEPD_MEMCHECK
+		char *const argv[2] = { (char *)conf->stepd_loc, NULL};
+#else
+		char *const argv[3] = {"memcheck",
+				       (char *)conf->stepd_loc, NULL};
+#endif
+		int failed = 0;
+		/* inform slurmstepd about our config */
+		setenv("SLURM_CONF", conf->conffile, 1);
+
+		/*
+		 * Child forks and exits
+		 */
+		if (setsid() < 0) {
+			error("_start_stepd: setsid: %m");
+			failed = 1;
+		}
+		if ((pid = fork()) < 0) {
+			error("_start_stepd: "
+			      "Unable to fork grandchild: %m");
+			failed = 2;
+		} else if (pid > 0) { /* child */
+			exit(0);
+		}
+
+		/*
+		 * Grandchild exec's the slurmstepd
+		 */
+		slurm_shutdown_msg_engine(conf->lfd);
+
+		if (close(to_stepd[1]) < 0)
+			error("close write to_stepd in grandchild: %m");
+		if (close(to_slurmd[0]) < 0)
+			error("close read to_slurmd in parent: %m");
+
+		(void) close(STDIN_FILENO); /* ignore return */
+		if (dup2(to_stepd[0], STDIN_FILENO) == -1) {
+			error("dup2 over STDIN_FILENO: %m");
+			exit(1);
+		}
+		fd_set_close_on_exec(to_stepd[0]);
+		(void) close(STDOUT_FILENO); /* ignore return */
+		if (dup2(to_slurmd[1], STDOUT_FILENO) == -1) {
+			error("dup2 over STDOUT_FILENO: %m");
+			exit(1);
+		}
+		fd_set_close_on_exec(to_slurmd[1]);
+		(void) close(STDERR_FILENO); /* ignore return */
+		if (dup2(devnull, STDERR_FILENO) == -1) {
+			error("dup2 /dev/null to STDERR_FILENO: %m");
+			exit(1);
+		}
+		fd_set_noclose_on_exec(STDERR_FILENO);
+		log_fini();
+		if (!failed) {
+			execvp(argv[0], argv);
+			error("exec of slurmstepd failed: %m");
+		}
+		exit(2);
+	}
+}
+
+extern void stepd_pool_init(void)
+{
+	slurm_mutex_lock(&pool_mutex);
+	pool_enabled = true;
+	_start_refill();
+	slurm_mutex_unlock(&pool_mutex);
+}
+
+extern void stepd_pool_fini(void)
+{
+	slurm_mutex_lock(&pool_mutex);
+	pool_enabled = false;
+	pool_gen++;
+	while (spare_cnt)
+		_close_spare(&spares[--spare_cnt]);
+	slurm_mutex_unlock(&pool_mutex);
+}
+
+extern int stepd_pool_get(int *to_stepd, int *to_slurmd, bool *spare)
+{
+	stepd_spare_t *use = NULL;
+
+	slurm_mutex_lock(&pool_mutex);
+	while (spare_cnt) {
+		use = &spares[--spare_cnt];
+		if (_spare_alive(use))
+			break;
+		_close_spare(use);
+		use = NULL;
+	}
+	if (use) {
+		*to_stepd  = use->to_stepd;
+		*to_slurmd = use->to_slurmd;
+	}
+	_start_refill();
+	slurm_mutex_unlock(&pool_mutex);
+
+	if (use) {
+		*spare = true;
+		return SLURM_SUCCESS;
+	}
+	*spare = false;
+	return _start_stepd(to_stepd, to_slurmd);
+}
+
+extern void stepd_pool_launch_done(struct timeval *start, bool spare)
+{
+	struct timeval now;
+	long delta_msec, limit_msec = 1;
+	int i = 0;
+
+	gettimeofday(&now, NULL);
+	delta_msec = (now.tv_sec  - start->tv_sec)  * 1000 +
+		     (now.tv_usec - start->tv_usec) / 1000;
+	while ((i < (LAUNCH_HIST_BUCKETS - 1)) && (delta_msec >= limit_msec)) {
+		limit_msec *= 10;
+		i++;
+	}
+
+	slurm_mutex_lock(&pool_mutex);
+	launch_cnt++;
+	if (spare)
+		launch_spare_cnt++;
+	launch_hist[i]++;
+	slurm_mutex_unlock(&pool_mutex);
+}
+
+extern void stepd_pool_get_stats(slurmd_status_t *status)
+{
+	slurm_mutex_lock(&pool_mutex);
+	status->launch_cnt       = launch_cnt;
+	status->launch_spare_cnt = launch_spare_cnt;
+	status->launch_hist_cnt  = LAUNCH_HIST_BUCKETS;
+	status->launch_hist = xmalloc(sizeof(uint32_t) * LAUNCH_HIST_BUCKETS);
+	memcpy(status->launch_hist, launch_hist,
+	       sizeof(uint32_t) * LAUNCH_HIST_BUCKETS);
+	slurm_mutex_unlock(&pool_mutex);
+}
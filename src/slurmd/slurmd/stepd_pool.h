@@ -0,0 +1,75 @@
+/*****************************************************************************\
+ *  src/slurmd/slurmd/stepd_pool.h - spare slurmstepd processes started ahead
+ *	of need
+ *****************************************************************************
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+
+#ifndef _STEPD_POOL_H
+#define _STEPD_POOL_H
+
+#include <stdbool.h>
+#include <sys/time.h>
+
+#include "slurm/slurm.h"
+
+/* stepd_pool_init - Start filling the pool of spare slurmstepd processes */
+extern void stepd_pool_init(void);
+
+/*
+ * stepd_pool_fini - Stop the spare slurmstepd processes. Used with
+ *	stepd_pool_init() on reconfigure, so spares read the new configuration.
+ */
+extern void stepd_pool_fini(void);
+
+/*
+ * stepd_pool_get - Get a slurmstepd waiting for its initialization data
+ *	from _send_slurmstepd_init(), taking a spare if one is available and
+ *	starting a new slurmstepd otherwise. The slurmstepd's parent process
+ *	is init, not slurmd.
+ * OUT to_stepd - pipe to write initialization data to, close when done
+ * OUT to_slurmd - pipe to read the slurmstepd's reply from, close when done
+ * OUT spare - set if a spare was used
+ * RET SLURM_SUCCESS or SLURM_FAILURE
+ */
+extern int stepd_pool_get(int *to_stepd, int *to_slurmd, bool *spare);
+
+/*
+ * stepd_pool_launch_done - Record a slurmstepd launch in the statistics
+ * IN start - time the launch request was received
+ * IN spare - set if a spare was used
+ */
+extern void stepd_pool_launch_done(struct timeval *start, bool spare);
+
+/* stepd_pool_get_stats - Load the launch statistics into a status message */
+extern void stepd_pool_get_stats(slurmd_status_t *status);
+
+#endif /* !_STEPD_POOL_H */
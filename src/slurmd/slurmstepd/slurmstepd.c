@@ -385,8 +385,14 @@ _init_from_slurmd(int sock, char **argv,
 
 	log_init(argv[0], lopts, LOG_DAEMON, NULL);
 
-	/* receive job type from slurmd */
-	safe_read(sock, &step_type, sizeof(int));
+	/* receive job type from slurmd. A spare slurmstepd waits here
+	 * until slurmd has a step for it, and exits quietly if slurmd
+	 * closes the pipe instead (see src/slurmd/slurmd/stepd_pool.c) */
+	len = read(sock, &step_type, sizeof(int));
+	if (len == 0)
+		exit(0);
+	else if (len != sizeof(int))
+		goto rwfail;
 	debug3("step_type = %d", step_type);
 
 	/* receive reverse-tree info from slurmd */
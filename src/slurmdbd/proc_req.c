@@ -72,6 +72,7 @@ static int   _archive_dump(slurmdbd_conn_t *slurmdbd_conn,
 			   Buf in_buffer, Buf *out_buffer, uint32_t *uid);
 static int   _archive_load(slurmdbd_conn_t *slurmdbd_conn,
 			   Buf in_buffer, Buf *out_buffer, uint32_t *uid);
+static bool  _batch_msg_type(Buf req_buf);
 static int   _cluster_cpus(slurmdbd_conn_t *slurmdbd_conn,
 			   Buf in_buffer, Buf *out_buffer, uint32_t *uid);
 static int   _get_accounts(slurmdbd_conn_t *slurmdbd_conn,
@@ -1188,6 +1189,8 @@ static int _get_config(slurmdbd_conn_t *slurmdbd_conn,
 	if (config_name == NULL ||
 	    strcmp(config_name, "slurmdbd.conf") == 0)
 		list_msg.my_list = dump_config();
+	else if (strcmp(config_name, "slurmdbd.stats") == 0)
+		list_msg.my_list = rpc_mgr_get_stats();
 	else if ((list_msg.my_list = acct_storage_g_get_config(
 			slurmdbd_conn->db_conn, config_name)) == NULL) {
 		*out_buffer = make_dbd_rc_msg(slurmdbd_conn->rpc_version,
@@ -3399,6 +3402,34 @@ static int   _send_mult_job_start(slurmdbd_conn_t *slurmdbd_conn,
 	return SLURM_SUCCESS;
 }
 
+/* Return true if a request only records job, step or node state and may be
+ * committed in one transaction with others like it */
+static bool _batch_msg_type(Buf req_buf)
+{
+	uint16_t msg_type;
+	uint32_t offset = get_buf_offset(req_buf);
+	bool batch = false;
+
+	set_buf_offset(req_buf, 0);
+	if (unpack16(&msg_type, req_buf) == SLURM_SUCCESS) {
+		switch (msg_type) {
+		case DBD_JOB_COMPLETE:
+		case DBD_JOB_START:
+		case DBD_JOB_SUSPEND:
+		case DBD_NODE_STATE:
+		case DBD_STEP_COMPLETE:
+		case DBD_STEP_START:
+			batch = true;
+			break;
+		default:
+			break;
+		}
+	}
+	set_buf_offset(req_buf, offset);
+
+	return batch;
+}
+
 static int   _send_mult_msg(slurmdbd_conn_t *slurmdbd_conn,
 			    Buf in_buffer, Buf *out_buffer,
 			    uint32_t *uid)
@@ -3409,6 +3440,7 @@ static int   _send_mult_msg(slurmdbd_conn_t *slurmdbd_conn,
 	ListIterator itr = NULL;
 	Buf req_buf = NULL, ret_buf = NULL;
 	int rc = SLURM_SUCCESS;
+	bool batch = true, done = false;
 
 	if (*uid != slurmdbd_conf->slurm_user_id && *uid != 0) {
 		comment = "DBD_SEND_MULT_MSG message from invalid uid";
@@ -3432,15 +3464,69 @@ static int   _send_mult_msg(slurmdbd_conn_t *slurmdbd_conn,
 
 	list_msg.my_list = list_create(slurmdbd_free_buffer);
 
+	/* The agent pipelines batches. Once a record has failed, process
+	 * none of the batches which follow it on this connection, so no
+	 * record is committed before an earlier one the agent still has
+	 * queued. The agent reconnects before sending them again. */
+	if (slurmdbd_conn->mult_failed) {
+		debug("CONN:%u DBD_SEND_MULT_MSG rejected after earlier "
+		      "failure", slurmdbd_conn->newsockfd);
+		done = true;
+		batch = false;
+	}
+
+	/* Commit a batch of job records in one transaction rather than one
+	 * per record. If any record fails, roll back and process them one
+	 * at a time so every record before the failure is kept. */
 	itr = list_iterator_create(get_msg->my_list);
-	while ((req_buf = list_next(itr))) {
-		ret_buf = NULL;
-		rc = proc_req(slurmdbd_conn, get_buf_data(req_buf),
-			      size_buf(req_buf), 0, &ret_buf, uid);
-		if (ret_buf)
-			list_append(list_msg.my_list, ret_buf);
+	while (batch && (req_buf = list_next(itr))) {
+		if (!_batch_msg_type(req_buf))
+			batch = false;
+	}
+	if (!done && batch && (list_count(get_msg->my_list) > 1) &&
+	    (acct_storage_g_batch_start(slurmdbd_conn->db_conn) ==
+	     SLURM_SUCCESS)) {
+		list_iterator_reset(itr);
+		while ((req_buf = list_next(itr))) {
+			ret_buf = NULL;
+			rc = proc_req(slurmdbd_conn, get_buf_data(req_buf),
+				      size_buf(req_buf), 0, &ret_buf, uid);
+			if (ret_buf)
+				list_append(list_msg.my_list, ret_buf);
+			if (rc != SLURM_SUCCESS)
+				break;
+		}
+		if (rc == SLURM_SUCCESS)
+			rc = acct_storage_g_batch_end(slurmdbd_conn->db_conn,
+						      true);
+		else
+			(void) acct_storage_g_batch_end(slurmdbd_conn->db_conn,
+							false);
+		if (rc == SLURM_SUCCESS)
+			done = true;
+		else {
+			debug("CONN:%u DBD_SEND_MULT_MSG batch failed, "
+			      "processing %d records individually",
+			      slurmdbd_conn->newsockfd,
+			      list_count(get_msg->my_list));
+			list_flush(list_msg.my_list);
+		}
+	}
+
+	if (!done) {
+		rc = SLURM_SUCCESS;
+		list_iterator_reset(itr);
+		while ((req_buf = list_next(itr))) {
+			ret_buf = NULL;
+			rc = proc_req(slurmdbd_conn, get_buf_data(req_buf),
+				      size_buf(req_buf), 0, &ret_buf, uid);
+			if (ret_buf)
+				list_append(list_msg.my_list, ret_buf);
+			if (rc != SLURM_SUCCESS)
+				break;
+		}
 		if (rc != SLURM_SUCCESS)
-			break;
+			slurmdbd_conn->mult_failed = true;
 	}
 	list_iterator_destroy(itr);
 
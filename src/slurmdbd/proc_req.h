@@ -49,6 +49,8 @@ typedef struct {
 	uint16_t ctld_port; /* slurmctld_port */
 	void *db_conn; /* database connection */
 	char ip[32];
+	bool mult_failed; /* a DBD_SEND_MULT_MSG record failed, so later
+			   * batches on this connection are not processed */
 	slurm_fd_t newsockfd; /* socket connection descriptor */
 	uint16_t orig_port;
 	uint16_t rpc_version; /* version of rpc */
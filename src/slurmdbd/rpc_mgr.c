@@ -41,6 +41,7 @@
 #  include "config.h"
 #endif
 #include <arpa/inet.h>
+#include <inttypes.h>
 #include <pthread.h>
 #include <signal.h>
 #include <sys/poll.h>
@@ -49,17 +50,20 @@
 #include "src/common/fd.h"
 #include "src/common/log.h"
 #include "src/common/macros.h"
+#include "src/common/read_config.h"
 #include "src/common/slurm_protocol_api.h"
 #include "src/common/slurm_accounting_storage.h"
 #include "src/common/slurmdbd_defs.h"
 #include "src/common/xmalloc.h"
 #include "src/common/xsignal.h"
+#include "src/common/xstring.h"
 #include "src/slurmdbd/proc_req.h"
 #include "src/slurmdbd/read_config.h"
 #include "src/slurmdbd/rpc_mgr.h"
 #include "src/slurmdbd/slurmdbd.h"
 
 #define MAX_THREAD_COUNT 100
+#define MAX_CONN_COUNT	 1000	/* connections polled by rpc_mgr */
 
 /*
  *  Maximum message size. Messages larger than this value (in bytes)
@@ -67,21 +71,76 @@
  */
 #define MAX_MSG_SIZE     (16*1024*1024)
 
+/* rpc_mgr polls all open connections and queues each complete message by
+ * its type for a fixed pool of worker threads, so large queries can not
+ * delay the accounting records sent by slurmctld, and neither waits
+ * behind rollups. A connection is not polled while its message is queued
+ * or being processed, so its messages are still processed in order. */
+#define DBD_QUEUE_QUERY		0	/* DBD_GET_* requests */
+#define DBD_QUEUE_UPDATE	1	/* accounting records and updates */
+#define DBD_QUEUE_ROLLUP	2	/* usage rollup and archive */
+#define DBD_QUEUE_CNT		3
+
+#define DBD_QUERY_THREADS	24
+#define DBD_UPDATE_THREADS	24
+#define DBD_ROLLUP_THREADS	2
+
+/* Latency histogram buckets, upper bounds in milliseconds. The last bucket
+ * counts RPCs taking RPC_HIST_MAX_MSEC or longer. */
+#define RPC_HIST_BUCKETS	6
+#define RPC_HIST_MAX_MSEC	10000
+
+typedef struct {
+	char *name;
+	int thread_cnt;
+	List conn_list;		/* rpc_conn_t waiting for a worker */
+	pthread_cond_t cond;
+
+	uint32_t count;		/* RPCs processed */
+	uint32_t depth_max;	/* largest count of RPCs queued */
+	uint64_t wait_usec;	/* total time RPCs were queued */
+	uint64_t run_usec;	/* total time processing RPCs */
+	uint32_t run_max_usec;	/* longest time processing an RPC */
+	uint32_t latency_hist[RPC_HIST_BUCKETS];
+} rpc_queue_t;
+
+typedef struct {
+	slurmdbd_conn_t *conn;
+	bool first;		/* set until first message processed */
+	uint32_t uid;		/* user ID who initiated the RPCs */
+	uint32_t nw_size;	/* message size, network byte order */
+	char *msg;		/* message being read, NULL to close */
+	uint32_t msg_size;
+	uint32_t offset;	/* bytes of nw_size or msg read */
+	struct timeval recv_time; /* when msg was read */
+} rpc_conn_t;
+
 /* Local functions */
-static bool   _fd_readable(slurm_fd_t fd);
+static void   _close_conn(rpc_conn_t *rpc_conn);
+static int    _delta_usec(struct timeval *start, struct timeval *end);
+static void   _fini_queues(void);
 static void   _free_server_thread(pthread_t my_tid);
+static void   _init_queues(void);
+static int    _msg_queue(uint16_t msg_type);
+static bool   _process_msg(rpc_conn_t *rpc_conn);
+static void   _queue_conn(rpc_conn_t *rpc_conn);
+static int    _read_conn(rpc_conn_t *rpc_conn, short revents);
+static void   _ready_conn(rpc_conn_t *rpc_conn);
+static void * _rpc_worker(void *arg);
 static int    _send_resp(slurm_fd_t fd, Buf buffer);
-static void * _service_connection(void *arg);
 static void   _sig_handler(int signal);
 static int    _tot_wait (struct timeval *start_time);
-static int    _wait_for_server_thread(void);
 static void   _wait_for_thread_fini(void);
 
-/* Local variables */
+/* Local variables, thread_count_lock protects all but master_thread_id
+ * and wake_fd */
 static pthread_t       master_thread_id = 0, slave_thread_id[MAX_THREAD_COUNT];
 static int             thread_count = 0;
 static pthread_mutex_t thread_count_lock = PTHREAD_MUTEX_INITIALIZER;
-static pthread_cond_t  thread_count_cond = PTHREAD_COND_INITIALIZER;
+static rpc_queue_t     rpc_queue[DBD_QUEUE_CNT];
+static List            ready_list = NULL; /* rpc_conn_t to poll again */
+static int             conn_count = 0;
+static int             wake_fd[2] = { -1, -1 };
 
 
 /* Process incoming RPCs. Meant to execute as a pthread */
@@ -89,9 +148,13 @@ extern void *rpc_mgr(void *no_data)
 {
 	pthread_attr_t thread_attr_rpc_req;
 	slurm_fd_t sockfd, newsockfd;
-	int i, retry_cnt, sigarray[] = {SIGUSR1, 0};
+	int i, j, nfds, first_conn, rc, sigarray[] = {SIGUSR1, 0};
 	slurm_addr_t cli_addr;
-	slurmdbd_conn_t *conn_arg = NULL;
+	struct pollfd *ufds;
+	List idle_list;
+	ListIterator itr;
+	rpc_conn_t *rpc_conn;
+	char buf[64];
 
 	slurm_mutex_lock(&thread_count_lock);
 	master_thread_id = pthread_self();
@@ -100,18 +163,21 @@ extern void *rpc_mgr(void *no_data)
 	(void) pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
 	(void) pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, NULL);
 
-	/* threads to process individual RPC's are detached */
-	slurm_attr_init(&thread_attr_rpc_req);
-	if (pthread_attr_setdetachstate
-	    (&thread_attr_rpc_req, PTHREAD_CREATE_DETACHED))
-		fatal("pthread_attr_setdetachstate %m");
-
 	/* initialize port for RPCs */
 	if ((sockfd = slurm_init_msg_engine_port(get_dbd_port()))
 	    == SLURM_SOCKET_ERROR)
 		fatal("slurm_init_msg_engine_port error %m");
 
-	/* Prepare to catch SIGUSR1 to interrupt accept().
+	/* Workers write to wake_fd when returning a connection to be
+	 * polled for its next message */
+	if (pipe(wake_fd))
+		fatal("pipe: %m");
+	for (i = 0; i < 2; i++) {
+		fd_set_nonblocking(wake_fd[i]);
+		fd_set_close_on_exec(wake_fd[i]);
+	}
+
+	/* Prepare to catch SIGUSR1 to interrupt poll().
 	 * This signal is generated by the slurmdbd signal
 	 * handler thread upon receipt of SIGABRT, SIGINT,
 	 * or SIGTERM. That thread does all processing of
@@ -119,10 +185,86 @@ extern void *rpc_mgr(void *no_data)
 	xsignal(SIGUSR1, _sig_handler);
 	xsignal_unblock(sigarray);
 
+	/* threads to process individual RPC's are detached */
+	slurm_attr_init(&thread_attr_rpc_req);
+	if (pthread_attr_setdetachstate
+	    (&thread_attr_rpc_req, PTHREAD_CREATE_DETACHED))
+		fatal("pthread_attr_setdetachstate %m");
+	_init_queues();
+	slurm_mutex_lock(&thread_count_lock);
+	for (i = 0; i < DBD_QUEUE_CNT; i++) {
+		for (j = 0; j < rpc_queue[i].thread_cnt; j++) {
+			if (pthread_create(&slave_thread_id[thread_count],
+					   &thread_attr_rpc_req, _rpc_worker,
+					   (void *) &rpc_queue[i]))
+				fatal("pthread_create: %m");
+			thread_count++;
+		}
+	}
+	slurm_mutex_unlock(&thread_count_lock);
+	slurm_attr_destroy(&thread_attr_rpc_req);
+
 	/*
 	 * Process incoming RPCs until told to shutdown
 	 */
-	while ((i = _wait_for_server_thread()) >= 0) {
+	idle_list = list_create(NULL);
+	ufds = xmalloc(sizeof(struct pollfd) * (MAX_CONN_COUNT + 2));
+	while (shutdown_time == 0) {
+		ufds[0].fd = wake_fd[0];
+		ufds[0].events = POLLIN;
+		nfds = 1;
+		if (conn_count < MAX_CONN_COUNT) {
+			ufds[nfds].fd = sockfd;
+			ufds[nfds].events = POLLIN;
+			nfds++;
+		}
+		first_conn = nfds;
+		itr = list_iterator_create(idle_list);
+		while ((rpc_conn = list_next(itr))) {
+			ufds[nfds].fd = rpc_conn->conn->newsockfd;
+			ufds[nfds].events = POLLIN;
+			nfds++;
+		}
+		list_iterator_destroy(itr);
+
+		rc = poll(ufds, nfds, -1);
+		if (shutdown_time)
+			break;
+		if (rc == -1) {
+			if ((errno != EINTR) && (errno != EAGAIN)) {
+				error("poll: %m");
+				usleep(10000);
+			}
+			continue;
+		}
+
+		/* Queue connections with a complete message for a
+		 * worker, or to be closed */
+		itr = list_iterator_create(idle_list);
+		for (i = first_conn; i < nfds; i++) {
+			rpc_conn = list_next(itr);
+			if (ufds[i].revents == 0)
+				continue;
+			rc = _read_conn(rpc_conn, ufds[i].revents);
+			if (rc == 0)
+				continue;
+			list_remove(itr);
+			if (rc < 0)
+				xfree(rpc_conn->msg);
+			_queue_conn(rpc_conn);
+		}
+		list_iterator_destroy(itr);
+
+		if (ufds[0].revents) {
+			while (read(wake_fd[0], buf, sizeof(buf)) > 0)
+				;
+			slurm_mutex_lock(&thread_count_lock);
+			list_transfer(idle_list, ready_list);
+			slurm_mutex_unlock(&thread_count_lock);
+		}
+
+		if ((first_conn == 1) || (ufds[1].revents == 0))
+			continue;
 		/*
 		 * accept needed for stream implementation is a no-op in
 		 * message implementation that just passes sockfd to newsockfd
@@ -130,38 +272,52 @@ extern void *rpc_mgr(void *no_data)
 		if ((newsockfd = slurm_accept_msg_conn(sockfd,
 						       &cli_addr)) ==
 		    SLURM_SOCKET_ERROR) {
-			_free_server_thread((pthread_t) 0);
 			if (errno != EINTR)
 				error("slurm_accept_msg_conn: %m");
 			continue;
 		}
 		fd_set_nonblocking(newsockfd);
 
-		conn_arg = xmalloc(sizeof(slurmdbd_conn_t));
-		conn_arg->newsockfd = newsockfd;
-		slurm_get_ip_str(&cli_addr, &conn_arg->orig_port,
-				 conn_arg->ip, sizeof(conn_arg->ip));
-		retry_cnt = 0;
-		while (pthread_create(&slave_thread_id[i],
-				      &thread_attr_rpc_req,
-				      _service_connection,
-				      (void *) conn_arg)) {
-			if (retry_cnt > 0) {
-				error("pthread_create failure, "
-				      "aborting RPC: %m");
-				close(newsockfd);
-				break;
-			}
-			error("pthread_create failure: %m");
-			retry_cnt++;
-			usleep(1000);	/* retry in 1 msec */
-		}
+		rpc_conn = xmalloc(sizeof(rpc_conn_t));
+		rpc_conn->conn = xmalloc(sizeof(slurmdbd_conn_t));
+		rpc_conn->conn->newsockfd = newsockfd;
+		slurm_get_ip_str(&cli_addr, &rpc_conn->conn->orig_port,
+				 rpc_conn->conn->ip,
+				 sizeof(rpc_conn->conn->ip));
+		rpc_conn->first = true;
+		rpc_conn->uid = NO_VAL;
+		debug2("Opened connection %d from %s",
+		       newsockfd, rpc_conn->conn->ip);
+		slurm_mutex_lock(&thread_count_lock);
+		conn_count++;
+		slurm_mutex_unlock(&thread_count_lock);
+		list_append(idle_list, rpc_conn);
 	}
 
 	debug3("rpc_mgr shutting down");
-	slurm_attr_destroy(&thread_attr_rpc_req);
+	slurm_mutex_lock(&thread_count_lock);
+	for (i = 0; i < DBD_QUEUE_CNT; i++)
+		pthread_cond_broadcast(&rpc_queue[i].cond);
+	slurm_mutex_unlock(&thread_count_lock);
 	(void) slurm_shutdown_msg_engine(sockfd);
 	_wait_for_thread_fini();
+
+	/* Close connections which were idle or still queued */
+	slurm_mutex_lock(&thread_count_lock);
+	list_transfer(idle_list, ready_list);
+	for (i = 0; i < DBD_QUEUE_CNT; i++)
+		list_transfer(idle_list, rpc_queue[i].conn_list);
+	slurm_mutex_unlock(&thread_count_lock);
+	while ((rpc_conn = list_dequeue(idle_list)))
+		_close_conn(rpc_conn);
+	list_destroy(idle_list);
+	xfree(ufds);
+	_fini_queues();
+
+	for (i = 0; i < 2; i++) {
+		(void) close(wake_fd[i]);
+		wake_fd[i] = -1;
+	}
 	pthread_exit((void *) 0);
 	return NULL;
 }
@@ -172,6 +328,8 @@ extern void rpc_mgr_wake(void)
 	int i;
 
 	slurm_mutex_lock(&thread_count_lock);
+	if (wake_fd[1] >= 0)
+		(void) write(wake_fd[1], "", 1);
 	if (master_thread_id)
 		pthread_kill(master_thread_id, SIGUSR1);
 	for (i=0; i<MAX_THREAD_COUNT; i++) {
@@ -181,72 +339,335 @@ extern void rpc_mgr_wake(void)
 	slurm_mutex_unlock(&thread_count_lock);
 }
 
-static void * _service_connection(void *arg)
+static void _add_stat(List stat_list, char *name, char *value)
 {
-	slurmdbd_conn_t *conn = (slurmdbd_conn_t *) arg;
-	uint32_t nw_size = 0, msg_size = 0, uid = NO_VAL;
-	char *msg = NULL;
-	ssize_t msg_read = 0, offset = 0;
-	bool fini = false, first = true;
-	Buf buffer = NULL;
-	int rc = SLURM_SUCCESS;
+	config_key_pair_t *key_pair = xmalloc(sizeof(config_key_pair_t));
+
+	key_pair->name = xstrdup(name);
+	key_pair->value = value;
+	list_append(stat_list, key_pair);
+}
 
-	debug2("Opened connection %d from %s", conn->newsockfd, conn->ip);
+/* Return RPC statistics for each queue as a list of config_key_pair_t */
+extern List rpc_mgr_get_stats(void)
+{
+	static char *hist_name[RPC_HIST_BUCKETS] = {
+		"<1", "<10", "<100", "<1000", "<10000", ">=10000" };
+	List stat_list = list_create(destroy_config_key_pair);
+	rpc_queue_t *queue;
+	char *name = NULL, *value;
+	int i, j;
 
-	while (!fini) {
-		if (!_fd_readable(conn->newsockfd))
-			break;		/* problem with this socket */
-		msg_read = read(conn->newsockfd, &nw_size, sizeof(nw_size));
-		if (msg_read == 0)	/* EOF */
-			break;
-		if (msg_read != sizeof(nw_size)) {
-			error("Could not read msg_size from "
-			      "connection %d(%s) uid(%d)",
-			      conn->newsockfd, conn->ip, uid);
-			break;
+	slurm_mutex_lock(&thread_count_lock);
+	_add_stat(stat_list, "Connections",
+		  xstrdup_printf("%d", conn_count));
+	for (i = 0; i < DBD_QUEUE_CNT; i++) {
+		queue = &rpc_queue[i];
+		if (!queue->conn_list)
+			continue;
+		xstrfmtcat(name, "%sThreads", queue->name);
+		_add_stat(stat_list, name,
+			  xstrdup_printf("%d", queue->thread_cnt));
+		xfree(name);
+		xstrfmtcat(name, "%sRPCs", queue->name);
+		_add_stat(stat_list, name, xstrdup_printf("%u", queue->count));
+		xfree(name);
+		xstrfmtcat(name, "%sQueued", queue->name);
+		_add_stat(stat_list, name,
+			  xstrdup_printf("%d", list_count(queue->conn_list)));
+		xfree(name);
+		xstrfmtcat(name, "%sQueuedMax", queue->name);
+		_add_stat(stat_list, name,
+			  xstrdup_printf("%u", queue->depth_max));
+		xfree(name);
+		xstrfmtcat(name, "%sWaitAve", queue->name);
+		_add_stat(stat_list, name, xstrdup_printf(
+				  "%"PRIu64" usec", queue->count ?
+				  (queue->wait_usec / queue->count) : 0));
+		xfree(name);
+		xstrfmtcat(name, "%sRunAve", queue->name);
+		_add_stat(stat_list, name, xstrdup_printf(
+				  "%"PRIu64" usec", queue->count ?
+				  (queue->run_usec / queue->count) : 0));
+		xfree(name);
+		xstrfmtcat(name, "%sRunMax", queue->name);
+		_add_stat(stat_list, name,
+			  xstrdup_printf("%u usec", queue->run_max_usec));
+		xfree(name);
+		value = NULL;
+		for (j = 0; j < RPC_HIST_BUCKETS; j++) {
+			xstrfmtcat(value, "%s%sms:%u", (j ? " " : ""),
+				   hist_name[j], queue->latency_hist[j]);
+		}
+		xstrfmtcat(name, "%sLatency", queue->name);
+		_add_stat(stat_list, name, value);
+		xfree(name);
+	}
+	slurm_mutex_unlock(&thread_count_lock);
+
+	return stat_list;
+}
+
+static void _init_queues(void)
+{
+	static char *queue_name[DBD_QUEUE_CNT] = {
+		"Query", "Update", "Rollup" };
+	static int queue_threads[DBD_QUEUE_CNT] = {
+		DBD_QUERY_THREADS, DBD_UPDATE_THREADS, DBD_ROLLUP_THREADS };
+	int i;
+
+	slurm_mutex_lock(&thread_count_lock);
+	for (i = 0; i < DBD_QUEUE_CNT; i++) {
+		memset(&rpc_queue[i], 0, sizeof(rpc_queue_t));
+		rpc_queue[i].name = queue_name[i];
+		rpc_queue[i].thread_cnt = queue_threads[i];
+		rpc_queue[i].conn_list = list_create(NULL);
+		pthread_cond_init(&rpc_queue[i].cond, NULL);
+	}
+	ready_list = list_create(NULL);
+	conn_count = 0;
+	slurm_mutex_unlock(&thread_count_lock);
+}
+
+static void _fini_queues(void)
+{
+	int i;
+
+	slurm_mutex_lock(&thread_count_lock);
+	for (i = 0; i < DBD_QUEUE_CNT; i++) {
+		list_destroy(rpc_queue[i].conn_list);
+		rpc_queue[i].conn_list = NULL;
+		pthread_cond_destroy(&rpc_queue[i].cond);
+	}
+	list_destroy(ready_list);
+	ready_list = NULL;
+	slurm_mutex_unlock(&thread_count_lock);
+}
+
+/* Return the queue for a message type */
+static int _msg_queue(uint16_t msg_type)
+{
+	switch (msg_type) {
+	case DBD_GET_ACCOUNTS:
+	case DBD_GET_ASSOCS:
+	case DBD_GET_ASSOC_USAGE:
+	case DBD_GET_CLUSTERS:
+	case DBD_GET_CLUSTER_USAGE:
+	case DBD_GET_CONFIG:
+	case DBD_GET_EVENTS:
+	case DBD_GET_JOBS_COND:
+	case DBD_GET_PROBS:
+	case DBD_GET_QOS:
+	case DBD_GET_RESVS:
+	case DBD_GET_TXN:
+	case DBD_GET_USERS:
+	case DBD_GET_WCKEYS:
+	case DBD_GET_WCKEY_USAGE:
+		return DBD_QUEUE_QUERY;
+	case DBD_ARCHIVE_DUMP:
+	case DBD_ARCHIVE_LOAD:
+	case DBD_ROLL_USAGE:
+		return DBD_QUEUE_ROLLUP;
+	default:
+		return DBD_QUEUE_UPDATE;
+	}
+}
+
+/* Read whatever is available of a connection's next message
+ * RET 1 if the message is complete, 0 if more remains to be read or -1 if
+ *	the connection should be closed */
+static int _read_conn(rpc_conn_t *rpc_conn, short revents)
+{
+	slurmdbd_conn_t *conn = rpc_conn->conn;
+	ssize_t msg_read;
+
+	if (revents & POLLNVAL) {
+		error("Connection %d is invalid", conn->newsockfd);
+		return -1;
+	}
+	if (revents & POLLERR) {
+		error("Connection %d experienced an error", conn->newsockfd);
+		return -1;
+	}
+
+	while (1) {
+		if (rpc_conn->msg) {
+			msg_read = read(conn->newsockfd,
+					(rpc_conn->msg + rpc_conn->offset),
+					(rpc_conn->msg_size -
+					 rpc_conn->offset));
+		} else {
+			msg_read = read(conn->newsockfd,
+					(((char *) &rpc_conn->nw_size) +
+					 rpc_conn->offset),
+					(sizeof(rpc_conn->nw_size) -
+					 rpc_conn->offset));
+		}
+		if (msg_read == 0) {	/* EOF */
+			if (rpc_conn->msg || rpc_conn->offset) {
+				error("Connection %d(%s) closed during "
+				      "message", conn->newsockfd, conn->ip);
+			}
+			return -1;
 		}
-		msg_size = ntohl(nw_size);
-		if ((msg_size < 2) || (msg_size > MAX_MSG_SIZE)) {
+		if (msg_read < 0) {
+			if (errno == EINTR)
+				continue;
+			if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+				return 0;
+			error("read(%d): %m", conn->newsockfd);
+			return -1;
+		}
+		rpc_conn->offset += msg_read;
+
+		if (rpc_conn->msg) {
+			if (rpc_conn->offset < rpc_conn->msg_size)
+				continue;
+			gettimeofday(&rpc_conn->recv_time, NULL);
+			return 1;
+		}
+		if (rpc_conn->offset < sizeof(rpc_conn->nw_size))
+			continue;
+		rpc_conn->msg_size = ntohl(rpc_conn->nw_size);
+		if ((rpc_conn->msg_size < 2) ||
+		    (rpc_conn->msg_size > MAX_MSG_SIZE)) {
 			error("Invalid msg_size (%u) from "
 			      "connection %d(%s) uid(%d)",
-			      msg_size, conn->newsockfd, conn->ip, uid);
+			      rpc_conn->msg_size, conn->newsockfd, conn->ip,
+			      rpc_conn->uid);
+			return -1;
+		}
+		rpc_conn->msg = xmalloc(rpc_conn->msg_size);
+		rpc_conn->offset = 0;
+	}
+}
+
+/* Queue a connection with a complete message for a worker, or with no
+ * message to be closed */
+static void _queue_conn(rpc_conn_t *rpc_conn)
+{
+	rpc_queue_t *queue;
+	uint16_t msg_type;
+	uint32_t depth;
+
+	if (rpc_conn->msg) {
+		memcpy(&msg_type, rpc_conn->msg, sizeof(msg_type));
+		queue = &rpc_queue[_msg_queue(ntohs(msg_type))];
+	} else {
+		/* closing a slurmctld's connection updates the database */
+		queue = &rpc_queue[DBD_QUEUE_UPDATE];
+	}
+
+	slurm_mutex_lock(&thread_count_lock);
+	list_enqueue(queue->conn_list, rpc_conn);
+	depth = list_count(queue->conn_list);
+	if (depth > queue->depth_max)
+		queue->depth_max = depth;
+	pthread_cond_signal(&queue->cond);
+	slurm_mutex_unlock(&thread_count_lock);
+}
+
+/* Return a connection to rpc_mgr to be polled for its next message */
+static void _ready_conn(rpc_conn_t *rpc_conn)
+{
+	rpc_conn->msg_size = 0;
+	rpc_conn->offset = 0;
+
+	slurm_mutex_lock(&thread_count_lock);
+	list_enqueue(ready_list, rpc_conn);
+	if (write(wake_fd[1], "", 1) < 0 && (errno != EAGAIN))
+		error("write(wake_fd): %m");
+	slurm_mutex_unlock(&thread_count_lock);
+}
+
+static void * _rpc_worker(void *arg)
+{
+	rpc_queue_t *queue = (rpc_queue_t *) arg;
+	rpc_conn_t *rpc_conn;
+	struct timeval start_time, end_time;
+	uint32_t msec, limit_msec, wait_usec, run_usec;
+	bool fini;
+	int i;
+
+	while (1) {
+		slurm_mutex_lock(&thread_count_lock);
+		while (!(rpc_conn = list_dequeue(queue->conn_list)) &&
+		       (shutdown_time == 0))
+			pthread_cond_wait(&queue->cond, &thread_count_lock);
+		slurm_mutex_unlock(&thread_count_lock);
+		if (!rpc_conn)
 			break;
+		if (!rpc_conn->msg || shutdown_time) {
+			_close_conn(rpc_conn);
+			continue;
 		}
 
-		msg = xmalloc(msg_size);
-		offset = 0;
-		while (msg_size > offset) {
-			if (!_fd_readable(conn->newsockfd))
-				break;		/* problem with this socket */
-			msg_read = read(conn->newsockfd, (msg + offset),
-					(msg_size - offset));
-			if (msg_read <= 0) {
-				error("read(%d): %m", conn->newsockfd);
+		gettimeofday(&start_time, NULL);
+		fini = _process_msg(rpc_conn);
+		gettimeofday(&end_time, NULL);
+		wait_usec = _delta_usec(&rpc_conn->recv_time, &start_time);
+		run_usec  = _delta_usec(&start_time, &end_time);
+		if (fini)
+			_close_conn(rpc_conn);
+		else
+			_ready_conn(rpc_conn);
+
+		msec = (wait_usec + run_usec) / 1000;
+		for (i = 0, limit_msec = 1; i < (RPC_HIST_BUCKETS - 1);
+		     i++, limit_msec *= 10) {
+			if (msec < limit_msec)
 				break;
-			}
-			offset += msg_read;
 		}
-		if (msg_size == offset) {
-			rc = proc_req(
-				conn, msg, msg_size, first, &buffer, &uid);
-			first = false;
-			if (rc != SLURM_SUCCESS && rc != ACCOUNTING_FIRST_REG) {
-				error("Processing last message from "
-				      "connection %d(%s) uid(%d)",
-				      conn->newsockfd, conn->ip, uid);
-				if (rc == ESLURM_ACCESS_DENIED
-				    || rc == SLURM_PROTOCOL_VERSION_ERROR)
-					fini = true;
-			}
-		} else {
-			buffer = make_dbd_rc_msg(conn->rpc_version,
-						 SLURM_ERROR, "Bad offset", 0);
+		slurm_mutex_lock(&thread_count_lock);
+		queue->count++;
+		queue->wait_usec += wait_usec;
+		queue->run_usec += run_usec;
+		if (run_usec > queue->run_max_usec)
+			queue->run_max_usec = run_usec;
+		queue->latency_hist[i]++;
+		slurm_mutex_unlock(&thread_count_lock);
+	}
+
+	_free_server_thread(pthread_self());
+	return NULL;
+}
+
+/* Process the message read from a connection and send the response
+ * RET true if the connection should be closed */
+static bool _process_msg(rpc_conn_t *rpc_conn)
+{
+	slurmdbd_conn_t *conn = rpc_conn->conn;
+	Buf buffer = NULL;
+	bool fini = false;
+	int rc;
+
+	rc = proc_req(conn, rpc_conn->msg, rpc_conn->msg_size,
+		      rpc_conn->first, &buffer, &rpc_conn->uid);
+	rpc_conn->first = false;
+	if (rc != SLURM_SUCCESS && rc != ACCOUNTING_FIRST_REG) {
+		error("Processing last message from "
+		      "connection %d(%s) uid(%d)",
+		      conn->newsockfd, conn->ip, rpc_conn->uid);
+		if (rc == ESLURM_ACCESS_DENIED
+		    || rc == SLURM_PROTOCOL_VERSION_ERROR)
 			fini = true;
-		}
+	}
+	xfree(rpc_conn->msg);
 
-		rc = _send_resp(conn->newsockfd, buffer);
-		xfree(msg);
+	if (!buffer) {
+		buffer = make_dbd_rc_msg(conn->rpc_version, SLURM_ERROR,
+					 "Bad message", 0);
+		fini = true;
 	}
+	if (_send_resp(conn->newsockfd, buffer) != SLURM_SUCCESS)
+		fini = true;
+
+	return fini;
+}
+
+static void _close_conn(rpc_conn_t *rpc_conn)
+{
+	slurmdbd_conn_t *conn = rpc_conn->conn;
 
 	if (conn->ctld_port && !shutdown_time) {
 		slurmdb_cluster_rec_t cluster_rec;
@@ -263,12 +684,17 @@ static void * _service_connection(void *arg)
 	if (slurm_close_accepted_conn(conn->newsockfd) < 0)
 		error("close(%d): %m(%s)",  conn->newsockfd, conn->ip);
 	else
-		debug2("Closed connection %d uid(%d)", conn->newsockfd, uid);
+		debug2("Closed connection %d uid(%d)", conn->newsockfd,
+		       rpc_conn->uid);
 
 	xfree(conn->cluster_name);
 	xfree(conn);
-	_free_server_thread(pthread_self());
-	return NULL;
+	xfree(rpc_conn->msg);
+	xfree(rpc_conn);
+
+	slurm_mutex_lock(&thread_count_lock);
+	conn_count--;
+	slurm_mutex_unlock(&thread_count_lock);
 }
 
 /* Return a buffer containing a DBD_RC (return code) message
@@ -323,6 +749,16 @@ io_err:
 	return SLURM_ERROR;
 }
 
+/* Return time in usec from "start" to "end" */
+static int _delta_usec(struct timeval *start, struct timeval *end)
+{
+	int usec_delay;
+
+	usec_delay  = (end->tv_sec  - start->tv_sec) * 1000000;
+	usec_delay += (end->tv_usec - start->tv_usec);
+	return usec_delay;
+}
+
 /* Return time in msec since "start time" */
 static int _tot_wait (struct timeval *start_time)
 {
@@ -335,47 +771,6 @@ static int _tot_wait (struct timeval *start_time)
 	return msec_delay;
 }
 
-/* Wait until a file is readable, return false if can not be read */
-static bool _fd_readable(slurm_fd_t fd)
-{
-	struct pollfd ufds;
-	int rc;
-
-	ufds.fd     = fd;
-	ufds.events = POLLIN;
-	while (1) {
-		rc = poll(&ufds, 1, -1);
-		if (shutdown_time)
-			return false;
-		if (rc == -1) {
-			if ((errno == EINTR) || (errno == EAGAIN))
-				continue;
-			error("poll: %m");
-			return false;
-		}
-		if ((ufds.revents & POLLHUP) &&
-		    ((ufds.revents & POLLIN) == 0)) {
-			debug3("Read connection %d closed", fd);
-			return false;
-		}
-		if (ufds.revents & POLLNVAL) {
-			error("Connection %d is invalid", fd);
-			return false;
-		}
-		if (ufds.revents & POLLERR) {
-			error("Connection %d experienced an error", fd);
-			return false;
-		}
-		if ((ufds.revents & POLLIN) == 0) {
-			error("Connection %d events %d", fd, ufds.revents);
-			return false;
-		}
-		break;
-	}
-	errno = 0;
-	return true;
-}
-
 /* Wait until a file is writeable,
  * RET false if can not be written to within 5 seconds */
 extern bool fd_writeable(slurm_fd_t fd)
@@ -410,9 +805,12 @@ extern bool fd_writeable(slurm_fd_t fd)
 		 * If not then exit out and notify the sender.  This
  		 * is here since a write doesn't always tell you the
 		 * socket is gone, but getting 0 back from a
-		 * nonblocking read means just that.
+		 * nonblocking read means just that. Peek so the start of
+		 * a message the client has already pipelined behind this
+		 * one is left in place.
 		 */
-		if (ufds.revents & POLLHUP || (recv(fd, &temp, 1, 0) == 0)) {
+		if (ufds.revents & POLLHUP ||
+		    (recv(fd, &temp, 1, MSG_PEEK) == 0)) {
 			debug3("Write connection %d closed", fd);
 			return false;
 		}
@@ -434,58 +832,6 @@ extern bool fd_writeable(slurm_fd_t fd)
 	return true;
 }
 
-/* Increment thread_count and don't return until its value is no larger
- *	than MAX_THREAD_COUNT,
- * RET index of free index in slave_pthread_id or -1 to exit */
-static int _wait_for_server_thread(void)
-{
-	bool print_it = true;
-	int i, rc = -1;
-
-	slurm_mutex_lock(&thread_count_lock);
-	while (1) {
-		if (shutdown_time)
-			break;
-
-		if (thread_count < MAX_THREAD_COUNT) {
-			thread_count++;
-			for (i=0; i<MAX_THREAD_COUNT; i++) {
-				if (slave_thread_id[i])
-					continue;
-				rc = i;
-				break;
-			}
-			if (rc == -1) {
-				/* thread_count and slave_thread_id
-				 * out of sync */
-				fatal("No free slave_thread_id");
-			}
-			break;
-		} else {
-			/* wait for state change and retry,
-			 * just a delay and not an error.
-			 * This can happen when the epilog completes
-			 * on a bunch of nodes at the same time, which
-			 * can easily happen for highly parallel jobs. */
-			if (print_it) {
-				static time_t last_print_time = 0;
-				time_t now = time(NULL);
-				if (difftime(now, last_print_time) > 2) {
-					verbose("thread_count over "
-						"limit (%d), waiting",
-						thread_count);
-					last_print_time = now;
-				}
-				print_it = false;
-			}
-			pthread_cond_wait(&thread_count_cond,
-			                  &thread_count_lock);
-		}
-	}
-	slurm_mutex_unlock(&thread_count_lock);
-	return rc;
-}
-
 /* my_tid IN - Thread ID of spawned thread, 0 if no thread spawned */
 static void _free_server_thread(pthread_t my_tid)
 {
@@ -508,7 +854,6 @@ static void _free_server_thread(pthread_t my_tid)
 			error("Could not find slave_thread_id");
 	}
 
-	pthread_cond_broadcast(&thread_count_cond);
 	slurm_mutex_unlock(&thread_count_lock);
 }
 
@@ -55,4 +55,8 @@ extern void *rpc_mgr(void *no_data);
 /* Wake up the RPC manager so that it can exit */
 extern void rpc_mgr_wake(void);
 
+/* Return RPC statistics for each of the RPC manager's queues as a list of
+ * config_key_pair_t, caller must destroy the returned list */
+extern List rpc_mgr_get_stats(void);
+
 #endif /* !_RPC_MGR_H */
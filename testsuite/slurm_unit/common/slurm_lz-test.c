@@ -0,0 +1,256 @@
+/*****************************************************************************\
+ *  slurm_lz-test.c - unit tests for slurm_lz compression
+ *****************************************************************************
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#include <check.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "src/common/slurm_lz.h"
+#include "src/common/xmalloc.h"
+
+/*****************************************************************************
+ * DEFINITIONS
+ *****************************************************************************/
+
+#define TEST_LEN	(64 * 1024)
+
+static char *orig_buf = NULL;
+static char *comp_buf = NULL;
+static char *out_buf  = NULL;
+
+/* Text with plenty of short and long repeats */
+static uint32_t fill_text(char *buf, uint32_t len)
+{
+	uint32_t i = 0;
+	int n;
+
+	while (i < len) {
+		n = snprintf(buf + i, len - i, "JobId=%u Name=job%u State=%s\n",
+			     i % 997, i % 13, (i & 1) ? "RUNNING" : "PENDING");
+		if ((n < 0) || (i + n >= len))
+			break;
+		i += n;
+	}
+	return i;
+}
+
+/* Pseudo random bytes, which are not compressible */
+static void fill_random(char *buf, uint32_t len)
+{
+	uint32_t i, seed = 12345;
+
+	for (i = 0; i < len; i++) {
+		seed = seed * 1103515245 + 12345;
+		buf[i] = (char) (seed >> 16);
+	}
+}
+
+/* Compress and restore in_len bytes of orig_buf, return compressed size */
+static uint32_t round_trip(uint32_t in_len)
+{
+	uint32_t comp_len, out_len;
+
+	comp_len = slurm_lz_compress(orig_buf, in_len, comp_buf, TEST_LEN * 2);
+	fail_unless(comp_len != 0, "compression failed");
+	out_len = slurm_lz_decompress(comp_buf, comp_len, out_buf, TEST_LEN);
+	fail_unless(out_len == in_len, "restored length differs");
+	fail_unless(!memcmp(orig_buf, out_buf, in_len),
+		    "restored data differs");
+	return comp_len;
+}
+
+/*****************************************************************************
+ * FIXTURES
+ *****************************************************************************/
+
+static void setup(void)
+{
+	orig_buf = xmalloc(TEST_LEN);
+	comp_buf = xmalloc(TEST_LEN * 2);
+	out_buf  = xmalloc(TEST_LEN);
+}
+
+static void teardown(void)
+{
+	xfree(orig_buf);
+	xfree(comp_buf);
+	xfree(out_buf);
+}
+
+/*****************************************************************************
+ * UNIT TESTS
+ ****************************************************************************/
+
+START_TEST(test_empty)
+{
+	fail_unless(slurm_lz_compress(orig_buf, 0, comp_buf, TEST_LEN) == 0,
+		    "empty input was compressed");
+	fail_unless(slurm_lz_compress(orig_buf, 10, comp_buf, 0) == 0,
+		    "input was compressed into an empty buffer");
+	fail_unless(slurm_lz_decompress(comp_buf, 0, out_buf, TEST_LEN) == 0,
+		    "empty stream restored data");
+}
+END_TEST
+
+START_TEST(test_text)
+{
+	uint32_t len = fill_text(orig_buf, TEST_LEN);
+	uint32_t comp_len = round_trip(len);
+
+	fail_unless(comp_len < len / 2, "text did not compress");
+	/* Short inputs without any match */
+	round_trip(1);
+	round_trip(3);
+}
+END_TEST
+
+START_TEST(test_incompressible)
+{
+	uint32_t comp_len, out_len;
+
+	fill_random(orig_buf, TEST_LEN);
+	fail_unless(slurm_lz_compress(orig_buf, TEST_LEN, comp_buf,
+				      TEST_LEN) == 0,
+		    "random data fit in its own length");
+
+	/* Given room for the literal headers it must still round trip */
+	comp_len = round_trip(TEST_LEN);
+	fail_unless(comp_len <= TEST_LEN + TEST_LEN / 32 + 1,
+		    "literal overhead too large");
+	out_len = slurm_lz_decompress(comp_buf, comp_len, out_buf,
+				      TEST_LEN - 1);
+	fail_unless(out_len == 0, "output overran its buffer");
+}
+END_TEST
+
+START_TEST(test_max_match)
+{
+	uint32_t comp_len;
+
+	/* One literal then a single copy token of the longest length */
+	memset(orig_buf, 'a', 265);
+	comp_len = round_trip(265);
+	fail_unless(comp_len == 5, "longest match not used");
+
+	/* A long run stays within the ratio file_bcast accepts */
+	memset(orig_buf, 0, TEST_LEN);
+	comp_len = round_trip(TEST_LEN);
+	fail_unless((uint64_t) comp_len * SLURM_LZ_MAX_RATIO >= TEST_LEN,
+		    "ratio exceeds SLURM_LZ_MAX_RATIO");
+
+	/* Matches ending exactly at and just past the longest length */
+	memset(orig_buf, 'b', 266);
+	round_trip(266);
+	memset(orig_buf, 'c', 264 * 2 + 1);
+	round_trip(264 * 2 + 1);
+}
+END_TEST
+
+START_TEST(test_truncated)
+{
+	uint32_t len = fill_text(orig_buf, 4096);
+	uint32_t comp_len = round_trip(len), i, out_len;
+
+	for (i = 0; i < comp_len; i++) {
+		out_len = slurm_lz_decompress(comp_buf, i, out_buf, TEST_LEN);
+		fail_unless(out_len < len, "truncated stream fully restored");
+	}
+}
+END_TEST
+
+START_TEST(test_corrupt)
+{
+	/* Copy before the start of the output */
+	char far_ref[]  = { 0x00, 'x', 0x3f, (char) 0xff };
+	/* Copy token missing its offset byte */
+	char short_ref[] = { 0x00, 'x', 0x20 };
+	/* Long copy token missing its length and offset */
+	char short_long[] = { 0x00, 'x', (char) 0xe0 };
+	/* Literal run longer than the stream */
+	char short_lit[] = { 0x1f, 'x', 'y' };
+
+	fail_unless(slurm_lz_decompress(far_ref, sizeof(far_ref), out_buf,
+					TEST_LEN) == 0,
+		    "copy from before the output accepted");
+	fail_unless(slurm_lz_decompress(short_ref, sizeof(short_ref), out_buf,
+					TEST_LEN) == 0,
+		    "copy without offset accepted");
+	fail_unless(slurm_lz_decompress(short_long, sizeof(short_long),
+					out_buf, TEST_LEN) == 0,
+		    "long copy without length accepted");
+	fail_unless(slurm_lz_decompress(short_lit, sizeof(short_lit), out_buf,
+					TEST_LEN) == 0,
+		    "short literal run accepted");
+	/* A valid stream into too small a buffer */
+	memset(orig_buf, 'a', 265);
+	round_trip(265);
+	fail_unless(slurm_lz_decompress(comp_buf, 5, out_buf, 264) == 0,
+		    "copy overran the output");
+}
+END_TEST
+
+/*****************************************************************************
+ * TEST SUITE                                                                *
+ ****************************************************************************/
+
+Suite* slurm_lz_suite(void)
+{
+	Suite* s = suite_create("slurm_lz");
+	TCase* tc_core = tcase_create("Core");
+	tcase_add_checked_fixture(tc_core, setup, teardown);
+	tcase_add_test(tc_core, test_empty);
+	tcase_add_test(tc_core, test_text);
+	tcase_add_test(tc_core, test_incompressible);
+	tcase_add_test(tc_core, test_max_match);
+	tcase_add_test(tc_core, test_truncated);
+	tcase_add_test(tc_core, test_corrupt);
+	suite_add_tcase(s, tc_core);
+	return s;
+}
+
+/*****************************************************************************
+ * TEST RUNNER                                                               *
+ ****************************************************************************/
+
+int main(void)
+{
+    int number_failed;
+    SRunner* sr = srunner_create(slurm_lz_suite());
+
+    srunner_run_all(sr, CK_NORMAL);
+    number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,299 @@
+/*****************************************************************************\
+ *  slurmdbd_mult-test.c - unit tests for matching DBD_SEND_MULT_MSG replies
+ *	to the slurmdbd agent's queued records
+ *****************************************************************************
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#include <arpa/inet.h>
+#include <check.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "src/common/list.h"
+#include "src/common/pack.h"
+#include "src/common/slurmdbd_defs.h"
+#include "src/common/xmalloc.h"
+
+/*****************************************************************************
+ * DEFINITIONS
+ *****************************************************************************/
+
+#define PIPELINE_DEPTH	4
+#define REC_CNT		40
+
+/* A stand-in for slurmdbd. Records are committed in the order processed,
+ * fail_id fails once, and once a record fails no later batch on the same
+ * connection is processed. */
+static List     rec_list = NULL;		/* the agent's queue */
+static uint32_t committed[REC_CNT * 2];
+static int      commit_cnt = 0;
+static uint32_t fail_id = NO_VAL;
+static bool     conn_failed = false;
+static uint32_t next_id = 0;
+
+static void queue_rec(void)
+{
+	Buf rec = init_buf(64);
+
+	pack32(next_id++, rec);
+	list_enqueue(rec_list, rec);
+}
+
+static uint32_t rec_id(Buf rec)
+{
+	uint32_t id;
+
+	memcpy(&id, get_buf_data(rec), sizeof(id));
+	return ntohl(id);
+}
+
+static Buf rc_msg(uint32_t rc)
+{
+	dbd_rc_msg_t msg;
+	Buf buffer = init_buf(64);
+
+	memset(&msg, 0, sizeof(msg));
+	msg.return_code = rc;
+	msg.sent_type = DBD_JOB_START;
+	pack16((uint16_t) DBD_RC, buffer);
+	slurmdbd_pack_rc_msg(&msg, SLURM_PROTOCOL_VERSION, buffer);
+	set_buf_offset(buffer, 0);
+	return buffer;
+}
+
+/* Process one batch, return the return code of each record processed */
+static List dbd_process(List sent_list)
+{
+	List rc_list = list_create(slurmdbd_free_buffer);
+	ListIterator itr;
+	Buf rec;
+	uint32_t id;
+
+	if (conn_failed)
+		return rc_list;
+	itr = list_iterator_create(sent_list);
+	while ((rec = list_next(itr))) {
+		id = rec_id(rec);
+		if (id == fail_id) {
+			fail_id = NO_VAL;
+			conn_failed = true;
+			list_append(rc_list, rc_msg(SLURM_ERROR));
+			break;
+		}
+		committed[commit_cnt++] = id;
+		list_append(rc_list, rc_msg(SLURM_SUCCESS));
+	}
+	list_iterator_destroy(itr);
+	return rc_list;
+}
+
+/* Send up to PIPELINE_DEPTH batches of batch_size records as the agent
+ * does, queueing new_recs more records while they are in flight, then
+ * match the replies. RET true if every record sent was processed. */
+static bool agent_pass(int batch_size, int new_recs)
+{
+	List sent_list[PIPELINE_DEPTH], rc_list[PIPELINE_DEPTH];
+	ListIterator itr;
+	Buf rec;
+	int depth, i, queued = 0, done_cnt;
+	bool ok = true;
+
+	for (depth = 0; depth < PIPELINE_DEPTH; depth++) {
+		sent_list[depth] = list_create(NULL);
+		i = 0;
+		itr = list_iterator_create(rec_list);
+		while ((rec = list_next(itr))) {
+			if (i++ < queued)
+				continue;
+			list_enqueue(sent_list[depth], rec);
+			if (list_count(sent_list[depth]) >= batch_size)
+				break;
+		}
+		list_iterator_destroy(itr);
+		if (list_count(sent_list[depth]) == 0) {
+			list_destroy(sent_list[depth]);
+			break;
+		}
+		queued += list_count(sent_list[depth]);
+		/* slurmdbd works through batches as they arrive */
+		rc_list[depth] = dbd_process(sent_list[depth]);
+	}
+
+	for (i = 0; i < new_recs; i++)
+		queue_rec();
+
+	for (i = 0; i < depth; i++) {
+		if (ok) {
+			done_cnt = slurmdbd_mult_rc_remove(
+				rec_list, sent_list[i], rc_list[i],
+				SLURM_PROTOCOL_VERSION);
+			if (done_cnt != list_count(sent_list[i]))
+				ok = false;	/* agent reconnects */
+		}
+		list_destroy(rc_list[i]);
+		list_destroy(sent_list[i]);
+	}
+	conn_failed = false;
+	return ok;
+}
+
+/* Verify records were committed once each in the order queued, and those
+ * not yet committed are queued in order after them */
+static void check_order(void)
+{
+	ListIterator itr;
+	Buf rec;
+	int i;
+
+	for (i = 0; i < commit_cnt; i++)
+		fail_unless(committed[i] == i, "record committed out of order");
+	itr = list_iterator_create(rec_list);
+	while ((rec = list_next(itr)))
+		fail_unless(rec_id(rec) == i++, "queued record out of order");
+	list_iterator_destroy(itr);
+	fail_unless(i == next_id, "record lost");
+}
+
+/*****************************************************************************
+ * FIXTURES
+ *****************************************************************************/
+
+static void setup(void)
+{
+	int i;
+
+	rec_list = list_create(slurmdbd_free_buffer);
+	commit_cnt = 0;
+	fail_id = NO_VAL;
+	conn_failed = false;
+	next_id = 0;
+	for (i = 0; i < REC_CNT; i++)
+		queue_rec();
+}
+
+static void teardown(void)
+{
+	list_destroy(rec_list);
+	rec_list = NULL;
+}
+
+/*****************************************************************************
+ * UNIT TESTS
+ ****************************************************************************/
+
+START_TEST(test_all_done)
+{
+	fail_unless(agent_pass(8, 0), "pass failed");
+	fail_unless(commit_cnt == 32, "records not committed");
+	check_order();
+	fail_unless(agent_pass(8, 0), "pass failed");
+	fail_unless(list_count(rec_list) == 0, "records left queued");
+	check_order();
+}
+END_TEST
+
+START_TEST(test_mid_batch_failure)
+{
+	/* Fail the middle of the second of four batches in flight */
+	fail_id = 11;
+	fail_unless(!agent_pass(8, 0), "failure not reported");
+	fail_unless(commit_cnt == 11, "later batches were committed");
+	check_order();
+
+	while (list_count(rec_list))
+		fail_unless(agent_pass(8, 0), "retry failed");
+	fail_unless(commit_cnt == REC_CNT, "records not committed");
+	check_order();
+}
+END_TEST
+
+START_TEST(test_first_record_failure)
+{
+	fail_id = 0;
+	fail_unless(!agent_pass(5, 0), "failure not reported");
+	fail_unless(commit_cnt == 0, "records committed after failure");
+	check_order();
+
+	while (list_count(rec_list))
+		fail_unless(agent_pass(5, 0), "retry failed");
+	check_order();
+}
+END_TEST
+
+START_TEST(test_queued_in_flight)
+{
+	/* Records queued while batches await replies stay behind those
+	 * not processed */
+	fail_id = 20;
+	fail_unless(!agent_pass(8, 7), "failure not reported");
+	fail_unless(commit_cnt == 20, "later batches were committed");
+	check_order();
+
+	while (list_count(rec_list))
+		fail_unless(agent_pass(8, 0), "retry failed");
+	fail_unless(commit_cnt == next_id, "records not committed");
+	check_order();
+}
+END_TEST
+
+/*****************************************************************************
+ * TEST SUITE                                                                *
+ ****************************************************************************/
+
+Suite* slurmdbd_mult_suite(void)
+{
+	Suite* s = suite_create("slurmdbd_mult");
+	TCase* tc_core = tcase_create("Core");
+	tcase_add_checked_fixture(tc_core, setup, teardown);
+	tcase_add_test(tc_core, test_all_done);
+	tcase_add_test(tc_core, test_mid_batch_failure);
+	tcase_add_test(tc_core, test_first_record_failure);
+	tcase_add_test(tc_core, test_queued_in_flight);
+	suite_add_tcase(s, tc_core);
+	return s;
+}
+
+/*****************************************************************************
+ * TEST RUNNER                                                               *
+ ****************************************************************************/
+
+int main(void)
+{
+    int number_failed;
+    SRunner* sr = srunner_create(slurmdbd_mult_suite());
+
+    srunner_run_all(sr, CK_NORMAL);
+    number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}